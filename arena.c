@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 8
+
+void arena_init(Arena* arena, size_t chunk_size) {
+    arena->head = NULL;
+    arena->chunk_size = chunk_size;
+    arena->reserved = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaChunk* chunk = arena->head;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        // Las peticiones mayores que un bloque reciben un bloque propio
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+        if (!chunk) {
+            perror("Error al reservar memoria para el arena");
+            exit(1);
+        }
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->reserved += chunk_size;
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_adopt(Arena* dst, Arena* src) {
+    if (src->head == NULL) return;
+    ArenaChunk* tail = src->head;
+    while (tail->next != NULL) tail = tail->next;
+    // Los bloques adoptados van detrás para que dst siga reservando en el suyo
+    if (dst->head == NULL) {
+        dst->head = src->head;
+    } else {
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    }
+    dst->reserved += src->reserved;
+    src->head = NULL;
+    src->reserved = 0;
+}
+
+void arena_release(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->reserved = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bloque de memoria del arena. Las reservas se sirven avanzando 'used'.
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaChunk;
+
+// Reservador por bloques: no hay free individual, todo se libera a la vez
+// con arena_release. No es seguro entre hilos; cada worker usa el suyo.
+typedef struct {
+    ArenaChunk* head;
+    size_t chunk_size;
+    size_t reserved; // bytes pedidos al sistema (para estadísticas)
+} Arena;
+
+void arena_init(Arena* arena, size_t chunk_size);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+// Transfiere todos los bloques de src a dst; src queda vacío.
+void arena_adopt(Arena* dst, Arena* src);
+void arena_release(Arena* arena);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+#define CACHE_INITIAL_BUCKETS 1024
+
+// FNV-1a de 64 bits
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int cache_init(ResultCache* cache, size_t budget) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->budget = budget;
+    if (budget == 0) return 0;
+    cache->n_buckets = CACHE_INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->n_buckets, sizeof(CacheEntry*));
+    return cache->buckets ? 0 : 1;
+}
+
+static void free_entry(CacheEntry* entry) {
+    free(entry->key);
+    free(entry->values);
+    free(entry->page);
+    free(entry);
+}
+
+void cache_free(ResultCache* cache) {
+    cache_clear(cache);
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static void lru_unlink(ResultCache* cache, CacheEntry* entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+}
+
+static void lru_push(ResultCache* cache, CacheEntry* entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest) cache->newest->newer = entry;
+    cache->newest = entry;
+    if (!cache->oldest) cache->oldest = entry;
+}
+
+// Saca una entrada de la caché. Si algún hilo la está usando, se libera
+// cuando la suelte.
+static void remove_entry(ResultCache* cache, CacheEntry* entry) {
+    CacheEntry** link = &cache->buckets[entry->hash % cache->n_buckets];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    cache->n_entries--;
+    entry->removed = 1;
+    if (entry->refs == 0) free_entry(entry);
+}
+
+void cache_clear(ResultCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    while (cache->newest) remove_entry(cache, cache->newest);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Expulsa las entradas menos usadas hasta que 'extra' bytes más quepan en el
+// presupuesto. 'keep' no se expulsa.
+static void make_room(ResultCache* cache, size_t extra, const CacheEntry* keep) {
+    while (cache->bytes + extra > cache->budget && cache->oldest) {
+        CacheEntry* victim = cache->oldest;
+        if (victim == keep) {
+            victim = victim->newer;
+            if (!victim) return;
+        }
+        remove_entry(cache, victim);
+        cache->evictions++;
+    }
+}
+
+// Duplica los cubos cuando hay más entradas que cubos. Si no hay memoria se
+// sigue con las cadenas más largas.
+static void grow_buckets(ResultCache* cache) {
+    size_t n_buckets = cache->n_buckets * 2;
+    CacheEntry** buckets = calloc(n_buckets, sizeof(CacheEntry*));
+    if (!buckets) return;
+    for (size_t i = 0; i < cache->n_buckets; i++) {
+        CacheEntry* entry = cache->buckets[i];
+        while (entry) {
+            CacheEntry* next = entry->next;
+            entry->next = buckets[entry->hash % n_buckets];
+            buckets[entry->hash % n_buckets] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->n_buckets = n_buckets;
+}
+
+static CacheEntry* find_entry(ResultCache* cache, const char* key, uint64_t hash) {
+    for (CacheEntry* entry = cache->buckets[hash % cache->n_buckets]; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) return entry;
+    }
+    return NULL;
+}
+
+CacheEntry* cache_get(ResultCache* cache, const char* key) {
+    if (cache->budget == 0) return NULL;
+    uint64_t hash = hash_key(key);
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry* entry = find_entry(cache, key, hash);
+    if (entry) {
+        lru_unlink(cache, entry);
+        lru_push(cache, entry);
+        entry->refs++;
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+// Lo que cuenta para el presupuesto una entrada de n resultados
+static size_t entry_bytes(const char* key, size_t n) {
+    return sizeof(CacheEntry) + strlen(key) + 1 + n * sizeof(long);
+}
+
+int cache_fits(const ResultCache* cache, const char* key, size_t n) {
+    return cache->budget > 0 && n <= cache->budget / sizeof(long) && entry_bytes(key, n) <= cache->budget / 4;
+}
+
+CacheEntry* cache_put(ResultCache* cache, const char* key, long* values, size_t n) {
+    if (!cache_fits(cache, key, n)) return NULL;
+    size_t bytes = entry_bytes(key, n);
+
+    CacheEntry* entry = calloc(1, sizeof(CacheEntry));
+    char* copy = strdup(key);
+    if (!entry || !copy) {
+        free(entry);
+        free(copy);
+        return NULL;
+    }
+    entry->hash = hash_key(key);
+    pthread_mutex_lock(&cache->lock);
+    // Otro hilo ha resuelto la misma consulta a la vez y ya la ha guardado
+    if (find_entry(cache, key, entry->hash)) {
+        pthread_mutex_unlock(&cache->lock);
+        free(entry);
+        free(copy);
+        return NULL;
+    }
+    make_room(cache, bytes, NULL);
+    if (cache->n_entries >= cache->n_buckets) grow_buckets(cache);
+
+    entry->key = copy;
+    entry->values = values;
+    entry->n = n;
+    entry->bytes = bytes;
+    entry->next = cache->buckets[entry->hash % cache->n_buckets];
+    cache->buckets[entry->hash % cache->n_buckets] = entry;
+    lru_push(cache, entry);
+    entry->refs = 1;
+    cache->bytes += bytes;
+    cache->n_entries++;
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+void cache_release(ResultCache* cache, CacheEntry* entry) {
+    pthread_mutex_lock(&cache->lock);
+    if (--entry->refs == 0 && entry->removed) free_entry(entry);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+const char* cache_page(ResultCache* cache, CacheEntry* entry, size_t limit, size_t* len) {
+    pthread_mutex_lock(&cache->lock);
+    const char* page = entry->page && entry->page_limit == limit ? entry->page : NULL;
+    *len = entry->page_len;
+    pthread_mutex_unlock(&cache->lock);
+    return page;
+}
+
+int cache_set_page(ResultCache* cache, CacheEntry* entry, const char* page, size_t len, size_t limit) {
+    if (len > CACHE_PAGE_MAX) return 1;
+    char* copy = malloc(len + 1);
+    if (!copy) return 1;
+    memcpy(copy, page, len);
+
+    pthread_mutex_lock(&cache->lock);
+    // La página anterior solo se sustituye si nadie más tiene la entrada
+    if (entry->removed || entry->bytes - entry->page_len + len > cache->budget / 4 ||
+        (entry->page && entry->refs > 1)) {
+        pthread_mutex_unlock(&cache->lock);
+        free(copy);
+        return 1;
+    }
+    cache->bytes -= entry->page_len;
+    entry->bytes -= entry->page_len;
+    free(entry->page);
+    make_room(cache, len, entry);
+    entry->page = copy;
+    entry->page_len = len;
+    entry->page_limit = limit;
+    entry->bytes += len;
+    cache->bytes += len;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+void cache_stats(ResultCache* cache, CacheStats* stats) {
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->n_entries = cache->n_entries;
+    stats->bytes = cache->bytes;
+    stats->budget = cache->budget;
+    pthread_mutex_unlock(&cache->lock);
+}
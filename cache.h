@@ -0,0 +1,100 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Caché de resultados del motor. La clave es la forma canónica de la
+// consulta (query_key), así que "A;B" y "B;A" comparten entrada. Cada entrada
+// guarda la lista completa de resultados (row IDs u offsets) y, si se ha
+// pedido, la primera página ya formada, para responder sin leer el índice ni
+// data.csv.
+//
+// Las entradas se expulsan por LRU cuando los bytes usados superan el
+// presupuesto. Una entrada no puede ocupar más de un cuarto del presupuesto:
+// una consulta con millones de resultados no vacía la caché entera.
+//
+// La caché se comparte entre los workers del motor: cada operación toma su
+// mutex, y quien obtiene una entrada (cache_get, cache_put) la tiene
+// reservada hasta cache_release. Una entrada expulsada mientras alguien la
+// usa sale de la caché enseguida, pero no se libera hasta que la sueltan.
+
+// Tamaño máximo de la primera página que se guarda con una entrada
+#define CACHE_PAGE_MAX (64 * 1024)
+
+typedef struct CacheEntry {
+    char* key;
+    uint64_t hash;
+    long* values;
+    size_t n;
+    char* page;                     // Primera página formada (NULL si no hay)
+    size_t page_len;
+    size_t page_limit;              // Filas por página con que se formó
+    size_t bytes;                   // Lo que cuenta para el presupuesto
+    int refs;                       // Hilos que la están usando
+    int removed;                    // Ya no está en la caché (se libera con refs = 0)
+    struct CacheEntry* next;        // Siguiente en el mismo cubo
+    struct CacheEntry* newer;       // Lista LRU
+    struct CacheEntry* older;
+} CacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t budget;                  // Bytes; 0 desactiva la caché
+    size_t bytes;
+    size_t n_entries;
+    CacheEntry** buckets;
+    size_t n_buckets;
+    CacheEntry* newest;
+    CacheEntry* oldest;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} ResultCache;
+
+// Copia de los contadores (STATS)
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t n_entries;
+    size_t bytes;
+    size_t budget;
+} CacheStats;
+
+// 0 si va bien. Con budget = 0 la caché queda desactivada.
+int cache_init(ResultCache* cache, size_t budget);
+void cache_free(ResultCache* cache);
+// Descarta todas las entradas (por ejemplo, al cambiar el índice). Los
+// contadores se mantienen.
+void cache_clear(ResultCache* cache);
+
+// Busca una entrada y la marca como la más reciente. Cuenta un acierto o un
+// fallo. La entrada queda reservada hasta cache_release.
+CacheEntry* cache_get(ResultCache* cache, const char* key);
+
+// Si una lista de n resultados de la clave cabría en una entrada (un cuarto
+// del presupuesto como mucho)
+int cache_fits(const ResultCache* cache, const char* key, size_t n);
+
+// Guarda la lista de resultados de una clave. Si cabe (y otro hilo no la ha
+// guardado antes), la caché se queda con 'values' (reservado con malloc) y
+// devuelve la entrada reservada; si no, devuelve NULL y 'values' sigue
+// siendo de quien llama.
+CacheEntry* cache_put(ResultCache* cache, const char* key, long* values, size_t n);
+
+// Suelta una entrada de cache_get o cache_put.
+void cache_release(ResultCache* cache, CacheEntry* entry);
+
+// Primera página formada de la entrada si se formó con 'limit' filas por
+// página, o NULL. Vale mientras se tenga la entrada reservada.
+const char* cache_page(ResultCache* cache, CacheEntry* entry, size_t limit, size_t* len);
+
+// Guarda una copia de la primera página formada de una entrada. No sustituye
+// una página que otro hilo pueda estar enviando. 0 si va bien.
+int cache_set_page(ResultCache* cache, CacheEntry* entry, const char* page, size_t len, size_t limit);
+
+void cache_stats(ResultCache* cache, CacheStats* stats);
+
+#endif
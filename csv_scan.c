@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "csv_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+typedef const char* (*find_any3_fn)(const char*, const char*, char, char, char);
+
+static const char* find_any3_scalar(const char* p, const char* end, char a, char b, char c) {
+    while (p < end) {
+        char ch = *p;
+        if (ch == a || ch == b || ch == c) return p;
+        p++;
+    }
+    return end;
+}
+
+#ifdef __SSE2__
+// Compara 16 bytes a la vez contra los tres delimitadores y usa la máscara
+// resultante para saltar directamente al primero que aparezca.
+static const char* find_any3_sse2(const char* p, const char* end, char a, char b, char c) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+                                 _mm_cmpeq_epi8(v, vc));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return find_any3_scalar(p, end, a, b, c);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Igual que la versión SSE2 pero con bloques de 32 bytes.
+__attribute__((target("avx2")))
+static const char* find_any3_avx2(const char* p, const char* end, char a, char b, char c) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+                                    _mm256_cmpeq_epi8(v, vc));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return find_any3_sse2(p, end, a, b, c);
+}
+#endif
+
+static find_any3_fn find_any3_impl = find_any3_scalar;
+static const char* find_any3_name = "escalar";
+
+void csv_scan_init(void) {
+#ifdef __SSE2__
+    find_any3_impl = find_any3_sse2;
+    find_any3_name = "SSE2";
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        find_any3_impl = find_any3_avx2;
+        find_any3_name = "AVX2";
+    }
+#endif
+}
+
+const char* csv_scan_impl_name(void) {
+    return find_any3_name;
+}
+
+const char* csv_find_any3(const char* p, const char* end, char a, char b, char c) {
+    return find_any3_impl(p, end, a, b, c);
+}
+
+int csv_map_open(CsvMap* map, const char* filename) {
+    map->data = NULL;
+    map->size = 0;
+    map->fd = open(filename, O_RDONLY);
+    if (map->fd < 0) {
+        perror("Error al abrir el CSV");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(map->fd, &st) != 0) {
+        perror("Error al obtener el tamaño del CSV");
+        close(map->fd);
+        return 1;
+    }
+    map->size = (size_t)st.st_size;
+    if (map->size == 0) return 0; // mmap no admite longitud 0
+
+    void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+    if (data == MAP_FAILED) {
+        perror("Error al proyectar el CSV en memoria");
+        close(map->fd);
+        return 1;
+    }
+    // El CSV se recorre de principio a fin una sola vez
+    madvise(data, map->size, MADV_SEQUENTIAL);
+    map->data = data;
+    return 0;
+}
+
+void csv_map_release(const CsvMap* map, const char* from, const char* to) {
+    // madvise trabaja con páginas completas: se redondea hacia dentro
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)from + page - 1) & ~(page - 1);
+    uintptr_t end = (uintptr_t)to & ~(page - 1);
+    if (map->data && end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+}
+
+void csv_map_close(CsvMap* map) {
+    if (map->data) munmap((void*)map->data, map->size);
+    if (map->fd >= 0) close(map->fd);
+    map->data = NULL;
+    map->fd = -1;
+}
@@ -0,0 +1,27 @@
+#ifndef CSV_SCAN_H
+#define CSV_SCAN_H
+
+#include <stddef.h>
+
+// Archivo CSV proyectado en memoria (solo lectura).
+typedef struct {
+    const char* data;
+    size_t size;
+    int fd;
+} CsvMap;
+
+int csv_map_open(CsvMap* map, const char* filename);
+void csv_map_close(CsvMap* map);
+// Indica al kernel que las páginas de [from, to) ya no se van a leer.
+void csv_map_release(const CsvMap* map, const char* from, const char* to);
+
+// Selecciona la implementación (AVX2, SSE2 o escalar) según la CPU.
+// Debe llamarse una vez antes de usar csv_find_any3.
+void csv_scan_init(void);
+const char* csv_scan_impl_name(void);
+
+// Devuelve un puntero al primer byte de [p, end) igual a a, b o c,
+// o end si no hay ninguno.
+const char* csv_find_any3(const char* p, const char* end, char a, char b, char c);
+
+#endif
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zdict.h>
+#include "docstore.h"
+
+#define DICT_MAX_SAMPLES 20000
+#define DICT_MAX_SAMPLE_BYTES 4096
+#define DICT_SAMPLES_BUFFER (100 * DOCS_DICT_SIZE) // Lo que recomienda zstd: ~100x el diccionario
+
+static char* tmp_name(const char* filename) {
+    size_t len = strlen(filename);
+    char* name = malloc(len + 5);
+    memcpy(name, filename, len);
+    memcpy(name + len, ".tmp", 5);
+    return name;
+}
+
+// Entrena un diccionario con filas repartidas uniformemente por el CSV.
+// Devuelve su tamaño, o 0 si no hay suficientes datos para entrenarlo.
+static size_t train_dictionary(const char* csv, size_t size, void* dict) {
+    char* samples = malloc(DICT_SAMPLES_BUFFER);
+    size_t* sample_sizes = malloc(DICT_MAX_SAMPLES * sizeof(size_t));
+    unsigned n_samples = 0;
+    size_t total = 0;
+
+    // La cabecera del CSV no es representativa: se empieza tras ella
+    const char* first = memchr(csv, '\n', size);
+    size_t start = first ? (size_t)(first - csv) + 1 : size;
+    size_t step = (size - start) / DICT_MAX_SAMPLES;
+    if (step == 0) step = 1;
+
+    for (size_t pos = start; pos < size && n_samples < DICT_MAX_SAMPLES; ) {
+        const char* newline = memchr(csv + pos, '\n', size - pos);
+        size_t end = newline ? (size_t)(newline - csv) + 1 : size;
+        size_t len = end - pos;
+        if (len > DICT_MAX_SAMPLE_BYTES) len = DICT_MAX_SAMPLE_BYTES;
+        if (total + len > DICT_SAMPLES_BUFFER) break;
+        memcpy(samples + total, csv + pos, len);
+        sample_sizes[n_samples++] = len;
+        total += len;
+
+        // Siguiente muestra: la primera línea que empiece en pos + step o después
+        size_t target = pos + step;
+        if (target <= end) {
+            pos = end;
+        } else {
+            if (target > size) break;
+            newline = memchr(csv + target - 1, '\n', size - target + 1);
+            if (!newline) break;
+            pos = (size_t)(newline - csv) + 1;
+        }
+    }
+
+    size_t dict_size = 0;
+    if (n_samples >= 16) {
+        dict_size = ZDICT_trainFromBuffer(dict, DOCS_DICT_SIZE, samples, sample_sizes, n_samples);
+        if (ZDICT_isError(dict_size)) {
+            fprintf(stderr, "Aviso: no se pudo entrenar el diccionario (%s); se comprime sin él\n",
+                    ZDICT_getErrorName(dict_size));
+            dict_size = 0;
+        }
+    } else {
+        fprintf(stderr, "Aviso: muy pocas filas para entrenar un diccionario; se comprime sin él\n");
+    }
+    free(samples);
+    free(sample_sizes);
+    return dict_size;
+}
+
+int docstore_build(const char* filename, const char* csv, size_t size, int use_dict) {
+    char* tmp = tmp_name(filename);
+    FILE* out = fopen(tmp, "wb");
+    if (!out) {
+        perror("Error al crear el almacén de filas");
+        free(tmp);
+        return 1;
+    }
+
+    DocStoreHeader header = {0};
+    header.magic = DOCS_MAGIC;
+    header.version = DOCS_VERSION;
+    header.header_size = sizeof(DocStoreHeader);
+    header.csv_size = size;
+    header.block_size = use_dict ? DOCS_DICT_BLOCK_SIZE : DOCS_BLOCK_SIZE;
+
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_CDict* cdict = NULL;
+    void* dict = NULL;
+    size_t capacity = ZSTD_compressBound(header.block_size);
+    uint8_t* compressed = malloc(capacity);
+    DocBlock* blocks = NULL;
+    size_t blocks_capacity = 0;
+    int failed = !cctx || !compressed || fwrite(&header, sizeof(header), 1, out) != 1;
+
+    if (!failed && use_dict) {
+        dict = malloc(DOCS_DICT_SIZE);
+        header.dict_size = train_dictionary(csv, size, dict);
+        if (header.dict_size > 0) {
+            header.dict_offset = sizeof(DocStoreHeader);
+            cdict = ZSTD_createCDict(dict, header.dict_size, DOCS_ZSTD_LEVEL);
+            failed = !cdict || fwrite(dict, 1, header.dict_size, out) != header.dict_size;
+        }
+    }
+
+    uint64_t file_offset = sizeof(DocStoreHeader) + header.dict_size;
+    for (size_t pos = 0; pos < size && !failed; ) {
+        // El bloque acaba en el primer fin de línea a partir de block_size
+        size_t end = size;
+        if (size - pos > header.block_size) {
+            const char* newline = memchr(csv + pos + header.block_size - 1, '\n',
+                                         size - pos - header.block_size + 1);
+            if (newline) end = (size_t)(newline - csv) + 1;
+        }
+        size_t raw_size = end - pos;
+        if (raw_size > UINT32_MAX) {
+            fprintf(stderr, "Error: línea de más de 4 GB en data.csv\n");
+            failed = 1;
+            break;
+        }
+        if (ZSTD_compressBound(raw_size) > capacity) {
+            capacity = ZSTD_compressBound(raw_size);
+            compressed = realloc(compressed, capacity);
+        }
+
+        size_t bytes = cdict
+            ? ZSTD_compress_usingCDict(cctx, compressed, capacity, csv + pos, raw_size, cdict)
+            : ZSTD_compressCCtx(cctx, compressed, capacity, csv + pos, raw_size, DOCS_ZSTD_LEVEL);
+        if (ZSTD_isError(bytes)) {
+            fprintf(stderr, "Error al comprimir data.csv: %s\n", ZSTD_getErrorName(bytes));
+            failed = 1;
+            break;
+        }
+        if (fwrite(compressed, 1, bytes, out) != bytes) {
+            perror("Error al escribir el almacén de filas");
+            failed = 1;
+            break;
+        }
+
+        if (header.n_blocks == blocks_capacity) {
+            blocks_capacity = blocks_capacity ? blocks_capacity * 2 : 1024;
+            blocks = realloc(blocks, blocks_capacity * sizeof(DocBlock));
+        }
+        DocBlock* block = &blocks[header.n_blocks++];
+        block->csv_start = pos;
+        block->file_offset = file_offset;
+        block->compressed_size = (uint32_t)bytes;
+        block->raw_size = (uint32_t)raw_size;
+        file_offset += bytes;
+        pos = end;
+    }
+
+    // La tabla va al final; la cabecera se reescribe con su posición
+    header.table_offset = file_offset;
+    if (!failed &&
+        (fwrite(blocks, sizeof(DocBlock), header.n_blocks, out) != header.n_blocks ||
+         fseek(out, 0, SEEK_SET) != 0 ||
+         fwrite(&header, sizeof(header), 1, out) != 1)) {
+        perror("Error al escribir el almacén de filas");
+        failed = 1;
+    }
+    if (fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp, filename) != 0) {
+        perror("Error al renombrar el almacén de filas");
+        failed = 1;
+    }
+    if (failed) remove(tmp);
+
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeCCtx(cctx);
+    free(dict);
+    free(compressed);
+    free(blocks);
+    free(tmp);
+    return failed;
+}
+
+int docstore_open(DocStore* store, const char* filename) {
+    memset(store, 0, sizeof(*store));
+    store->file = fopen(filename, "rb");
+    if (!store->file) return 1;
+
+    DocStoreHeader* header = &store->header;
+    if (fread(header, sizeof(*header), 1, store->file) != 1 ||
+        header->magic != DOCS_MAGIC || header->version != DOCS_VERSION) {
+        fprintf(stderr, "Formato de %s no soportado\n", filename);
+        docstore_close(store);
+        return 1;
+    }
+
+    store->blocks = malloc((header->n_blocks ? header->n_blocks : 1) * sizeof(DocBlock));
+    int failed = !store->blocks ||
+                 fseek(store->file, (long)header->table_offset, SEEK_SET) != 0 ||
+                 fread(store->blocks, sizeof(DocBlock), header->n_blocks, store->file) != header->n_blocks;
+
+    if (!failed && header->dict_size > 0) {
+        void* dict = malloc(header->dict_size);
+        failed = !dict || fseek(store->file, (long)header->dict_offset, SEEK_SET) != 0 ||
+                 fread(dict, 1, header->dict_size, store->file) != header->dict_size;
+        if (!failed) {
+            store->ddict = ZSTD_createDDict(dict, header->dict_size);
+            failed = !store->ddict;
+        }
+        free(dict);
+    }
+    if (failed) {
+        fprintf(stderr, "Error al leer la tabla de bloques de %s\n", filename);
+        docstore_close(store);
+        return 1;
+    }
+    return 0;
+}
+
+void docstore_close(DocStore* store) {
+    if (store->file) fclose(store->file);
+    ZSTD_freeDDict(store->ddict);
+    free(store->blocks);
+    memset(store, 0, sizeof(*store));
+}
+
+void docstore_reader_init(DocReader* reader, const DocStore* store) {
+    memset(reader, 0, sizeof(*reader));
+    reader->store = store;
+    reader->cached_block = -1;
+}
+
+void docstore_reader_free(DocReader* reader) {
+    ZSTD_freeDCtx(reader->dctx);
+    free(reader->compressed);
+    free(reader->raw);
+    memset(reader, 0, sizeof(*reader));
+    reader->cached_block = -1;
+}
+
+// Lee con pread, que no mueve la posición del archivo compartido
+static int read_at(FILE* file, void* buffer, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fileno(file), (char*)buffer + done, size - done, (off_t)(offset + done));
+        if (n <= 0) return 1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Descomprime el bloque i salvo que sea el que ya está en memoria.
+static int load_block(DocReader* reader, size_t i) {
+    if (reader->cached_block == (long)i) return 0;
+    const DocStore* store = reader->store;
+    const DocBlock* block = &store->blocks[i];
+    if (!reader->dctx) reader->dctx = ZSTD_createDCtx();
+    if (block->compressed_size > reader->compressed_capacity) {
+        reader->compressed_capacity = block->compressed_size;
+        reader->compressed = realloc(reader->compressed, reader->compressed_capacity);
+    }
+    if (block->raw_size > reader->raw_capacity) {
+        reader->raw_capacity = block->raw_size;
+        reader->raw = realloc(reader->raw, reader->raw_capacity);
+    }
+    if (!reader->dctx || !reader->compressed || !reader->raw ||
+        read_at(store->file, reader->compressed, block->compressed_size, block->file_offset) != 0) {
+        reader->cached_block = -1;
+        return 1;
+    }
+    size_t raw = store->ddict
+        ? ZSTD_decompress_usingDDict(reader->dctx, reader->raw, reader->raw_capacity,
+                                     reader->compressed, block->compressed_size, store->ddict)
+        : ZSTD_decompressDCtx(reader->dctx, reader->raw, reader->raw_capacity,
+                              reader->compressed, block->compressed_size);
+    if (ZSTD_isError(raw) || raw != block->raw_size) {
+        reader->cached_block = -1;
+        return 1;
+    }
+    reader->cached_block = (long)i;
+    return 0;
+}
+
+int docstore_read_row(DocReader* reader, long offset, const char** row, size_t* len) {
+    const DocStore* store = reader->store;
+    if (offset < 0 || (uint64_t)offset >= store->header.csv_size || store->header.n_blocks == 0) {
+        return 0;
+    }
+
+    // Último bloque cuyo inicio es <= offset
+    size_t lo = 0, hi = store->header.n_blocks;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (store->blocks[mid].csv_start <= (uint64_t)offset) lo = mid;
+        else hi = mid;
+    }
+    if (load_block(reader, lo) != 0) return 0;
+
+    // Las filas nunca cruzan bloques: la fila llega hasta el '\n'
+    const DocBlock* block = &store->blocks[lo];
+    const char* start = reader->raw + (offset - (long)block->csv_start);
+    size_t available = block->raw_size - (size_t)(offset - (long)block->csv_start);
+    const char* newline = memchr(start, '\n', available);
+    *row = start;
+    *len = newline ? (size_t)(newline - start) + 1 : available;
+    return 1;
+}
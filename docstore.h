@@ -0,0 +1,87 @@
+#ifndef DOCSTORE_H
+#define DOCSTORE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zstd.h>
+
+// Copia comprimida de las filas de data.csv (dist/jobs.docs, index -z).
+//
+// El CSV se parte en bloques de unos block_size bytes que siempre terminan
+// en un fin de línea, y cada bloque se comprime con zstd por separado:
+//
+//   [DocStoreHeader][diccionario (opcional)][bloques zstd...][tabla de bloques]
+//
+// La tabla guarda, para cada bloque, en qué offset de data.csv empieza. Para
+// leer una fila basta una búsqueda binaria en la tabla y descomprimir un
+// único bloque; la posición de la fila dentro del bloque es la diferencia
+// de offsets, así que los offsets de jobs.idx sirven sin cambios.
+
+// "JOBDOCS" en little endian
+#define DOCS_MAGIC 0x53434F44424F4AULL
+#define DOCS_VERSION 1
+#define DOCS_BLOCK_SIZE (64 * 1024)
+#define DOCS_DICT_BLOCK_SIZE (16 * 1024) // Con diccionario compensan bloques más pequeños
+#define DOCS_DICT_SIZE (110 * 1024)
+#define DOCS_ZSTD_LEVEL 6
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t n_blocks;
+    uint64_t table_offset;
+    uint64_t dict_offset;
+    uint64_t dict_size;     // 0 si no hay diccionario
+    uint64_t csv_size;      // Bytes de data.csv cubiertos por los bloques
+    uint32_t block_size;
+    uint32_t flags;         // Reservado
+} DocStoreHeader;
+
+typedef struct {
+    uint64_t csv_start;         // Offset en data.csv del primer byte del bloque
+    uint64_t file_offset;       // Posición del bloque comprimido en jobs.docs
+    uint32_t compressed_size;
+    uint32_t raw_size;
+} DocBlock;
+
+// Comprime 'size' bytes del CSV en 'filename' (se escribe como .tmp y se
+// renombra al terminar). Con use_dict se entrena un diccionario con una
+// muestra de filas y se usan bloques de DOCS_DICT_BLOCK_SIZE.
+int docstore_build(const char* filename, const char* csv, size_t size, int use_dict);
+
+// Almacén abierto: la tabla de bloques y el diccionario, en solo lectura.
+// Se puede compartir entre hilos; cada uno lee con su propio DocReader.
+typedef struct {
+    FILE* file;
+    DocStoreHeader header;
+    DocBlock* blocks;
+    ZSTD_DDict* ddict;
+} DocStore;
+
+int docstore_open(DocStore* store, const char* filename);
+void docstore_close(DocStore* store);
+
+// Lector de un almacén: mantiene el último bloque descomprimido, porque los
+// resultados de una búsqueda suelen caer en bloques cercanos.
+typedef struct {
+    const DocStore* store;
+    ZSTD_DCtx* dctx;
+    uint8_t* compressed;
+    size_t compressed_capacity;
+    char* raw;
+    size_t raw_capacity;
+    long cached_block;  // -1 si no hay ninguno
+} DocReader;
+
+void docstore_reader_init(DocReader* reader, const DocStore* store);
+void docstore_reader_free(DocReader* reader);
+
+// Deja en *row y *len la fila que empieza en 'offset', entera y con su
+// '\n'. Apunta al bloque descomprimido del lector y vale hasta la siguiente
+// lectura. Devuelve 1 si la fila está en el almacén y 0 si no (offset fuera
+// de rango o error).
+int docstore_read_row(DocReader* reader, long offset, const char** row, size_t* len);
+
+#endif
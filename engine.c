@@ -1,287 +1,3377 @@
+#define _GNU_SOURCE // accept4 y cerrojos de lectura/escritura que dan prioridad al escritor
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
+#include <errno.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include "index_format.h"
+#include "postings.h"
+#include "index_reader.h"
+#include "segments.h"
+#include "docstore.h"
+#include "rowstore.h"
+#include "forward.h"
+#include "suggest.h"
+#include "fuzzy.h"
+#include "pairs.h"
+#include "roaring.h"
+#include "intersect.h"
+#include "query.h"
+#include "cache.h"
+#include "workpool.h"
+#include "protocol.h"
 
 #define PORT 5050
 #define BUFFER_SIZE 1024
 #define HOST "127.0.0.1" // Should always be localhost
-#define BACKLOG 8
-#define SKILL_DIR_FILE "dist/jobs.skl"
-#define INDEX_FILE "dist/jobs.idx"
+#define BACKLOG 4096
+#define SKILL_DIR_FILE BASE_SKL_FILE
+#define INDEX_FILE BASE_IDX_FILE
+#define DOCS_FILE "dist/jobs.docs"
+#define ROWS_FILE "dist/jobs.rows"
+#define FORWARD_FILE "dist/jobs.fwd"
+#define SUGGEST_FILE "dist/jobs.sug"
+#define FUZZY_FILE "dist/jobs.fzy"
+#define PAIRS_FILE "dist/jobs.pairs.skl"
+// Si la siguiente lista tiene al menos GALLOP_RATIO veces más valores que la
+// intersección actual, se busca cada valor por galope en lugar de recorrerla
+#define GALLOP_RATIO 16
 
-int serverFd = -1;
-int clientFd = -1;
+// Un AND de skills cuya lista más corta tiene al menos PARALLEL_MIN_POSTINGS
+// valores se interseca por rangos de row IDs en varios hilos: unos
+// PARALLEL_RANGES_PER_THREAD rangos por hilo, de al menos PARALLEL_MIN_RANGE
+// filas cada uno
+#define PARALLEL_MIN_POSTINGS 100000
+#define PARALLEL_RANGES_PER_THREAD 4
+#define PARALLEL_MIN_RANGE 65536
 
-// Estructura para guardar metadatos de un criterio de búsqueda
+// Páginas de resultados: una petición que empieza por
+// "PAGE <límite> <cursor>\n" recibe "OK <total> <n> <siguiente cursor>\n" y
+// n filas. Las peticiones sin cabecera reciben hasta LEGACY_RESPONSE_SIZE
+// bytes de filas seguidas, como antes.
+#define PAGE_HEADER "PAGE "
+#define MAX_PAGE_SIZE 1000
+#define LEGACY_RESPONSE_SIZE 8192
+// Las respuestas antiguas leen las filas de jobs.rows en lotes de este tamaño
+#define LEGACY_ROW_BATCH 32
+
+// Petición de las estadísticas de la caché de resultados
+#define STATS_REQUEST "STATS\n"
+
+// Conteos sin leer filas: "COUNT\n<consulta>" recibe "OK <total>\n", y
+// "FACET <n>\n<consulta>" recibe "OK <total> <k>\n" y las k (hasta n)
+// skills que más se repiten entre los resultados, "<veces> <skill>\n" cada
+// una, sin contar las de la propia consulta
+#define COUNT_REQUEST "COUNT\n"
+#define FACET_HEADER "FACET "
+#define MAX_FACET_SIZE 100
+
+// Una skill sin comillas se amplía con, como mucho, EXPAND_MAX_SKILLS
+// variantes: las de su misma clave normalizada o, si no hay ninguna y la
+// skill no existe, las más frecuentes entre las EXPAND_MAX_MATCHES que están
+// a la menor distancia de edición encontrada (ver fuzzy.h)
+#define EXPAND_MAX_SKILLS 16
+#define EXPAND_MAX_MATCHES 256
+
+// Autocompletado: "SUGGEST <n>\n<prefijo>" recibe "OK <k>\n" y las k (hasta
+// n, como mucho SUG_TOP_K) skills de la base con más filas que empiezan por
+// el prefijo, "<filas> <skill>\n" cada una
+#define SUGGEST_HEADER "SUGGEST "
+
+// Un lote (PROTO_BATCH, ver protocol.h) carga entera, una sola vez, la lista
+// de cada skill distinta que aparece en sus consultas, hasta este número de
+// valores entre todas
+#define BATCH_MAX_VALUES (16 * 1024 * 1024)
+
+// Presupuesto por defecto de la caché de resultados (engine -C <MB>)
+#define DEFAULT_CACHE_MB 64
+
+// Workers que resuelven las consultas (engine -j <n>; por defecto, uno por
+// CPU) y eventos que se recogen de epoll en cada vuelta del bucle
+#define MAX_WORKERS 256
+#define MAX_EVENTS 256
+
+// Tras enviar una respuesta, la conexión conserva su buffer de salida si no
+// pasa de este tamaño
+#define OUTPUT_KEEP_SIZE (64 * 1024)
+
+// Una conexión binaria deja de leer marcos con MAX_IN_FLIGHT peticiones en
+// curso o más de MAX_PENDING_OUTPUT bytes de respuestas sin enviar
+#define MAX_IN_FLIGHT 64
+#define MAX_PENDING_OUTPUT (4 * 1024 * 1024)
+
+int serverFd = -1;  // Protocolo de texto (PORT)
+int binaryFd = -1;  // Protocolo binario (PROTO_PORT, ver protocol.h)
+int epollFd = -1;
+int wakeFd = -1;    // eventfd con el que los workers avisan al bucle de eventos
+
+// Modo mmap (engine -M): jobs.skl, jobs.idx y data.csv se proyectan en
+// memoria una vez y cada búsqueda lee directamente de los mapas, sin fseek
+// ni fread. Por defecto el motor lee con stdio para gastar la mínima memoria.
+int use_mmap = 0;
+
+// Registro detallado (engine -v): cómo se resuelve cada consulta (caché,
+// plan, ampliación de skills, parejas, reparto por rangos). Por defecto no se
+// escribe nada por consulta, porque cuesta más que la consulta misma.
+int verbose = 0;
+
+// data.csv proyectado en memoria (modo mmap). Se vuelve a proyectar si el
+// archivo cambia; como solo crece por el final, los offsets siguen valiendo.
+const char* csv_map = NULL;
+size_t csv_map_size = 0;
+struct stat csv_stat;
+
+// Hilos que ayudan a intersecar las consultas grandes (engine -P <n>; por
+// defecto, uno menos que CPUs). Con 0 cada consulta usa solo su worker.
+WorkPool query_pool;
+
+// Resultados de las consultas más usadas (ver cache.h). Se vacía cada vez
+// que cambian los archivos del índice.
+ResultCache result_cache;
+
+// Almacén de filas comprimido. Se abre en la primera búsqueda y se vuelve a
+// abrir si el archivo cambia (por ejemplo, tras reindexar).
+DocStore doc_store;
+int doc_store_loaded = 0;
+struct stat doc_store_stat;
+
+// Almacén de filas por row ID (formato 4 sin -z), con el mismo ciclo de vida.
+// En modo mmap también se proyecta.
+RowStore row_store;
+int row_store_loaded = 0;
+struct stat row_store_stat;
+
+// Estructura para guardar metadatos de un criterio de búsqueda. La lista de
+// una skill puede estar repartida entre la base y los segmentos delta. Un
+// criterio también puede ser una pareja materializada (ver pairs.h), con su
+// única parte en el índice de parejas en lugar de en la base.
+typedef struct {
+    char* skill;
+    size_t count;                   // Total entre todos los segmentos
+    int bitmap;                     // Alguna parte está guardada como Roaring
+    int pair;                       // Pareja materializada
+    SkillEntry parts[MAX_SEGMENTS]; // count = 0 si la skill no está en el segmento
+} Criterion;
+
+// Resultado parcial de una intersección: una lista ordenada de valores o,
+// mientras solo intervienen skills muy frecuentes, un bitmap Roaring.
+typedef struct {
+    int is_bitmap;
+    long* values;
+    size_t n;
+    Roaring bitmap;
+} PostingSet;
+
+// Un segmento abierto: la base o un delta
+typedef struct {
+    FILE* skl;
+    FILE* idx;
+    SkillDirInfo info;
+    void* skl_map;      // Modo mmap: archivos proyectados (NULL si no)
+    size_t skl_size;
+    void* idx_map;
+    size_t idx_size;
+    ForwardIndex forward;   // Skills por fila (formato 4), si has_forward
+    int has_forward;
+    SuggestIndex suggest;   // Autocompletado (solo la base), si has_suggest
+    int has_suggest;
+    FuzzyIndex fuzzy;       // Claves normalizadas y trigramas (solo la base), si has_fuzzy
+    int has_fuzzy;
+} Segment;
+
+// Base y deltas vigentes, en orden de rango de data.csv, y las parejas
+// materializadas de la base si las hay
+typedef struct {
+    Segment segments[MAX_SEGMENTS];
+    int n;
+    Segment pairs;
+    int has_pairs;
+} IndexView;
+
+// Proyecta un archivo abierto completo con el consejo de acceso indicado.
+// Devuelve NULL si no se puede (el archivo se sigue leyendo con stdio).
+static void* map_file(FILE* file, size_t* size, int advice) {
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || st.st_size == 0) return NULL;
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+    if (data == MAP_FAILED) {
+        perror("Error al proyectar el índice en memoria");
+        return NULL;
+    }
+    madvise(data, (size_t)st.st_size, advice);
+    *size = (size_t)st.st_size;
+    return data;
+}
+
+static int open_segment(Segment* segment, const char* skl_name, const char* idx_name) {
+    segment->skl = fopen(skl_name, "rb");
+    segment->idx = fopen(idx_name, "rb");
+    segment->skl_map = segment->idx_map = NULL;
+    segment->has_forward = 0;
+    segment->has_suggest = 0;
+    segment->has_fuzzy = 0;
+    if (!segment->skl || !segment->idx || !read_skill_dir_header(segment->skl, &segment->info)) {
+        if (segment->skl) fclose(segment->skl);
+        if (segment->idx) fclose(segment->idx);
+        segment->skl = segment->idx = NULL;
+        return 0;
+    }
+    if (use_mmap) {
+        // El directorio se consulta en cada búsqueda: que se cargue ya. Las
+        // listas se leen a saltos, así que no interesa la lectura anticipada.
+        // Los archivos se sustituyen con rename y los deltas se borran con
+        // unlink, así que los mapas siguen siendo válidos hasta cerrarlos.
+        segment->skl_map = map_file(segment->skl, &segment->skl_size, MADV_WILLNEED);
+        segment->idx_map = map_file(segment->idx, &segment->idx_size, MADV_RANDOM);
+        if (segment->skl_map && segment->idx_map) {
+            set_index_maps(&segment->info, segment->skl_map, segment->skl_size, segment->idx_map,
+                           segment->idx_size);
+        }
+    }
+    if (segment->info.row_ids) {
+        // El .fwd se genera después del índice: uno que aún es del anterior
+        // no cuadra con el directorio y no se usa
+        char fwd_name[64];
+        forward_file_name(skl_name, fwd_name, sizeof(fwd_name));
+        const FwdHeader* header = &segment->forward.header;
+        segment->has_forward = forward_open(&segment->forward, fwd_name, use_mmap) == 0;
+        if (segment->has_forward && (header->first_row != segment->info.first_row ||
+                                     header->n_rows != segment->info.n_rows ||
+                                     header->n_skills != segment->info.total_skills)) {
+            forward_close(&segment->forward);
+            segment->has_forward = 0;
+        }
+    }
+    if (segment->info.front_coded) {
+        // Lo mismo con el .sug, que solo existe para la base
+        char sug_name[64];
+        suggest_file_name(skl_name, sug_name, sizeof(sug_name));
+        const SugHeader* header = &segment->suggest.header;
+        segment->has_suggest = suggest_open(&segment->suggest, sug_name) == 0;
+        if (segment->has_suggest && (header->n_skills != segment->info.total_skills ||
+                                     header->data_end != segment->info.data_end)) {
+            suggest_close(&segment->suggest);
+            segment->has_suggest = 0;
+        }
+        char fzy_name[64];
+        fuzzy_file_name(skl_name, fzy_name, sizeof(fzy_name));
+        const FzyHeader* fzy = &segment->fuzzy.header;
+        segment->has_fuzzy = fuzzy_open(&segment->fuzzy, fzy_name, use_mmap) == 0;
+        if (segment->has_fuzzy && (fzy->n_skills != segment->info.total_skills ||
+                                   fzy->data_end != segment->info.data_end)) {
+            fuzzy_close(&segment->fuzzy);
+            segment->has_fuzzy = 0;
+        }
+    }
+    return 1;
+}
+
+static void close_segment(Segment* segment) {
+    if (segment->skl_map) munmap(segment->skl_map, segment->skl_size);
+    if (segment->idx_map) munmap(segment->idx_map, segment->idx_size);
+    if (segment->has_forward) forward_close(&segment->forward);
+    if (segment->has_suggest) suggest_close(&segment->suggest);
+    if (segment->has_fuzzy) fuzzy_close(&segment->fuzzy);
+    fclose(segment->skl);
+    fclose(segment->idx);
+    free_skill_dir_info(&segment->info);
+}
+
+void close_index_view(IndexView* view) {
+    for (int i = 0; i < view->n; i++) close_segment(&view->segments[i]);
+    if (view->has_pairs) close_segment(&view->pairs);
+    view->n = 0;
+    view->has_pairs = 0;
+}
+
+// Abre las parejas materializadas de la base. Las de una base anterior (se
+// generan después de ella) no cuadran con sus filas y no se usan.
+static void open_pairs(IndexView* view) {
+    char pairs_skl[64], pairs_idx[64];
+    pairs_file_names(SKILL_DIR_FILE, pairs_skl, pairs_idx, sizeof(pairs_skl));
+    const SkillDirInfo* base = &view->segments[0].info;
+    view->has_pairs = base->row_ids && open_segment(&view->pairs, pairs_skl, pairs_idx);
+    if (view->has_pairs && (!view->pairs.info.row_ids || view->pairs.info.first_row != base->first_row ||
+                            view->pairs.info.n_rows != base->n_rows || view->pairs.info.data_end != base->data_end)) {
+        close_segment(&view->pairs);
+        view->has_pairs = 0;
+    }
+}
+
+// Abre la base y los deltas del manifiesto. Los deltas se abren antes que la
+// base: si una compactación termina entretanto, la base nueva ya los cubre y
+// se descartan por rango. Si un delta desaparece antes de abrirlo (lo acaba
+// de borrar una compactación) se vuelve a empezar con el manifiesto nuevo.
+int open_index_view(IndexView* view) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        SegmentManifest manifest;
+        view->n = 1;
+        int ok = segments_read(&manifest) == 0;
+        for (uint32_t i = 0; ok && i < manifest.n_segments; i++) {
+            char skl_name[64], idx_name[64];
+            segments_file_names(manifest.segments[i].id, skl_name, idx_name, sizeof(skl_name));
+            ok = open_segment(&view->segments[view->n], skl_name, idx_name);
+            if (ok) view->n++;
+        }
+        if (ok && open_segment(&view->segments[0], SKILL_DIR_FILE, INDEX_FILE)) {
+            // Quitar los deltas que ya están dentro de la base
+            uint64_t base_end = view->segments[0].info.data_end;
+            int kept = 1;
+            for (int i = 1; i < view->n; i++) {
+                if (view->segments[i].info.data_end <= base_end) {
+                    close_segment(&view->segments[i]);
+                } else {
+                    view->segments[kept++] = view->segments[i];
+                }
+            }
+            view->n = kept;
+            view->has_pairs = 0;
+            // Los valores de todas las listas deben ser del mismo tipo
+            for (int i = 1; i < view->n; i++) {
+                if (view->segments[i].info.row_ids != view->segments[0].info.row_ids) {
+                    close_index_view(view);
+                    return 0;
+                }
+            }
+            open_pairs(view);
+            return 1;
+        }
+        // Cerrar lo abierto (la base no llegó a abrirse) y reintentar
+        for (int i = 1; i < view->n; i++) close_segment(&view->segments[i]);
+        view->n = 0;
+    }
+    return 0;
+}
+
+// Busca la skill en todos los segmentos. Devuelve 1 si aparece en alguno.
+int find_criterion(IndexView* view, const char* skill, Criterion* criterion) {
+    criterion->count = 0;
+    criterion->bitmap = 0;
+    criterion->pair = 0;
+    for (int i = 0; i < view->n; i++) {
+        Segment* segment = &view->segments[i];
+        if (!find_skill_metadata(segment->skl, &segment->info, skill, &criterion->parts[i])) {
+            criterion->parts[i].count = 0;
+        }
+        criterion->count += criterion->parts[i].count;
+        if (postings_are_bitmap(&segment->info, &criterion->parts[i])) criterion->bitmap = 1;
+    }
+    if (criterion->count == 0) return 0;
+    criterion->skill = strdup(skill);
+    return 1;
+}
+
+// Segmento del que se lee la parte i de un criterio
+static Segment* criterion_segment(IndexView* view, const Criterion* criterion, int i) {
+    return i == 0 && criterion->pair ? &view->pairs : &view->segments[i];
+}
+
+// 1 si el segmento no puede tener valores de [lo, hi]: row IDs fuera de sus
+// filas o, en los formatos anteriores, offsets fuera de su rango de data.csv.
+static int segment_outside(const Segment* segment, long lo, long hi) {
+    const SkillDirInfo* info = &segment->info;
+    if (info->row_ids) {
+        return (long)(info->first_row + info->n_rows) <= lo || (long)info->first_row > hi;
+    }
+    return info->data_end > 0 && ((long)info->data_end <= lo || (long)info->data_start > hi);
+}
+
+// Carga la lista de un criterio concatenando la de cada segmento. Como los
+// segmentos cubren rangos consecutivos de data.csv, el resultado sale
+// ordenado. Solo interesan los valores de [lo, hi]: los segmentos que no
+// pueden tenerlos ni se leen.
+//
+// Los índices anteriores al formato 4 repiten el offset de una línea que
+// lista la misma skill dos veces; aquí se quitan esas repeticiones, porque
+// los kernels de intersect.c esperan listas sin repetidos.
+int load_criterion(IndexView* view, const Criterion* criterion, long lo, long hi, long* out, size_t* loaded) {
+    *loaded = 0;
+    for (int i = 0; i < view->n; i++) {
+        Segment* segment = criterion_segment(view, criterion, i);
+        if (criterion->parts[i].count == 0 || segment_outside(segment, lo, hi)) continue;
+        size_t n;
+        long* part = out + *loaded;
+        if (!load_postings(segment->idx, &segment->info, &criterion->parts[i], lo, hi, part, &n)) {
+            return 0;
+        }
+        if (segment->info.version < SKL_VERSION_ROWS && n > 1) {
+            size_t kept = 1;
+            for (size_t j = 1; j < n; j++) {
+                if (part[j] != part[kept - 1]) part[kept++] = part[j];
+            }
+            n = kept;
+        }
+        *loaded += n;
+    }
+    return 1;
+}
+
+// Como load_criterion, pero el resultado es un bitmap Roaring.
+int load_criterion_bitmap(IndexView* view, const Criterion* criterion, long lo, long hi, Roaring* out) {
+    for (int i = 0; i < view->n; i++) {
+        Segment* segment = criterion_segment(view, criterion, i);
+        if (criterion->parts[i].count == 0 || segment_outside(segment, lo, hi)) continue;
+        if (!load_bitmap_postings(segment->idx, &segment->info, &criterion->parts[i], lo, hi, out)) return 0;
+    }
+    return 1;
+}
+
+// Offset en data.csv de un resultado. En la versión 4 los resultados son row
+// IDs y se traducen con la tabla de filas del segmento que los contiene.
+int resolve_row(IndexView* view, long value, long* offset) {
+    for (int i = 0; i < view->n; i++) {
+        const SkillDirInfo* info = &view->segments[i].info;
+        if (!info->row_ids) {
+            *offset = value;
+            return 1;
+        }
+        if (lookup_row_offset(view->segments[i].idx, info, (uint64_t)value, offset)) return 1;
+    }
+    return 0;
+}
+
+// Vista del índice abierta. Se mantiene entre búsquedas para no volver a cargar
+// los índices dispersos de los directorios en cada consulta, y se reabre si
+// cambian la base o el manifiesto de segmentos (tras 'index -u' o 'index -c'),
+// o el índice de skills por fila de la base, que se genera después que ella.
+IndexView index_view;
+int index_view_loaded = 0;
+struct stat base_stat;
+struct stat manifest_stat;
+struct stat forward_stat;
+struct stat suggest_stat;
+struct stat fuzzy_stat;
+struct stat pairs_stat;
+
+// La vista del índice, el almacén de filas y data.csv proyectado se comparten
+// entre los workers en solo lectura. Cada búsqueda los usa con el cerrojo de
+// lectura; recargarlos porque han cambiado los archivos necesita el de
+// escritura, que espera a que terminen las búsquedas en curso.
+pthread_rwlock_t index_lock;
+
+static int same_file(const struct stat* a, const struct stat* b) {
+    return a->st_ino == b->st_ino && a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+// Las funciones get_* reabren lo que haya cambiado: solo se llaman con el
+// cerrojo de escritura, o antes de arrancar los workers.
+IndexView* get_index_view(void) {
+    struct stat base, manifest, forward, suggest, fuzzy, pairs;
+    if (stat(SKILL_DIR_FILE, &base) != 0) {
+        if (index_view_loaded) close_index_view(&index_view);
+        index_view_loaded = 0;
+        cache_clear(&result_cache);
+        return NULL;
+    }
+    if (stat(SEGMENTS_FILE, &manifest) != 0) memset(&manifest, 0, sizeof(manifest));
+    if (stat(FORWARD_FILE, &forward) != 0) memset(&forward, 0, sizeof(forward));
+    if (stat(SUGGEST_FILE, &suggest) != 0) memset(&suggest, 0, sizeof(suggest));
+    if (stat(FUZZY_FILE, &fuzzy) != 0) memset(&fuzzy, 0, sizeof(fuzzy));
+    if (stat(PAIRS_FILE, &pairs) != 0) memset(&pairs, 0, sizeof(pairs));
+    if (index_view_loaded && same_file(&base, &base_stat) && same_file(&manifest, &manifest_stat) &&
+        same_file(&forward, &forward_stat) && same_file(&suggest, &suggest_stat) &&
+        same_file(&fuzzy, &fuzzy_stat) && same_file(&pairs, &pairs_stat)) {
+        return &index_view;
+    }
+    // Índice nuevo: los resultados guardados ya no valen
+    if (index_view_loaded) close_index_view(&index_view);
+    cache_clear(&result_cache);
+    index_view_loaded = open_index_view(&index_view);
+    base_stat = base;
+    manifest_stat = manifest;
+    forward_stat = forward;
+    suggest_stat = suggest;
+    fuzzy_stat = fuzzy;
+    pairs_stat = pairs;
+    return index_view_loaded ? &index_view : NULL;
+}
+
+// Devuelve el almacén de filas comprimido, o NULL si no existe (índice
+// construido sin -z). Si el archivo ha cambiado desde la última vez se reabre.
+DocStore* get_doc_store(void) {
+    struct stat st;
+    if (stat(DOCS_FILE, &st) != 0) {
+        if (doc_store_loaded) docstore_close(&doc_store);
+        doc_store_loaded = 0;
+        memset(&doc_store_stat, 0, sizeof(doc_store_stat));
+        return NULL;
+    }
+    if (doc_store_loaded && st.st_ino == doc_store_stat.st_ino && st.st_size == doc_store_stat.st_size &&
+        st.st_mtime == doc_store_stat.st_mtime) {
+        return &doc_store;
+    }
+    if (doc_store_loaded) docstore_close(&doc_store);
+    doc_store_loaded = docstore_open(&doc_store, DOCS_FILE) == 0;
+    doc_store_stat = st;
+    return doc_store_loaded ? &doc_store : NULL;
+}
+
+// Devuelve el almacén de filas por row ID, o NULL si no existe. Igual que
+// get_doc_store, se reabre si el archivo ha cambiado.
+RowStore* get_row_store(void) {
+    struct stat st;
+    if (stat(ROWS_FILE, &st) != 0) {
+        if (row_store_loaded) rowstore_close(&row_store);
+        row_store_loaded = 0;
+        memset(&row_store_stat, 0, sizeof(row_store_stat));
+        return NULL;
+    }
+    if (row_store_loaded && same_file(&st, &row_store_stat)) return &row_store;
+    if (row_store_loaded) rowstore_close(&row_store);
+    row_store_loaded = rowstore_open(&row_store, ROWS_FILE, use_mmap) == 0;
+    row_store_stat = st;
+    return row_store_loaded ? &row_store : NULL;
+}
+
+static void posting_set_free(PostingSet* set) {
+    free(set->values);
+    if (set->is_bitmap) roaring_free(&set->bitmap);
+    memset(set, 0, sizeof(*set));
+}
+
+static int posting_set_empty(const PostingSet* set) {
+    return set->is_bitmap ? set->bitmap.n == 0 : set->n == 0;
+}
+
+// Rango de valores que puede tener un conjunto no vacío
+static void posting_set_bounds(const PostingSet* set, long* lo, long* hi) {
+    if (set->is_bitmap) {
+        uint32_t low, high;
+        roaring_bounds(&set->bitmap, &low, &high);
+        *lo = low;
+        *hi = high;
+    } else {
+        *lo = set->values[0];
+        *hi = set->values[set->n - 1];
+    }
+}
+
+// Intersección por galope de una lista corta con un criterio mucho más
+// largo: cada valor se busca con un cursor por segmento, que salta por la
+// tabla de saltos (o de frames) y solo decodifica los grupos donde cae.
+static int gallop_criterion(IndexView* view, PostingSet* set, const Criterion* criterion) {
+    PostingCursor cursor;
+    int part = 0, open = 0, ok = 1;
+    size_t kept = 0;
+    for (size_t i = 0; ok && i < set->n; i++) {
+        long value = 0;
+        int found = 0;
+        // Los segmentos cubren rangos crecientes: si la parte actual se acaba
+        // antes del valor, se pasa a la siguiente
+        while (part < view->n) {
+            Segment* segment = criterion_segment(view, criterion, part);
+            if (!open) {
+                if (criterion->parts[part].count == 0) {
+                    part++;
+                    continue;
+                }
+                if (!posting_cursor_open(&cursor, segment->idx, &segment->info, &criterion->parts[part])) {
+                    posting_cursor_close(&cursor);
+                    return 0;
+                }
+                open = 1;
+            }
+            found = posting_cursor_seek(&cursor, set->values[i], &value);
+            if (found != 0) break;
+            posting_cursor_close(&cursor);
+            open = 0;
+            part++;
+        }
+        if (found < 0) ok = 0;
+        if (part == view->n) break; // El criterio no tiene más valores
+        if (found == 1 && value == set->values[i]) set->values[kept++] = set->values[i];
+    }
+    if (open) posting_cursor_close(&cursor);
+    set->n = kept;
+    return ok;
+}
+
+// Intersecta 'set' con la lista de un criterio. Solo se lee la parte de la
+// lista que cae en el rango del conjunto, y el algoritmo depende de cómo
+// estén guardados los dos lados:
+//   - bitmap y bitmap: AND palabra a palabra (roaring_and)
+//   - lista y bitmap: se comprueba cada valor de la lista en el bitmap
+//   - lista y lista mucho más larga: galope (gallop_criterion)
+//   - lista y lista: dos punteros
+int intersect_criterion(IndexView* view, PostingSet* set, const Criterion* criterion) {
+    long lo, hi;
+    posting_set_bounds(set, &lo, &hi);
+
+    if (criterion->bitmap) {
+        Roaring other;
+        roaring_init(&other);
+        int ok = load_criterion_bitmap(view, criterion, lo, hi, &other);
+        if (ok && set->is_bitmap) {
+            Roaring both;
+            roaring_init(&both);
+            ok = roaring_and(&set->bitmap, &other, &both) == 0;
+            roaring_free(&set->bitmap);
+            set->bitmap = both;
+        } else if (ok) {
+            size_t kept = 0;
+            for (size_t i = 0; i < set->n; i++) {
+                if (roaring_contains(&other, (uint32_t)set->values[i])) set->values[kept++] = set->values[i];
+            }
+            set->n = kept;
+        }
+        roaring_free(&other);
+        return ok;
+    }
+
+    if (!set->is_bitmap && criterion->count / GALLOP_RATIO >= set->n) {
+        return gallop_criterion(view, set, criterion);
+    }
+
+    long* list = malloc(criterion->count * sizeof(long));
+    size_t list_size = 0;
+    if (!load_criterion(view, criterion, lo, hi, list, &list_size)) {
+        free(list);
+        return 0;
+    }
+    if (set->is_bitmap) {
+        // La lista es la parte pequeña: se queda con los valores del bitmap
+        size_t kept = 0;
+        for (size_t i = 0; i < list_size; i++) {
+            if (roaring_contains(&set->bitmap, (uint32_t)list[i])) list[kept++] = list[i];
+        }
+        roaring_free(&set->bitmap);
+        set->is_bitmap = 0;
+        set->values = list;
+        set->n = kept;
+        return 1;
+    }
+
+    // Recorrido de las dos listas, O(n+m), con el kernel SIMD de la CPU
+    long* both = malloc((set->n < list_size ? set->n : list_size) * sizeof(long) + sizeof(long));
+    if (!both) {
+        free(list);
+        return 0;
+    }
+    set->n = intersect2(set->values, set->n, list, list_size, both);
+    free(set->values);
+    free(list);
+    set->values = both;
+    return 1;
+}
+
+// Caso de tres criterios con listas de tamaño parecido: se cargan las dos
+// listas restantes y se intersecan con el conjunto en una sola pasada, sin
+// la intersección intermedia.
+int intersect_three(IndexView* view, PostingSet* set, const Criterion* second, const Criterion* third) {
+    long lo = set->values[0], hi = set->values[set->n - 1];
+    long* list2 = malloc(second->count * sizeof(long));
+    long* list3 = malloc(third->count * sizeof(long));
+    size_t n2 = 0, n3 = 0;
+    int ok = list2 && list3 && load_criterion(view, second, lo, hi, list2, &n2) &&
+             load_criterion(view, third, lo, hi, list3, &n3);
+    long* all = ok ? malloc(set->n * sizeof(long)) : NULL;
+    if (all) {
+        set->n = intersect3(set->values, set->n, list2, n2, list3, n3, all);
+        free(set->values);
+        set->values = all;
+    }
+    ok = all != NULL;
+    free(list2);
+    free(list3);
+    return ok;
+}
+
+// Posición del primer valor >= target de una lista ordenada
+static size_t lower_bound(const long* values, size_t n, long target) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Quita del conjunto los valores fuera de [lo, hi]: las listas se cargan por
+// grupos o contenedores enteros
+static void clip_posting_set(PostingSet* set, long lo, long hi) {
+    if (set->is_bitmap) {
+        roaring_clip(&set->bitmap, lo < 0 ? 0 : (uint32_t)lo, hi > (long)UINT32_MAX ? UINT32_MAX : (uint32_t)hi);
+        return;
+    }
+    size_t first = lower_bound(set->values, set->n, lo);
+    size_t end = hi == LONG_MAX ? set->n : lower_bound(set->values, set->n, hi + 1);
+    memmove(set->values, set->values + first, (end - first) * sizeof(long));
+    set->n = end - first;
+}
+
+// Carga la lista de la primera skill de un AND, la más selectiva. Si es de
+// una skill muy frecuente, se queda como bitmap para intersecarla con otros
+// bitmaps.
+static int load_first_term(IndexView* view, const Criterion* term, long lo, long hi, PostingSet* result) {
+    memset(result, 0, sizeof(*result));
+    if (term->bitmap) {
+        result->is_bitmap = 1;
+        roaring_init(&result->bitmap);
+        return load_criterion_bitmap(view, term, lo, hi, &result->bitmap);
+    }
+    result->values = malloc((term->count + 1) * sizeof(long));
+    return result->values && load_criterion(view, term, lo, hi, result->values, &result->n);
+}
+
+// 1 si el criterio se interseca con la lista del conjunto recorriéndola
+// entera (ni bitmap ni galope)
+static int merges_linearly(const PostingSet* set, const Criterion* criterion) {
+    return !set->is_bitmap && !criterion->bitmap && criterion->count / GALLOP_RATIO < set->n;
+}
+
+// Intersección de las skills de un AND, ya ordenadas de menos a más
+// frecuente, con los valores de [lo, hi]. Es el camino de las consultas con
+// solo ';': el conjunto empieza por la lista más corta y solo puede encoger,
+// así que se materializa y se usan los kernels de intersección, los bitmaps
+// y el galope.
+static int intersect_terms(IndexView* view, const Criterion** terms, int n, long lo, long hi,
+                           PostingSet* result) {
+    int ok = load_first_term(view, terms[0], lo, hi, result);
+
+    // Con tres listas que se recorren enteras, las tres a la vez
+    if (ok && n == 3 && !posting_set_empty(result) && merges_linearly(result, terms[1]) &&
+        merges_linearly(result, terms[2])) {
+        ok = intersect_three(view, result, terms[1], terms[2]);
+    } else {
+        for (int i = 1; ok && i < n && !posting_set_empty(result); i++) {
+            ok = intersect_criterion(view, result, terms[i]);
+        }
+    }
+    if (ok && result->is_bitmap) {
+        // El resultado se recorre en orden como lista
+        long* values = malloc((roaring_cardinality(&result->bitmap) + 1) * sizeof(long));
+        ok = values != NULL;
+        if (ok) result->n = roaring_to_array(&result->bitmap, values);
+        roaring_free(&result->bitmap);
+        result->is_bitmap = 0;
+        result->values = values;
+    }
+    if (ok && (lo != LONG_MIN || hi != LONG_MAX)) clip_posting_set(result, lo, hi);
+    return ok;
+}
+
+// Cuántos valores del conjunto están también en la lista de un criterio. Es
+// el último paso de count_terms: los mismos casos que intersect_criterion,
+// pero con los kernels que solo cuentan, sin formar el resultado.
+static int count_criterion(IndexView* view, PostingSet* set, const Criterion* criterion, size_t* count) {
+    long lo, hi;
+    posting_set_bounds(set, &lo, &hi);
+    *count = 0;
+
+    if (criterion->bitmap) {
+        Roaring other;
+        roaring_init(&other);
+        int ok = load_criterion_bitmap(view, criterion, lo, hi, &other);
+        if (ok && set->is_bitmap) {
+            *count = (size_t)roaring_and_cardinality(&set->bitmap, &other);
+        } else if (ok) {
+            for (size_t i = 0; i < set->n; i++) *count += roaring_contains(&other, (uint32_t)set->values[i]);
+        }
+        roaring_free(&other);
+        return ok;
+    }
+
+    // El galope deja las coincidencias en la propia lista, sin otra nueva
+    if (!set->is_bitmap && criterion->count / GALLOP_RATIO >= set->n) {
+        int ok = gallop_criterion(view, set, criterion);
+        *count = set->n;
+        return ok;
+    }
+
+    long* list = malloc((criterion->count + 1) * sizeof(long));
+    size_t list_size = 0;
+    int ok = list && load_criterion(view, criterion, lo, hi, list, &list_size);
+    if (ok && set->is_bitmap) {
+        for (size_t i = 0; i < list_size; i++) *count += roaring_contains(&set->bitmap, (uint32_t)list[i]);
+    } else if (ok) {
+        *count = intersect2_count(set->values, set->n, list, list_size);
+    }
+    free(list);
+    return ok;
+}
+
+// Como intersect_three, pero solo cuenta
+static int count_three(IndexView* view, const PostingSet* set, const Criterion* second, const Criterion* third,
+                       size_t* count) {
+    long lo = set->values[0], hi = set->values[set->n - 1];
+    long* list2 = malloc((second->count + 1) * sizeof(long));
+    long* list3 = malloc((third->count + 1) * sizeof(long));
+    size_t n2 = 0, n3 = 0;
+    int ok = list2 && list3 && load_criterion(view, second, lo, hi, list2, &n2) &&
+             load_criterion(view, third, lo, hi, list3, &n3);
+    if (ok) *count = intersect3_count(set->values, set->n, list2, n2, list3, n3);
+    free(list2);
+    free(list3);
+    return ok;
+}
+
+// Número de valores de [lo, hi] en la intersección de las skills de un AND,
+// sin materializarla entera: los pasos intermedios son los de
+// intersect_terms (el conjunto solo encoge) y el último solo cuenta.
+static int count_terms(IndexView* view, const Criterion** terms, int n, long lo, long hi, size_t* count) {
+    PostingSet set;
+    *count = 0;
+    int ok = load_first_term(view, terms[0], lo, hi, &set);
+    // El rango se recorta antes, para no contar lo que cae fuera
+    if (ok && (lo != LONG_MIN || hi != LONG_MAX)) clip_posting_set(&set, lo, hi);
+
+    if (ok && n == 1) {
+        *count = set.is_bitmap ? (size_t)roaring_cardinality(&set.bitmap) : set.n;
+    } else if (ok && n == 3 && !posting_set_empty(&set) && merges_linearly(&set, terms[1]) &&
+               merges_linearly(&set, terms[2])) {
+        ok = count_three(view, &set, terms[1], terms[2], count);
+    } else {
+        for (int i = 1; ok && i < n - 1 && !posting_set_empty(&set); i++) {
+            ok = intersect_criterion(view, &set, terms[i]);
+        }
+        if (ok && !posting_set_empty(&set)) ok = count_criterion(view, &set, terms[n - 1], count);
+    }
+    posting_set_free(&set);
+    return ok;
+}
+
+// Intersección por rangos: cada trozo de workpool_run es un rango de row
+// IDs, que carga solo su parte de cada lista (buscando sus límites en las
+// tablas de saltos, de frames o de contenedores) y la interseca por su
+// cuenta. Con 'counts', cada rango solo cuenta sus resultados.
+typedef struct {
+    IndexView* view;
+    const Criterion** terms;
+    int n;
+    long first;             // Primer row ID del primer rango
+    long width;             // Row IDs por rango
+    PostingSet* parts;      // Resultado de cada rango
+    size_t* counts;         // O su número de resultados
+    int* ok;
+} RangeIntersection;
+
+static void intersect_range(void* arg, size_t i) {
+    RangeIntersection* job = arg;
+    long lo = job->first + (long)i * job->width;
+    if (job->counts) {
+        job->ok[i] = count_terms(job->view, job->terms, job->n, lo, lo + job->width - 1, &job->counts[i]);
+        return;
+    }
+    PostingSet* part = &job->parts[i];
+    job->ok[i] = intersect_terms(job->view, job->terms, job->n, lo, lo + job->width - 1, part);
+    // El buffer se reservó para la lista entera: quedarse con lo usado
+    long* shrunk = job->ok[i] ? realloc(part->values, (part->n + 1) * sizeof(long)) : NULL;
+    if (shrunk) part->values = shrunk;
+}
+
+// Reparte el espacio de row IDs de la vista en rangos para el worker y los
+// hilos de query_pool. Devuelve cuántos, o 0 si la consulta no se reparte
+// (índice sin row IDs, lista más corta pequeña o sin hilos de ayuda).
+static long plan_ranges(IndexView* view, const Criterion* shortest, RangeIntersection* job) {
+    const SkillDirInfo* last = &view->segments[view->n - 1].info;
+    if (query_pool.n_threads == 0 || !view->segments[0].info.row_ids || shortest->count < PARALLEL_MIN_POSTINGS) {
+        return 0;
+    }
+    long first = (long)view->segments[0].info.first_row;
+    long rows = (long)(last->first_row + last->n_rows) - first;
+    long n_ranges = (long)(query_pool.n_threads + 1) * PARALLEL_RANGES_PER_THREAD;
+    if (n_ranges > rows / PARALLEL_MIN_RANGE) n_ranges = rows / PARALLEL_MIN_RANGE;
+    if (n_ranges < 2) return 0;
+    job->first = first;
+    job->width = (rows + n_ranges - 1) / n_ranges;
+    return n_ranges;
+}
+
+// Como intersect_terms, repartida en rangos (ver plan_ranges). Los
+// resultados de los rangos se concatenan en orden. Devuelve -1 si la
+// consulta no se reparte.
+static int intersect_terms_parallel(IndexView* view, const Criterion** terms, int n, PostingSet* result) {
+    RangeIntersection job = { view, terms, n, 0, 0, NULL, NULL, NULL };
+    long n_ranges = plan_ranges(view, terms[0], &job);
+    if (n_ranges == 0) return -1;
+    job.parts = calloc((size_t)n_ranges, sizeof(PostingSet));
+    job.ok = calloc((size_t)n_ranges, sizeof(int));
+    int ok = job.parts && job.ok;
+    if (ok) {
+        if (verbose) printf("Intersección en %ld rangos de %ld filas\n", n_ranges, job.width);
+        workpool_run(&query_pool, (size_t)n_ranges, intersect_range, &job);
+    }
+
+    // Concatenar en orden
+    size_t total = 0;
+    for (long i = 0; ok && i < n_ranges; i++) {
+        ok = job.ok[i];
+        total += job.parts[i].n;
+    }
+    memset(result, 0, sizeof(*result));
+    if (ok) result->values = malloc((total + 1) * sizeof(long));
+    ok = ok && result->values;
+    for (long i = 0; ok && i < n_ranges; i++) {
+        memcpy(result->values + result->n, job.parts[i].values, job.parts[i].n * sizeof(long));
+        result->n += job.parts[i].n;
+    }
+    for (long i = 0; job.parts && i < n_ranges; i++) posting_set_free(&job.parts[i]);
+    free(job.parts);
+    free(job.ok);
+    return ok;
+}
+
+// Como count_terms, repartida en rangos: se suman los conteos de cada uno.
+// Devuelve -1 si la consulta no se reparte.
+static int count_terms_parallel(IndexView* view, const Criterion** terms, int n, size_t* count) {
+    RangeIntersection job = { view, terms, n, 0, 0, NULL, NULL, NULL };
+    long n_ranges = plan_ranges(view, terms[0], &job);
+    if (n_ranges == 0) return -1;
+    job.counts = calloc((size_t)n_ranges, sizeof(size_t));
+    job.ok = calloc((size_t)n_ranges, sizeof(int));
+    int ok = job.counts && job.ok;
+    if (ok) {
+        if (verbose) printf("Conteo en %ld rangos de %ld filas\n", n_ranges, job.width);
+        workpool_run(&query_pool, (size_t)n_ranges, intersect_range, &job);
+    }
+    *count = 0;
+    for (long i = 0; ok && i < n_ranges; i++) {
+        ok = job.ok[i];
+        *count += job.counts[i];
+    }
+    free(job.counts);
+    free(job.ok);
+    return ok;
+}
+
+// Iterador sobre los valores (row IDs u offsets) de un nodo de la consulta,
+// en orden creciente. 'seek' avanza hasta el primer valor >= target y lo
+// devuelve en *value (1), o devuelve 0 si no quedan y -1 si hay un error de
+// lectura. Pedir un target que no pasa del último valor devuelto vuelve a dar
+// ese valor, así que el siguiente valor es seek(último + 1).
+//
+// Los resultados se piden de uno en uno hasta llenar la respuesta: un OR o
+// un AND con NOT no construyen listas intermedias y dejan de leer en cuanto
+// hay bastantes resultados.
+typedef struct QueryIterator {
+    int (*seek)(struct QueryIterator* it, long target, long* value);
+    void (*close)(struct QueryIterator* it);
+} QueryIterator;
+
+// Una skill: recorre sus partes de segmento en segmento. Las partes en
+// contenedores Roaring se cargan como bitmap; las demás con un cursor, que
+// con tabla de saltos solo decodifica los grupos por los que pasa.
+typedef struct {
+    QueryIterator base;
+    IndexView* view;
+    const Criterion* criterion;
+    int part;               // Segmento actual
+    int open;               // PART_CLOSED, PART_CURSOR o PART_BITMAP
+    PostingCursor cursor;
+    Roaring bitmap;
+    long last;              // Último valor devuelto (el bitmap no guarda posición)
+} TermIterator;
+
+#define PART_CLOSED 0
+#define PART_CURSOR 1
+#define PART_BITMAP 2
+
+static void term_close_part(TermIterator* term) {
+    if (term->open == PART_CURSOR) posting_cursor_close(&term->cursor);
+    if (term->open == PART_BITMAP) roaring_free(&term->bitmap);
+    term->open = PART_CLOSED;
+}
+
+static int term_seek(QueryIterator* it, long target, long* value) {
+    TermIterator* term = (TermIterator*)it;
+    IndexView* view = term->view;
+    if (target < term->last) target = term->last;
+    while (term->part < view->n) {
+        Segment* segment = criterion_segment(view, term->criterion, term->part);
+        const SkillEntry* entry = &term->criterion->parts[term->part];
+        if (term->open == PART_CLOSED) {
+            // Las partes sin la skill o con todas sus filas antes de target ni se abren
+            if (entry->count == 0 || segment_outside(segment, target, LONG_MAX)) {
+                term->part++;
+                continue;
+            }
+            if (postings_are_bitmap(&segment->info, entry)) {
+                term->open = PART_BITMAP;
+                roaring_init(&term->bitmap);
+                if (!load_bitmap_postings(segment->idx, &segment->info, entry, target, LONG_MAX, &term->bitmap)) {
+                    return -1;
+                }
+            } else {
+                term->open = PART_CURSOR;
+                if (!posting_cursor_open(&term->cursor, segment->idx, &segment->info, entry)) return -1;
+            }
+        }
+        int found;
+        if (term->open == PART_BITMAP) {
+            uint32_t row;
+            found = target <= (long)UINT32_MAX && roaring_seek(&term->bitmap, target > 0 ? (uint32_t)target : 0, &row);
+            if (found) *value = row;
+        } else {
+            found = posting_cursor_seek(&term->cursor, target, value);
+        }
+        if (found == 1) term->last = *value;
+        if (found != 0) return found;
+        term_close_part(term);
+        term->part++;
+    }
+    return 0;
+}
+
+static void term_close(QueryIterator* it) {
+    term_close_part((TermIterator*)it);
+    free(it);
+}
+
+// Resultado ya materializado de intersect_terms
+typedef struct {
+    QueryIterator base;
+    PostingSet set;
+    size_t pos;
+} SetIterator;
+
+static int set_seek(QueryIterator* it, long target, long* value) {
+    SetIterator* iterator = (SetIterator*)it;
+    const long* values = iterator->set.values;
+    size_t lo = iterator->pos, n = iterator->set.n;
+    size_t step = 1;
+    while (lo + step < n && values[lo + step - 1] < target) step *= 2;
+    size_t hi = lo + step < n ? lo + step : n;
+    if (step > 1) lo += step / 2;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    iterator->pos = lo;
+    if (lo == n) return 0;
+    *value = values[lo];
+    return 1;
+}
+
+static void set_close(QueryIterator* it) {
+    posting_set_free(&((SetIterator*)it)->set);
+    free(it);
+}
+
+// OR: mezcla de los hijos con un montículo de mínimos sobre su valor actual.
+// Los valores repetidos entre ramas salen una sola vez.
+typedef struct {
+    QueryIterator base;
+    QueryIterator** children;
+    int n;
+    long* heads;        // Valor actual de cada hijo
+    int* heap;          // Hijos que aún tienen valores
+    int n_heap;
+    int started;
+} OrIterator;
+
+static void or_sift_down(OrIterator* or_it, int i) {
+    int* heap = or_it->heap;
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < or_it->n_heap && or_it->heads[heap[left]] < or_it->heads[heap[smallest]]) smallest = left;
+        if (right < or_it->n_heap && or_it->heads[heap[right]] < or_it->heads[heap[smallest]]) smallest = right;
+        if (smallest == i) return;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static int or_seek(QueryIterator* it, long target, long* value) {
+    OrIterator* or_it = (OrIterator*)it;
+    if (!or_it->started) {
+        or_it->started = 1;
+        for (int i = 0; i < or_it->n; i++) {
+            int found = or_it->children[i]->seek(or_it->children[i], target, &or_it->heads[i]);
+            if (found < 0) return -1;
+            if (found) or_it->heap[or_it->n_heap++] = i;
+        }
+        for (int i = or_it->n_heap / 2 - 1; i >= 0; i--) or_sift_down(or_it, i);
+    }
+    while (or_it->n_heap > 0 && or_it->heads[or_it->heap[0]] < target) {
+        int child = or_it->heap[0];
+        int found = or_it->children[child]->seek(or_it->children[child], target, &or_it->heads[child]);
+        if (found < 0) return -1;
+        if (!found) or_it->heap[0] = or_it->heap[--or_it->n_heap];
+        or_sift_down(or_it, 0);
+    }
+    if (or_it->n_heap == 0) return 0;
+    *value = or_it->heads[or_it->heap[0]];
+    return 1;
+}
+
+static void or_close(QueryIterator* it) {
+    OrIterator* or_it = (OrIterator*)it;
+    for (int i = 0; i < or_it->n; i++) or_it->children[i]->close(or_it->children[i]);
+    free(or_it->children);
+    free(or_it->heads);
+    free(or_it->heap);
+    free(it);
+}
+
+// AND: los hijos positivos se alcanzan unos a otros con seek (del más
+// selectivo al menos) hasta coincidir en un valor, y solo entonces se
+// comprueba contra los NOT, que van al final.
+typedef struct {
+    QueryIterator base;
+    QueryIterator** children;
+    int n;
+    QueryIterator** excluded;   // Hijos de los NOT
+    int n_excluded;
+} AndIterator;
+
+static int and_seek(QueryIterator* it, long target, long* value) {
+    AndIterator* and_it = (AndIterator*)it;
+    long candidate = target;
+    while (1) {
+        int agreed = 0;
+        for (int i = 0; agreed < and_it->n; i = (i + 1) % and_it->n) {
+            long found_value;
+            int found = and_it->children[i]->seek(and_it->children[i], candidate, &found_value);
+            if (found <= 0) return found;
+            if (found_value == candidate) {
+                agreed++;
+            } else {
+                candidate = found_value;
+                agreed = 1;
+            }
+        }
+        int rejected = 0;
+        for (int i = 0; !rejected && i < and_it->n_excluded; i++) {
+            long found_value;
+            int found = and_it->excluded[i]->seek(and_it->excluded[i], candidate, &found_value);
+            if (found < 0) return -1;
+            rejected = found && found_value == candidate;
+        }
+        if (!rejected) {
+            *value = candidate;
+            return 1;
+        }
+        candidate++;
+    }
+}
+
+static void and_close(QueryIterator* it) {
+    AndIterator* and_it = (AndIterator*)it;
+    for (int i = 0; i < and_it->n; i++) and_it->children[i]->close(and_it->children[i]);
+    for (int i = 0; i < and_it->n_excluded; i++) and_it->excluded[i]->close(and_it->excluded[i]);
+    free(and_it->children);
+    free(and_it->excluded);
+    free(it);
+}
+
+// Metadatos de cada skill de la consulta. Las que no existen se quedan con
+// count = 0.
+static void find_query_terms(IndexView* view, const QueryNode* node, Criterion* criteria) {
+    if (node->op == QUERY_TERM) {
+        find_criterion(view, node->skill, &criteria[node->term]);
+        return;
+    }
+    for (int i = 0; i < node->n_children; i++) find_query_terms(view, node->children[i], criteria);
+}
+
+// Variante de una skill de la consulta
+typedef struct {
+    char* name;
+    int distance;
+    size_t count;
+} Variant;
+
+static int compare_variants(const void* a, const void* b) {
+    const Variant* x = a;
+    const Variant* y = b;
+    if (x->distance != y->distance) return x->distance - y->distance;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+// Amplía cada skill sin comillas de la consulta con sus variantes del
+// directorio de la base (ver EXPAND_MAX_SKILLS). Devuelve 0 si falla la
+// lectura del índice o no hay memoria.
+static int expand_query_terms(IndexView* view, QueryNode* node, int* n_terms) {
+    if (node->op != QUERY_TERM) {
+        for (int i = 0; i < node->n_children; i++) {
+            if (!expand_query_terms(view, node->children[i], n_terms)) return 0;
+        }
+        return 1;
+    }
+    Segment* base = &view->segments[0];
+    if (node->exact || !base->has_fuzzy || *n_terms >= QUERY_MAX_TERMS) return 1;
+
+    FuzzyMatch matches[EXPAND_MAX_MATCHES];
+    size_t n_matches;
+    if (fuzzy_lookup(&base->fuzzy, node->skill, 0, matches, EXPAND_MAX_MATCHES, &n_matches) != 0) return 0;
+    if (n_matches == 0) {
+        // Ni mayúsculas ni tildes: si la skill no existe, puede ser una errata
+        int found = 0;
+        SkillEntry entry;
+        for (int i = 0; i < view->n && !found; i++) {
+            found = find_skill_metadata(view->segments[i].skl, &view->segments[i].info, node->skill, &entry);
+        }
+        if (!found && fuzzy_lookup(&base->fuzzy, node->skill, -1, matches, EXPAND_MAX_MATCHES, &n_matches) != 0) {
+            return 0;
+        }
+        n_matches = fuzzy_nearest(matches, n_matches);
+    }
+
+    Variant variants[EXPAND_MAX_MATCHES];
+    size_t n_variants = 0;
+    char* name = NULL;
+    size_t capacity = 0;
+    int ok = 1;
+    for (size_t i = 0; ok && i < n_matches; i++) {
+        SkillEntry entry;
+        ok = read_skill_name(base->skl, &base->info, matches[i].number, &name, &capacity) &&
+             find_skill_metadata(base->skl, &base->info, name, &entry);
+        if (!ok || strcmp(name, node->skill) == 0) continue; // La propia skill ya está
+        ok = (variants[n_variants].name = strdup(name)) != NULL;
+        if (!ok) break;
+        variants[n_variants].distance = matches[i].distance;
+        variants[n_variants].count = entry.count;
+        n_variants++;
+    }
+    free(name);
+    if (ok && n_variants > 0) {
+        qsort(variants, n_variants, sizeof(Variant), compare_variants);
+        char* skills[EXPAND_MAX_SKILLS];
+        int n = 0;
+        for (size_t i = 0; i < n_variants && n < EXPAND_MAX_SKILLS; i++) skills[n++] = variants[i].name;
+        if (verbose) {
+            printf("Skill '%s' ampliada con %d variante%s%s\n", node->skill, n, n == 1 ? "" : "s",
+                   variants[0].distance == 0 ? "" : n == 1 ? " parecida" : " parecidas");
+        }
+        ok = query_expand_term(node, skills, n, n_terms);
+    }
+    for (size_t i = 0; i < n_variants; i++) free(variants[i].name);
+    return ok;
+}
+
+// Orden de los operandos de un AND: primero los positivos, de menos a más
+// filas estimadas; después los NOT, de más a menos, porque el que excluye
+// más filas es el que antes descarta un candidato.
+static int compare_plan(const void* a, const void* b) {
+    const QueryNode* nodeA = *(const QueryNode* const*)a;
+    const QueryNode* nodeB = *(const QueryNode* const*)b;
+    int notA = nodeA->op == QUERY_NOT, notB = nodeB->op == QUERY_NOT;
+    if (notA != notB) return notA - notB;
+    if (nodeA->cost == nodeB->cost) return 0;
+    return (nodeA->cost < nodeB->cost) == !notA ? -1 : 1;
+}
+
+// Planificador: estima las filas de cada nodo con el 'count' de cada skill
+// en jobs.skl (un AND, las de su operando positivo más pequeño; un OR, la
+// suma de sus ramas) y ordena los operandos de cada AND.
+static void plan_query(QueryNode* node, const Criterion* criteria) {
+    if (node->op == QUERY_TERM) {
+        node->cost = criteria[node->term].count;
+        return;
+    }
+    for (int i = 0; i < node->n_children; i++) plan_query(node->children[i], criteria);
+    if (node->op == QUERY_NOT) {
+        node->cost = node->children[0]->cost;
+    } else if (node->op == QUERY_OR) {
+        node->cost = 0;
+        for (int i = 0; i < node->n_children; i++) node->cost += node->children[i]->cost;
+    } else {
+        qsort(node->children, (size_t)node->n_children, sizeof(QueryNode*), compare_plan);
+        node->cost = node->children[0]->cost;
+    }
+}
+
+// Pareja de skills de un AND con su intersección materializada
+typedef struct {
+    int first;
+    int second;
+    SkillEntry entry;
+} PairMatch;
+
+static int compare_pair_matches(const void* a, const void* b) {
+    size_t x = ((const PairMatch*)a)->entry.count, y = ((const PairMatch*)b)->entry.count;
+    return x < y ? -1 : x > y;
+}
+
+// Sustituye las parejas de skills de un AND que están materializadas (ver
+// pairs.h) por su lista, empezando por la de menos filas. Solo valen las
+// skills que no tienen filas en los deltas. 'terms' queda de menos a más
+// frecuente y apunta a criterios de 'pairs', que tiene sitio para n / 2.
+// Devuelve el nuevo número de skills, o -1 si falla la lectura o la memoria.
+static int apply_pairs(IndexView* view, const Criterion** terms, int n, Criterion* pairs) {
+    if (!view->has_pairs || n < 2) return n;
+    int usable[QUERY_MAX_TERMS] = {0};
+    for (int i = 0; i < n && i < QUERY_MAX_TERMS; i++) {
+        usable[i] = terms[i]->count > 0 && !terms[i]->pair;
+        for (int k = 1; usable[i] && k < view->n; k++) usable[i] = terms[i]->parts[k].count == 0;
+    }
+    PairMatch* matches = malloc((size_t)n * (size_t)n / 2 * sizeof(PairMatch));
+    if (!matches) return -1;
+    size_t n_matches = 0;
+    for (int i = 0; i < n && i < QUERY_MAX_TERMS; i++) {
+        for (int j = i + 1; usable[i] && j < n && j < QUERY_MAX_TERMS; j++) {
+            if (!usable[j]) continue;
+            size_t size = strlen(terms[i]->skill) + strlen(terms[j]->skill) + 2;
+            char* key = malloc(size);
+            if (!key) {
+                free(matches);
+                return -1;
+            }
+            pairs_key(terms[i]->skill, terms[j]->skill, key, size);
+            PairMatch* match = &matches[n_matches];
+            if (find_skill_metadata(view->pairs.skl, &view->pairs.info, key, &match->entry)) {
+                match->first = i;
+                match->second = j;
+                n_matches++;
+            }
+            free(key);
+        }
+    }
+
+    // Cada skill entra en una sola pareja: primero las más selectivas
+    qsort(matches, n_matches, sizeof(PairMatch), compare_pair_matches);
+    int used[QUERY_MAX_TERMS] = {0};
+    int n_pairs = 0;
+    for (size_t i = 0; i < n_matches; i++) {
+        if (used[matches[i].first] || used[matches[i].second]) continue;
+        used[matches[i].first] = used[matches[i].second] = 1;
+        Criterion* pair = &pairs[n_pairs++];
+        memset(pair, 0, sizeof(*pair));
+        pair->pair = 1;
+        pair->count = matches[i].entry.count;
+        pair->bitmap = postings_are_bitmap(&view->pairs.info, &matches[i].entry);
+        pair->parts[0] = matches[i].entry;
+    }
+    free(matches);
+    if (n_pairs == 0) return n;
+    if (verbose) {
+        printf("AND con %d pareja%s materializada%s\n", n_pairs, n_pairs == 1 ? "" : "s", n_pairs == 1 ? "" : "s");
+    }
+
+    // Las parejas y las skills sueltas, otra vez de menos a más filas
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (i >= QUERY_MAX_TERMS || !used[i]) terms[kept++] = terms[i];
+    }
+    for (int i = 0; i < n_pairs; i++) {
+        int j = kept++;
+        while (j > 0 && terms[j - 1]->count > pairs[i].count) {
+            terms[j] = terms[j - 1];
+            j--;
+        }
+        terms[j] = &pairs[i];
+    }
+    return kept;
+}
+
+static QueryIterator* build_iterator(IndexView* view, const QueryNode* node, const Criterion* criteria);
+
+static OrIterator* or_iterator_new(int capacity) {
+    OrIterator* or_it = calloc(1, sizeof(OrIterator));
+    if (!or_it) return NULL;
+    or_it->base.seek = or_seek;
+    or_it->base.close = or_close;
+    or_it->children = malloc((size_t)capacity * sizeof(QueryIterator*));
+    or_it->heads = malloc((size_t)capacity * sizeof(long));
+    or_it->heap = malloc((size_t)capacity * sizeof(int));
+    if (!or_it->children || !or_it->heads || !or_it->heap) {
+        or_close(&or_it->base);
+        return NULL;
+    }
+    return or_it;
+}
+
+static AndIterator* and_iterator_new(int capacity) {
+    AndIterator* and_it = calloc(1, sizeof(AndIterator));
+    if (!and_it) return NULL;
+    and_it->base.seek = and_seek;
+    and_it->base.close = and_close;
+    and_it->children = malloc((size_t)capacity * sizeof(QueryIterator*));
+    and_it->excluded = malloc((size_t)capacity * sizeof(QueryIterator*));
+    if (!and_it->children || !and_it->excluded) {
+        and_close(&and_it->base);
+        return NULL;
+    }
+    return and_it;
+}
+
+// Rama principal de un grupo de variantes (la de más filas): es la que entra
+// en la intersección de las skills del AND. -1 si el nodo no es un grupo.
+static int main_variant(const QueryNode* node, const Criterion* criteria) {
+    if (node->op != QUERY_OR || !node->variants) return -1;
+    int best = 0;
+    for (int i = 1; i < node->n_children; i++) {
+        if (criteria[node->children[i]->term].count > criteria[node->children[best]->term].count) best = i;
+    }
+    return best;
+}
+
+// Ordena las skills de una intersección de menos a más frecuente
+static void sort_terms(const Criterion** terms, int n) {
+    for (int i = 1; i < n; i++) {
+        const Criterion* term = terms[i];
+        int j = i;
+        for (; j > 0 && terms[j - 1]->count > term->count; j--) terms[j] = terms[j - 1];
+        terms[j] = term;
+    }
+}
+
+// Skill suelta o grupo de variantes: va en la intersección de las skills
+static int is_set_operand(const QueryNode* node, const Criterion* criteria) {
+    return node->op == QUERY_TERM || main_variant(node, criteria) >= 0;
+}
+
+// Filas del AND que tienen alguna variante del grupo 'group' distinta de la
+// principal: AND de esas variantes con los demás operandos de la
+// intersección (los grupos con todas sus ramas). NULL si falla la lectura o
+// la memoria.
+static QueryIterator* build_variant_iterator(IndexView* view, const QueryNode* node, const QueryNode* group,
+                                             const Criterion* criteria) {
+    int main = main_variant(group, criteria);
+    OrIterator* variants = or_iterator_new(group->n_children);
+    AndIterator* and_it = and_iterator_new(node->n_children);
+    int ok = variants && and_it;
+    for (int i = 0; ok && i < group->n_children; i++) {
+        if (i == main || group->children[i]->cost == 0) continue;
+        QueryIterator* child = build_iterator(view, group->children[i], criteria);
+        ok = child != NULL;
+        if (ok) variants->children[variants->n++] = child;
+    }
+    if (ok) {
+        // Las variantes, lo más selectivo, primero
+        and_it->children[and_it->n++] = &variants->base;
+        variants = NULL;
+    }
+    for (int i = 0; ok && i < node->n_children; i++) {
+        const QueryNode* child = node->children[i];
+        if (child == group || !is_set_operand(child, criteria)) continue;
+        QueryIterator* iterator = build_iterator(view, child, criteria);
+        ok = iterator != NULL;
+        if (ok) and_it->children[and_it->n++] = iterator;
+    }
+    if (variants) or_close(&variants->base);
+    if (!ok && and_it) and_close(&and_it->base);
+    return ok ? &and_it->base : NULL;
+}
+
+// Iterador de un AND. Sus skills sueltas y la rama principal de cada grupo de
+// variantes se intersecan juntas con intersect_terms, con las parejas
+// materializadas en lugar de sus dos listas; las filas que solo tienen otras
+// variantes se añaden con build_variant_iterator. Los demás OR y los NOT se
+// unen con seek.
+static QueryIterator* build_and_iterator(IndexView* view, const QueryNode* node, const Criterion* criteria) {
+    AndIterator* and_it = and_iterator_new(node->n_children);
+    const Criterion** terms = malloc((size_t)node->n_children * sizeof(Criterion*));
+    Criterion* pairs = malloc(((size_t)node->n_children / 2 + 1) * sizeof(Criterion));
+    int n_terms = 0, n_extra = 0, ok = and_it && terms && pairs;
+    for (int i = 0; ok && i < node->n_children; i++) {
+        const QueryNode* child = node->children[i];
+        int main = main_variant(child, criteria);
+        if (child->op == QUERY_TERM) {
+            terms[n_terms++] = &criteria[child->term];
+        } else if (main >= 0) {
+            terms[n_terms++] = &criteria[child->children[main]->term];
+            if (child->cost > child->children[main]->cost) n_extra++;
+        }
+    }
+    // La rama principal de un grupo tiene menos filas que el grupo por el
+    // que se ordenó
+    sort_terms(terms, n_terms);
+    int n_skills = n_terms;
+    if (ok && n_terms > 1) {
+        n_terms = apply_pairs(view, terms, n_terms, pairs);
+        ok = n_terms > 0;
+    }
+
+    int placed = 0;
+    for (int i = 0; ok && i < node->n_children; i++) {
+        const QueryNode* child = node->children[i];
+        QueryIterator* iterator = NULL;
+        if (n_skills > 1 && is_set_operand(child, criteria)) {
+            // Las skills ocupan el lugar de la más selectiva; las demás ya van en ella
+            if (placed++) continue;
+            SetIterator* set_it = calloc(1, sizeof(SetIterator));
+            if (set_it) {
+                set_it->base.seek = set_seek;
+                set_it->base.close = set_close;
+                iterator = &set_it->base;
+                int done = intersect_terms_parallel(view, terms, n_terms, &set_it->set);
+                if (done < 0) done = intersect_terms(view, terms, n_terms, LONG_MIN, LONG_MAX, &set_it->set);
+                if (!done) {
+                    set_close(iterator);
+                    iterator = NULL;
+                }
+            }
+            OrIterator* with_variants = iterator && n_extra > 0 ? or_iterator_new(n_extra + 1) : NULL;
+            if (with_variants) {
+                with_variants->children[with_variants->n++] = iterator;
+                iterator = &with_variants->base;
+                for (int j = 0; iterator && j < node->n_children; j++) {
+                    const QueryNode* group = node->children[j];
+                    int main = main_variant(group, criteria);
+                    if (main < 0 || group->cost <= group->children[main]->cost) continue;
+                    QueryIterator* extra = build_variant_iterator(view, node, group, criteria);
+                    if (extra) {
+                        with_variants->children[with_variants->n++] = extra;
+                    } else {
+                        or_close(iterator);
+                        iterator = NULL;
+                    }
+                }
+            } else if (iterator && n_extra > 0) {
+                iterator->close(iterator);
+                iterator = NULL;
+            }
+        } else {
+            iterator = build_iterator(view, child->op == QUERY_NOT ? child->children[0] : child, criteria);
+        }
+        ok = iterator != NULL;
+        if (ok && child->op == QUERY_NOT) and_it->excluded[and_it->n_excluded++] = iterator;
+        else if (ok) and_it->children[and_it->n++] = iterator;
+    }
+    free(terms);
+    free(pairs);
+    if (!ok) {
+        if (and_it) and_close(&and_it->base);
+        return NULL;
+    }
+    if (and_it->n == 1 && and_it->n_excluded == 0) {
+        // Solo quedaba la intersección de las skills
+        QueryIterator* only = and_it->children[0];
+        and_it->n = 0;
+        and_close(&and_it->base);
+        return only;
+    }
+    return &and_it->base;
+}
+
+// Construye los iteradores de un árbol ya planificado. NULL si falla la
+// lectura o la memoria.
+static QueryIterator* build_iterator(IndexView* view, const QueryNode* node, const Criterion* criteria) {
+    if (node->op == QUERY_AND) return build_and_iterator(view, node, criteria);
+    if (node->op == QUERY_TERM) {
+        TermIterator* term = calloc(1, sizeof(TermIterator));
+        if (!term) return NULL;
+        term->base.seek = term_seek;
+        term->base.close = term_close;
+        term->view = view;
+        term->criterion = &criteria[node->term];
+        return &term->base;
+    }
+
+    // OR (los NOT solo aparecen dentro de un AND)
+    OrIterator* or_it = or_iterator_new(node->n_children);
+    int ok = or_it != NULL;
+    for (int i = 0; ok && i < node->n_children; i++) {
+        // Las ramas sin filas (skills que no existen) no hace falta ni abrirlas
+        if (node->children[i]->cost == 0) continue;
+        QueryIterator* child = build_iterator(view, node->children[i], criteria);
+        ok = child != NULL;
+        if (ok) or_it->children[or_it->n++] = child;
+    }
+    if (!ok) {
+        if (or_it) or_close(&or_it->base);
+        return NULL;
+    }
+    return &or_it->base;
+}
+
+// Modo mmap: devuelve data.csv proyectado, o NULL si no se puede. Si el
+// archivo ha cambiado desde la última vez se vuelve a proyectar.
+const char* get_csv_map(void) {
+    struct stat st;
+    if (stat("data.csv", &st) != 0 || st.st_size == 0) return NULL;
+    if (csv_map && same_file(&st, &csv_stat)) return csv_map;
+    if (csv_map) munmap((void*)csv_map, csv_map_size);
+    csv_map = NULL;
+    int fd = open("data.csv", O_RDONLY);
+    if (fd < 0) return NULL;
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error al proyectar data.csv en memoria");
+        return NULL;
+    }
+    // Solo se leen las filas de los resultados
+    madvise(data, (size_t)st.st_size, MADV_RANDOM);
+    csv_map = data;
+    csv_map_size = (size_t)st.st_size;
+    csv_stat = st;
+    return csv_map;
+}
+
+// 1 si alguno de los archivos que usan las búsquedas ha cambiado desde que
+// se abrió, con los mismos criterios que get_index_view, get_doc_store,
+// get_row_store y get_csv_map
+static int index_files_changed(void) {
+    struct stat st, manifest;
+    if (stat(SKILL_DIR_FILE, &st) != 0) {
+        if (index_view_loaded) return 1;
+    } else {
+        if (stat(SEGMENTS_FILE, &manifest) != 0) memset(&manifest, 0, sizeof(manifest));
+        if (!index_view_loaded || !same_file(&st, &base_stat) || !same_file(&manifest, &manifest_stat)) return 1;
+        if (stat(FORWARD_FILE, &st) != 0) memset(&st, 0, sizeof(st));
+        if (!same_file(&st, &forward_stat)) return 1;
+        if (stat(SUGGEST_FILE, &st) != 0) memset(&st, 0, sizeof(st));
+        if (!same_file(&st, &suggest_stat)) return 1;
+        if (stat(FUZZY_FILE, &st) != 0) memset(&st, 0, sizeof(st));
+        if (!same_file(&st, &fuzzy_stat)) return 1;
+        if (stat(PAIRS_FILE, &st) != 0) memset(&st, 0, sizeof(st));
+        if (!same_file(&st, &pairs_stat)) return 1;
+    }
+    // Un almacén que no se pudo abrir (por ejemplo, de una versión
+    // anterior) no se vuelve a intentar hasta que cambie el archivo
+    if (stat(DOCS_FILE, &st) != 0) {
+        if (doc_store_loaded) return 1;
+    } else if (!same_file(&st, &doc_store_stat)) {
+        return 1;
+    }
+    if (stat(ROWS_FILE, &st) != 0) {
+        if (row_store_loaded) return 1;
+    } else if (!same_file(&st, &row_store_stat)) {
+        return 1;
+    }
+    return use_mmap && stat("data.csv", &st) == 0 && st.st_size > 0 && !(csv_map && same_file(&st, &csv_stat));
+}
+
+// Toma el cerrojo de lectura del índice, reabriendo antes lo que haya
+// cambiado. Devuelve la vista (NULL si el índice no está disponible); en
+// los dos casos hay que llamar después a release_index_view.
+static IndexView* acquire_index_view(void) {
+    pthread_rwlock_rdlock(&index_lock);
+    if (index_files_changed()) {
+        pthread_rwlock_unlock(&index_lock);
+        pthread_rwlock_wrlock(&index_lock);
+        // Otro worker puede haberlo recargado ya; get_* solo reabren lo que
+        // siga sin coincidir
+        get_index_view();
+        get_doc_store();
+        get_row_store();
+        if (use_mmap) get_csv_map();
+        pthread_rwlock_unlock(&index_lock);
+        pthread_rwlock_rdlock(&index_lock);
+    }
+    return index_view_loaded ? &index_view : NULL;
+}
+
+static void release_index_view(void) {
+    pthread_rwlock_unlock(&index_lock);
+}
+
+// Fila del CSV proyectado que empieza en 'offset', entera y sin copiarla:
+// hasta su salto de línea (incluido) o el final del mapa. Devuelve 0 si el
+// offset queda fuera del mapa.
+static int read_mapped_row(long offset, const char** row, size_t* len) {
+    if (offset < 0 || (size_t)offset >= csv_map_size) return 0;
+    size_t available = csv_map_size - (size_t)offset;
+    const char* newline = memchr(csv_map + offset, '\n', available);
+    *row = csv_map + offset;
+    *len = newline ? (size_t)(newline - *row) + 1 : available;
+    return 1;
+}
+
+// Origen de las filas de los resultados: jobs.rows para las filas de la base
+// que cubre, leídas por lotes con fetch_result_rows; para las demás, el
+// almacén comprimido si existe, o data.csv (proyectado en modo mmap, con
+// stdio si no). Cada respuesta tiene el suyo, con sus propios lectores y su
+// propio FILE*.
+typedef struct {
+    const RowStore* rows;
+    RowReader row_reader;
+    RowFetch* fetched;          // Último lote, en el orden de los valores
+    size_t n_fetched;
+    size_t fetched_capacity;
+    const DocStore* store;
+    DocReader reader;
+    const char* csv_mapped;
+    FILE* csv_file;
+    char* line;                 // Última fila rehecha o leída con stdio, entera
+    size_t line_capacity;
+} RowSource;
+
+static void row_source_open(RowSource* source) {
+    source->rows = row_store_loaded ? &row_store : NULL;
+    rowstore_reader_init(&source->row_reader, source->rows);
+    source->fetched = NULL;
+    source->n_fetched = source->fetched_capacity = 0;
+    source->store = doc_store_loaded ? &doc_store : NULL;
+    docstore_reader_init(&source->reader, source->store);
+    source->csv_mapped = use_mmap ? csv_map : NULL;
+    source->csv_file = NULL;
+    source->line = NULL;
+    source->line_capacity = 0;
+}
+
+static void row_source_close(RowSource* source) {
+    rowstore_reader_free(&source->row_reader);
+    free(source->fetched);
+    docstore_reader_free(&source->reader);
+    if (source->csv_file) fclose(source->csv_file);
+    free(source->line);
+}
+
+// Lee de una vez de jobs.rows las filas de values[0..n), en orden creciente
+// de row ID. Solo vale si la base del índice usa row IDs; si no, o si la
+// lectura falla, el lote queda vacío y cada fila se lee con read_result_row.
+static void fetch_result_rows(IndexView* view, RowSource* source, const long* values, size_t n) {
+    source->n_fetched = 0;
+    if (!source->rows || n == 0 || !view->segments[0].info.row_ids) return;
+    if (n > source->fetched_capacity) {
+        RowFetch* bigger = realloc(source->fetched, n * sizeof(RowFetch));
+        if (!bigger) return;
+        source->fetched = bigger;
+        source->fetched_capacity = n;
+    }
+    for (size_t i = 0; i < n; i++) source->fetched[i].row = (uint64_t)values[i];
+    if (rowstore_fetch(&source->row_reader, source->fetched, n) != 0) {
+        perror("Error al leer las filas de jobs.rows");
+        return;
+    }
+    source->n_fetched = n;
+}
+
+// Deja en *row y *len la fila de data.csv de un resultado, entera y con su
+// salto de línea (la última de data.csv puede no tenerlo). Apunta al bloque
+// del almacén comprimido, al mapa o a source->line, y vale hasta la
+// siguiente fila. Devuelve 1 si la pudo leer.
+static int read_result_row(IndexView* view, RowSource* source, long value, const char** row, size_t* len) {
+    long offset;
+    if (!resolve_row(view, value, &offset)) return 0;
+    if (source->store && docstore_read_row(&source->reader, offset, row, len)) return 1;
+    if (source->csv_mapped && read_mapped_row(offset, row, len)) return 1;
+    if (!source->csv_file) source->csv_file = fopen("data.csv", "r");
+    // Saltar a la posición del offset en el archivo CSV y leer la línea completa
+    if (!source->csv_file || fseek(source->csv_file, offset, SEEK_SET) != 0) return 0;
+    ssize_t read = getline(&source->line, &source->line_capacity, source->csv_file);
+    if (read <= 0) return 0;
+    *row = source->line;
+    *len = (size_t)read;
+    return 1;
+}
+
+// Como read_result_row para el valor i del último lote de fetch_result_rows:
+// si estaba en jobs.rows, la fila se rehace en source->line.
+static int read_fetched_row(IndexView* view, RowSource* source, size_t i, long value, const char** row,
+                            size_t* len) {
+    if (i < source->n_fetched && source->fetched[i].found) {
+        size_t size = rowstore_line_length(&source->fetched[i]) + 1;
+        if (size > source->line_capacity) {
+            char* bigger = realloc(source->line, size);
+            if (!bigger) return 0;
+            source->line = bigger;
+            source->line_capacity = size;
+        }
+        *row = source->line;
+        *len = rowstore_line(&source->fetched[i], source->line, size);
+        return 1;
+    }
+    return read_result_row(view, source, value, row, len);
+}
+
+// Petición de un cliente. Un worker la resuelve y deja la respuesta en su
+// buffer; el bucle de eventos la pasa luego a la salida de la conexión. El
+// worker solo toca la petición, nunca la conexión.
+typedef struct Request {
+    struct Connection* client;
+    char* text;                 // Petición (en binario, la carga del marco), terminada en 0
+    size_t text_len;
+    int framed;                 // Llegó por el protocolo binario: la respuesta va en un marco
+    ProtoHeader header;         // Cabecera del marco recibido
+    uint8_t reply_type;         // Tipo del marco de respuesta
+    char* out;                  // Respuesta (con su cabecera de marco, si lleva)
+    size_t out_len;
+    size_t out_capacity;
+    int broken;                 // No se pudo formar la respuesta: se cierra la conexión
+    struct Request* next;       // Cola de trabajo o de respuestas listas
+} Request;
+
+// Añade bytes a la respuesta de una petición
+static void output_append(Request* request, const char* bytes, size_t n) {
+    if (request->broken) return;
+    if (request->out_len + n > request->out_capacity) {
+        size_t capacity = request->out_capacity ? request->out_capacity : 8192;
+        while (capacity < request->out_len + n) capacity *= 2;
+        char* bigger = realloc(request->out, capacity);
+        if (!bigger) {
+            perror("Error al reservar la respuesta");
+            request->broken = 1;
+            return;
+        }
+        request->out = bigger;
+        request->out_capacity = capacity;
+    }
+    memcpy(request->out + request->out_len, bytes, n);
+    request->out_len += n;
+}
+
+// Respuesta que se va formando en el buffer de la petición; el bucle de
+// eventos la envía cuando el worker termina. Con 'capture' se guarda
+// además una copia (hasta CACHE_PAGE_MAX bytes) para la caché.
+typedef struct {
+    Request* request;
+    int capture;
+    char* captured;
+    size_t captured_len;
+} ReplyWriter;
+
+static void reply_write(ReplyWriter* reply, const char* bytes, size_t n) {
+    if (reply->capture) {
+        // Una página demasiado grande para la caché deja de copiarse
+        if (!reply->captured) reply->captured = malloc(CACHE_PAGE_MAX);
+        reply->capture = reply->captured && reply->captured_len + n <= CACHE_PAGE_MAX;
+        if (reply->capture) {
+            memcpy(reply->captured + reply->captured_len, bytes, n);
+            reply->captured_len += n;
+        }
+    }
+    output_append(reply->request, bytes, n);
+}
+
+// Si se ha copiado entera, guarda la respuesta como primera página de la
+// entrada de la caché
+static void reply_finish(ReplyWriter* reply, CacheEntry* entry, size_t limit) {
+    if (entry && reply->capture && !reply->request->broken) {
+        cache_set_page(&result_cache, entry, reply->captured, reply->captured_len, limit);
+    }
+    free(reply->captured);
+}
+
+static void send_text(Request* request, const char* text) {
+    output_append(request, text, strlen(text));
+}
+
+// Error de una consulta. Las peticiones antiguas reciben NA; las paginadas,
+// "ERR <motivo>", y las binarias que no son de texto (PROTO_IDS y
+// PROTO_BATCH) un marco PROTO_ERROR con el motivo.
+static void respond_error(Request* request, int paged, const char* error) {
+    char message[160];
+    if (request->framed && request->header.type != PROTO_QUERY) {
+        request->reply_type = PROTO_ERROR;
+        snprintf(message, sizeof(message), "%s", error);
+    } else if (!paged) snprintf(message, sizeof(message), "NA");
+    else snprintf(message, sizeof(message), "ERR %s\n", error);
+    send_text(request, message);
+}
+
+static void respond_legacy(Request* request, IndexView* view, QueryIterator* results, CacheEntry* entry) {
+    char final_response[LEGACY_RESPONSE_SIZE];  // Buffer para la respuesta final
+    size_t response_len = 0;
+    RowSource source;
+    row_source_open(&source);
+    long batch[LEGACY_ROW_BATCH];
+    long value = 0;
+    int found = results ? results->seek(results, 0, &value) : 0;
+    int truncated_response = 0;
+    while (found == 1 && !truncated_response) {
+        // Las filas se leen por lotes; el último puede sobrar en parte
+        size_t n = 0;
+        for (; found == 1 && n < LEGACY_ROW_BATCH; found = results->seek(results, value + 1, &value)) {
+            batch[n++] = value;
+        }
+        fetch_result_rows(view, &source, batch, n);
+        for (size_t i = 0; i < n; i++) {
+            const char* row;
+            size_t len;
+            if (!read_fetched_row(view, &source, i, batch[i], &row, &len)) continue;
+            // Verificar que la respuesta no exceda el tamaño máximo: una fila
+            // que no cabe entera no se corta
+            if (response_len + len >= sizeof(final_response) - 30) {
+                // Si se excede el tamaño, truncar y salir
+                const char* truncated = "\n... (resultados truncados) ...";
+                memcpy(final_response + response_len, truncated, strlen(truncated));
+                response_len += strlen(truncated);
+                truncated_response = 1;
+                break;
+            }
+            memcpy(final_response + response_len, row, len);
+            response_len += len;
+        }
+    }
+    if (found < 0) perror("Error al leer los datos de intersección");
+    row_source_close(&source);
+
+    // 7.1 Caso: No hay resultados de búsqueda
+    if (response_len == 0) {
+        memcpy(final_response, "NA", 2);
+        response_len = 2;
+    }
+    ReplyWriter reply = { .request = request, .capture = entry != NULL && found >= 0 };
+    reply_write(&reply, final_response, response_len);
+    reply_finish(&reply, entry, 0);
+}
+
+// Respuesta paginada a partir de la lista completa de resultados: el total
+// es su tamaño y la página empieza en el primero >= cursor. Solo se leen las
+// filas de la página, de una vez.
+static void respond_page(Request* request, IndexView* view, const long* values, size_t total, size_t limit,
+                         long cursor, CacheEntry* entry) {
+    size_t first = lower_bound(values, total, cursor);
+    size_t n = total - first < limit ? total - first : limit;
+
+    ReplyWriter reply = { .request = request, .capture = entry != NULL && first == 0 };
+    char header[96];
+    if (first + n == total) snprintf(header, sizeof(header), "OK %zu %zu -\n", total, n);
+    else snprintf(header, sizeof(header), "OK %zu %zu %ld\n", total, n, values[first + n]);
+    reply_write(&reply, header, strlen(header));
+
+    // Cada fila va entera como "<bytes>\n<fila sin salto de línea>"; si no se
+    // puede leer se envía vacía para que el número de registros cuadre
+    RowSource source;
+    row_source_open(&source);
+    fetch_result_rows(view, &source, values + first, n);
+    for (size_t i = first; i < first + n && !request->broken; i++) {
+        const char* row = NULL;
+        size_t len = 0;
+        if (read_fetched_row(view, &source, i - first, values[i], &row, &len)) {
+            if (len > 0 && row[len - 1] == '\n') len--;
+            if (len > 0 && row[len - 1] == '\r') len--;
+        } else {
+            reply.capture = 0;
+        }
+        char length[24];
+        snprintf(length, sizeof(length), "%zu\n", len);
+        reply_write(&reply, length, strlen(length));
+        if (len > 0) reply_write(&reply, row, len);
+    }
+    reply_finish(&reply, entry, limit);
+    row_source_close(&source);
+}
+
+// Añade valores a la respuesta como enteros de 8 bytes en orden de red
+static void append_values(Request* request, const long* values, size_t n) {
+    uint8_t chunk[8 * 512];
+    for (size_t i = 0; i < n && !request->broken;) {
+        size_t k = 0;
+        for (; i < n && k < sizeof(chunk); i++, k += 8) proto_put_u64(chunk + k, (uint64_t)values[i]);
+        output_append(request, (const char*)chunk, k);
+    }
+}
+
+// Página de resultados en binario (PROTO_IDS): los valores tal cual, row IDs
+// u offsets según el índice, sin leer ninguna fila
+static void respond_ids(Request* request, IndexView* view, const long* values, size_t total, size_t limit,
+                        long cursor) {
+    size_t first = lower_bound(values, total, cursor);
+    size_t n = total - first < limit ? total - first : limit;
+    uint8_t header[PROTO_IDS_REPLY_SIZE];
+    proto_put_u64(header, total);
+    proto_put_u64(header + 8, first + n == total ? PROTO_NO_CURSOR : (uint64_t)values[first + n]);
+    proto_put_u32(header + 16, (uint32_t)n);
+    proto_put_u32(header + 20, view->segments[0].info.row_ids ? PROTO_ROW_IDS : PROTO_OFFSETS);
+    output_append(request, (const char*)header, sizeof(header));
+    append_values(request, values + first, n);
+}
+
+// Recorre el iterador entero y deja todos sus valores en *values (reservado
+// con malloc). 'hint' es la estimación del planificador. 0 si falla.
+static int collect_results(QueryIterator* results, size_t hint, long** values, size_t* n) {
+    size_t capacity = hint < 1024 ? 1024 : hint > (1 << 20) ? (1 << 20) : hint;
+    *values = malloc(capacity * sizeof(long));
+    *n = 0;
+    if (!*values) return 0;
+    long value = 0;
+    int found = results ? results->seek(results, 0, &value) : 0;
+    for (; found == 1; found = results->seek(results, value + 1, &value)) {
+        if (*n == capacity) {
+            long* bigger = realloc(*values, 2 * capacity * sizeof(long));
+            if (!bigger) {
+                found = -1;
+                break;
+            }
+            *values = bigger;
+            capacity *= 2;
+        }
+        (*values)[(*n)++] = value;
+    }
+    if (found < 0) {
+        free(*values);
+        *values = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Número de resultados de una consulta ya planificada, sin formar la lista
+// cuando se puede: una skill sola se cuenta con los metadatos (en el formato
+// 4 sus listas no tienen repetidos), un AND de skills con count_terms y el
+// resto recorriendo los iteradores sin guardar los valores.
+static int count_query(IndexView* view, const QueryNode* query, const Criterion* criteria, size_t* count) {
+    *count = 0;
+    if (query->cost == 0) return 1;
+    if (query->op == QUERY_TERM && view->segments[0].info.row_ids) {
+        *count = criteria[query->term].count;
+        return 1;
+    }
+
+    // Un grupo de variantes cuenta como su rama principal si las demás no
+    // tienen filas (por ejemplo, la propia skill escrita en minúsculas)
+    int only_terms = query->op == QUERY_AND;
+    for (int i = 0; only_terms && i < query->n_children; i++) {
+        const QueryNode* child = query->children[i];
+        int main = main_variant(child, criteria);
+        only_terms = child->op == QUERY_TERM || (main >= 0 && child->cost == child->children[main]->cost);
+    }
+    if (only_terms) {
+        const Criterion** terms = malloc((size_t)query->n_children * sizeof(Criterion*));
+        Criterion* pairs = malloc(((size_t)query->n_children / 2 + 1) * sizeof(Criterion));
+        int n = terms && pairs ? query->n_children : -1;
+        for (int i = 0; i < n; i++) {
+            const QueryNode* child = query->children[i];
+            int main = main_variant(child, criteria);
+            terms[i] = &criteria[main >= 0 ? child->children[main]->term : child->term];
+        }
+        if (n > 0) sort_terms(terms, n);
+        if (n > 0) n = apply_pairs(view, terms, n, pairs);
+        int done = n > 0 ? count_terms_parallel(view, terms, n, count) : 0;
+        if (done < 0) done = count_terms(view, terms, n, LONG_MIN, LONG_MAX, count);
+        free(terms);
+        free(pairs);
+        return done;
+    }
+
+    QueryIterator* results = build_iterator(view, query, criteria);
+    if (!results) return 0;
+    long value = 0;
+    int found = results->seek(results, 0, &value);
+    for (; found == 1; found = results->seek(results, value + 1, &value)) (*count)++;
+    results->close(results);
+    return found == 0;
+}
+
+// Skill de una faceta: su número de entrada en la base (-1 si solo está en
+// algún delta), su nombre y cuántos resultados la tienen
+typedef struct {
+    long number;
+    char* name;
+    uint32_t count;
+} Facet;
+
+// Más resultados primero; a igualdad, por nombre (en la base, el número de
+// entrada sigue el orden alfabético)
+static int compare_facet_numbers(const void* a, const void* b) {
+    const Facet* facetA = a;
+    const Facet* facetB = b;
+    if (facetA->count != facetB->count) return facetA->count > facetB->count ? -1 : 1;
+    return (facetA->number > facetB->number) - (facetA->number < facetB->number);
+}
+
+static int compare_facet_names(const void* a, const void* b) {
+    const Facet* facetA = a;
+    const Facet* facetB = b;
+    if (facetA->count != facetB->count) return facetA->count > facetB->count ? -1 : 1;
+    return strcmp(facetA->name, facetB->name);
+}
+
+static int compare_facet_alpha(const void* a, const void* b) {
+    return strcmp(((const Facet*)a)->name, ((const Facet*)b)->name);
+}
+
+// Cuenta las skills de las filas de values[0..n) con el índice de skills por
+// fila de cada segmento, en 'counts' (uno por entrada de la base). Las de los
+// deltas se pasan a la base por su nombre; las que la base no tiene quedan
+// en *extras, una vez cada una. 0 si falla.
+static int count_facets(IndexView* view, const long* values, size_t n, uint32_t* counts, Facet** extras,
+                        size_t* n_extras) {
+    Segment* base = &view->segments[0];
+    size_t start = 0, capacity = 0, name_capacity = 0;
+    char* name = NULL;
+    int ok = 1;
+    *extras = NULL;
+    *n_extras = 0;
+    for (int s = 0; ok && s < view->n && start < n; s++) {
+        Segment* segment = &view->segments[s];
+        size_t end = lower_bound(values, n, (long)(segment->info.first_row + segment->info.n_rows));
+        if (end == start) continue;
+        if (s == 0) {
+            ok = forward_count(&segment->forward, values, end, counts) == 0;
+            start = end;
+            continue;
+        }
+        uint32_t* part = calloc(segment->forward.header.n_skills + 1, sizeof(uint32_t));
+        ok = part && forward_count(&segment->forward, values + start, end - start, part) == 0;
+        for (size_t e = 0; ok && e < segment->forward.header.n_skills; e++) {
+            if (part[e] == 0) continue;
+            size_t number;
+            ok = read_skill_name(segment->skl, &segment->info, e, &name, &name_capacity);
+            if (ok && find_skill_number(base->skl, &base->info, name, &number)) {
+                counts[number] += part[e];
+            } else if (ok) {
+                if (*n_extras == capacity) {
+                    capacity = capacity ? capacity * 2 : 64;
+                    Facet* bigger = realloc(*extras, capacity * sizeof(Facet));
+                    if (!bigger) {
+                        ok = 0;
+                        break;
+                    }
+                    *extras = bigger;
+                }
+                Facet* extra = &(*extras)[(*n_extras)++];
+                extra->number = -1;
+                extra->name = strdup(name);
+                extra->count = part[e];
+                ok = extra->name != NULL;
+            }
+        }
+        free(part);
+        start = end;
+    }
+    free(name);
+    // Una skill nueva puede estar en varios deltas: se suman
+    if (*n_extras > 1) {
+        qsort(*extras, *n_extras, sizeof(Facet), compare_facet_alpha);
+        size_t kept = 1;
+        for (size_t i = 1; i < *n_extras; i++) {
+            Facet* previous = &(*extras)[kept - 1];
+            if (strcmp(previous->name, (*extras)[i].name) == 0) {
+                previous->count += (*extras)[i].count;
+                free((*extras)[i].name);
+            } else {
+                (*extras)[kept++] = (*extras)[i];
+            }
+        }
+        *n_extras = kept;
+    }
+    return ok && start == n;
+}
+
+// Nombres de las skills de la consulta, que no se devuelven como facetas
+static void query_term_names(const QueryNode* node, const char** names, int* n) {
+    if (node->op == QUERY_TERM) {
+        names[(*n)++] = node->skill;
+        return;
+    }
+    for (int i = 0; i < node->n_children; i++) query_term_names(node->children[i], names, n);
+}
+
+// Facetas de los resultados: las 'size' skills que más se repiten entre
+// ellos (sin las de la consulta), con cuántos resultados tiene cada una.
+// Solo se leen los índices de skills por fila, nunca las filas.
+static void respond_facet(Request* request, IndexView* view, const QueryNode* query, const long* values,
+                          size_t total, size_t size) {
+    for (int i = 0; i < view->n; i++) {
+        if (!view->segments[i].has_forward) {
+            respond_error(request, 1, "el índice no tiene skills por fila (formato 4)");
+            return;
+        }
+    }
+    Segment* base = &view->segments[0];
+    size_t n_skills = (size_t)base->forward.header.n_skills;
+    uint32_t* counts = calloc(n_skills + 1, sizeof(uint32_t));
+    Facet* extras = NULL;
+    size_t n_extras = 0;
+    int ok = counts && count_facets(view, values, total, counts, &extras, &n_extras);
+
+    // Candidatas: las 'size' primeras más tantas como skills tiene la
+    // consulta, que se descartan al final
+    const char* excluded[QUERY_MAX_TERMS];
+    int n_excluded = 0;
+    query_term_names(query, excluded, &n_excluded);
+    size_t wanted = size + (size_t)n_excluded;
+    size_t n_candidates = 0;
+    Facet* candidates = NULL;
+    if (ok) {
+        for (size_t e = 0; e < n_skills; e++) n_candidates += counts[e] > 0;
+        candidates = malloc((n_candidates + 1) * sizeof(Facet));
+        ok = candidates != NULL;
+    }
+    if (ok) {
+        n_candidates = 0;
+        for (size_t e = 0; e < n_skills; e++) {
+            if (counts[e] > 0) candidates[n_candidates++] = (Facet){ (long)e, NULL, counts[e] };
+        }
+        qsort(candidates, n_candidates, sizeof(Facet), compare_facet_numbers);
+        if (n_candidates > wanted) n_candidates = wanted;
+        size_t capacity = 0;
+        char* name = NULL;
+        for (size_t i = 0; ok && i < n_candidates; i++) {
+            ok = read_skill_name(base->skl, &base->info, (size_t)candidates[i].number, &name, &capacity) &&
+                 (candidates[i].name = strdup(name)) != NULL;
+        }
+        free(name);
+        if (n_extras > 1) qsort(extras, n_extras, sizeof(Facet), compare_facet_names);
+    }
+
+    // Mezcla de las dos listas, ya ordenadas
+    char header[64];
+    char* body = NULL;
+    size_t body_len = 0, body_capacity = 0, k = 0;
+    size_t i = 0, j = 0;
+    while (ok && k < size && (i < n_candidates || j < n_extras)) {
+        const Facet* facet;
+        if (j == n_extras || (i < n_candidates && compare_facet_names(&candidates[i], &extras[j]) <= 0)) {
+            facet = &candidates[i++];
+        } else {
+            facet = &extras[j++];
+        }
+        int skip = 0;
+        for (int t = 0; t < n_excluded && !skip; t++) skip = strcmp(facet->name, excluded[t]) == 0;
+        if (skip) continue;
+        size_t need = body_len + strlen(facet->name) + 16;
+        if (need > body_capacity) {
+            body_capacity = need * 2;
+            char* bigger = realloc(body, body_capacity);
+            if (!bigger) {
+                ok = 0;
+                break;
+            }
+            body = bigger;
+        }
+        body_len += (size_t)sprintf(body + body_len, "%u %s\n", facet->count, facet->name);
+        k++;
+    }
+
+    if (ok) {
+        snprintf(header, sizeof(header), "OK %zu %zu\n", total, k);
+        send_text(request, header);
+        if (body_len > 0) output_append(request, body, body_len);
+    } else {
+        perror("Error al leer el índice de skills por fila");
+        respond_error(request, 1, "error al leer el índice de skills por fila");
+    }
+    for (size_t c = 0; candidates && c < n_candidates; c++) free(candidates[c].name);
+    for (size_t e = 0; e < n_extras; e++) free(extras[e].name);
+    free(candidates);
+    free(extras);
+    free(counts);
+    free(body);
+}
+
+// Autocompletado de un prefijo con el índice de la base: los nodos del árbol
+// que cubren el tramo de skills del prefijo y, en sus extremos, unos pocos
+// bloques del directorio. Los deltas no cuentan hasta que se compactan.
+static void respond_suggest(Request* request, size_t size, const char* prefix) {
+    IndexView* view = acquire_index_view();
+    Segment* base = view ? &view->segments[0] : NULL;
+    if (!base || !base->has_suggest) {
+        release_index_view();
+        respond_error(request, 1, base ? "el índice no tiene autocompletado" : "índice no disponible");
+        return;
+    }
+    SugItem items[SUG_TOP_K];
+    size_t n = 0;
+    int ok = suggest_top(&base->suggest, base->skl, &base->info, prefix, strlen(prefix), size, items, &n) == 0;
+
+    char header[64];
+    char* body = NULL;
+    size_t body_len = 0, body_capacity = 0;
+    char* name = NULL;
+    size_t capacity = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        ok = read_skill_name(base->skl, &base->info, items[i].number, &name, &capacity);
+        size_t need = ok ? body_len + strlen(name) + 16 : 0;
+        if (ok && need > body_capacity) {
+            body_capacity = need * 2;
+            char* bigger = realloc(body, body_capacity);
+            ok = bigger != NULL;
+            if (ok) body = bigger;
+        }
+        if (ok) body_len += (size_t)sprintf(body + body_len, "%u %s\n", items[i].count, name);
+    }
+    release_index_view();
+
+    if (ok) {
+        snprintf(header, sizeof(header), "OK %zu\n", n);
+        send_text(request, header);
+        if (body_len > 0) output_append(request, body, body_len);
+    } else {
+        perror("Error al leer el índice de autocompletado");
+        respond_error(request, 1, "error al leer el índice de autocompletado");
+    }
+    free(name);
+    free(body);
+}
+
+// Lotes de consultas (PROTO_BATCH). Cada skill distinta del lote se busca y
+// se carga entera una sola vez, aunque aparezca en miles de consultas, y
+// cada consulta se evalúa después sobre esas listas en memoria. Las
+// consultas se reparten entre el worker y los hilos de query_pool.
+typedef struct {
+    const char* skill;      // Nombre (de uno de los nodos que la usan)
+    Criterion criterion;
+    long* values;           // Lista entera, de todos los segmentos
+    size_t n;
+    int ok;
+} SharedList;
+
+typedef struct {
+    const char* text;
+    size_t len;
+    QueryNode* query;       // NULL si no es válida
+    int n_terms;
+    int* lists;             // Lista compartida de cada término
+    char error[128];
+    size_t total;
+    long* values;           // Los primeros resultados (PROTO_BATCH_IDS)
+    size_t n;
+    int ok;
+} BatchQuery;
+
+typedef struct {
+    IndexView* view;
+    BatchQuery* queries;
+    size_t n_queries;
+    SharedList* lists;
+    size_t n_lists;
+    int counting;
+    size_t limit;
+} Batch;
+
+// Conjunto intermedio de la evaluación: la lista de una skill (prestada) o
+// una lista nueva
+typedef struct {
+    long* values;
+    size_t n;
+    int owned;
+} BatchSet;
+
+static void batch_set_free(BatchSet* set) {
+    if (set->owned) free(set->values);
+    memset(set, 0, sizeof(*set));
+}
+
+// a ∩ b, con a la más corta. Si b es mucho más larga, cada valor de a se
+// busca en ella por galope.
+static size_t intersect_sorted(const long* a, size_t n, const long* b, size_t m, long* out) {
+    if (m / GALLOP_RATIO < n) return intersect2(a, n, b, m, out);
+    size_t kept = 0, pos = 0;
+    for (size_t i = 0; i < n && pos < m; i++) {
+        size_t step = 1;
+        while (pos + step < m && b[pos + step] < a[i]) step *= 2;
+        size_t end = pos + step < m ? pos + step + 1 : m;
+        pos += lower_bound(b + pos, end - pos, a[i]);
+        if (pos < m && b[pos] == a[i]) out[kept++] = a[i];
+    }
+    return kept;
+}
+
+// a \ b, sobre 'a' mismo
+static size_t subtract_sorted(long* a, size_t n, const long* b, size_t m) {
+    size_t kept = 0, pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (m / GALLOP_RATIO >= n) pos += lower_bound(b + pos, m - pos, a[i]);
+        else while (pos < m && b[pos] < a[i]) pos++;
+        if (pos == m || b[pos] != a[i]) a[kept++] = a[i];
+    }
+    return kept;
+}
+
+// a ∪ b sin repetidos. 'out' debe tener sitio para n + m valores.
+static size_t merge_sorted(const long* a, size_t n, const long* b, size_t m, long* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < n && j < m) {
+        if (a[i] < b[j]) out[k++] = a[i++];
+        else if (b[j] < a[i]) out[k++] = b[j++];
+        else {
+            out[k++] = a[i++];
+            j++;
+        }
+    }
+    while (i < n) out[k++] = a[i++];
+    while (j < m) out[k++] = b[j++];
+    return k;
+}
+
+static int compare_batch_sets(const void* a, const void* b) {
+    size_t x = ((const BatchSet*)a)->n, y = ((const BatchSet*)b)->n;
+    return x < y ? -1 : x > y;
+}
+
+// Evalúa un nodo de la consulta sobre las listas compartidas. 0 si no hay
+// memoria.
+static int evaluate_batch_node(const Batch* batch, const BatchQuery* query, const QueryNode* node, BatchSet* out) {
+    memset(out, 0, sizeof(*out));
+    if (node->op == QUERY_TERM) {
+        const SharedList* list = &batch->lists[query->lists[node->term]];
+        out->values = list->values;
+        out->n = list->n;
+        return 1;
+    }
+    // Los hijos positivos quedan delante y los NOT detrás
+    int n = node->n_children, n_positive = 0, n_excluded = 0;
+    BatchSet* children = calloc((size_t)n, sizeof(BatchSet));
+    int ok = children != NULL;
+    for (int i = 0; ok && i < n; i++) {
+        const QueryNode* child = node->children[i];
+        BatchSet* slot = child->op == QUERY_NOT ? &children[n - ++n_excluded] : &children[n_positive++];
+        ok = evaluate_batch_node(batch, query, child->op == QUERY_NOT ? child->children[0] : child, slot);
+    }
+
+    if (ok && node->op == QUERY_OR) {
+        // Se van juntando las ramas de dos en dos
+        for (int i = 0; ok && i < n; i++) {
+            if (i == 0) {
+                *out = children[0];
+                children[0].owned = 0;
+                continue;
+            }
+            long* merged = malloc((out->n + children[i].n + 1) * sizeof(long));
+            ok = merged != NULL;
+            if (ok) {
+                size_t n = merge_sorted(out->values, out->n, children[i].values, children[i].n, merged);
+                batch_set_free(out);
+                *out = (BatchSet){ merged, n, 1 };
+            }
+        }
+    } else if (ok) {
+        // AND: los positivos de la lista más corta a la más larga (los
+        // kernels no escriben sobre sus listas: se alternan dos buffers), y
+        // después se quitan los NOT
+        qsort(children, (size_t)n_positive, sizeof(BatchSet), compare_batch_sets);
+        long* values = malloc((children[0].n + 1) * sizeof(long));
+        long* spare = n_positive > 1 ? malloc((children[0].n + 1) * sizeof(long)) : NULL;
+        ok = values != NULL && (n_positive == 1 || spare != NULL);
+        size_t kept = 0;
+        if (ok) {
+            memcpy(values, children[0].values, children[0].n * sizeof(long));
+            kept = children[0].n;
+        }
+        for (int i = 1; ok && i < n_positive && kept > 0; i++) {
+            kept = intersect_sorted(values, kept, children[i].values, children[i].n, spare);
+            long* swap = values;
+            values = spare;
+            spare = swap;
+        }
+        for (int i = n_positive; ok && i < n && kept > 0; i++) {
+            kept = subtract_sorted(values, kept, children[i].values, children[i].n);
+        }
+        free(spare);
+        if (ok) *out = (BatchSet){ values, kept, 1 };
+        else free(values);
+    }
+    for (int i = 0; children && i < n; i++) batch_set_free(&children[i]);
+    free(children);
+    return ok;
+}
+
+// Análisis y ampliación de una consulta del lote
+static void prepare_batch_query(void* arg, size_t i) {
+    Batch* batch = arg;
+    BatchQuery* query = &batch->queries[i];
+    char* text = strndup(query->text, query->len);
+    query->query = text ? query_parse(text, &query->n_terms, query->error, sizeof(query->error)) : NULL;
+    if (!text) snprintf(query->error, sizeof(query->error), "sin memoria");
+    free(text);
+    if (query->query && !expand_query_terms(batch->view, query->query, &query->n_terms)) {
+        snprintf(query->error, sizeof(query->error), "error al leer el índice");
+        query_free(query->query);
+        query->query = NULL;
+    }
+    if (query->query) {
+        query->lists = malloc((size_t)query->n_terms * sizeof(int));
+        if (!query->lists) {
+            snprintf(query->error, sizeof(query->error), "sin memoria");
+            query_free(query->query);
+            query->query = NULL;
+        }
+    }
+}
+
+// Carga una lista compartida
+static void load_shared_list(void* arg, size_t i) {
+    Batch* batch = arg;
+    SharedList* list = &batch->lists[i];
+    list->values = malloc((list->criterion.count + 1) * sizeof(long));
+    list->ok = list->values &&
+               load_criterion(batch->view, &list->criterion, LONG_MIN, LONG_MAX, list->values, &list->n);
+}
+
+static void run_batch_query(void* arg, size_t i) {
+    Batch* batch = arg;
+    BatchQuery* query = &batch->queries[i];
+    if (!query->query) return;
+    BatchSet result;
+    query->ok = evaluate_batch_node(batch, query, query->query, &result);
+    if (!query->ok) {
+        snprintf(query->error, sizeof(query->error), "sin memoria");
+        return;
+    }
+    query->total = result.n;
+    size_t n = batch->counting ? 0 : result.n < batch->limit ? result.n : batch->limit;
+    if (n > 0) {
+        query->values = malloc(n * sizeof(long));
+        query->ok = query->values != NULL;
+        if (query->ok) memcpy(query->values, result.values, n * sizeof(long));
+        query->n = query->ok ? n : 0;
+    }
+    batch_set_free(&result);
+}
+
+// Término de una consulta del lote, para juntar los de la misma skill
 typedef struct {
-    char* skill;
-    size_t count;
-    long offset;
-} Criterion;
+    const char* skill;
+    BatchQuery* query;
+    int term;
+} BatchTerm;
 
+static void collect_batch_terms(BatchQuery* query, const QueryNode* node, BatchTerm* terms, size_t* n) {
+    if (node->op == QUERY_TERM) {
+        terms[(*n)++] = (BatchTerm){ node->skill, query, node->term };
+        return;
+    }
+    for (int i = 0; i < node->n_children; i++) collect_batch_terms(query, node->children[i], terms, n);
+}
 
+static int compare_batch_terms(const void* a, const void* b) {
+    return strcmp(((const BatchTerm*)a)->skill, ((const BatchTerm*)b)->skill);
+}
 
-// Realiza búsqueda binaria en el archivo .skl para encontrar metadata.
-int find_skill_metadata(FILE* skl_file, const char* skill, Criterion* meta) {
-    fseek(skl_file, 0, SEEK_SET); // Ir al inicio
-    size_t total_skills;
-    // Leer total de skills
-    if (fread(&total_skills, sizeof(size_t), 1, skl_file) != 1) {
-        perror("Error al leer el número total de habilidades");
-        return 0;
+// Separa las consultas del lote. Devuelve el motivo si la carga no es válida.
+static const char* split_batch(Request* request, Batch* batch) {
+    const uint8_t* payload = (const uint8_t*)request->text;
+    size_t len = request->text_len;
+    if (len < PROTO_BATCH_REQUEST_SIZE) return "marco PROTO_BATCH demasiado corto";
+    uint32_t mode = proto_get_u32(payload);
+    batch->limit = proto_get_u32(payload + 4);
+    batch->n_queries = proto_get_u32(payload + 8);
+    batch->counting = mode == PROTO_BATCH_COUNT;
+    if (mode != PROTO_BATCH_COUNT && mode != PROTO_BATCH_IDS) return "modo de PROTO_BATCH no válido";
+    if (batch->n_queries == 0 || batch->n_queries > PROTO_MAX_BATCH) return "número de consultas no válido";
+    if (!batch->counting &&
+        (batch->limit == 0 || batch->limit > PROTO_MAX_IDS ||
+         batch->n_queries * batch->limit > PROTO_MAX_BATCH_VALUES)) {
+        return "límite de PROTO_BATCH no válido";
+    }
+    batch->queries = calloc(batch->n_queries, sizeof(BatchQuery));
+    if (!batch->queries) return "sin memoria";
+    size_t pos = PROTO_BATCH_REQUEST_SIZE;
+    for (size_t i = 0; i < batch->n_queries; i++) {
+        if (len - pos < 4) return "lote incompleto";
+        size_t query_len = proto_get_u32(payload + pos);
+        pos += 4;
+        if (len - pos < query_len) return "lote incompleto";
+        batch->queries[i].text = request->text + pos;
+        batch->queries[i].len = query_len;
+        pos += query_len;
     }
+    return pos == len ? NULL : "bytes de más al final del lote";
+}
 
-    // NOTA: Una búsqueda binaria real en archivo es compleja.
-    // Para simplificar, haremos una búsqueda lineal que es más lenta
-    // pero igual de eficiente en memoria. Si la velocidad se vuelve un problema,
-    // se puede implementar la búsqueda binaria aquí.
-    
-    for(size_t i = 0; i < total_skills; i++) {
-        size_t skill_len;
-        if (fread(&skill_len, sizeof(size_t), 1, skl_file) != 1) return 0; // Fin de archivo
+// Responde un lote: analiza las consultas, junta sus skills, carga cada
+// lista una vez y evalúa las consultas sobre ellas. Si las listas distintas
+// no caben en BATCH_MAX_VALUES, el lote entero se rechaza.
+static void respond_batch(Request* request) {
+    Batch batch = { 0 };
+    const char* error = split_batch(request, &batch);
+    int acquired = error == NULL;
+    IndexView* view = acquired ? acquire_index_view() : NULL;
+    if (!error && !view) error = "índice no disponible";
+    batch.view = view;
 
-        char* skill_buffer = malloc(skill_len + 1);
-        if (fread(skill_buffer, 1, skill_len, skl_file) != skill_len) {
-            free(skill_buffer);
-            return 0;
+    // 1. Análisis y ampliación de cada consulta
+    if (!error) workpool_run(&query_pool, batch.n_queries, prepare_batch_query, &batch);
+
+    // 2. Skills distintas del lote
+    size_t n_terms = 0;
+    for (size_t i = 0; !error && i < batch.n_queries; i++) {
+        if (batch.queries[i].query) n_terms += (size_t)batch.queries[i].n_terms;
+    }
+    BatchTerm* terms = error ? NULL : malloc((n_terms + 1) * sizeof(BatchTerm));
+    batch.lists = error ? NULL : malloc((n_terms + 1) * sizeof(SharedList));
+    if (!error && (!terms || !batch.lists)) error = "sin memoria";
+    n_terms = 0;
+    for (size_t i = 0; !error && i < batch.n_queries; i++) {
+        if (batch.queries[i].query) collect_batch_terms(&batch.queries[i], batch.queries[i].query, terms, &n_terms);
+    }
+    if (!error) qsort(terms, n_terms, sizeof(BatchTerm), compare_batch_terms);
+    size_t shared_values = 0, plain_values = 0;
+    for (size_t i = 0; !error && i < n_terms; i++) {
+        if (i == 0 || strcmp(terms[i].skill, terms[i - 1].skill) != 0) {
+            SharedList* list = &batch.lists[batch.n_lists++];
+            memset(list, 0, sizeof(*list));
+            list->skill = terms[i].skill;
+            find_criterion(view, list->skill, &list->criterion);
+            shared_values += list->criterion.count;
         }
-        skill_buffer[skill_len] = '\0';
-        
-        int is_match = (strcmp(skill, skill_buffer) == 0);
-        free(skill_buffer);
-        
-        if (is_match) {
-            meta->skill = strdup(skill);
-            if (fread(&meta->count, sizeof(size_t), 1, skl_file) != 1) {
-                return 0;
-            }
-            if (fread(&meta->offset, sizeof(long), 1, skl_file) != 1) {
-                return 0;
-            }
-            return 1; // Encontrado
-        } else {
-            // Si no es, saltar el resto de los metadatos de esta entrada
-            fseek(skl_file, sizeof(size_t) + sizeof(long), SEEK_CUR);
+        terms[i].query->lists[terms[i].term] = (int)batch.n_lists - 1;
+        plain_values += batch.lists[batch.n_lists - 1].criterion.count;
+    }
+    if (!error && shared_values > BATCH_MAX_VALUES) error = "el lote lee demasiadas filas; divídalo";
+
+    // 3. Cada lista una vez, y las consultas sobre ellas
+    if (!error) {
+        if (verbose) {
+            printf("Lote de %zu consultas: %zu skills distintas, %zu valores leídos "
+                   "(%zu consultándolas por separado)\n",
+                   batch.n_queries, batch.n_lists, shared_values, plain_values);
+        }
+        workpool_run(&query_pool, batch.n_lists, load_shared_list, &batch);
+        for (size_t i = 0; !error && i < batch.n_lists; i++) {
+            if (!batch.lists[i].ok) error = "error al leer el índice";
+        }
+    }
+    if (!error) workpool_run(&query_pool, batch.n_queries, run_batch_query, &batch);
+
+    // 4. Respuesta, consulta a consulta en el orden del lote
+    if (error) {
+        respond_error(request, 1, error);
+    } else {
+        uint8_t header[8];
+        proto_put_u32(header, (uint32_t)batch.n_queries);
+        proto_put_u32(header + 4, view->segments[0].info.row_ids ? PROTO_ROW_IDS : PROTO_OFFSETS);
+        output_append(request, (const char*)header, sizeof(header));
+    }
+    for (size_t i = 0; !error && i < batch.n_queries && !request->broken; i++) {
+        BatchQuery* query = &batch.queries[i];
+        uint8_t record[16];
+        if (!query->ok) {
+            size_t len = strlen(query->error);
+            proto_put_u32(record, PROTO_BATCH_INVALID);
+            proto_put_u32(record + 4, (uint32_t)len);
+            output_append(request, (const char*)record, 8);
+            output_append(request, query->error, len);
+            continue;
         }
+        proto_put_u32(record, PROTO_BATCH_OK);
+        proto_put_u64(record + 4, query->total);
+        proto_put_u32(record + 12, (uint32_t)query->n);
+        output_append(request, (const char*)record, 16);
+        append_values(request, query->values, query->n);
+    }
+
+    // 5. Limpieza
+    for (size_t i = 0; batch.lists && i < batch.n_lists; i++) {
+        free(batch.lists[i].criterion.skill);
+        free(batch.lists[i].values);
+    }
+    for (size_t i = 0; batch.queries && i < batch.n_queries; i++) {
+        if (batch.queries[i].query) query_free(batch.queries[i].query);
+        free(batch.queries[i].lists);
+        free(batch.queries[i].values);
     }
-    return 0; // No encontrado
+    free(batch.lists);
+    free(batch.queries);
+    free(terms);
+    if (acquired) release_index_view();
 }
 
-int compare_criteria(const void* a, const void* b) {
-    Criterion* critA = (Criterion*)a;
-    Criterion* critB = (Criterion*)b;
-    if (critA->count < critB->count) return -1;
-    if (critA->count > critB->count) return 1;
-    return 0;
+static void respond_stats(Request* request) {
+    CacheStats stats;
+    cache_stats(&result_cache, &stats);
+    char message[256];
+    snprintf(message, sizeof(message), "OK %llu %llu %llu %zu %zu %zu\n", (unsigned long long)stats.hits,
+             (unsigned long long)stats.misses, (unsigned long long)stats.evictions, stats.n_entries, stats.bytes,
+             stats.budget);
+    send_text(request, message);
 }
 
 /**
- * Procesa una consulta de búsqueda y devuelve los resultados a través de un pipe.
+ * Procesa una consulta de búsqueda y deja la respuesta en el buffer de salida
+ * de la conexión. La ejecuta un worker.
  * 
- * @param client_fd  Descriptor de archivo del pipe de entrada para leer la consulta
+ * @param request  Petición recibida, con su texto en request->text
  * 
  * La función realiza los siguientes pasos:
- * 1. Recibe y parsea la consulta del usuario
- * 2. Busca los metadatos de cada criterio en el archivo de habilidades
- * 3. Ordena los criterios por frecuencia (menos frecuentes primero)
- * 4. Realiza la intersección de los resultados en memoria
- * 5. Recupera y devuelve las ofertas coincidentes del archivo CSV
+ * 1. Recibe y analiza la consulta del usuario (ver query.h), con la cabecera
+ *    de página si la trae
+ * 2. Busca la consulta en la caché de resultados por su clave canónica
+ * 3. Si no está: busca los metadatos de cada skill, planifica la consulta con
+ *    la frecuencia de cada skill y construye los iteradores
+ * 4. Guarda la lista de resultados en la caché
+ * 5. Recupera y devuelve las ofertas coincidentes del archivo CSV: la página
+ *    pedida con el total de resultados, o los primeros 8 KB sin cabecera.
+ *    COUNT y FACET no leen filas: el número de resultados, o las skills que
+ *    más se repiten entre ellos. PROTO_IDS tampoco: la página de valores en
+ *    binario
  * 
  * @note La función asume que los archivos de índice (jobs.skl y jobs.idx) existen
  *       y están correctamente formateados.
  */
-void search_and_respond(int client_fd, char* query_buffer) {
-    int check;
-    
-    // 1. LECTURA DE LA CONSULTA
-    char* tokens[3];
-    int n_criteria = 0;
-    char* token = strtok(query_buffer, ";");
-
-    // 2. PROCESAMIENTO DE LA CONSULTA
-    // Dividir la consulta en tokens usando ';' como delimitador
-    // Se admiten hasta 3 criterios de búsqueda
-    while (token != NULL && n_criteria < 3) {
-        tokens[n_criteria++] = token;
-        token = strtok(NULL, ";");
-    }
-
-    // Si no hay criterios, devolvemos NA
-    if (n_criteria == 0) {
-        check = send(client_fd, "NA", 2, 0);
-        
-        if (check < 0) perror("Error al enviar el mensaje");
-        
-        return; 
+void search_and_respond(Request* request) {
+    if (request->framed && request->header.type == PROTO_BATCH) {
+        respond_batch(request);
+        return;
+    }
+    char* query_buffer = request->text;
+    // Un marco PROTO_IDS es una página de valores con límite y cursor en binario
+    int ids = request->framed && request->header.type == PROTO_IDS;
+    if (!ids && strcmp(query_buffer, STATS_REQUEST) == 0) {
+        respond_stats(request);
+        return;
+    }
+    if (!ids && strncmp(query_buffer, SUGGEST_HEADER, strlen(SUGGEST_HEADER)) == 0) {
+        char* newline = strchr(query_buffer, '\n');
+        size_t size;
+        char end;
+        if (!newline || sscanf(query_buffer, SUGGEST_HEADER "%zu%c", &size, &end) != 2 || end != '\n' ||
+            size == 0 || size > SUG_TOP_K) {
+            respond_error(request, 1, "cabecera SUGGEST no válida");
+            return;
+        }
+        // El prefijo va tal cual, sin los espacios de delante ni el salto final
+        char* prefix = newline + 1;
+        while (isspace((unsigned char)*prefix)) prefix++;
+        size_t len = strlen(prefix);
+        while (len > 0 && (prefix[len - 1] == '\n' || prefix[len - 1] == '\r')) prefix[--len] = '\0';
+        respond_suggest(request, size, prefix);
+        return;
     }
 
-    // 3. BÚSQUEDA DE METADATOS
-    // Inicializar estructura para almacenar los criterios de búsqueda
-    Criterion criteria[3] = {0};
-    
-    // Abrir el archivo de habilidades (skills) para buscar los metadatos
-    FILE* skl_file = fopen(SKILL_DIR_FILE, "rb");
-    if (!skl_file) { 
-        // Si no se puede abrir el archivo, responder con error
-
-        check = send(client_fd, "NA", 2, 0);
+    // 1. ANÁLISIS DE LA CONSULTA
+    // "PAGE <límite> <cursor>\n" delante de la consulta pide una página
+    int paged = ids || strncmp(query_buffer, PAGE_HEADER, strlen(PAGE_HEADER)) == 0;
+    size_t limit = 0;
+    long cursor = 0;
+    if (ids) {
+        uint64_t ids_cursor = 0;
+        if (request->text_len >= PROTO_IDS_REQUEST_SIZE) {
+            limit = proto_get_u32((const uint8_t*)query_buffer);
+            ids_cursor = proto_get_u64((const uint8_t*)query_buffer + 4);
+        }
+        if (limit == 0 || limit > PROTO_MAX_IDS || ids_cursor > LONG_MAX) {
+            respond_error(request, 1, "límite o cursor de PROTO_IDS no válido");
+            return;
+        }
+        cursor = (long)ids_cursor;
+        query_buffer += PROTO_IDS_REQUEST_SIZE;
+    } else if (paged) {
+        char* newline = strchr(query_buffer, '\n');
+        char end;
+        if (!newline || sscanf(query_buffer, PAGE_HEADER "%zu %ld%c", &limit, &cursor, &end) != 3 || end != '\n' ||
+            limit == 0 || limit > MAX_PAGE_SIZE || cursor < 0) {
+            respond_error(request, 1, "cabecera PAGE no válida");
+            return;
+        }
+        query_buffer = newline + 1;
+    }
+    // "COUNT\n" o "FACET <n>\n" piden solo conteos, sin filas
+    int counting = strncmp(query_buffer, COUNT_REQUEST, strlen(COUNT_REQUEST)) == 0;
+    size_t facet_size = 0;
+    if (counting) {
+        query_buffer += strlen(COUNT_REQUEST);
+    } else if (strncmp(query_buffer, FACET_HEADER, strlen(FACET_HEADER)) == 0) {
+        char* newline = strchr(query_buffer, '\n');
+        char end;
+        if (paged || !newline || sscanf(query_buffer, FACET_HEADER "%zu%c", &facet_size, &end) != 2 ||
+            end != '\n' || facet_size == 0 || facet_size > MAX_FACET_SIZE) {
+            respond_error(request, 1, "cabecera FACET no válida");
+            return;
+        }
+        query_buffer = newline + 1;
+    }
+    if (paged && counting) {
+        respond_error(request, 1, "COUNT no admite PAGE");
+        return;
+    }
+    // Todas salvo las antiguas responden "OK ..." o "ERR <motivo>"
+    int framed = paged || counting || facet_size > 0;
 
-        if (check < 0) perror("Error al enviar el mensaje");
+    char error[128];
+    int n_terms = 0;
+    QueryNode* query = query_parse(query_buffer, &n_terms, error, sizeof(error));
 
+    // Si la consulta no es válida (o no tiene criterios), devolvemos un error
+    if (!query) {
+        printf("Consulta no válida: %s\n", error);
+        respond_error(request, framed, error);
         return; 
     }
 
-    // 4. OBTENCIÓN DE METADATOS
-    // Para cada criterio de búsqueda, encontrar sus metadatos (conteo y offset)
-    for (int i = 0; i < n_criteria; i++) {
-        // Buscar los metadatos de la habilidad en el archivo .skl
-        if (!find_skill_metadata(skl_file, tokens[i], &criteria[i])) {
-            // Si no se encuentra la habilidad, responder con error
-            check = send(client_fd, "NA", 2, 0);
+    // Base y segmentos delta donde buscar los metadatos, con el cerrojo de
+    // lectura hasta terminar la respuesta. Si han cambiado, se reabren y la
+    // caché se vacía aquí.
+    IndexView* view = acquire_index_view();
+    if (!view) {
+        // Si no se puede abrir el índice, responder con error
+        release_index_view();
+        query_free(query);
+        respond_error(request, framed, "índice no disponible");
+        return;
+    }
 
-            if (check < 0) perror("Error al enviar el mensaje");
+    // 2. CACHÉ DE RESULTADOS
+    char key[BUFFER_SIZE * 2];
+    int cacheable = result_cache.budget > 0 && query_key(query, key, sizeof(key));
+    CacheEntry* entry = cacheable ? cache_get(&result_cache, key) : NULL;
+    if (cacheable && verbose) {
+        CacheStats stats;
+        cache_stats(&result_cache, &stats);
+        printf("Caché: %s (%llu aciertos, %llu fallos, %zu entradas, %zu KB)\n", entry ? "acierto" : "fallo",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses, stats.n_entries,
+               stats.bytes / 1024);
+    }
 
-            fclose(skl_file);
-            // Liberar memoria de habilidades ya encontradas
-            for(int j = 0; j < i; j++) free(criteria[j].skill);
-            return;
+    // La primera página ya formada se envía tal cual
+    size_t page_len = 0;
+    const char* page = entry && cursor == 0 && !counting && facet_size == 0 && !ids
+                           ? cache_page(&result_cache, entry, paged ? limit : 0, &page_len)
+                           : NULL;
+    if (page) {
+        output_append(request, page, page_len);
+        cache_release(&result_cache, entry);
+        release_index_view();
+        query_free(query);
+        return;
+    }
+
+    // 3. METADATOS, PLANIFICACIÓN E ITERADORES
+    Criterion* criteria = NULL;
+    QueryIterator* results = NULL;
+    long* values = NULL;
+    size_t n_values = 0;
+    size_t count = 0;
+    int failed = 0;
+    if (entry) {
+        values = entry->values;
+        n_values = count = entry->n;
+    } else {
+        // Para cada skill, sus metadatos (conteo y offset) en cada segmento.
+        // Una skill que no existe se queda con count = 0.
+        // Antes, las skills sin comillas se amplían con sus variantes
+        failed = !expand_query_terms(view, query, &n_terms);
+        criteria = failed ? NULL : calloc((size_t)n_terms, sizeof(Criterion));
+        failed = failed || criteria == NULL;
+        if (!failed) find_query_terms(view, query, criteria);
+
+        // Estimar filas y ordenar los operandos de cada AND (menos frecuentes
+        // primero, NOT al final)
+        if (!failed) plan_query(query, criteria);
+        if (!failed && verbose) {
+            char plan[512];
+            query_format(query, plan, sizeof(plan));
+            printf("Plan: %s\n", plan);
+        }
+
+        // Un conteo no forma la lista de resultados (ni la guarda)
+        if (!failed && counting) failed = !count_query(view, query, criteria, &count);
+
+        // Si el plan ya estima 0 filas (por ejemplo, falta una skill de un
+        // AND), no se lee ninguna lista
+        if (!failed && !counting && query->cost > 0) {
+            results = build_iterator(view, query, criteria);
+            failed = results == NULL;
+        }
+
+        // 4. Las páginas y las facetas necesitan la lista entera; las
+        // respuestas antiguas solo si se va a guardar en la caché (con la
+        // estimación del plan, si cabe en una entrada), y si no leen del
+        // iterador hasta llenar la respuesta
+        int collect = paged || facet_size > 0 || (cacheable && cache_fits(&result_cache, key, query->cost));
+        if (!failed && !counting && collect) {
+            failed = !collect_results(results, query->cost, &values, &n_values);
+            if (!failed && cacheable) entry = cache_put(&result_cache, key, values, n_values);
         }
     }
 
-    fclose(skl_file);
-    
-    // 5. OPTIMIZACIÓN: Ordenar criterios por frecuencia (menos frecuentes primero)
-    // Esto mejora el rendimiento de la intersección
-    qsort(criteria, n_criteria, sizeof(Criterion), compare_criteria);
-
-    // 6. INTERSECCIÓN DE RESULTADOS
-    // Abrir el archivo de índices que contiene los offsets de las ofertas
-    FILE* idx_file = fopen(INDEX_FILE, "rb");
-    
-    // 6.1 Cargar la primera lista de offsets (la más corta) en memoria
-    // Esto optimiza la intersección al reducir el espacio de búsqueda inicial
-    long* intersection_buffer = malloc(criteria[0].count * sizeof(long));
-    
-    fseek(idx_file, criteria[0].offset, SEEK_SET);
-    
-    if (fread(intersection_buffer, sizeof(long), criteria[0].count, idx_file) != criteria[0].count) {
+    // 5. CONSTRUCCIÓN DE LA RESPUESTA
+    if (failed) {
         perror("Error al leer los datos de intersección");
-        free(intersection_buffer);
+        respond_error(request, framed, "error al leer el índice");
+    } else if (counting) {
+        char message[32];
+        snprintf(message, sizeof(message), "OK %zu\n", count);
+        send_text(request, message);
+    } else if (facet_size > 0) {
+        respond_facet(request, view, query, values, n_values, facet_size);
+    } else if (ids) {
+        respond_ids(request, view, values, n_values, limit, cursor);
+    } else if (paged) {
+        respond_page(request, view, values, n_values, limit, cursor, entry);
+    } else if (values) {
+        // Lista ya completa (de la caché o recién guardada en ella). El
+        // iterador solo la recorre: no se cierra
+        SetIterator list = { .base = { set_seek, NULL }, .set = { .values = values, .n = n_values } };
+        respond_legacy(request, view, &list.base, entry);
+    } else {
+        respond_legacy(request, view, results, NULL);
+    }
+
+    // 6. LIMPIEZA
+    // Cerrar los iteradores (liberan sus listas) y los metadatos. La lista
+    // de resultados es de la caché si se guardó en ella.
+    if (entry) cache_release(&result_cache, entry);
+    else free(values);
+    if (results) results->close(results);
+    for (int i = 0; criteria && i < n_terms; i++) {
+        free(criteria[i].skill);
+    }
+    free(criteria);
+    release_index_view();
+    query_free(query);
+}
+
+
+// Cola de peticiones entre el bucle de eventos y los workers
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Request* head;
+    Request* tail;
+} RequestQueue;
+
+// Peticiones pendientes de resolver y respuestas listas para enviar
+RequestQueue work_queue = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+RequestQueue done_queue = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+
+static void queue_push(RequestQueue* queue, Request* request) {
+    request->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) queue->tail->next = request;
+    else queue->head = request;
+    queue->tail = request;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Espera a que haya una petición en la cola y la saca
+static Request* queue_pop(RequestQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->head) pthread_cond_wait(&queue->ready, &queue->lock);
+    Request* request = queue->head;
+    queue->head = request->next;
+    if (!queue->head) queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+    return request;
+}
+
+// Saca todas las peticiones de la cola sin esperar
+static Request* queue_take_all(RequestQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    Request* list = queue->head;
+    queue->head = queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+    return list;
+}
+
+static void request_free(Request* request) {
+    free(request->text);
+    free(request->out);
+    free(request);
+}
+
+// Worker: resuelve peticiones y las devuelve al bucle de eventos con la
+// respuesta en su buffer. Las binarias llevan delante la cabecera del marco,
+// que se rellena al terminar con el tamaño de la respuesta.
+static void* worker_main(void* arg) {
+    (void)arg;
+    while (1) {
+        Request* request = queue_pop(&work_queue);
+        if (request->framed) {
+            char header[PROTO_HEADER_SIZE] = {0};
+            output_append(request, header, sizeof(header));
+        }
+        search_and_respond(request);
+        if (request->framed && !request->broken) {
+            ProtoHeader reply = { PROTO_VERSION, request->reply_type, 0, request->header.id,
+                                  (uint32_t)(request->out_len - PROTO_HEADER_SIZE) };
+            proto_write_header((uint8_t*)request->out, &reply);
+        }
+        queue_push(&done_queue, request);
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) perror("Error al avisar al bucle de eventos");
+    }
+    return NULL;
+}
+
+// Conexión de un cliente. Solo la toca el bucle de eventos: lee sus
+// peticiones, las pasa a los workers y envía las respuestas según vuelven.
+// En texto hay como mucho una petición en curso y no se lee la siguiente
+// hasta enviar la respuesta, como hasta ahora. En binario se siguen leyendo
+// marcos mientras haya menos de MAX_IN_FLIGHT peticiones en curso y la
+// salida pendiente no pase de MAX_PENDING_OUTPUT.
+typedef struct Connection {
+    int fd;                     // -1 una vez cerrada
+    int binary;                 // Protocolo binario (PROTO_PORT) o de texto
+    char* in;                   // Bytes recibidos que aún no forman un marco
+    size_t in_len;
+    size_t in_capacity;
+    char* out;                  // Respuestas pendientes de enviar
+    size_t out_len;
+    size_t out_sent;
+    size_t out_capacity;
+    int in_flight;              // Peticiones en manos de los workers
+    int closing;                // No se leen más peticiones: se cierra al acabar las pendientes
+    int failed;                 // Además, lo pendiente de enviar se descarta
+    struct Connection* next;    // Conexiones cerradas por liberar
+} Connection;
+
+// Conexiones abiertas. Si se acaban los descriptores se deja de aceptar en
+// los dos puertos hasta que se cierre alguna.
+size_t open_connections = 0;
+int accept_paused = 0;
+
+// Las conexiones cerradas se liberan al final de cada vuelta del bucle: aún
+// puede quedar algún evento suyo en la lista de epoll_wait
+Connection* closed_connections = NULL;
+
+// Vigila el socket de la conexión para 'events'. Con EPOLLONESHOT cada aviso
+// desactiva el socket hasta volver a llamar a watch_connection, así que cada
+// conexión se atiende en una sola vuelta del bucle a la vez.
+static void watch_connection(Connection* client, uint32_t events) {
+    struct epoll_event event = { .events = events | EPOLLONESHOT, .data.ptr = client };
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &event) != 0) perror("Error al vigilar la conexión");
+}
+
+static void watch_listeners(int op) {
+    int* listeners[] = { &serverFd, &binaryFd };
+    for (int i = 0; i < 2; i++) {
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = listeners[i] };
+        if (epoll_ctl(epollFd, op, *listeners[i], &event) != 0) perror("Error al vigilar el puerto");
+    }
+}
+
+static void close_connection(Connection* client) {
+    close(client->fd); // También la quita de epoll
+    client->fd = -1;
+    client->next = closed_connections;
+    closed_connections = client;
+    open_connections--;
+    if (accept_paused) {
+        watch_listeners(EPOLL_CTL_ADD);
+        accept_paused = 0;
+    }
+}
+
+static void free_closed_connections(void) {
+    while (closed_connections) {
+        Connection* client = closed_connections;
+        closed_connections = client->next;
+        free(client->in);
+        free(client->out);
+        free(client);
+    }
+}
+
+// Añade bytes a la salida pendiente de la conexión. 0 si falla.
+static int connection_append(Connection* client, const char* bytes, size_t n) {
+    if (client->out_sent > 0) {
+        memmove(client->out, client->out + client->out_sent, client->out_len - client->out_sent);
+        client->out_len -= client->out_sent;
+        client->out_sent = 0;
+    }
+    if (client->out_len + n > client->out_capacity) {
+        size_t capacity = client->out_capacity ? client->out_capacity : 8192;
+        while (capacity < client->out_len + n) capacity *= 2;
+        char* bigger = realloc(client->out, capacity);
+        if (!bigger) {
+            perror("Error al reservar la respuesta");
+            return 0;
+        }
+        client->out = bigger;
+        client->out_capacity = capacity;
+    }
+    memcpy(client->out + client->out_len, bytes, n);
+    client->out_len += n;
+    return 1;
+}
+
+// Envía lo que el socket admita de la salida pendiente. 0 si falla.
+static int flush_output(Connection* client) {
+    while (client->out_sent < client->out_len) {
+        ssize_t check = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                             MSG_NOSIGNAL);
+        if (check < 0 && errno == EINTR) continue;
+        if (check < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (check < 0) {
+            perror("Error al enviar el mensaje");
+            return 0;
+        }
+        client->out_sent += (size_t)check;
+    }
+    client->out_len = client->out_sent = 0;
+    if (client->out_capacity > OUTPUT_KEEP_SIZE) {
+        free(client->out);
+        client->out = NULL;
+        client->out_capacity = 0;
+    }
+    return 1;
+}
+
+// Vuelve a vigilar la conexión: para escribir si queda salida pendiente, para
+// leer si admite más peticiones. La cierra si ya no queda nada que hacer.
+static void update_connection(Connection* client) {
+    int pending = client->out_sent < client->out_len && !client->failed;
+    if (client->closing && client->in_flight == 0 && !pending) {
+        close_connection(client);
         return;
     }
+    uint32_t events = pending ? EPOLLOUT : 0;
+    int readable = client->binary ? client->in_flight < MAX_IN_FLIGHT &&
+                                        client->out_len - client->out_sent <= MAX_PENDING_OUTPUT
+                                  : client->in_flight == 0 && !pending;
+    if (!client->closing && readable) events |= EPOLLIN;
+    // Sin nada que vigilar, espera a que vuelva alguna petición
+    if (events) watch_connection(client, events);
+}
 
-    size_t intersection_size = criteria[0].count;
+// Pasa una petición a los workers. 'header' es su marco (NULL en texto).
+static void dispatch_request(Connection* client, const char* text, size_t len, const ProtoHeader* header) {
+    Request* request = calloc(1, sizeof(Request));
+    char* copy = malloc(len + 1);
+    if (!request || !copy) {
+        perror("Error al reservar la petición");
+        free(request);
+        free(copy);
+        client->closing = client->failed = 1;
+        return;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0'; // 0 al final
+    request->client = client;
+    request->text = copy;
+    request->text_len = len;
+    if (header) {
+        request->framed = 1;
+        request->header = *header;
+        request->reply_type = header->type | PROTO_REPLY;
+    }
+    client->in_flight++;
+    queue_push(&work_queue, request);
+}
 
-    // 6.2 Procesar cada criterio adicional
-    // Realizar intersección con cada lista de offsets adicional
-    for (int i = 1; i < n_criteria; i++) {
-        // Si ya no hay elementos en la intersección, terminar temprano
-        if (intersection_size == 0) break;
+// Responde un marco PROTO_ERROR desde el bucle, sin pasar por los workers
+static void send_frame_error(Connection* client, uint32_t id, const char* error) {
+    uint8_t header[PROTO_HEADER_SIZE];
+    ProtoHeader reply = { PROTO_VERSION, PROTO_ERROR, 0, id, (uint32_t)strlen(error) };
+    proto_write_header(header, &reply);
+    if (!connection_append(client, (const char*)header, sizeof(header)) ||
+        !connection_append(client, error, strlen(error))) {
+        client->closing = client->failed = 1;
+    }
+}
 
-        // Cargar la siguiente lista de offsets a comparar
-        long* next_list_buffer = malloc(criteria[i].count * sizeof(long));
-        
-        fseek(idx_file, criteria[i].offset, SEEK_SET);
-        
-        if (fread(next_list_buffer, sizeof(long), criteria[i].count, idx_file) != criteria[i].count) {
-            perror("Error al leer la siguiente lista de offsets");
-            free(next_list_buffer);
-            free(intersection_buffer);
-            return;
+// Pasa a los workers los marcos completos recibidos, sin pasar de
+// MAX_IN_FLIGHT peticiones en curso. Los que sobran esperan en el buffer a
+// que vuelva alguna. Un marco de otra versión o demasiado grande no deja
+// encontrar el siguiente: se responde el error y se cierra la conexión.
+static void process_frames(Connection* client) {
+    size_t pos = 0;
+    while (!client->failed && client->in_flight < MAX_IN_FLIGHT && client->in_len - pos >= PROTO_HEADER_SIZE) {
+        ProtoHeader header;
+        proto_read_header((const uint8_t*)client->in + pos, &header);
+        if (header.version != PROTO_VERSION || header.length > PROTO_MAX_PAYLOAD) {
+            send_frame_error(client, header.id, header.version != PROTO_VERSION ? "versión del protocolo no soportada"
+                                                                                : "marco demasiado grande");
+            client->closing = 1;
+            pos = client->in_len;
+            break;
         }
-        
-        // Buffer para la nueva intersección
-        long* new_intersection_buffer = malloc(intersection_size * sizeof(long));
-        size_t new_size = 0;
-        
-        // 6.3 ALGORITMO DE DOS PUNTEROS
-        // Eficiente para intersección de listas ordenadas (O(n+m) tiempo)
-        size_t ptr1 = 0, ptr2 = 0;
-        while(ptr1 < intersection_size && ptr2 < criteria[i].count) {
-            if (intersection_buffer[ptr1] < next_list_buffer[ptr2]) {
-                // Avanzar en la primera lista
-                ptr1++;
-            } else if (next_list_buffer[ptr2] < intersection_buffer[ptr1]) {
-                // Avanzar en la segunda lista
-                ptr2++;
-            } else {
-                // Coincidencia encontrada: guardar el offset y avanzar ambos punteros
-                new_intersection_buffer[new_size++] = intersection_buffer[ptr1];
-                ptr1++;
-                ptr2++;
-            }
+        if (client->in_len - pos - PROTO_HEADER_SIZE < header.length) break; // Incompleto
+        const char* payload = client->in + pos + PROTO_HEADER_SIZE;
+        pos += PROTO_HEADER_SIZE + header.length;
+        if (header.type == PROTO_QUERY) {
+            printf("Petición %u recibida: '%.*s'\n", header.id, (int)header.length, payload);
+        } else if (header.type == PROTO_IDS && header.length >= PROTO_IDS_REQUEST_SIZE) {
+            printf("Petición %u de resultados en binario recibida: '%.*s'\n", header.id,
+                   (int)(header.length - PROTO_IDS_REQUEST_SIZE), payload + PROTO_IDS_REQUEST_SIZE);
+        } else if (header.type == PROTO_BATCH) {
+            printf("Lote %u recibido (%u bytes)\n", header.id, header.length);
+        } else {
+            send_frame_error(client, header.id, header.type == PROTO_IDS ? "marco PROTO_IDS demasiado corto"
+                                                                         : "tipo de marco desconocido");
+            continue;
         }
-        
-        // 6.4 ACTUALIZAR BUFFER DE INTERSECCIÓN
-        // Liberar buffers antiguos y actualizar con la nueva intersección
-        free(intersection_buffer);
-        free(next_list_buffer);
-        intersection_buffer = new_intersection_buffer;
-        intersection_size = new_size;
+        dispatch_request(client, payload, header.length, &header);
     }
+    memmove(client->in, client->in + pos, client->in_len - pos);
+    client->in_len -= pos;
+}
 
-    fclose(idx_file);  // Cerrar archivo de índices
+// Lee lo que haya llegado a la conexión. En texto, como hasta ahora, cada
+// lectura es una petición completa; en binario los bytes se juntan hasta
+// formar marcos.
+static void read_input(Connection* client) {
+    char text[BUFFER_SIZE];
+    char* buffer = text;
+    size_t space = BUFFER_SIZE - 1;
+    if (client->binary) {
+        // Sitio para un marco entero como mucho
+        size_t limit = PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD;
+        if (client->in_len == client->in_capacity && client->in_capacity < limit) {
+            size_t capacity = client->in_capacity ? 2 * client->in_capacity : 4096;
+            if (capacity > limit) capacity = limit;
+            char* bigger = realloc(client->in, capacity);
+            if (!bigger) {
+                perror("Error al reservar la petición");
+                client->closing = client->failed = 1;
+                return;
+            }
+            client->in = bigger;
+            client->in_capacity = capacity;
+        }
+        buffer = client->in + client->in_len;
+        space = client->in_capacity - client->in_len;
+        if (space == 0) return;
+    }
+    ssize_t check = recv(client->fd, buffer, space, 0);
+    if (check < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (check <= 0) {
+        // El cliente ya no envía más: se responde lo pendiente y se cierra
+        if (check == 0) printf("Cliente desconectado\n");
+        else perror("Error al recibir el mensaje");
+        client->closing = 1;
+        client->failed = check < 0;
+        if (client->binary) process_frames(client);
+        return;
+    }
+    if (client->binary) {
+        client->in_len += (size_t)check;
+        process_frames(client);
+        return;
+    }
 
-    // 7. CONSTRUCCIÓN DE LA RESPUESTA
-    if (intersection_size == 0) {
-        // 7.1 Caso: No hay resultados de búsqueda
-        check = send(client_fd, "NA", 2, 0);
+    // Registrar la consulta recibida y pasarla a los workers. El socket no
+    // se vigila hasta que vuelva con la respuesta.
+    text[check] = '\0';
+    printf("Petición recibida: '%s'\n", text);
+    dispatch_request(client, text, (size_t)check, NULL);
+}
 
-        if (check < 0) perror("Error al enviar el mensaje");
-    } else {
-        // 7.2 Caso: Hay resultados
-        char final_response[8192] = "";  // Buffer para la respuesta final
-        char line_buffer[4096];           // Buffer para leer líneas del CSV
-        
-        // Abrir el archivo CSV para leer las ofertas
-        FILE* csv_file = fopen("data.csv", "r");
-        
-        // Para cada offset en la intersección
-        for(size_t i = 0; i < intersection_size; i++) {
-            // Saltar a la posición del offset en el archivo CSV
-            if (fseek(csv_file, intersection_buffer[i], SEEK_SET) == 0) {
-                // Leer la línea completa de la oferta
-                if (fgets(line_buffer, sizeof(line_buffer), csv_file)) {
-                    // Verificar que la respuesta no exceda el tamaño máximo
-                    if (strlen(final_response) + strlen(line_buffer) < sizeof(final_response) - 30) {
-                        strcat(final_response, line_buffer);
-                    } else {
-                        // Si se excede el tamaño, truncar y salir
-                        strcat(final_response, "\n... (resultados truncados) ...");
-                        break;
-                    }
+// Acepta todas las conexiones pendientes de un puerto. Las de texto reciben
+// el saludo de siempre; las binarias empiezan directamente con sus marcos.
+static void accept_connections(int listen_fd, int binary) {
+    while (1) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                // Sin descriptores: dejar de vigilar los puertos (si no,
+                // epoll avisaría sin parar) hasta cerrar una conexión
+                perror("Error al aceptar la conexión");
+                if (open_connections > 0 && !accept_paused) {
+                    watch_listeners(EPOLL_CTL_DEL);
+                    accept_paused = 1;
                 }
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Error al aceptar la conexión");
+            }
+            return;
+        }
+
+        Connection* client = calloc(1, sizeof(Connection));
+        struct epoll_event event = { .events = EPOLLONESHOT, .data.ptr = client };
+        if (!client || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            perror("Error al registrar la conexión");
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->binary = binary;
+        open_connections++;
+        printf("Conectado a un cliente%s (%zu conexiones)\n", binary ? " binario" : "", open_connections);
+
+        if (!binary) {
+            // El saludo ocupa siempre BUFFER_SIZE - 1 bytes, rellenos con ceros
+            char message[BUFFER_SIZE - 1] = "Motor listo, recibiendo peticiones...";
+            if (!connection_append(client, message, sizeof(message)) || !flush_output(client)) {
+                client->closing = client->failed = 1;
             }
         }
-        fclose(csv_file);
-        
-        // 7.3 Enviar la respuesta a través del pipe de salida
-        check = send(client_fd, final_response, strlen(final_response), 0);
+        update_connection(client);
+    }
+}
 
-        if (check < 0) perror("Error al enviar el mensaje");
+// Respuestas listas: se pasan a la salida de su conexión y se envían. En
+// binario, cada una que vuelve deja sitio para otro marco del buffer.
+static void collect_replies(void) {
+    Request* request = queue_take_all(&done_queue);
+    while (request) {
+        Request* next = request->next;
+        Connection* client = request->client;
+        client->in_flight--;
+        if (request->broken) client->closing = client->failed = 1;
+        if (!client->failed && !connection_append(client, request->out, request->out_len)) {
+            client->closing = client->failed = 1;
+        }
+        request_free(request);
+        if (!client->failed && !flush_output(client)) client->closing = client->failed = 1;
+        if (client->binary) process_frames(client);
+        update_connection(client);
+        request = next;
     }
+}
 
-    // 8. LIMPIEZA
-    // Liberar la memoria asignada para los buffers
-    free(intersection_buffer);
-    
-    // Liberar las cadenas de habilidades copiadas
-    for(int i = 0; i < n_criteria; i++) {
-        free(criteria[i].skill);
+// Bucle de eventos: acepta conexiones, lee peticiones y envía respuestas sin
+// bloquearse en ningún socket. Las consultas las resuelven los workers.
+static void run_event_loop(void) {
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error en epoll_wait");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &serverFd) {
+                accept_connections(serverFd, 0);
+            } else if (events[i].data.ptr == &binaryFd) {
+                accept_connections(binaryFd, 1);
+            } else if (events[i].data.ptr == &wakeFd) {
+                uint64_t count;
+                if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) perror("Error al leer el aviso");
+                collect_replies();
+            } else {
+                Connection* client = events[i].data.ptr;
+                if (client->fd < 0) continue; // Cerrada en esta misma vuelta
+                if ((events[i].events & EPOLLOUT) && !flush_output(client)) client->closing = client->failed = 1;
+                if (!client->failed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) read_input(client);
+                update_connection(client);
+            }
+        }
+        free_closed_connections();
     }
 }
 
+// Crea el socket que escucha en 'port'. Devuelve -1 si falla.
+static int open_listener(int port) {
+    struct sockaddr_in server;
+    // Creando descriptor de archivo del socket
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        perror("Error al crear el socket");
+        return -1;
+    }
+
+    int opt = 1;
+
+    // Permite reutilizar el socket
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    {
+        perror("Error al configurar el socket");
+        close(fd);
+        return -1;
+    }
+
+    // Configurar el servidor
+    server.sin_port = htons(port);
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = INADDR_ANY;
+    bzero(server.sin_zero, 8);
+
+    // Enlace del socket con el puerto
+    if (bind(fd, (struct sockaddr *)&server, sizeof(struct sockaddr_in)) < 0)
+    {
+        perror("Error al enlazar el socket");
+        close(fd);
+        return -1;
+    }
+
+    // Escuchando por conexiones entrantes
+    if (listen(fd, BACKLOG) < 0)
+    {
+        perror("Error al escuchar");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
 void cleanup(int signum) {
     (void)signum;
     printf("\nCerrando el motor de búsqueda...\n");
     close(serverFd);
+    close(binaryFd);
     printf("Recursos liberados. Adiós.\n");
     exit(0);
 }
@@ -291,13 +3381,76 @@ void cleanup(int signum) {
  *
  * Recibe una consulta, devuelve un mensaje y recibe otro
  */
- int main(void) {
-    printf("Motor de búsqueda iniciando (modo de memoria mínima)...\n");
+ int main(int argc, char* argv[]) {
+    long cache_mb = DEFAULT_CACHE_MB;
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > MAX_WORKERS) num_workers = MAX_WORKERS;
+    long num_helpers = num_workers - 1;
+    for (int i = 1; i < argc; i++) {
+        char* end = NULL;
+        if (strcmp(argv[i], "-M") == 0) {
+            use_mmap = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc &&
+                   (cache_mb = strtol(argv[i + 1], &end, 10)) >= 0 && *end == '\0' && end != argv[i + 1]) {
+            i++;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc &&
+                   (num_workers = strtol(argv[i + 1], &end, 10)) >= 1 && num_workers <= MAX_WORKERS &&
+                   *end == '\0') {
+            i++;
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc &&
+                   (num_helpers = strtol(argv[i + 1], &end, 10)) >= 0 && num_helpers < MAX_WORKERS &&
+                   *end == '\0') {
+            i++;
+        } else {
+            fprintf(stderr, "Uso: %s [-M] [-v] [-C <MB>] [-j <workers>] [-P <hilos>]\n", argv[0]);
+            fprintf(stderr, "  -M  Proyecta el índice y data.csv en memoria al arrancar\n");
+            fprintf(stderr, "  -v  Registra cómo se resuelve cada consulta (plan, caché, rangos...)\n");
+            fprintf(stderr, "  -C  Memoria para la caché de resultados (por defecto %d MB, 0 la desactiva)\n",
+                    DEFAULT_CACHE_MB);
+            fprintf(stderr, "  -j  Hilos que resuelven consultas, entre 1 y %d (por defecto, uno por CPU)\n",
+                    MAX_WORKERS);
+            fprintf(stderr, "  -P  Hilos que ayudan a intersecar las consultas grandes por rangos (por\n");
+            fprintf(stderr, "      defecto, uno menos que CPUs; 0 no las reparte)\n");
+            return 1;
+        }
+    }
+    if (cache_init(&result_cache, (size_t)cache_mb * 1024 * 1024) != 0) {
+        perror("Error al reservar la caché de resultados");
+        return 1;
+    }
+    printf("Motor de búsqueda iniciando (%s)...\n", use_mmap ? "modo mmap" : "modo de memoria mínima");
+    printf("Decodificador de listas comprimidas: %s\n", postings_impl_name());
+    intersect_init();
+    printf("Intersección de listas: %s\n", intersect_impl_name());
+    printf("Caché de resultados: %ld MB\n", cache_mb);
+    if (workpool_init(&query_pool, (int)num_helpers) != 0) {
+        perror("Error al crear los hilos de intersección");
+        return 1;
+    }
+    printf("Hilos de ayuda para consultas grandes: %d\n", query_pool.n_threads);
     signal(SIGINT, cleanup);
 
-    // No se carga nada en memoria al inicio.
-    
-    int check;
+    // Los workers comparten el índice con un cerrojo de lectura/escritura.
+    // Se da prioridad al escritor para que una recarga no espere para
+    // siempre mientras llegan consultas.
+    pthread_rwlockattr_t lock_attr;
+    pthread_rwlockattr_init(&lock_attr);
+    pthread_rwlockattr_setkind_np(&lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&index_lock, &lock_attr);
+    pthread_rwlockattr_destroy(&lock_attr);
+
+    // Al inicio se cargan los índices dispersos y los hashes perfectos de los
+    // directorios. Sin -M las listas se leen de disco en cada búsqueda; con
+    // -M se proyectan aquí los archivos completos.
+    if (use_mmap) get_csv_map();
+    if (get_index_view()) {
+        printf("Índice cargado: %d segmento(s)\n", index_view.n);
+    } else {
+        printf("Índice no disponible todavía; se cargará en la primera búsqueda\n");
+    }
 
     // Usar señales para cerrar el servidor
     struct sigaction sa;
@@ -317,116 +3470,57 @@ void cleanup(int signum) {
         exit(1);
     }
 
-    printf("Iniciando servidor en %s:%d\n", HOST, PORT);
-    
-    struct sockaddr_in server, client;
-    // Creando descriptor de archivo del socket
-    serverFd = socket(AF_INET, SOCK_STREAM, 0);
-
-    if (serverFd < 0)
-    {
-        perror("Error al crear el socket");
-        exit(1);
-    }
-
-    int opt = 1;
-
-    // Permite reutilizar el socket
-    check = setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-    if (check < 0)
-    {
-        perror("Error al configurar el socket");
-        close(serverFd);
+    printf("Iniciando servidor en %s:%d (texto) y %d (binario)\n", HOST, PORT, PROTO_PORT);
+    serverFd = open_listener(PORT);
+    binaryFd = serverFd >= 0 ? open_listener(PROTO_PORT) : -1;
+    if (binaryFd < 0) {
+        if (serverFd >= 0) close(serverFd);
         exit(1);
     }
 
-    // Configurar el servidor
-    server.sin_port = htons(PORT);
-    server.sin_family = AF_INET;
-    server.sin_addr.s_addr = INADDR_ANY;
-    bzero(server.sin_zero, 8);
-
-    // Enlace del socket con el puerto
-    check = bind(serverFd, (struct sockaddr *)&server, sizeof(struct sockaddr_in));
-    
-    if (check < 0)
-    {
-        perror("Error al enlazar el socket");
-        close(serverFd);
-        exit(1);
+    // Un descriptor por conexión: subir el límite blando hasta el máximo
+    struct rlimit files = { 0, 0 };
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
     }
 
-    // Escuchando por conexiones entrantes
-    check = listen(serverFd, BACKLOG);
-    
-    if (check < 0)
-    {
-        perror("Error al escuchar");
+    // Sockets no bloqueantes vigilados con epoll, y un eventfd para que los
+    // workers avisen de que hay respuestas listas
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.ptr = &serverFd };
+    struct epoll_event binary_event = { .events = EPOLLIN, .data.ptr = &binaryFd };
+    struct epoll_event wake_event = { .events = EPOLLIN, .data.ptr = &wakeFd };
+    if (epollFd < 0 || wakeFd < 0 || fcntl(serverFd, F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(binaryFd, F_SETFL, O_NONBLOCK) != 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, serverFd, &listen_event) != 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, binaryFd, &binary_event) != 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wake_event) != 0) {
+        perror("Error al preparar epoll");
         close(serverFd);
+        close(binaryFd);
         exit(1);
     }
 
-    printf("Escuchando por conexiones entrantes\n");
-
-    while (1)
-    {
-        // Aceptar una conexión
-        socklen_t clientLen = sizeof(struct sockaddr_in);
-        clientFd = accept(serverFd, (struct sockaddr *)&client, &clientLen);
-
-        if (clientFd < 0)
-        {
-            perror("Error al aceptar la conexión");
+    for (long i = 0; i < num_workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+            perror("Error al crear los workers");
             close(serverFd);
+            close(binaryFd);
             exit(1);
         }
+        pthread_detach(thread);
+    }
 
-        printf("Conectado a un cliente\n");
-
-        char *message = "Motor listo, recibiendo peticiones...";
-
-        // Enviando mensaje al cliente
-        check = send(clientFd, message, BUFFER_SIZE - 1, 0);
-
-        if (check < 0)
-        {
-            perror("Error al enviar el mensaje");
-            close(clientFd);
-
-            continue;
-        }
-
-        printf("Mensaje de bienvenida enviado al cliente\n");
-
-        while (1) {
-            // Leer la consulta del pipe de entrada
-            char query_buffer[BUFFER_SIZE];
-            
-            check = recv(clientFd, query_buffer, BUFFER_SIZE, 0);
-
-            if (check <= 0)
-            {
-                if (check == 0) printf("Cliente desconectado\n");
-                else perror("Error al recibir el mensaje");
-
-                close(clientFd);
+    printf("Escuchando por conexiones entrantes (%ld workers, hasta %llu descriptores)\n", num_workers,
+           (unsigned long long)files.rlim_cur);
 
-                break;
-            }
-            
-            query_buffer[check] = '\0'; // 0 al final
-            
-            // Registrar la consulta recibida
-            printf("Petición recibida: '%s'\n", query_buffer);
-    
-            // Procesar la consulta
-            search_and_respond(clientFd, query_buffer);
-        }
-    }
+    run_event_loop();
 
     // Cerrar los sockets
-    close(clientFd);
     close(serverFd);
+    close(binaryFd);
     exit(0);
 }
\ No newline at end of file
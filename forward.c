@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "forward.h"
+#include "index_reader.h"
+
+// Filas que forward_count lee de una vez: con 4096 filas el tramo de la
+// tabla son 32 KB
+#define FWD_WINDOW_ROWS 4096
+#define FWD_MIN_WINDOW (1024 * 1024)
+
+void forward_file_name(const char* skl_name, char* fwd_name, size_t size) {
+    size_t len = strlen(skl_name);
+    if (len >= 4 && strcmp(skl_name + len - 4, ".skl") == 0) len -= 4;
+    snprintf(fwd_name, size, "%.*s.fwd", (int)len, skl_name);
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+// Vuelve a la primera entrada del directorio para recorrerlo otra vez
+static int rewind_entries(FILE* skl, SkillDirInfo* info) {
+    free_skill_dir_info(info);
+    memset(info, 0, sizeof(*info));
+    rewind(skl);
+    return read_skill_dir_header(skl, info);
+}
+
+// Recorre las listas del segmento y, para cada valor de [lo, hi), llama a
+// visit con el número de entrada y la fila relativa al segmento.
+typedef struct {
+    FILE* skl;
+    FILE* idx;
+    SkillDirInfo info;
+    long* list;
+    size_t list_capacity;
+    char* skill;
+    size_t skill_capacity;
+} ListScan;
+
+static int scan_lists(ListScan* scan, uint64_t lo, uint64_t hi,
+                      void (*visit)(void* arg, uint32_t number, uint64_t row), void* arg) {
+    if (!rewind_entries(scan->skl, &scan->info)) return 1;
+    uint64_t first_row = scan->info.first_row;
+    size_t len;
+    SkillEntry entry;
+    for (uint32_t number = 0; read_skill_entry(scan->skl, &scan->info, &scan->skill, &scan->skill_capacity,
+                                               &len, &entry); number++) {
+        if (entry.count > scan->list_capacity) {
+            long* bigger = realloc(scan->list, entry.count * sizeof(long));
+            if (!bigger) return 1;
+            scan->list = bigger;
+            scan->list_capacity = entry.count;
+        }
+        size_t n;
+        if (!load_postings(scan->idx, &scan->info, &entry, (long)(first_row + lo), (long)(first_row + hi) - 1,
+                           scan->list, &n)) {
+            return 1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t row = (uint64_t)scan->list[i] - first_row;
+            if (row >= scan->info.n_rows) return 1;
+            if (row >= lo && row < hi) visit(arg, number, row);
+        }
+    }
+    return scan->info.entries_read != scan->info.total_skills;
+}
+
+// Estado de las dos pasadas. 'last' guarda la última skill vista de cada
+// fila más 1 (0 = ninguna todavía), para codificar la diferencia.
+typedef struct {
+    uint32_t* last;
+    uint64_t* positions;
+    uint8_t* data;          // Tramo de filas en construcción
+    uint64_t data_start;    // Posición del tramo
+} ForwardBuild;
+
+static void measure_row(void* arg, uint32_t number, uint64_t row) {
+    ForwardBuild* build = arg;
+    uint32_t last = build->last[row];
+    build->positions[row + 1] += varint_size(last ? number - (last - 1) : number);
+    build->last[row] = number + 1;
+}
+
+static void fill_row(void* arg, uint32_t number, uint64_t row) {
+    ForwardBuild* build = arg;
+    uint32_t last = build->last[row];
+    uint8_t* p = build->data + (build->positions[row] - build->data_start);
+    uint8_t* next = put_varint(p, last ? number - (last - 1) : number);
+    build->positions[row] = build->data_start + (uint64_t)(next - build->data);
+    build->last[row] = number + 1;
+}
+
+int forward_build(const char* skl_name, const char* idx_name, const char* fwd_name, size_t budget) {
+    ListScan scan = {0};
+    scan.skl = fopen(skl_name, "rb");
+    scan.idx = fopen(idx_name, "rb");
+    if (!scan.skl || !scan.idx || !read_skill_dir_header(scan.skl, &scan.info) || !scan.info.row_ids) {
+        fprintf(stderr, "Error al abrir el segmento '%s'\n", skl_name);
+        if (scan.skl) fclose(scan.skl);
+        if (scan.idx) fclose(scan.idx);
+        free_skill_dir_info(&scan.info);
+        return 1;
+    }
+    FwdHeader header = {0};
+    header.magic = FWD_MAGIC;
+    header.version = FWD_VERSION;
+    header.header_size = sizeof(FwdHeader);
+    header.first_row = scan.info.first_row;
+    header.n_rows = scan.info.n_rows;
+    header.n_skills = scan.info.total_skills;
+    header.table_offset = sizeof(FwdHeader);
+    header.data_offset = header.table_offset + (header.n_rows + 1) * sizeof(uint64_t);
+    uint64_t n_rows = header.n_rows;
+
+    ForwardBuild build = {0};
+    build.last = calloc(n_rows > 0 ? n_rows : 1, sizeof(uint32_t));
+    build.positions = calloc(n_rows + 1, sizeof(uint64_t));
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fwd_name);
+    FILE* out = NULL;
+    int failed = !build.last || !build.positions || header.n_skills > UINT32_MAX;
+
+    // 1. Bytes de cada fila, y de ahí dónde empieza cada una
+    failed = failed || scan_lists(&scan, 0, n_rows, measure_row, &build) != 0;
+    for (uint64_t row = 0; row < n_rows && !failed; row++) build.positions[row + 1] += build.positions[row];
+
+    out = failed ? NULL : fopen(tmp, "wb");
+    failed = failed || !out || fwrite(&header, sizeof(header), 1, out) != 1 ||
+             fwrite(build.positions, sizeof(uint64_t), n_rows + 1, out) != n_rows + 1;
+
+    // 2. Las skills de cada fila, por tramos de filas que quepan en memoria
+    size_t window = budget > 0 ? budget / 2 : (size_t)build.positions[n_rows];
+    if (window < FWD_MIN_WINDOW) window = FWD_MIN_WINDOW;
+    for (uint64_t lo = 0; lo < n_rows && !failed;) {
+        uint64_t hi = lo + 1;
+        while (hi < n_rows && build.positions[hi + 1] - build.positions[lo] <= window) hi++;
+        size_t bytes = (size_t)(build.positions[hi] - build.positions[lo]);
+        build.data = malloc(bytes > 0 ? bytes : 1);
+        build.data_start = build.positions[lo];
+        memset(build.last + lo, 0, (size_t)(hi - lo) * sizeof(uint32_t));
+        failed = !build.data || scan_lists(&scan, lo, hi, fill_row, &build) != 0 ||
+                 fwrite(build.data, 1, bytes, out) != bytes;
+        // Cada fila ha avanzado hasta el inicio de la siguiente: se deshace
+        for (uint64_t row = hi - 1; row > lo && !failed; row--) build.positions[row] = build.positions[row - 1];
+        build.positions[lo] = build.data_start;
+        free(build.data);
+        build.data = NULL;
+        lo = hi;
+    }
+    if (out && fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp, fwd_name) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "Error al escribir el índice de skills por fila '%s'\n", fwd_name);
+        remove(tmp);
+    }
+
+    fclose(scan.skl);
+    fclose(scan.idx);
+    free_skill_dir_info(&scan.info);
+    free(scan.list);
+    free(scan.skill);
+    free(build.last);
+    free(build.positions);
+    return failed;
+}
+
+int forward_open(ForwardIndex* index, const char* filename, int use_map) {
+    memset(index, 0, sizeof(*index));
+    index->fd = open(filename, O_RDONLY);
+    if (index->fd < 0) return 1;
+
+    struct stat st;
+    FwdHeader* header = &index->header;
+    if (fstat(index->fd, &st) != 0 ||
+        pread(index->fd, header, sizeof(*header), 0) != (ssize_t)sizeof(*header) ||
+        header->magic != FWD_MAGIC || header->version != FWD_VERSION ||
+        header->table_offset + (header->n_rows + 1) * sizeof(uint64_t) > header->data_offset ||
+        header->data_offset > (uint64_t)st.st_size) {
+        fprintf(stderr, "Formato de %s no soportado\n", filename);
+        forward_close(index);
+        return 1;
+    }
+    index->file_size = (uint64_t)st.st_size;
+    if (use_map) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, index->fd, 0);
+        // Sin mapa se sigue leyendo con pread
+        if (map != MAP_FAILED) index->map = map;
+    }
+    return 0;
+}
+
+void forward_close(ForwardIndex* index) {
+    if (index->map) munmap((void*)index->map, index->file_size);
+    if (index->fd >= 0) close(index->fd);
+    memset(index, 0, sizeof(*index));
+    index->fd = -1;
+}
+
+// Bytes [offset, offset + size) del índice: del mapa o leídos en *buffer
+static const uint8_t* read_span(const ForwardIndex* index, uint64_t offset, size_t size, uint8_t** buffer,
+                                size_t* capacity) {
+    if (offset + size > index->file_size) return NULL;
+    if (index->map) return index->map + offset;
+    if (size > *capacity) {
+        uint8_t* bigger = realloc(*buffer, size);
+        if (!bigger) return NULL;
+        *buffer = bigger;
+        *capacity = size;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(index->fd, *buffer + done, size - done, (off_t)(offset + done));
+        if (n <= 0) return NULL;
+        done += (size_t)n;
+    }
+    return *buffer;
+}
+
+int forward_count(const ForwardIndex* index, const long* rows, size_t n, uint32_t* counts) {
+    const FwdHeader* header = &index->header;
+    uint8_t* table_buffer = NULL;
+    uint8_t* data_buffer = NULL;
+    size_t table_capacity = 0, data_capacity = 0;
+    int failed = 0;
+
+    for (size_t i = 0; i < n && !failed;) {
+        // Filas a menos de FWD_WINDOW_ROWS de la primera del tramo
+        size_t j = i + 1;
+        while (j < n && rows[j] - rows[i] < FWD_WINDOW_ROWS) j++;
+        uint64_t first = (uint64_t)rows[i] - header->first_row;
+        uint64_t last = (uint64_t)rows[j - 1] - header->first_row;
+        if (rows[i] < (long)header->first_row || last >= header->n_rows) {
+            failed = 1;
+            break;
+        }
+        size_t n_positions = (size_t)(last - first + 2);
+        const uint64_t* positions = (const uint64_t*)read_span(
+            index, header->table_offset + first * sizeof(uint64_t), n_positions * sizeof(uint64_t),
+            &table_buffer, &table_capacity);
+        uint64_t start = positions ? positions[0] : 0;
+        uint64_t end = positions ? positions[n_positions - 1] : 0;
+        const uint8_t* data = positions && start <= end
+                                  ? read_span(index, header->data_offset + start, (size_t)(end - start),
+                                              &data_buffer, &data_capacity)
+                                  : NULL;
+        if (!data) {
+            failed = 1;
+            break;
+        }
+
+        for (; i < j && !failed; i++) {
+            uint64_t row = (uint64_t)rows[i] - header->first_row - first;
+            if (positions[row] < start || positions[row] > positions[row + 1] || positions[row + 1] > end) {
+                failed = 1;
+                break;
+            }
+            const uint8_t* p = data + (positions[row] - start);
+            const uint8_t* row_end = data + (positions[row + 1] - start);
+            uint64_t skill = 0;
+            for (int k = 0; p < row_end; k++) {
+                uint64_t delta = 0;
+                int shift = 0;
+                while (p < row_end && (*p & 0x80) && shift < 63) {
+                    delta |= (uint64_t)(*p++ & 0x7F) << shift;
+                    shift += 7;
+                }
+                if (p == row_end) {
+                    failed = 1;
+                    break;
+                }
+                delta |= (uint64_t)*p++ << shift;
+                skill = k == 0 ? delta : skill + delta;
+                if (skill >= header->n_skills) {
+                    failed = 1;
+                    break;
+                }
+                counts[skill]++;
+            }
+        }
+    }
+    free(table_buffer);
+    free(data_buffer);
+    return failed;
+}
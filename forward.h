@@ -0,0 +1,63 @@
+#ifndef FORWARD_H
+#define FORWARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Índice de skills por fila de un segmento del formato 4 (dist/jobs.fwd para
+// la base, dist/jobs.<id>.fwd para cada delta). Es la inversa de las listas:
+// para cada fila, los números de entrada del directorio de sus skills.
+//
+//   [FwdHeader][tabla: n_rows + 1 posiciones][skills de cada fila...]
+//
+// Las skills de una fila van en orden creciente como diferencias en varint
+// (la primera, tal cual), desde la posición i de la tabla hasta la i + 1.
+// Las posiciones son relativas a data_offset.
+//
+// Con él, el motor cuenta las skills que más se repiten entre los resultados
+// de una búsqueda (FACET) sin leer data.csv. Los números de entrada son los
+// del directorio del propio segmento (ver find_skill_number).
+
+// "JOBFWD" en little endian
+#define FWD_MAGIC 0x445746424F4AULL
+#define FWD_VERSION 1
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t first_row;     // Filas [first_row, first_row + n_rows), como en jobs.skl
+    uint64_t n_rows;
+    uint64_t n_skills;      // Entradas del directorio del segmento
+    uint64_t table_offset;
+    uint64_t data_offset;
+} FwdHeader;
+
+// Nombre del .fwd de un segmento a partir del de su jobs.skl
+void forward_file_name(const char* skl_name, char* fwd_name, size_t size);
+
+// Genera 'fwd_name' (como .tmp, renombrado al terminar) recorriendo las
+// listas del segmento ya escrito. Con 'budget' (bytes, 0 = sin límite) las
+// skills de las filas se reúnen por tramos de filas que quepan en él, con
+// una pasada por las listas en cada tramo. Devuelve 0 si va bien.
+int forward_build(const char* skl_name, const char* idx_name, const char* fwd_name, size_t budget);
+
+// Índice abierto. Con use_map se proyecta en memoria; si no, se lee con
+// pread. Se puede compartir entre hilos.
+typedef struct {
+    int fd;
+    FwdHeader header;
+    uint64_t file_size;
+    const uint8_t* map;     // NULL si no está proyectado
+} ForwardIndex;
+
+int forward_open(ForwardIndex* index, const char* filename, int use_map);
+void forward_close(ForwardIndex* index);
+
+// Suma 1 en counts[e] por cada skill e de cada fila de rows[0..n), que deben
+// ir en orden creciente y ser del segmento. 'counts' tiene header.n_skills
+// contadores. Las filas cercanas se leen juntas: un tramo de la tabla y el
+// de sus skills. Devuelve 0 si va bien.
+int forward_count(const ForwardIndex* index, const long* rows, size_t n, uint32_t* counts);
+
+#endif
@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fuzzy.h"
+#include "index_reader.h"
+#include "postings.h"
+
+// Trigramas posibles: tres bytes
+#define FZY_CODES (1u << 24)
+#define FZY_MIN_WINDOW (1024 * 1024)
+
+// Letras de U+00C0 a U+017F sin tilde y en minúsculas. NULL: se deja tal cual.
+static const char* const latin_letters[192] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", NULL, "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", NULL, "o", "u", "u", "u", "u", "y", "th", "y",
+    "a", "a", "a", "a", "a", "a", "c", "c", "c", "c", "c", "c", "c", "c", "d", "d",
+    "d", "d", "e", "e", "e", "e", "e", "e", "e", "e", "e", "e", "g", "g", "g", "g",
+    "g", "g", "g", "g", "h", "h", "h", "h", "i", "i", "i", "i", "i", "i", "i", "i",
+    "i", "i", "ij", "ij", "j", "j", "k", "k", "k", "l", "l", "l", "l", "l", "l", "l",
+    "l", "l", "l", "n", "n", "n", "n", "n", "n", "n", "n", "n", "o", "o", "o", "o",
+    "o", "o", "oe", "oe", "r", "r", "r", "r", "r", "r", "s", "s", "s", "s", "s", "s",
+    "s", "s", "t", "t", "t", "t", "t", "t", "u", "u", "u", "u", "u", "u", "u", "u",
+    "u", "u", "u", "u", "w", "w", "y", "y", "y", "z", "z", "z", "z", "z", "z", "s",
+};
+
+size_t fuzzy_normalize(const char* text, size_t len, char* out) {
+    const unsigned char* p = (const unsigned char*)text;
+    size_t n = 0;
+    int space = 0;
+    for (size_t i = 0; i < len;) {
+        unsigned char c = p[i];
+        if (isspace(c)) {
+            space = n > 0; // Los del principio se quitan
+            i++;
+            continue;
+        }
+        // Lo que sustituye al carácter: una letra (o dos), nada o él mismo
+        char lower[2] = { (char)tolower(c), '\0' };
+        const char* replacement = NULL;
+        size_t bytes = 1;
+        if (c < 0x80) {
+            replacement = lower;
+        } else if ((c & 0xE0) == 0xC0 && i + 1 < len && (p[i + 1] & 0xC0) == 0x80) {
+            unsigned code = ((unsigned)(c & 0x1F) << 6) | (p[i + 1] & 0x3F);
+            if (code >= 0xC0 && code < 0x180) replacement = latin_letters[code - 0xC0];
+            else if (code >= 0x300 && code < 0x370) replacement = ""; // Marca combinante
+            if (replacement) bytes = 2;
+        }
+        if (replacement && !*replacement) {
+            i += bytes;
+            continue;
+        }
+        if (space) out[n++] = ' ';
+        space = 0;
+        if (replacement) {
+            while (*replacement) out[n++] = *replacement++;
+        } else {
+            out[n++] = (char)c;
+        }
+        i += bytes;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+int fuzzy_max_distance(size_t len) {
+    return len < 4 ? 0 : len < 8 ? 1 : 2;
+}
+
+void fuzzy_file_name(const char* skl_name, char* fzy_name, size_t size) {
+    size_t len = strlen(skl_name);
+    if (len >= 4 && strcmp(skl_name + len - 4, ".skl") == 0) len -= 4;
+    snprintf(fzy_name, size, "%.*s.fzy", (int)len, skl_name);
+}
+
+static int compare_codes(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Trigramas distintos de una clave, ordenados, en 'codes' (len + 1 huecos)
+static size_t key_trigrams(const char* key, size_t len, uint32_t* codes) {
+    if (len == 0) return 0;
+    size_t n = 0;
+    uint32_t code = (FZY_PAD << 8) | FZY_PAD;
+    for (size_t i = 0; i <= len; i++) {
+        uint32_t next = i < len ? (unsigned char)key[i] : FZY_PAD;
+        code = ((code << 8) | next) & (FZY_CODES - 1);
+        codes[n++] = code;
+    }
+    qsort(codes, n, sizeof(uint32_t), compare_codes);
+    size_t unique = 1;
+    for (size_t i = 1; i < n; i++) {
+        if (codes[i] != codes[unique - 1]) codes[unique++] = codes[i];
+    }
+    return unique;
+}
+
+static size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static int write_varint(FILE* out, uint64_t value) {
+    uint8_t bytes[10];
+    size_t n = 0;
+    while (value >= 0x80) {
+        bytes[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (uint8_t)value;
+    return fwrite(bytes, 1, n, out) == n;
+}
+
+// Clave normalizada de una entrada del directorio
+typedef struct {
+    const char* key;
+    uint32_t len;
+    uint32_t number;
+} KeyRef;
+
+static int compare_key_refs(const void* a, const void* b) {
+    const KeyRef* x = a;
+    const KeyRef* y = b;
+    if (x->len != y->len) return x->len < y->len ? -1 : 1;
+    int cmp = memcmp(x->key, y->key, x->len);
+    if (cmp != 0) return cmp;
+    return (x->number > y->number) - (x->number < y->number);
+}
+
+// Listas de trigramas en construcción
+typedef struct {
+    const KeyRef* refs;
+    const size_t* key_refs;     // Primera entrada de cada clave en refs
+    size_t n_keys;
+    uint32_t* counts;
+    FzyTrigram* trigrams;
+    size_t n_trigrams;
+    size_t trigrams_capacity;
+    uint64_t written;
+} TrigramBuild;
+
+// Escribe las listas de los trigramas [lo, hi) a partir de las claves. En
+// counts[c] entra cuántas claves tiene cada trigrama y queda dónde acaba su
+// lista dentro del tramo.
+static int write_window(TrigramBuild* build, uint32_t lo, uint32_t hi, size_t values, FILE* out) {
+    uint32_t* list = malloc((values > 0 ? values : 1) * sizeof(uint32_t));
+    uint32_t codes[FZY_MAX_FUZZY_LEN + 1];
+    if (!list) return 1;
+
+    // Inicio de la lista de cada trigrama dentro del tramo
+    uint32_t position = 0;
+    for (uint32_t c = lo; c < hi; c++) {
+        uint32_t count = build->counts[c];
+        build->counts[c] = position;
+        position += count;
+    }
+    int failed = 0;
+    for (size_t k = 0; k < build->n_keys; k++) {
+        const KeyRef* ref = &build->refs[build->key_refs[k]];
+        if (ref->len > FZY_MAX_FUZZY_LEN) continue; // Nunca se buscan por trigramas
+        size_t n = key_trigrams(ref->key, ref->len, codes);
+        for (size_t i = 0; i < n; i++) {
+            if (codes[i] >= lo && codes[i] < hi) list[build->counts[codes[i]]++] = (uint32_t)k;
+        }
+    }
+
+    // counts[c] es ahora el fin de la lista de c, que es el inicio de la siguiente
+    uint8_t block[POSTING_MAX_BLOCK_BYTES];
+    long values_block[POSTING_BLOCK_SIZE];
+    uint32_t start = 0;
+    for (uint32_t c = lo; c < hi && !failed; c++) {
+        uint32_t end = build->counts[c];
+        if (end == start) continue;
+        long previous = 0;
+        for (uint32_t i = start; i < end && !failed; i += POSTING_BLOCK_SIZE) {
+            size_t n = end - i < POSTING_BLOCK_SIZE ? end - i : POSTING_BLOCK_SIZE;
+            for (size_t j = 0; j < n; j++) values_block[j] = list[i + j];
+            size_t bytes = postings_encode_block(values_block, n, previous, block);
+            previous = values_block[n - 1];
+            failed = fwrite(block, 1, bytes, out) != bytes;
+            build->written += bytes;
+        }
+        if (build->n_trigrams == build->trigrams_capacity) {
+            size_t bigger_capacity = build->trigrams_capacity * 2 + 64;
+            FzyTrigram* bigger = realloc(build->trigrams, bigger_capacity * sizeof(FzyTrigram));
+            if (!bigger) {
+                failed = 1;
+                break;
+            }
+            build->trigrams = bigger;
+            build->trigrams_capacity = bigger_capacity;
+        }
+        build->trigrams[build->n_trigrams++] = (FzyTrigram){ c, end - start, build->written };
+        start = end;
+    }
+    free(list);
+    return failed;
+}
+
+int fuzzy_build(const char* skl_name, const char* fzy_name, size_t budget) {
+    FILE* skl = fopen(skl_name, "rb");
+    SkillDirInfo info = {0};
+    if (!skl || !read_skill_dir_header(skl, &info) || !info.front_coded || info.total_skills > UINT32_MAX) {
+        fprintf(stderr, "Error al abrir el segmento '%s'\n", skl_name);
+        if (skl) fclose(skl);
+        free_skill_dir_info(&info);
+        return 1;
+    }
+    size_t n_skills = info.total_skills;
+    KeyRef* refs = malloc((n_skills > 0 ? n_skills : 1) * sizeof(KeyRef));
+    size_t* key_refs = malloc((n_skills + 1) * sizeof(size_t));
+    uint64_t* key_offsets = NULL;
+    uint32_t* length_starts = NULL;
+    char* keys = NULL;
+    size_t keys_len = 0, keys_capacity = 0;
+    TrigramBuild build = {0};
+    int failed = !refs || !key_refs;
+
+    // 1. Clave normalizada de cada entrada, en un único buffer
+    char* skill = NULL;
+    size_t capacity = 0, len;
+    SkillEntry entry;
+    for (size_t number = 0; number < n_skills && !failed; number++) {
+        if (!read_skill_entry(skl, &info, &skill, &capacity, &len, &entry) || len > UINT32_MAX) {
+            failed = 1;
+            break;
+        }
+        if (keys_len + len + 1 > keys_capacity) {
+            size_t bigger_capacity = (keys_len + len + 1) * 2;
+            char* bigger = realloc(keys, bigger_capacity);
+            if (!bigger) {
+                failed = 1;
+                break;
+            }
+            keys = bigger;
+            keys_capacity = bigger_capacity;
+        }
+        size_t key_len = fuzzy_normalize(skill, len, keys + keys_len);
+        refs[number] = (KeyRef){ (const char*)(uintptr_t)keys_len, (uint32_t)key_len, (uint32_t)number };
+        keys_len += key_len + 1;
+    }
+    free(skill);
+    for (size_t i = 0; i < n_skills && !failed; i++) refs[i].key = keys + (uintptr_t)refs[i].key;
+
+    // 2. Orden por longitud y bytes; las entradas de una misma clave, juntas
+    size_t n_keys = 0, max_len = 0;
+    if (!failed) {
+        qsort(refs, n_skills, sizeof(KeyRef), compare_key_refs);
+        for (size_t i = 0; i < n_skills; i++) {
+            if (i == 0 || refs[i].len != refs[i - 1].len || memcmp(refs[i].key, refs[i - 1].key, refs[i].len) != 0) {
+                key_refs[n_keys++] = i;
+            }
+            if (refs[i].len > max_len) max_len = refs[i].len;
+        }
+        key_refs[n_keys] = n_skills;
+        length_starts = calloc(max_len + 2, sizeof(uint32_t));
+        key_offsets = malloc((n_keys + 1) * sizeof(uint64_t));
+        failed = !length_starts || !key_offsets;
+    }
+    if (!failed) {
+        // Primera clave de cada longitud y posición de cada clave
+        size_t k = 0;
+        for (size_t l = 0; l <= max_len + 1; l++) {
+            while (k < n_keys && refs[key_refs[k]].len < l) k++;
+            length_starts[l] = (uint32_t)k;
+        }
+        uint64_t position = 0;
+        for (k = 0; k < n_keys; k++) {
+            key_offsets[k] = position;
+            const KeyRef* ref = &refs[key_refs[k]];
+            size_t n = key_refs[k + 1] - key_refs[k];
+            position += varint_size(ref->len) + ref->len + varint_size(n);
+            for (size_t i = 0; i < n; i++) {
+                uint32_t previous = i > 0 ? refs[key_refs[k] + i - 1].number : 0;
+                position += varint_size(refs[key_refs[k] + i].number - previous);
+            }
+        }
+        key_offsets[n_keys] = position;
+    }
+
+    FzyHeader header = {0};
+    header.magic = FZY_MAGIC;
+    header.version = FZY_VERSION;
+    header.header_size = sizeof(FzyHeader);
+    header.n_skills = n_skills;
+    header.data_end = info.data_end;
+    header.n_keys = n_keys;
+    header.max_len = max_len;
+    header.lengths_offset = sizeof(FzyHeader);
+    header.table_offset = header.lengths_offset + (max_len + 2) * sizeof(uint32_t);
+    header.keys_offset = header.table_offset + (n_keys + 1) * sizeof(uint64_t);
+    header.postings_offset = header.keys_offset + (key_offsets ? key_offsets[n_keys] : 0);
+
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fzy_name);
+    FILE* out = failed ? NULL : fopen(tmp, "wb");
+    failed = failed || !out || fwrite(&header, sizeof(header), 1, out) != 1 ||
+             fwrite(length_starts, sizeof(uint32_t), max_len + 2, out) != max_len + 2 ||
+             fwrite(key_offsets, sizeof(uint64_t), n_keys + 1, out) != n_keys + 1;
+
+    // 3. Las claves, con las entradas de cada una
+    for (size_t k = 0; k < n_keys && !failed; k++) {
+        const KeyRef* ref = &refs[key_refs[k]];
+        size_t n = key_refs[k + 1] - key_refs[k];
+        failed = !write_varint(out, ref->len) || fwrite(ref->key, 1, ref->len, out) != ref->len ||
+                 !write_varint(out, n);
+        for (size_t i = 0; i < n && !failed; i++) {
+            uint32_t previous = i > 0 ? refs[key_refs[k] + i - 1].number : 0;
+            failed = !write_varint(out, refs[key_refs[k] + i].number - previous);
+        }
+    }
+
+    // 4. Las listas de trigramas, por tramos de trigramas que quepan en memoria
+    build.refs = refs;
+    build.key_refs = key_refs;
+    build.n_keys = n_keys;
+    build.counts = failed ? NULL : calloc(FZY_CODES, sizeof(uint32_t));
+    failed = failed || !build.counts;
+    uint32_t codes[FZY_MAX_FUZZY_LEN + 1];
+    for (size_t k = 0; k < n_keys && !failed; k++) {
+        const KeyRef* ref = &refs[key_refs[k]];
+        if (ref->len > FZY_MAX_FUZZY_LEN) continue; // Nunca se buscan por trigramas
+        size_t n = key_trigrams(ref->key, ref->len, codes);
+        for (size_t i = 0; i < n; i++) build.counts[codes[i]]++;
+    }
+    size_t window = budget > 0 ? budget / 2 / sizeof(uint32_t) : SIZE_MAX;
+    if (window < FZY_MIN_WINDOW / sizeof(uint32_t)) window = FZY_MIN_WINDOW / sizeof(uint32_t);
+    if (window > UINT32_MAX) window = UINT32_MAX; // Las posiciones del tramo van en counts
+    for (uint32_t lo = 0; lo < FZY_CODES && !failed;) {
+        uint32_t hi = lo;
+        size_t values = 0;
+        while (hi < FZY_CODES && (values == 0 || values + build.counts[hi] <= window)) values += build.counts[hi++];
+        failed = write_window(&build, lo, hi, values, out);
+        lo = hi;
+    }
+    if (!failed) {
+        header.n_trigrams = build.n_trigrams;
+        header.trigrams_offset = header.postings_offset + build.written;
+        failed = fwrite(build.trigrams, sizeof(FzyTrigram), build.n_trigrams, out) != build.n_trigrams ||
+                 fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1;
+    }
+    if (out && fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp, fzy_name) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "Error al escribir el índice de búsqueda aproximada '%s'\n", fzy_name);
+        remove(tmp);
+    }
+
+    fclose(skl);
+    free_skill_dir_info(&info);
+    free(refs);
+    free(key_refs);
+    free(key_offsets);
+    free(length_starts);
+    free(keys);
+    free(build.counts);
+    free(build.trigrams);
+    return failed;
+}
+
+int fuzzy_open(FuzzyIndex* index, const char* filename, int use_map) {
+    memset(index, 0, sizeof(*index));
+    index->fd = open(filename, O_RDONLY);
+    if (index->fd < 0) return 1;
+
+    struct stat st;
+    FzyHeader* header = &index->header;
+    int ok = fstat(index->fd, &st) == 0 &&
+             pread(index->fd, header, sizeof(*header), 0) == (ssize_t)sizeof(*header) &&
+             header->magic == FZY_MAGIC && header->version == FZY_VERSION &&
+             header->header_size == sizeof(FzyHeader) && header->n_keys <= UINT32_MAX &&
+             header->table_offset == header->lengths_offset + (header->max_len + 2) * sizeof(uint32_t) &&
+             header->keys_offset == header->table_offset + (header->n_keys + 1) * sizeof(uint64_t) &&
+             header->trigrams_offset + header->n_trigrams * sizeof(FzyTrigram) == (uint64_t)st.st_size;
+    if (ok) {
+        size_t lengths_size = (size_t)(header->max_len + 2) * sizeof(uint32_t);
+        size_t trigrams_size = (size_t)header->n_trigrams * sizeof(FzyTrigram);
+        index->length_starts = malloc(lengths_size);
+        index->trigrams = malloc(trigrams_size > 0 ? trigrams_size : 1);
+        ok = index->length_starts && index->trigrams &&
+             pread(index->fd, index->length_starts, lengths_size, (off_t)header->lengths_offset) ==
+                 (ssize_t)lengths_size &&
+             pread(index->fd, index->trigrams, trigrams_size, (off_t)header->trigrams_offset) ==
+                 (ssize_t)trigrams_size;
+    }
+    if (!ok) {
+        fprintf(stderr, "Formato de %s no soportado\n", filename);
+        fuzzy_close(index);
+        return 1;
+    }
+    index->file_size = (uint64_t)st.st_size;
+    if (use_map) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, index->fd, 0);
+        // Sin mapa se sigue leyendo con pread
+        if (map != MAP_FAILED) index->map = map;
+    }
+    return 0;
+}
+
+void fuzzy_close(FuzzyIndex* index) {
+    if (index->map) munmap((void*)index->map, index->file_size);
+    if (index->fd >= 0) close(index->fd);
+    free(index->length_starts);
+    free(index->trigrams);
+    memset(index, 0, sizeof(*index));
+    index->fd = -1;
+}
+
+// Buffer de una lectura del índice, reutilizable entre lecturas
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+} SpanBuffer;
+
+// Bytes [offset, offset + size) del índice: del mapa o leídos en el buffer
+static const uint8_t* read_span(const FuzzyIndex* index, uint64_t offset, size_t size, SpanBuffer* buffer) {
+    if (offset + size > index->file_size) return NULL;
+    if (index->map) return index->map + offset;
+    if (size > buffer->capacity) {
+        uint8_t* bigger = realloc(buffer->data, size);
+        if (!bigger) return NULL;
+        buffer->data = bigger;
+        buffer->capacity = size;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(index->fd, buffer->data + done, size - done, (off_t)(offset + done));
+        if (n <= 0) return NULL;
+        done += (size_t)n;
+    }
+    return buffer->data;
+}
+
+static int get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Clave 'id' leída del índice: su texto y sus entradas sin decodificar
+typedef struct {
+    const char* key;
+    size_t len;
+    uint64_t n_entries;
+    const uint8_t* entries;
+    const uint8_t* end;
+} KeyRecord;
+
+static int read_key(const FuzzyIndex* index, uint64_t id, KeyRecord* record, SpanBuffer* table,
+                    SpanBuffer* data) {
+    const uint8_t* span = read_span(index, index->header.table_offset + id * sizeof(uint64_t),
+                                    2 * sizeof(uint64_t), table);
+    if (!span) return 0;
+    uint64_t positions[2];
+    memcpy(positions, span, sizeof(positions));
+    if (positions[1] < positions[0]) return 0;
+    size_t size = (size_t)(positions[1] - positions[0]);
+    const uint8_t* p = read_span(index, index->header.keys_offset + positions[0], size, data);
+    if (!p) return 0;
+    record->end = p + size;
+    uint64_t len;
+    if (!get_varint(&p, record->end, &len) || len > (uint64_t)(record->end - p)) return 0;
+    record->key = (const char*)p;
+    record->len = (size_t)len;
+    p += len;
+    if (!get_varint(&p, record->end, &record->n_entries)) return 0;
+    record->entries = p;
+    return 1;
+}
+
+// Añade las entradas de la clave. Devuelve 0 si los datos no cuadran.
+static int add_entries(const KeyRecord* record, int distance, FuzzyMatch* out, size_t capacity, size_t* n) {
+    const uint8_t* p = record->entries;
+    uint64_t number = 0;
+    for (uint64_t i = 0; i < record->n_entries && *n < capacity; i++) {
+        uint64_t delta;
+        if (!get_varint(&p, record->end, &delta)) return 0;
+        number += delta;
+        out[(*n)++] = (FuzzyMatch){ (uint32_t)number, distance };
+    }
+    return 1;
+}
+
+// Distancia de edición entre a y b si es como mucho max_distance; si no,
+// max_distance + 1. Las dos tienen como mucho FZY_MAX_FUZZY_LEN + 2 bytes.
+static int edit_distance(const char* a, size_t a_len, const char* b, size_t b_len, int max_distance) {
+    int rows[2][FZY_MAX_FUZZY_LEN + 3];
+    int* previous = rows[0];
+    int* current = rows[1];
+    for (size_t j = 0; j <= b_len; j++) previous[j] = (int)j;
+    for (size_t i = 1; i <= a_len; i++) {
+        current[0] = (int)i;
+        int best = current[0];
+        for (size_t j = 1; j <= b_len; j++) {
+            int cost = previous[j - 1] + (a[i - 1] != b[j - 1]);
+            if (previous[j] + 1 < cost) cost = previous[j] + 1;
+            if (current[j - 1] + 1 < cost) cost = current[j - 1] + 1;
+            current[j] = cost;
+            if (cost < best) best = cost;
+        }
+        if (best > max_distance) return max_distance + 1; // Ya no puede bajar
+        int* swap = previous;
+        previous = current;
+        current = swap;
+    }
+    return previous[b_len] <= max_distance ? previous[b_len] : max_distance + 1;
+}
+
+static int compare_trigram_code(const void* key, const void* element) {
+    uint32_t code = *(const uint32_t*)key;
+    const FzyTrigram* trigram = element;
+    return (code > trigram->code) - (code < trigram->code);
+}
+
+// Clave candidata de la búsqueda por trigramas
+typedef struct {
+    uint32_t id;
+    int distance;
+} Candidate;
+
+static int compare_candidates(const void* a, const void* b) {
+    const Candidate* x = a;
+    const Candidate* y = b;
+    if (x->distance != y->distance) return x->distance - y->distance;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+// Busca las claves de longitud parecida que comparten bastantes trigramas
+// con 'key' y deja en *candidates (ordenadas por distancia) las que están a
+// distancia <= max_distance, sin contar la propia clave.
+static int find_candidates(const FuzzyIndex* index, const char* key, size_t len, int max_distance,
+                           Candidate** candidates, size_t* n_candidates, SpanBuffer* table, SpanBuffer* data) {
+    const FzyHeader* header = &index->header;
+    *n_candidates = 0;
+    size_t lo_len = len > (size_t)max_distance ? len - (size_t)max_distance : 1;
+    size_t hi_len = len + (size_t)max_distance;
+    if (hi_len > header->max_len) hi_len = (size_t)header->max_len;
+    if (lo_len > hi_len) return 1;
+    uint32_t id_lo = index->length_starts[lo_len];
+    uint32_t id_hi = index->length_starts[hi_len + 1];
+    if (id_lo >= id_hi) return 1;
+
+    // Cada edición quita como mucho tres trigramas de la clave
+    uint32_t codes[FZY_MAX_FUZZY_LEN + 1];
+    size_t n_codes = key_trigrams(key, len, codes);
+    size_t threshold = n_codes > 3 * (size_t)max_distance ? n_codes - 3 * (size_t)max_distance : 1;
+
+    uint8_t* shared = calloc(id_hi - id_lo, 1);
+    long* values = NULL;
+    size_t values_capacity = 0;
+    int ok = shared != NULL;
+    for (size_t c = 0; ok && c < n_codes; c++) {
+        const FzyTrigram* trigram = bsearch(&codes[c], index->trigrams, (size_t)header->n_trigrams,
+                                            sizeof(FzyTrigram), compare_trigram_code);
+        if (!trigram) continue;
+        uint64_t start = trigram == index->trigrams ? 0 : trigram[-1].end;
+        if (trigram->count > values_capacity) {
+            long* bigger = realloc(values, trigram->count * sizeof(long));
+            if (!bigger) {
+                ok = 0;
+                break;
+            }
+            values = bigger;
+            values_capacity = trigram->count;
+        }
+        const uint8_t* list = read_span(index, header->postings_offset + start, (size_t)(trigram->end - start), data);
+        ok = list && postings_decode(list, (size_t)(trigram->end - start), trigram->count, values) == 0;
+        for (uint32_t i = 0; ok && i < trigram->count; i++) {
+            if (values[i] >= id_lo && values[i] < id_hi) shared[values[i] - id_lo]++;
+        }
+    }
+    free(values);
+
+    size_t capacity = 0;
+    for (uint32_t id = id_lo; ok && id < id_hi; id++) {
+        if (shared[id - id_lo] < threshold) continue;
+        KeyRecord record;
+        ok = read_key(index, id, &record, table, data);
+        if (!ok) break;
+        int distance = edit_distance(key, len, record.key, record.len, max_distance);
+        if (distance == 0 || distance > max_distance) continue;
+        if (*n_candidates == capacity) {
+            capacity = capacity * 2 + 16;
+            Candidate* bigger = realloc(*candidates, capacity * sizeof(Candidate));
+            if (!bigger) {
+                ok = 0;
+                break;
+            }
+            *candidates = bigger;
+        }
+        (*candidates)[(*n_candidates)++] = (Candidate){ id, distance };
+    }
+    free(shared);
+    if (ok && *n_candidates > 1) qsort(*candidates, *n_candidates, sizeof(Candidate), compare_candidates);
+    return ok;
+}
+
+int fuzzy_lookup(const FuzzyIndex* index, const char* term, int max_distance, FuzzyMatch* out, size_t capacity,
+                 size_t* n) {
+    const FzyHeader* header = &index->header;
+    *n = 0;
+    size_t term_len = strlen(term);
+    char* key = malloc(term_len + 1);
+    if (!key) return 1;
+    size_t len = fuzzy_normalize(term, term_len, key);
+    if (max_distance < 0) max_distance = fuzzy_max_distance(len);
+    if (len > FZY_MAX_FUZZY_LEN) max_distance = 0;
+
+    SpanBuffer table = {0}, data = {0};
+    int ok = 1;
+    // 1. La misma clave: búsqueda binaria entre las de su longitud
+    if (len > 0 && len <= header->max_len) {
+        uint64_t lo = index->length_starts[len], hi = index->length_starts[len + 1];
+        while (ok && lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            KeyRecord record;
+            ok = read_key(index, mid, &record, &table, &data);
+            int cmp = ok ? memcmp(record.key, key, len) : 0;
+            if (ok && cmp == 0) {
+                ok = add_entries(&record, 0, out, capacity, n);
+                break;
+            }
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+    }
+
+    // 2. Las parecidas, por trigramas
+    Candidate* candidates = NULL;
+    size_t n_candidates = 0;
+    if (ok && len > 0 && max_distance > 0) {
+        ok = find_candidates(index, key, len, max_distance, &candidates, &n_candidates, &table, &data);
+    }
+    for (size_t i = 0; ok && i < n_candidates && *n < capacity; i++) {
+        KeyRecord record;
+        ok = read_key(index, candidates[i].id, &record, &table, &data) &&
+             add_entries(&record, candidates[i].distance, out, capacity, n);
+    }
+    free(candidates);
+    free(table.data);
+    free(data.data);
+    free(key);
+    return !ok;
+}
+
+size_t fuzzy_nearest(const FuzzyMatch* matches, size_t n) {
+    size_t nearest = 0;
+    while (nearest < n && matches[nearest].distance == matches[0].distance) nearest++;
+    return nearest;
+}
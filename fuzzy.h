@@ -0,0 +1,111 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Búsqueda aproximada de skills (dist/jobs.fzy, directorio de la base).
+//
+// Cada skill tiene una clave normalizada: en minúsculas, sin tildes (latín
+// 1 y latín extendido A, o marcas combinantes sueltas) y con los espacios
+// juntos en uno y quitados de los extremos. "Pythón", "python" y "Python "
+// comparten la clave "python". El archivo guarda las claves, cada una con
+// los números de entrada del directorio de las skills que la tienen, y un
+// índice de trigramas sobre ellas:
+//
+//   [FzyHeader][primera clave de cada longitud][tabla: n_keys + 1 posiciones]
+//   [claves...][listas de trigramas...][FzyTrigram de cada trigrama]
+//
+// Las claves van ordenadas por longitud y, a igualdad, byte a byte; su
+// número es la posición en ese orden. Cada una es [varint longitud][clave]
+// [varint n][n números de entrada como diferencias en varint]. Las listas de
+// trigramas son números de clave crecientes codificados como las listas de
+// jobs.idx (ver postings.h). Los trigramas se toman de la clave con dos
+// FZY_PAD delante y uno detrás, y cada clave aparece una vez en la lista de
+// cada trigrama suyo.
+//
+// Con el orden por longitud, las claves a distancia de edición d de una de
+// longitud n son un tramo de números: las de longitud n - d a n + d. Solo
+// se cuentan los trigramas compartidos dentro de ese tramo, y solo se
+// comprueba la distancia de las que comparten bastantes.
+
+// "JOBFZY" en little endian
+#define FZY_MAGIC 0x595A46424F4AULL
+#define FZY_VERSION 1
+#define FZY_PAD 0x01
+// Términos más largos no se buscan por trigramas
+#define FZY_MAX_FUZZY_LEN 64
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t n_skills;      // Entradas del directorio de la base
+    uint64_t data_end;      // Fin del rango de data.csv de la base, como en jobs.skl
+    uint64_t n_keys;
+    uint64_t max_len;       // Longitud de la clave más larga
+    uint64_t lengths_offset;    // max_len + 2 números de clave (uint32)
+    uint64_t table_offset;      // n_keys + 1 posiciones (uint64), relativas a keys_offset
+    uint64_t keys_offset;
+    uint64_t postings_offset;
+    uint64_t n_trigrams;
+    uint64_t trigrams_offset;
+} FzyHeader;
+
+typedef struct {
+    uint32_t code;          // Los tres bytes del trigrama, el primero en los bits altos
+    uint32_t count;         // Claves con el trigrama
+    uint64_t end;           // Fin de su lista, relativo a postings_offset
+} FzyTrigram;
+
+// Clave normalizada de los 'len' bytes de 'text' en 'out', que debe tener
+// sitio para len + 1 bytes (la clave nunca es más larga). Devuelve su longitud.
+size_t fuzzy_normalize(const char* text, size_t len, char* out);
+
+// Distancia de edición máxima de la búsqueda aproximada para una clave de
+// 'len' bytes: ninguna por debajo de 4, 1 hasta 7 y 2 desde 8.
+int fuzzy_max_distance(size_t len);
+
+// Nombre del .fzy a partir del jobs.skl
+void fuzzy_file_name(const char* skl_name, char* fzy_name, size_t size);
+
+// Genera 'fzy_name' (como .tmp, renombrado al terminar) a partir del
+// directorio de 'skl_name'. Las listas de trigramas se reúnen por tramos de
+// trigramas que quepan en 'budget' (bytes, 0 = sin límite), con una pasada
+// por las claves en cada tramo. Devuelve 0 si va bien.
+int fuzzy_build(const char* skl_name, const char* fzy_name, size_t budget);
+
+// Índice abierto. La primera clave de cada longitud y la tabla de trigramas
+// se cargan en memoria; las claves y las listas se leen del mapa (use_map)
+// o con pread. Se puede compartir entre hilos.
+typedef struct {
+    int fd;
+    FzyHeader header;
+    uint64_t file_size;
+    const uint8_t* map;     // NULL si no está proyectado
+    uint32_t* length_starts;
+    FzyTrigram* trigrams;
+} FuzzyIndex;
+
+int fuzzy_open(FuzzyIndex* index, const char* filename, int use_map);
+void fuzzy_close(FuzzyIndex* index);
+
+typedef struct {
+    uint32_t number;        // Número de entrada en el directorio
+    int distance;           // Distancia de edición entre las claves
+} FuzzyMatch;
+
+// Skills cuya clave está a distancia de edición <= max_distance de la de
+// 'term': con 0, las de su misma clave; con un valor negativo, la distancia
+// de fuzzy_max_distance para la longitud de la clave. Añade hasta 'capacity'
+// en 'out', primero las de menor distancia, y deja en *n cuántas. Devuelve 0
+// si va bien.
+int fuzzy_lookup(const FuzzyIndex* index, const char* term, int max_distance, FuzzyMatch* out, size_t capacity,
+                 size_t* n);
+
+// Cuántas de las n coincidencias de fuzzy_lookup están a la menor distancia
+// (van primero): una errata de una edición no se amplía con las que están a
+// dos, que suelen ser skills más frecuentes y sin relación.
+size_t fuzzy_nearest(const FuzzyMatch* matches, size_t n);
+
+#endif
@@ -3,230 +3,1397 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <limits.h>
 #include "utils.h"
+#include "csv_scan.h"
+#include "arena.h"
+#include "index_writer.h"
+#include "index_reader.h"
+#include "segments.h"
+#include "docstore.h"
+#include "rowstore.h"
+#include "forward.h"
+#include "suggest.h"
+#include "fuzzy.h"
+#include "pairs.h"
 
 #define TABLE_SIZE 4520789
+#define MIN_TABLE_SIZE 4096
+#define MAX_WORKERS 256
+#define ARENA_CHUNK_SIZE (64UL * 1024 * 1024)
+#define MIN_ARENA_CHUNK_SIZE (64UL * 1024)
+#define MERGE_CHUNK 65536       // Offsets leídos de un run por llamada
+#define MAX_RUN_BUFFER (1UL * 1024 * 1024)
+#define MAX_OPEN_RUNS 512       // Runs abiertos a la vez entre todos los workers
+#define MIN_WORKER_BUDGET (1UL * 1024 * 1024)
+#define POSTING_CHUNK_MIN 2     // La mayoría de skills aparecen muy pocas veces
+#define POSTING_CHUNK_MAX 4096  // Tope de crecimiento: 32 KB por bloque
+#define DOCS_FILE "dist/jobs.docs"
+#define ROWS_FILE "dist/jobs.rows"
 
-typedef struct OffsetNode {
-    long offset;
-    struct OffsetNode* next;
-} OffsetNode;
+// Bloque contiguo de offsets de una skill. Los bloques crecen al doble
+// hasta POSTING_CHUNK_MAX y viven en el arena del worker que los creó.
+typedef struct PostingChunk {
+    struct PostingChunk* next;
+    unsigned int used;
+    unsigned int capacity;
+    long offsets[];
+} PostingChunk;
 
 typedef struct HashNode {
     char* skill;
-    OffsetNode* offsets;
+    size_t skill_len;
+    PostingChunk* postings;
+    PostingChunk* postings_tail; // Bloque donde se añaden offsets; permite unir listas en O(1)
     size_t offset_count; // Contaremos los offsets aquí
     struct HashNode* next;
 } HashNode;
 
-HashNode* hashTable[TABLE_SIZE];
+// Tabla de skills. Cada worker tiene la suya, así no hay que sincronizar
+// inserciones. Nodos, cadenas y offsets se reservan en su arena.
+typedef struct {
+    HashNode** buckets;
+    size_t n_buckets;
+    Arena arena;
+} SkillTable;
+
+// Rango de bytes [start, end) de data.csv que procesa un worker.
+// Los límites siempre caen al inicio de una línea.
+typedef struct {
+    const CsvMap* csv;
+    long start;
+    long end;
+    int row_ids;    // Versión 4: se indexa el row ID de cada línea
+    long next_row;  // Row ID de la siguiente línea del rango
+    SkillTable table;
+    size_t budget;  // Memoria máxima de la tabla en bytes (0 = sin límite)
+    int* runs;      // Descriptores de los runs volcados a disco, en orden
+    int n_runs;
+    int max_runs;   // Al alcanzarlo, los runs del worker se fusionan en uno
+    int failed;
+} Worker;
+
+// Lector secuencial de un run durante la fusión k-way.
+// Formato de cada registro: [len, skill, count, offsets...]
+// En la compactación el lector recorre un segmento del índice (jobs.skl +
+// jobs.idx): cada lista se decodifica entera en 'list' y se copia desde ahí.
+typedef struct {
+    FILE* file;     // Run, o jobs.skl del segmento
+    FILE* idx;      // Solo segmentos
+    SkillDirInfo info;
+    size_t remaining_skills;
+    long* list;
+    size_t list_capacity;
+    size_t list_pos;
+    int order;      // Posición del run; desempata skills iguales
+    char* skill;
+    size_t skill_len;
+    size_t skill_capacity;
+    size_t count;
+} RunReader;
+
+// Copia de las filas de data.csv, en paralelo con la escritura del índice:
+// comprimida en jobs.docs o, con rows, por row ID en jobs.rows.
+typedef struct {
+    const CsvMap* csv;
+    int use_dict;
+    int rows;
+    pthread_t thread;
+    int started;
+    int failed;
+} DocStoreJob;
+
+SkillTable hashTable;
+
+// Opciones del modo de memoria acotada
+size_t memory_budget = 0;
+const char* tmp_dir = "dist";
+
+// Parejas de skills materializadas (ver pairs.h)
+const char* pairs_list = NULL;
+size_t max_pairs = PAIRS_DEFAULT_COUNT;
+size_t pairs_budget = (size_t)PAIRS_DEFAULT_BUDGET_MB * 1024 * 1024;
+
+int index_version = SKL_VERSION_CURRENT;
+int use_zstd = 0;
+int use_dict = 0;
+
+// Líneas procesadas entre todos los workers (solo para mostrar el progreso)
+long lines_processed = 0;
 
 // Prototipos
-unsigned long hash_function(const char* str);
-void insert_skill(const char* skill, long offset);
-void write_sorted_indices(const char* skl_filename, const char* idx_filename);
-void free_hash_table();
-char* trim_whitespace(char* str);
+unsigned long hash_function(const char* str, size_t len);
+int init_skill_table(SkillTable* table, size_t n_buckets, size_t chunk_size);
+void reset_skill_table(SkillTable* table);
+size_t skill_table_memory(const SkillTable* table);
+void insert_skill(SkillTable* table, const char* skill, size_t len, long offset);
+void merge_skill_tables(SkillTable* dst, SkillTable* src);
+void compute_ranges(const CsvMap* csv, long start, long end, Worker* workers, int num_workers);
+void* process_range(void* arg);
+HashNode** sort_skill_nodes(const SkillTable* table, size_t* total_skills);
+int write_sorted_indices(const SkillTable* table, IndexWriter* writer);
+int create_run_file(int* fd, FILE** file);
+int spill_run(Worker* worker);
+int merge_run_files(const int* fds, int n, size_t budget, IndexWriter* writer, FILE* out);
+void free_hash_table(SkillTable* table);
+void* build_doc_store(void* arg);
+int finish_doc_store(DocStoreJob* job, CsvMap* csv);
+static int merge_readers(RunReader* readers, int n, IndexWriter* writer, FILE* out);
+int build_index(CsvMap* csv, long start, long end, uint64_t first_row, int num_workers,
+                const char* skl_name, const char* idx_name, int version, int zstd, int with_docs, int with_rows);
+static int write_row_table(const CsvMap* csv, Worker* workers, int num_workers, uint64_t first_row,
+                           IndexWriter* writer);
+static int copy_row_tables(RunReader* readers, int n, IndexWriter* writer);
+int rebuild_index(int num_workers);
+int update_index(int num_workers);
+int compact_segments(void);
 int compare_hash_nodes_alpha(const void* a, const void* b);
-int compare_longs(const void* a, const void* b);
 
-int main() {
+void print_usage(const char* program) {
+    fprintf(stderr, "Uso: %s [-j workers] [-m MB] [-t dir] [-f formato] [-z] [-D] [-p archivo] [-P n] [-B MB] "
+            "[-u | -c]\n", program);
+    fprintf(stderr, "  -j workers  Número de hilos que procesan data.csv en paralelo (por defecto 1)\n");
+    fprintf(stderr, "  -m MB       Memoria máxima para las tablas de skills. Al superarla se vuelcan\n");
+    fprintf(stderr, "              runs ordenados a disco y se fusionan al final (por defecto sin límite)\n");
+    fprintf(stderr, "  -t dir      Directorio para los runs temporales (por defecto dist)\n");
+    fprintf(stderr, "  -f formato  Versión del índice: 1 = offsets sin comprimir, 2 = bloques\n");
+    fprintf(stderr, "              comprimidos, 4 = row IDs con tabla de filas y listas Roaring,\n");
+    fprintf(stderr, "              más %s sin -z (por defecto %d)\n", ROWS_FILE, SKL_VERSION_CURRENT);
+    fprintf(stderr, "  -z          Modo zstd: listas largas en frames zstd (con -f 2, formato %d) y copia\n",
+            SKL_VERSION_ZSTD);
+    fprintf(stderr, "              comprimida de las filas en %s\n", DOCS_FILE);
+    fprintf(stderr, "  -D          Como -z, entrenando un diccionario zstd para las filas\n");
+    fprintf(stderr, "  -p archivo  Parejas de skills cuya intersección se guarda ya calculada, una\n");
+    fprintf(stderr, "              'skill;skill' por línea (formato 4)\n");
+    fprintf(stderr, "  -P n        Parejas más frecuentes que se materializan además de las de -p\n");
+    fprintf(stderr, "              (por defecto %d; 0 = ninguna)\n", PAIRS_DEFAULT_COUNT);
+    fprintf(stderr, "  -B MB       Espacio máximo de las parejas materializadas (por defecto %d)\n",
+            PAIRS_DEFAULT_BUDGET_MB);
+    fprintf(stderr, "  -u          Actualización incremental: indexa solo las filas añadidas a\n");
+    fprintf(stderr, "              data.csv desde la última vez en un segmento delta\n");
+    fprintf(stderr, "  -c          Compacta la base y los segmentos delta en una base nueva\n");
+}
+
+int main(int argc, char* argv[]) {
     struct timespec start_time, end_time;
     clock_gettime(CLOCK_MONOTONIC, &start_time);
-    
-    for (int i = 0; i < TABLE_SIZE; i++) hashTable[i] = NULL;
 
-    FILE* file_csv = fopen("data.csv", "r");
-    if (!file_csv) {
-        perror("Error al abrir data.csv");
+    int num_workers = 1;
+    int update = 0, compact = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            long megabytes = atol(argv[++i]);
+            if (megabytes <= 0) {
+                fprintf(stderr, "Error: la memoria máxima debe ser positiva\n");
+                return 1;
+            }
+            memory_budget = (size_t)megabytes * 1024 * 1024;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tmp_dir = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            index_version = atoi(argv[++i]);
+            if (index_version != SKL_VERSION_RAW && index_version != SKL_VERSION_PACKED &&
+                index_version != SKL_VERSION_ROWS) {
+                fprintf(stderr, "Error: formato de índice desconocido: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-z") == 0) {
+            use_zstd = 1;
+        } else if (strcmp(argv[i], "-D") == 0) {
+            use_zstd = 1;
+            use_dict = 1;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pairs_list = argv[++i];
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            long pairs = atol(argv[++i]);
+            if (pairs < 0) {
+                fprintf(stderr, "Error: el número de parejas no puede ser negativo\n");
+                return 1;
+            }
+            max_pairs = (size_t)pairs;
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            long megabytes = atol(argv[++i]);
+            if (megabytes <= 0) {
+                fprintf(stderr, "Error: el espacio de las parejas debe ser positivo\n");
+                return 1;
+            }
+            pairs_budget = (size_t)megabytes * 1024 * 1024;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            update = 1;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            compact = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_workers < 1 || num_workers > MAX_WORKERS) {
+        fprintf(stderr, "Error: el número de workers debe estar entre 1 y %d\n", MAX_WORKERS);
         return 1;
     }
-
-    char line_buffer[4096];
-    long current_offset = ftell(file_csv);
-    if (fgets(line_buffer, sizeof(line_buffer), file_csv)) {
-        current_offset = ftell(file_csv);
+    if (update && compact) {
+        fprintf(stderr, "Error: -u y -c no se pueden combinar\n");
+        return 1;
     }
-    
-    long line_count = 0;
-    while (fgets(line_buffer, sizeof(line_buffer), file_csv)) {
-        if (line_count++ % 10000 == 0) {
-            printf("Procesando línea del CSV: %ld\r", line_count);
-            fflush(stdout);
-        }
-        char* skills_part = strchr(line_buffer, ',');
-        if (skills_part) {
-            skills_part++;
-            char* token = strtok(skills_part, "\",\n");
-            while (token != NULL) {
-                char* trimmed_skill = trim_whitespace(token);
-                if (strlen(trimmed_skill) > 0) {
-                    insert_skill(trimmed_skill, current_offset);
-                }
-                token = strtok(NULL, "\",\n");
-            }
+    if (use_zstd) {
+        // Los frames zstd se apoyan en los bloques de la versión 2. Con el
+        // formato 2 se genera la versión 3; la 4 los admite directamente.
+        if (index_version == SKL_VERSION_RAW) {
+            fprintf(stderr, "Error: -z no es compatible con el formato %d\n", SKL_VERSION_RAW);
+            return 1;
         }
-        current_offset = ftell(file_csv);
+        if (index_version == SKL_VERSION_PACKED) index_version = SKL_VERSION_ZSTD;
     }
-    printf("\nProcesamiento de CSV finalizado. Ordenando y escribiendo índices...\n");
-    fclose(file_csv);
 
     // Crear el directorio dist si no existe
     mkdir("dist", 0755);
-    
-    // Escribir los archivos de índice en el directorio dist
-    write_sorted_indices("dist/jobs.skl", "dist/jobs.idx");
-    printf("Archivos de índice ordenados 'dist/jobs.skl' y 'dist/jobs.idx' creados.\n");
 
-    free_hash_table();
-    
+    int failed;
+    if (compact) {
+        failed = compact_segments();
+    } else if (update) {
+        failed = update_index(num_workers);
+    } else {
+        failed = rebuild_index(num_workers);
+    }
+    if (failed) return 1;
+
     clock_gettime(CLOCK_MONOTONIC, &end_time);
     char time_buffer[100];
     format_time(time_buffer, sizeof(time_buffer), &start_time, &end_time);
     printf("Memoria liberada.\n");
     printf("Tiempo total de indexación: %s\n", time_buffer);
-    
+
+    return 0;
+}
+
+// El índice de skills por fila de un segmento deja de valer en cuanto se
+// sustituye el segmento
+static void remove_forward_index(const char* skl_name) {
+    char fwd_name[64];
+    forward_file_name(skl_name, fwd_name, sizeof(fwd_name));
+    remove(fwd_name);
+}
+
+// Genera el índice de skills por fila de un segmento del formato 4 ya
+// escrito. Sin él el índice sigue siendo válido: el motor solo no puede
+// responder FACET, así que un fallo no es un error.
+static void build_forward_index(const char* skl_name, const char* idx_name) {
+    char fwd_name[64];
+    forward_file_name(skl_name, fwd_name, sizeof(fwd_name));
+    if (forward_build(skl_name, idx_name, fwd_name, memory_budget) == 0) {
+        printf("Índice de skills por fila '%s' creado.\n", fwd_name);
+    } else {
+        fprintf(stderr, "Aviso: sin '%s', el motor no podrá responder FACET\n", fwd_name);
+    }
+}
+
+// Genera el índice de autocompletado de la base, que ya debe estar escrita
+// y tener el directorio por bloques. Igual que el .fwd, sin él el motor solo
+// no puede responder SUGGEST. Se escribe como .tmp y sustituye al de la base
+// anterior al renombrarlo, así que mientras tanto el motor sigue con aquel.
+static void build_suggest_index(void) {
+    char sug_name[64];
+    suggest_file_name(BASE_SKL_FILE, sug_name, sizeof(sug_name));
+    if (suggest_build(BASE_SKL_FILE, sug_name) == 0) {
+        printf("Índice de autocompletado '%s' creado.\n", sug_name);
+    } else {
+        remove(sug_name);
+        fprintf(stderr, "Aviso: sin '%s', el motor no podrá responder SUGGEST\n", sug_name);
+    }
+}
+
+static void remove_suggest_index(void) {
+    char sug_name[64];
+    suggest_file_name(BASE_SKL_FILE, sug_name, sizeof(sug_name));
+    remove(sug_name);
+}
+
+// Lo mismo con el índice de búsqueda aproximada: sin él, el motor busca las
+// skills solo tal cual se escriben
+static void build_fuzzy_index(void) {
+    char fzy_name[64];
+    fuzzy_file_name(BASE_SKL_FILE, fzy_name, sizeof(fzy_name));
+    if (fuzzy_build(BASE_SKL_FILE, fzy_name, memory_budget) == 0) {
+        printf("Índice de búsqueda aproximada '%s' creado.\n", fzy_name);
+    } else {
+        remove(fzy_name);
+        fprintf(stderr, "Aviso: sin '%s', el motor solo buscará las skills exactas\n", fzy_name);
+    }
+}
+
+static void remove_fuzzy_index(void) {
+    char fzy_name[64];
+    fuzzy_file_name(BASE_SKL_FILE, fzy_name, sizeof(fzy_name));
+    remove(fzy_name);
+}
+
+static void remove_pairs_index(void) {
+    char pairs_skl[64], pairs_idx[64];
+    pairs_file_names(BASE_SKL_FILE, pairs_skl, pairs_idx, sizeof(pairs_skl));
+    remove(pairs_skl);
+    remove(pairs_idx);
+}
+
+// Genera las parejas materializadas de la base del formato 4, con su .fwd
+// ya escrito. Sin ellas el motor interseca las dos listas como siempre.
+static void build_pairs_index(void) {
+    if (!pairs_list && max_pairs == 0) {
+        remove_pairs_index();
+        return;
+    }
+    if (pairs_build(BASE_SKL_FILE, BASE_IDX_FILE, pairs_list, max_pairs, pairs_budget) != 0) {
+        remove_pairs_index();
+        fprintf(stderr, "Aviso: sin parejas materializadas, el motor interseca cada pareja\n");
+    }
+}
+
+// Indexa las líneas de [start, end) de data.csv (ya proyectado) y escribe el
+// resultado en skl_name/idx_name. En la versión 4 la primera línea del rango
+// recibe el row ID first_row. El CSV se cierra en cuanto deja de hacer falta.
+// Con with_docs, además se genera jobs.docs en paralelo; con with_rows,
+// jobs.rows (solo para una base que empieza en la fila 0).
+int build_index(CsvMap* csv, long start, long end, uint64_t first_row, int num_workers,
+                const char* skl_name, const char* idx_name, int version, int zstd, int with_docs, int with_rows) {
+    // 1. Dividir el rango en trozos alineados al inicio de línea.
+    Worker* workers = calloc(num_workers, sizeof(Worker));
+    compute_ranges(csv, start, end, workers, num_workers);
+
+    // Con memoria acotada, cada worker recibe una parte del presupuesto. Un
+    // octavo se dedica a los buckets y el arena crece en bloques pequeños
+    // para que el consumo se pueda medir con precisión.
+    size_t n_buckets = TABLE_SIZE;
+    size_t chunk_size = ARENA_CHUNK_SIZE;
+    if (memory_budget > 0) {
+        size_t worker_budget = memory_budget / num_workers;
+        if (worker_budget < MIN_WORKER_BUDGET) {
+            fprintf(stderr, "Error: -m debe dejar al menos %lu MB por worker\n", MIN_WORKER_BUDGET / (1024 * 1024));
+            csv_map_close(csv);
+            free(workers);
+            return 1;
+        }
+        n_buckets = worker_budget / 8 / sizeof(HashNode*);
+        if (n_buckets < MIN_TABLE_SIZE) n_buckets = MIN_TABLE_SIZE;
+        if (n_buckets > TABLE_SIZE) n_buckets = TABLE_SIZE;
+        chunk_size = worker_budget / 16;
+        if (chunk_size < MIN_ARENA_CHUNK_SIZE) chunk_size = MIN_ARENA_CHUNK_SIZE;
+        if (chunk_size > ARENA_CHUNK_SIZE) chunk_size = ARENA_CHUNK_SIZE;
+        int max_runs = MAX_OPEN_RUNS / num_workers;
+        if (max_runs < 2) max_runs = 2;
+        for (int i = 0; i < num_workers; i++) {
+            workers[i].budget = worker_budget;
+            workers[i].max_runs = max_runs;
+        }
+        mkdir(tmp_dir, 0755);
+    }
+
+    // En la versión 4 la tabla de filas va al principio de jobs.idx, así que
+    // el escritor se abre antes de procesar el CSV.
+    IndexWriter writer;
+    if (index_writer_open(&writer, skl_name, idx_name, version, zstd) != 0) {
+        csv_map_close(csv);
+        free(workers);
+        return 1;
+    }
+    index_writer_set_range(&writer, (uint64_t)start, (uint64_t)end);
+    if (version == SKL_VERSION_ROWS && write_row_table(csv, workers, num_workers, first_row, &writer) != 0) {
+        index_writer_abort(&writer);
+        csv_map_close(csv);
+        free(workers);
+        return 1;
+    }
+
+    // 2. Cada worker construye su propia tabla de skills sobre su rango.
+    pthread_t threads[MAX_WORKERS];
+    int failed = 0;
+    for (int i = 0; i < num_workers; i++) {
+        if (init_skill_table(&workers[i].table, n_buckets, chunk_size) != 0) {
+            failed = 1;
+            num_workers = i;
+            break;
+        }
+        if (pthread_create(&threads[i], NULL, process_range, &workers[i]) != 0) {
+            perror("Error al crear el hilo del worker");
+            free_hash_table(&workers[i].table);
+            failed = 1;
+            num_workers = i;
+            break;
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+        if (workers[i].failed) failed = 1;
+    }
+    int copy_rows = with_docs || with_rows;
+    if (!copy_rows || failed) csv_map_close(csv);
+
+    // Si algún worker tuvo que volcar runs, el resto de tablas también se
+    // vuelca para que todo salga de la misma fusión k-way.
+    int spilled = 0;
+    for (int i = 0; i < num_workers; i++) {
+        if (workers[i].n_runs > 0) spilled = 1;
+    }
+    for (int i = 0; i < num_workers && spilled && !failed; i++) {
+        if (spill_run(&workers[i]) != 0) failed = 1;
+    }
+    if (failed) {
+        for (int i = 0; i < num_workers; i++) {
+            free_hash_table(&workers[i].table);
+            for (int r = 0; r < workers[i].n_runs; r++) close(workers[i].runs[r]);
+            free(workers[i].runs);
+        }
+        free(workers);
+        index_writer_abort(&writer);
+        return 1;
+    }
+    printf("\nProcesamiento de CSV finalizado. Ordenando y escribiendo índices...\n");
+
+    // La copia de las filas (comprimida en modo zstd) se escribe en otro hilo
+    // mientras se ordenan y escriben las listas: el CSV sigue proyectado y
+    // solo se lee.
+    DocStoreJob doc_job = {0};
+    doc_job.csv = csv;
+    doc_job.use_dict = use_dict;
+    doc_job.rows = with_rows;
+    if (copy_rows) {
+        if (pthread_create(&doc_job.thread, NULL, build_doc_store, &doc_job) == 0) {
+            doc_job.started = 1;
+        } else {
+            perror("Error al crear el hilo del almacén de filas");
+            doc_job.failed = 1;
+        }
+    }
+
+    if (spilled) {
+        // 3a. Fusión k-way de los runs directamente sobre el índice final.
+        //     Los runs se numeran en orden de worker y de volcado.
+        int total_runs = 0;
+        for (int i = 0; i < num_workers; i++) total_runs += workers[i].n_runs;
+        int* fds = malloc(total_runs * sizeof(int));
+        total_runs = 0;
+        for (int i = 0; i < num_workers; i++) {
+            memcpy(fds + total_runs, workers[i].runs, workers[i].n_runs * sizeof(int));
+            total_runs += workers[i].n_runs;
+            free_hash_table(&workers[i].table);
+            free(workers[i].runs);
+        }
+        printf("Fusionando %d runs...\n", total_runs);
+        failed = merge_run_files(fds, total_runs, memory_budget, &writer, NULL);
+        free(fds);
+    } else {
+        // 3b. Fusionar las tablas en la del primer worker, en orden de rango.
+        hashTable = workers[0].table;
+        for (int i = 1; i < num_workers; i++) {
+            merge_skill_tables(&hashTable, &workers[i].table);
+        }
+        failed = write_sorted_indices(&hashTable, &writer);
+        free_hash_table(&hashTable);
+    }
+    free(workers);
+
+    if (failed) {
+        index_writer_abort(&writer);
+        if (copy_rows) finish_doc_store(&doc_job, csv);
+        return 1;
+    }
+    remove_forward_index(skl_name);
+    if (index_writer_close(&writer) != 0) {
+        if (copy_rows) finish_doc_store(&doc_job, csv);
+        return 1;
+    }
+    printf("Archivos de índice ordenados '%s' y '%s' creados.\n", skl_name, idx_name);
+    if (version == SKL_VERSION_ROWS) build_forward_index(skl_name, idx_name);
+
+    if (with_docs) {
+        if (finish_doc_store(&doc_job, csv) != 0) return 1;
+        printf("Almacén de filas comprimido '%s' creado%s.\n", DOCS_FILE, use_dict ? " (con diccionario)" : "");
+    } else if (with_rows) {
+        if (finish_doc_store(&doc_job, csv) != 0) return 1;
+        printf("Almacén de filas por row ID '%s' creado.\n", ROWS_FILE);
+    }
+    return 0;
+}
+
+// Borra los segmentos delta y el manifiesto. Se llama con SEGMENTS_LOCK_FILE
+// tomado, después de escribir una base que ya los cubre.
+static void remove_deltas(const SegmentManifest* manifest) {
+    for (uint32_t i = 0; i < manifest->n_segments; i++) {
+        char skl_name[64], idx_name[64];
+        segments_file_names(manifest->segments[i].id, skl_name, idx_name, sizeof(skl_name));
+        remove_forward_index(skl_name);
+        remove(skl_name);
+        remove(idx_name);
+    }
+}
+
+// Reconstrucción completa: indexa todo data.csv en la base y descarta los
+// deltas. Espera a que termine cualquier compactación en curso y bloquea las
+// actualizaciones mientras tanto.
+int rebuild_index(int num_workers) {
+    int compact_lock = segments_lock(COMPACT_LOCK_FILE, 1);
+    int lock = segments_lock(SEGMENTS_LOCK_FILE, 1);
+
+    // 1. Proyectar data.csv en memoria
+    CsvMap csv;
+    if (csv_map_open(&csv, "data.csv") != 0) {
+        segments_unlock(lock);
+        segments_unlock(compact_lock);
+        return 1;
+    }
+    csv_scan_init();
+    printf("Escáner de CSV: %s\n", csv_scan_impl_name());
+
+    // Sin -z, el formato 4 lleva jobs.rows para leer las filas por row ID
+    int with_rows = index_version == SKL_VERSION_ROWS && !use_zstd;
+    int failed = build_index(&csv, 0, (long)csv.size, 0, num_workers, BASE_SKL_FILE, BASE_IDX_FILE,
+                             index_version, use_zstd, use_zstd, with_rows);
+    if (!failed) {
+        SegmentManifest manifest;
+        segments_read(&manifest);
+        remove_deltas(&manifest);
+        manifest.n_segments = 0;
+        failed = segments_write(&manifest);
+        // Un jobs.docs o jobs.rows anterior ya no corresponde a este índice
+        if (!use_zstd) remove(DOCS_FILE);
+        if (!with_rows) remove(ROWS_FILE);
+    }
+    segments_unlock(lock);
+    segments_unlock(compact_lock);
+    // Los índices auxiliares de la base anterior valen hasta que se
+    // sustituyen; los que el formato nuevo no lleva se borran
+    if (!failed && index_version != SKL_VERSION_RAW) {
+        build_suggest_index();
+        build_fuzzy_index();
+    } else if (!failed) {
+        remove_suggest_index();
+        remove_fuzzy_index();
+    }
+    if (!failed && index_version == SKL_VERSION_ROWS) build_pairs_index();
+    else if (!failed) remove_pairs_index();
+    return failed;
+}
+
+// Fila siguiente a la última de un segmento de la versión 4
+static int segment_end_row(const char* skl_name, uint64_t* end_row) {
+    FILE* skl = fopen(skl_name, "rb");
+    SkillDirInfo info = {0};
+    int ok = skl && read_skill_dir_header(skl, &info);
+    if (skl) fclose(skl);
+    free_skill_dir_info(&info);
+    if (ok) *end_row = info.first_row + info.n_rows;
+    return ok;
+}
+
+// Actualización incremental: indexa solo las líneas completas añadidas a
+// data.csv desde el final de la base y del último delta, en un delta nuevo.
+// Si la base no permite actualizarse (formato 1, índice anterior a los
+// segmentos o data.csv más corto que lo indexado) se reconstruye entera.
+int update_index(int num_workers) {
+    int lock = segments_lock(SEGMENTS_LOCK_FILE, 1);
+    SegmentManifest manifest;
+    SkillDirInfo base = {0};
+    int can_update = segments_read(&manifest) == 0 && manifest.n_segments < MAX_SEGMENTS - 1;
+
+    FILE* skl = fopen(BASE_SKL_FILE, "rb");
+    can_update = can_update && skl && read_skill_dir_header(skl, &base) &&
+                 base.version != SKL_VERSION_RAW && base.data_end > 0;
+    if (skl) fclose(skl);
+    free_skill_dir_info(&base); // Solo interesan la versión y el rango
+
+    CsvMap csv;
+    if (csv_map_open(&csv, "data.csv") != 0) {
+        segments_unlock(lock);
+        return 1;
+    }
+    uint64_t last_end = can_update ? base.data_end : 0;
+    uint64_t next_row = base.first_row + base.n_rows; // Versión 4: row ID de la primera fila nueva
+    if (can_update && manifest.n_segments > 0) {
+        last_end = manifest.segments[manifest.n_segments - 1].data_end;
+        char last_skl[64], last_idx[64];
+        segments_file_names(manifest.segments[manifest.n_segments - 1].id, last_skl, last_idx, sizeof(last_skl));
+        if (base.row_ids && !segment_end_row(last_skl, &next_row)) can_update = 0;
+    }
+    if (can_update && csv.size < last_end) can_update = 0;
+
+    if (!can_update) {
+        printf("El índice actual no admite actualizaciones incrementales. Reconstruyendo...\n");
+        csv_map_close(&csv);
+        segments_unlock(lock);
+        return rebuild_index(num_workers);
+    }
+
+    // Solo líneas completas: una fila a medio escribir entrará en el siguiente delta
+    long end = (long)csv.size;
+    while (end > (long)last_end && csv.data[end - 1] != '\n') end--;
+    if (end <= (long)last_end) {
+        printf("No hay filas nuevas en data.csv.\n");
+        csv_map_close(&csv);
+        segments_unlock(lock);
+        return 0;
+    }
+    csv_scan_init();
+
+    uint32_t id = manifest.next_id;
+    char skl_name[64], idx_name[64];
+    segments_file_names(id, skl_name, idx_name, sizeof(skl_name));
+    printf("Indexando %ld bytes nuevos de data.csv en el segmento %u...\n", end - (long)last_end, id);
+
+    int failed = build_index(&csv, (long)last_end, end, next_row, num_workers, skl_name, idx_name,
+                             base.version, base.zstd_min_postings > 0, 0, 0);
+    if (!failed) {
+        SegmentEntry* entry = &manifest.segments[manifest.n_segments++];
+        memset(entry, 0, sizeof(*entry));
+        entry->id = id;
+        entry->data_start = last_end;
+        entry->data_end = (uint64_t)end;
+        manifest.next_id = id + 1;
+        failed = segments_write(&manifest);
+    }
+    if (!failed) {
+        printf("Segmentos delta: %u", manifest.n_segments);
+        if (manifest.n_segments >= SEGMENTS_COMPACT_THRESHOLD) printf(" (conviene compactar con -c)");
+        printf("\n");
+    }
+    segments_unlock(lock);
+    return failed;
+}
+
+// Versión 4: la tabla de filas del índice compactado es la concatenación de
+// las de la base y los deltas, que numeran filas consecutivas.
+static int copy_row_tables(RunReader* readers, int n, IndexWriter* writer) {
+    uint64_t buffer[4096];
+    uint64_t total = 0;
+    for (int r = 0; r < n; r++) {
+        const SkillDirInfo* info = &readers[r].info;
+        if (!info->row_ids || info->first_row != readers[0].info.first_row + total) {
+            fprintf(stderr, "Error: los segmentos no numeran filas consecutivas\n");
+            return 1;
+        }
+        if (fseek(readers[r].idx, (long)info->rows_offset, SEEK_SET) != 0) return 1;
+        for (uint64_t done = 0; done < info->n_rows;) {
+            size_t chunk = info->n_rows - done < 4096 ? (size_t)(info->n_rows - done) : 4096;
+            if (fread(buffer, sizeof(uint64_t), chunk, readers[r].idx) != chunk ||
+                index_writer_append_rows(writer, buffer, chunk) != 0) {
+                fprintf(stderr, "Error al copiar la tabla de filas\n");
+                return 1;
+            }
+            done += chunk;
+        }
+        total += info->n_rows;
+    }
+    index_writer_set_rows(writer, readers[0].info.first_row, total);
+    return 0;
+}
+
+// Si el jobs.docs actual se comprimió con diccionario
+static int doc_store_has_dict(void) {
+    DocStoreHeader header;
+    FILE* file = fopen(DOCS_FILE, "rb");
+    int has_dict = file && fread(&header, sizeof(header), 1, file) == 1 && header.magic == DOCS_MAGIC &&
+                   header.dict_size > 0;
+    if (file) fclose(file);
+    return has_dict;
+}
+
+// Rehace jobs.docs (base comprimida) o jobs.rows (versión 4 sin -z) sobre
+// los primeros 'size' bytes de data.csv, los que cubre la base compactada.
+// Se escribe como .tmp y se renombra: hasta entonces el motor sigue con el
+// anterior, que tiene los mismos row IDs y solo le faltan las filas nuevas.
+static int rebuild_row_store(uint64_t size, int zstd, int row_ids) {
+    if (!zstd && !row_ids) return 0;
+    CsvMap csv;
+    if (csv_map_open(&csv, "data.csv") != 0) return 1;
+    if (csv.size < size) {
+        fprintf(stderr, "Error: data.csv es más corto que el índice compactado\n");
+        csv_map_close(&csv);
+        return 1;
+    }
+    int failed;
+    if (zstd) {
+        int dict = use_dict || doc_store_has_dict();
+        failed = docstore_build(DOCS_FILE, csv.data, (size_t)size, dict);
+        if (!failed) printf("Almacén de filas comprimido '%s' creado%s.\n", DOCS_FILE, dict ? " (con diccionario)" : "");
+    } else {
+        failed = rowstore_build(ROWS_FILE, csv.data, (size_t)size);
+        if (!failed) printf("Almacén de filas por row ID '%s' creado.\n", ROWS_FILE);
+    }
+    csv_map_close(&csv);
+    return failed;
+}
+
+// Compactación: fusiona la base y los deltas en una base nueva con la misma
+// fusión k-way que los runs. La fusión se hace sin bloquear: mientras tanto
+// 'index -u' puede seguir añadiendo deltas, que se conservan. Solo el cambio
+// de base y de manifiesto se hace con el bloqueo tomado.
+int compact_segments(void) {
+    int compact_lock = segments_lock(COMPACT_LOCK_FILE, 0);
+    if (compact_lock < 0) {
+        printf("Ya hay una compactación en curso.\n");
+        return 0;
+    }
+
+    int lock = segments_lock(SEGMENTS_LOCK_FILE, 1);
+    SegmentManifest snapshot;
+    int failed = segments_read(&snapshot);
+    segments_unlock(lock);
+    if (failed || snapshot.n_segments == 0) {
+        if (!failed) printf("No hay segmentos delta que compactar.\n");
+        segments_unlock(compact_lock);
+        return failed;
+    }
+
+    // Lectores: la base primero y después los deltas, en orden de rango
+    int n = (int)snapshot.n_segments + 1;
+    RunReader* readers = calloc(n, sizeof(RunReader));
+    for (int r = 0; r < n && !failed; r++) {
+        char skl_name[64], idx_name[64];
+        if (r == 0) {
+            snprintf(skl_name, sizeof(skl_name), "%s", BASE_SKL_FILE);
+            snprintf(idx_name, sizeof(idx_name), "%s", BASE_IDX_FILE);
+        } else {
+            segments_file_names(snapshot.segments[r - 1].id, skl_name, idx_name, sizeof(skl_name));
+        }
+        RunReader* reader = &readers[r];
+        reader->order = r;
+        reader->file = fopen(skl_name, "rb");
+        reader->idx = fopen(idx_name, "rb");
+        if (!reader->file || !reader->idx || !read_skill_dir_header(reader->file, &reader->info)) {
+            fprintf(stderr, "Error al abrir el segmento '%s'\n", skl_name);
+            failed = 1;
+            break;
+        }
+        reader->remaining_skills = reader->info.total_skills;
+    }
+
+    IndexWriter writer;
+    uint64_t data_end = snapshot.segments[snapshot.n_segments - 1].data_end;
+    int row_ids = !failed && readers[0].info.row_ids;
+    int zstd = !failed && readers[0].info.zstd_min_postings > 0;
+    if (!failed) {
+        printf("Compactando la base y %u segmentos delta...\n", snapshot.n_segments);
+        failed = index_writer_open(&writer, BASE_SKL_FILE, BASE_IDX_FILE, readers[0].info.version, zstd);
+        if (!failed) {
+            index_writer_set_range(&writer, 0, data_end);
+            if (readers[0].info.row_ids && copy_row_tables(readers, n, &writer) != 0) failed = 1;
+            if (!failed) failed = merge_readers(readers, n, &writer, NULL);
+            if (failed) index_writer_abort(&writer);
+        }
+    }
+    for (int r = 0; r < n; r++) {
+        if (readers[r].file) fclose(readers[r].file);
+        if (readers[r].idx) fclose(readers[r].idx);
+        free_skill_dir_info(&readers[r].info);
+        free(readers[r].skill);
+        free(readers[r].list);
+    }
+    free(readers);
+
+    if (!failed) {
+        // Sustituir la base y quitar del manifiesto los deltas fusionados,
+        // conservando los que se hayan añadido durante la fusión.
+        lock = segments_lock(SEGMENTS_LOCK_FILE, 1);
+        SegmentManifest current;
+        if (segments_read(&current) != 0) {
+            index_writer_abort(&writer);
+            failed = 1;
+        } else {
+            remove_forward_index(BASE_SKL_FILE);
+            failed = index_writer_close(&writer);
+        }
+        if (!failed) {
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < current.n_segments; i++) {
+                if (current.segments[i].data_end > data_end) current.segments[kept++] = current.segments[i];
+            }
+            current.n_segments = kept;
+            failed = segments_write(&current);
+        }
+        if (!failed) remove_deltas(&snapshot);
+        segments_unlock(lock);
+        // Sin bloquear las actualizaciones: el motor usa el .fwd en cuanto aparece
+        if (!failed && row_ids) build_forward_index(BASE_SKL_FILE, BASE_IDX_FILE);
+        if (!failed) {
+            build_suggest_index();
+            build_fuzzy_index();
+        }
+        if (!failed && row_ids) build_pairs_index();
+        else if (!failed) remove_pairs_index();
+        // Las filas de los deltas no están en el almacén de filas
+        if (!failed) failed = rebuild_row_store(data_end, zstd, row_ids);
+        if (!failed) printf("Compactación terminada: la base cubre %lu bytes de data.csv.\n", (unsigned long)data_end);
+    }
+    segments_unlock(compact_lock);
+    return failed;
+}
+
+void* build_doc_store(void* arg) {
+    DocStoreJob* job = (DocStoreJob*)arg;
+    job->failed = job->rows ? rowstore_build(ROWS_FILE, job->csv->data, job->csv->size)
+                            : docstore_build(DOCS_FILE, job->csv->data, job->csv->size, job->use_dict);
+    return NULL;
+}
+
+// Espera al hilo de jobs.docs (si se lanzó) y libera el CSV proyectado.
+int finish_doc_store(DocStoreJob* job, CsvMap* csv) {
+    if (job->started) pthread_join(job->thread, NULL);
+    csv_map_close(csv);
+    return job->failed;
+}
+
+// Reparte [start, end) entre los workers. El límite k se desplaza desde
+// start + k*(end-start)/n hasta el inicio de la siguiente línea, de modo que
+// ninguna línea se parte.
+void compute_ranges(const CsvMap* csv, long start, long end, Worker* workers, int num_workers) {
+    long previous = start;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].csv = csv;
+        workers[i].start = previous;
+        long boundary = end;
+        if (i + 1 < num_workers) {
+            boundary = start + (end - start) / num_workers * (i + 1);
+            if (boundary < previous) boundary = previous;
+            const char* newline = memchr(csv->data + boundary, '\n', end - boundary);
+            boundary = newline ? (newline - csv->data) + 1 : end;
+        }
+        workers[i].end = boundary;
+        previous = boundary;
+    }
+}
+
+// Primera línea de datos de [start, end): la cabecera del CSV solo está al
+// principio del primer rango.
+static long first_line(const CsvMap* csv, long start, long end) {
+    if (start != 0 || start >= end) return start;
+    const char* newline = memchr(csv->data, '\n', end);
+    return newline ? (newline - csv->data) + 1 : end;
+}
+
+// Versión 4: numera las líneas de cada rango a partir de first_row y escribe
+// la tabla rowid -> offset en el índice. Recorre las líneas igual que
+// process_range, así cada worker sabe qué row ID tiene su primera línea.
+static int write_row_table(const CsvMap* csv, Worker* workers, int num_workers, uint64_t first_row,
+                           IndexWriter* writer) {
+    uint64_t buffer[4096];
+    size_t fill = 0;
+    uint64_t row = first_row;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].row_ids = 1;
+        workers[i].next_row = (long)row;
+        long p = first_line(csv, workers[i].start, workers[i].end);
+        while (p < workers[i].end) {
+            buffer[fill++] = (uint64_t)p;
+            row++;
+            if (fill == sizeof(buffer) / sizeof(buffer[0])) {
+                if (index_writer_append_rows(writer, buffer, fill) != 0) return 1;
+                fill = 0;
+            }
+            const char* newline = memchr(csv->data + p, '\n', workers[i].end - p);
+            p = newline ? (newline - csv->data) + 1 : workers[i].end;
+        }
+    }
+    if (fill > 0 && index_writer_append_rows(writer, buffer, fill) != 0) return 1;
+    if (row > (uint64_t)UINT32_MAX + 1) {
+        fprintf(stderr, "Error: data.csv tiene demasiadas filas para row IDs de 32 bits\n");
+        return 1;
+    }
+    index_writer_set_rows(writer, first_row, row - first_row);
     return 0;
 }
 
-void insert_skill(const char* skill, long offset) {
-    unsigned long index = hash_function(skill);
-    HashNode* current_node = hashTable[index];
+// Hilo de trabajo: procesa las líneas de [start, end) directamente sobre el
+// CSV proyectado. Los delimitadores se buscan con csv_find_any3 y el offset
+// de cada línea es su distancia al inicio del mapa, sin límite de longitud.
+void* process_range(void* arg) {
+    Worker* worker = (Worker*)arg;
+    const char* base = worker->csv->data;
+    const char* p = base + first_line(worker->csv, worker->start, worker->end);
+    const char* end = base + worker->end;
+
+    long local_lines = 0;
+    while (p < end) {
+        if (++local_lines % 10000 == 0) {
+            long total = __atomic_add_fetch(&lines_processed, 10000, __ATOMIC_RELAXED);
+            printf("Procesando línea del CSV: %ld\r", total);
+            fflush(stdout);
+        }
+        // Identificador de la fila: su row ID en la versión 4 o su offset
+        long current_offset = worker->row_ids ? worker->next_row++ : p - base;
+
+        // La primera columna (URL) termina en la primera coma de la línea.
+        const char* q = csv_find_any3(p, end, ',', '\n', '\n');
+        if (q == end || *q == '\n') {
+            p = q + 1;
+            continue;
+        }
+        q++;
+
+        // Las skills se separan por comillas, comas o el fin de línea.
+        while (1) {
+            const char* delim = csv_find_any3(q, end, '"', ',', '\n');
+            const char* token = q;
+            const char* token_end = delim;
+            while (token < token_end && isspace((unsigned char)*token)) token++;
+            while (token_end > token && isspace((unsigned char)token_end[-1])) token_end--;
+            if (token_end > token) {
+                insert_skill(&worker->table, token, token_end - token, current_offset);
+            }
+            if (delim == end || *delim == '\n') {
+                p = delim + 1;
+                break;
+            }
+            q = delim + 1;
+        }
+
+        // Modo de memoria acotada: volcar la tabla al superar el presupuesto.
+        // Solo se comprueba entre líneas, así un run nunca parte una línea.
+        if (worker->budget > 0 && skill_table_memory(&worker->table) > worker->budget) {
+            if (spill_run(worker) != 0) {
+                worker->failed = 1;
+                return NULL;
+            }
+            // Las páginas del CSV ya procesadas tampoco deben contar en memoria
+            csv_map_release(worker->csv, base + worker->start, p);
+        }
+    }
+    return NULL;
+}
+
+int init_skill_table(SkillTable* table, size_t n_buckets, size_t chunk_size) {
+    table->buckets = calloc(n_buckets, sizeof(HashNode*));
+    if (!table->buckets) {
+        perror("Error al reservar la tabla de skills");
+        return 1;
+    }
+    table->n_buckets = n_buckets;
+    arena_init(&table->arena, chunk_size);
+    return 0;
+}
+
+// Vacía la tabla tras volcar un run, conservando el array de buckets.
+void reset_skill_table(SkillTable* table) {
+    memset(table->buckets, 0, table->n_buckets * sizeof(HashNode*));
+    arena_release(&table->arena);
+}
+
+size_t skill_table_memory(const SkillTable* table) {
+    return table->n_buckets * sizeof(HashNode*) + table->arena.reserved;
+}
+
+// La skill llega como (puntero, longitud) porque apunta al CSV proyectado,
+// que no tiene terminadores nulos.
+void insert_skill(SkillTable* table, const char* skill, size_t len, long offset) {
+    unsigned long index = hash_function(skill, len) % table->n_buckets;
+    HashNode* current_node = table->buckets[index];
     while (current_node != NULL) {
-        if (strcmp(current_node->skill, skill) == 0) break;
+        if (current_node->skill_len == len && memcmp(current_node->skill, skill, len) == 0) break;
         current_node = current_node->next;
     }
     if (current_node == NULL) {
-        current_node = (HashNode*)malloc(sizeof(HashNode));
-        current_node->skill = strdup(skill);
-        current_node->offsets = NULL;
+        current_node = arena_alloc(&table->arena, sizeof(HashNode));
+        current_node->skill = arena_strndup(&table->arena, skill, len);
+        current_node->skill_len = len;
+        current_node->postings = NULL;
+        current_node->postings_tail = NULL;
         current_node->offset_count = 0;
-        current_node->next = hashTable[index];
-        hashTable[index] = current_node;
+        current_node->next = table->buckets[index];
+        table->buckets[index] = current_node;
+    }
+    // Los offsets se añaden al final: dentro de un worker llegan en orden
+    // creciente. Una skill repetida en la misma fila solo cuenta una vez.
+    PostingChunk* chunk = current_node->postings_tail;
+    if (chunk != NULL && chunk->used > 0 && chunk->offsets[chunk->used - 1] == offset) return;
+    if (chunk == NULL || chunk->used == chunk->capacity) {
+        unsigned int capacity = chunk ? chunk->capacity * 2 : POSTING_CHUNK_MIN;
+        if (capacity > POSTING_CHUNK_MAX) capacity = POSTING_CHUNK_MAX;
+        PostingChunk* new_chunk = arena_alloc(&table->arena, sizeof(PostingChunk) + capacity * sizeof(long));
+        new_chunk->next = NULL;
+        new_chunk->used = 0;
+        new_chunk->capacity = capacity;
+        if (chunk) chunk->next = new_chunk;
+        else current_node->postings = new_chunk;
+        current_node->postings_tail = new_chunk;
+        chunk = new_chunk;
     }
-    OffsetNode* new_offset_node = (OffsetNode*)malloc(sizeof(OffsetNode));
-    new_offset_node->offset = offset;
-    new_offset_node->next = current_node->offsets;
-    current_node->offsets = new_offset_node;
+    chunk->offsets[chunk->used++] = offset;
     current_node->offset_count++;
 }
 
+// Mueve todas las skills de src a dst. Como ambas tablas usan la misma función
+// hash, cada bucket de src solo puede coincidir con el mismo bucket de dst.
+void merge_skill_tables(SkillTable* dst, SkillTable* src) {
+    for (size_t i = 0; i < src->n_buckets; i++) {
+        HashNode* src_node = src->buckets[i];
+        while (src_node != NULL) {
+            HashNode* next_src = src_node->next;
+            HashNode* dst_node = dst->buckets[i];
+            while (dst_node != NULL && (dst_node->skill_len != src_node->skill_len ||
+                                        memcmp(dst_node->skill, src_node->skill, src_node->skill_len) != 0)) {
+                dst_node = dst_node->next;
+            }
+            if (dst_node == NULL) {
+                // Skill nueva: se reutiliza el nodo tal cual
+                src_node->next = dst->buckets[i];
+                dst->buckets[i] = src_node;
+            } else {
+                // Skill existente: se concatenan sus bloques de offsets. Los
+                // rangos se fusionan en orden, así la lista sigue ordenada.
+                dst_node->postings_tail->next = src_node->postings;
+                dst_node->postings_tail = src_node->postings_tail;
+                dst_node->offset_count += src_node->offset_count;
+            }
+            src_node = next_src;
+        }
+    }
+    free(src->buckets);
+    src->buckets = NULL;
+    // Los nodos movidos siguen en el arena de src: dst pasa a ser su dueño
+    arena_adopt(&dst->arena, &src->arena);
+}
 
-// Función para escribir los índices completamente ordenados
-void write_sorted_indices(const char* skl_filename, const char* idx_filename) {
+
+// Devuelve los nodos de la tabla ordenados alfabéticamente por 'skill'.
+HashNode** sort_skill_nodes(const SkillTable* table, size_t* total_skills) {
     // 1. Contar el número total de skills únicas.
-    size_t total_skills = 0;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        for (HashNode* node = hashTable[i]; node != NULL; node = node->next) {
-            total_skills++;
+    size_t total = 0;
+    for (size_t i = 0; i < table->n_buckets; i++) {
+        for (HashNode* node = table->buckets[i]; node != NULL; node = node->next) {
+            total++;
         }
     }
 
     // 2. Crear un array de punteros a todos los HashNodes para ordenarlos.
-    HashNode** sorted_nodes = malloc(total_skills * sizeof(HashNode*));
+    HashNode** sorted_nodes = malloc((total > 0 ? total : 1) * sizeof(HashNode*));
     size_t current_skill = 0;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        for (HashNode* node = hashTable[i]; node != NULL; node = node->next) {
+    for (size_t i = 0; i < table->n_buckets; i++) {
+        for (HashNode* node = table->buckets[i]; node != NULL; node = node->next) {
             sorted_nodes[current_skill++] = node;
         }
     }
 
     // 3. Ordenar el array de nodos alfabéticamente por 'skill'.
-    qsort(sorted_nodes, total_skills, sizeof(HashNode*), compare_hash_nodes_alpha);
+    qsort(sorted_nodes, total, sizeof(HashNode*), compare_hash_nodes_alpha);
+    *total_skills = total;
+    return sorted_nodes;
+}
 
-    // 4. Abrir archivos para escritura.
-    FILE* file_skl = fopen(skl_filename, "wb");
-    FILE* file_idx = fopen(idx_filename, "wb");
-    if (!file_skl || !file_idx) {
-        perror("Error al crear archivos de índice");
-        return;
-    }
-    
-    // Escribir el número total de skills al inicio del archivo .skl (útil para la búsqueda binaria)
-    fwrite(&total_skills, sizeof(size_t), 1, file_skl);
+// Función para escribir los índices completamente ordenados
+int write_sorted_indices(const SkillTable* table, IndexWriter* writer) {
+    size_t total_skills;
+    HashNode** sorted_nodes = sort_skill_nodes(table, &total_skills);
 
-    // 5. Iterar a través de los nodos ORDENADOS.
+    // Iterar a través de los nodos ORDENADOS. Los bloques de offsets ya
+    // están en orden creciente, así que se pasan tal cual al escritor.
     for (size_t i = 0; i < total_skills; i++) {
         HashNode* current_node = sorted_nodes[i];
-        
-        // Convertir la lista enlazada de offsets a un array para ordenarla.
-        long* offset_array = malloc(current_node->offset_count * sizeof(long));
-        OffsetNode* o_node = current_node->offsets;
-        for (size_t j = 0; j < current_node->offset_count; j++) {
-            offset_array[j] = o_node->offset;
-            o_node = o_node->next;
-        }
-
-        // Ordenar el array de offsets numéricamente.
-        qsort(offset_array, current_node->offset_count, sizeof(long), compare_longs);
-
-        // Escribir en los archivos de índice.
-        long idx_offset = ftell(file_idx);
-        size_t skill_len = strlen(current_node->skill);
-
-        // Formato .skl: [len, skill, count, offset_en_idx]
-        fwrite(&skill_len, sizeof(size_t), 1, file_skl);
-        fwrite(current_node->skill, 1, skill_len, file_skl);
-        fwrite(&current_node->offset_count, sizeof(size_t), 1, file_skl);
-        fwrite(&idx_offset, sizeof(long), 1, file_skl);
-
-        // Escribir la lista de offsets YA ORDENADA en .idx
-        fwrite(offset_array, sizeof(long), current_node->offset_count, file_idx);
-        
-        free(offset_array);
-    }
-    
-    fclose(file_skl);
-    fclose(file_idx);
+        if (index_writer_begin_skill(writer, current_node->skill, current_node->skill_len,
+                                     current_node->offset_count) != 0) {
+            free(sorted_nodes);
+            return 1;
+        }
+        for (PostingChunk* chunk = current_node->postings; chunk != NULL; chunk = chunk->next) {
+            if (index_writer_append(writer, chunk->offsets, chunk->used) != 0) {
+                free(sorted_nodes);
+                return 1;
+            }
+        }
+        if (index_writer_end_skill(writer) != 0) {
+            free(sorted_nodes);
+            return 1;
+        }
+    }
     free(sorted_nodes);
+    return 0;
 }
 
-// --- Funciones auxiliares y de liberación (incluyendo nuevas funciones de comparación) ---
-int compare_hash_nodes_alpha(const void* a, const void* b) {
-    HashNode* nodeA = *(HashNode**)a;
-    HashNode* nodeB = *(HashNode**)b;
-    return strcmp(nodeA->skill, nodeB->skill);
+// Crea un archivo temporal para un run. Se borra del directorio nada más
+// crearlo: solo queda su descriptor, así no quedan restos en disco aunque el
+// proceso muera. 'file' es un FILE* de escritura sobre una copia del descriptor.
+int create_run_file(int* fd, FILE** file) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/jobs.runXXXXXX", tmp_dir);
+    *fd = mkstemp(path);
+    if (*fd < 0) {
+        perror("Error al crear el run temporal");
+        return 1;
+    }
+    unlink(path);
+
+    int write_fd = dup(*fd);
+    *file = write_fd >= 0 ? fdopen(write_fd, "wb") : NULL;
+    if (!*file) {
+        perror("Error al abrir el run temporal");
+        if (write_fd >= 0) close(write_fd);
+        close(*fd);
+        return 1;
+    }
+    return 0;
 }
 
-int compare_longs(const void* a, const void* b) {
-    long la = *(const long*)a;
-    long lb = *(const long*)b;
-    if (la < lb) return -1;
-    if (la > lb) return 1;
+// Fusiona todos los runs del worker en uno solo para no agotar descriptores.
+// Son runs consecutivos, así que el resultado conserva el orden de offsets.
+static int compact_worker_runs(Worker* worker) {
+    int fd;
+    FILE* out;
+    if (create_run_file(&fd, &out) != 0) return 1;
+    int failed = merge_run_files(worker->runs, worker->n_runs, worker->budget, NULL, out);
+    if (fclose(out) != 0) failed = 1;
+    if (failed) {
+        perror("Error al fusionar runs temporales");
+        close(fd);
+        worker->n_runs = 0;
+        return 1;
+    }
+    worker->runs[0] = fd;
+    worker->n_runs = 1;
     return 0;
 }
 
-unsigned long hash_function(const char* str) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = *str++)) hash = ((hash << 5) + hash) + c;
-    return hash % TABLE_SIZE;
-}
-
-void free_hash_table() {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        HashNode* current_node = hashTable[i];
-        while (current_node != NULL) {
-            OffsetNode* current_offset = current_node->offsets;
-            while(current_offset != NULL) {
-                OffsetNode* temp_offset = current_offset;
-                current_offset = current_offset->next;
-                free(temp_offset);
+// Vuelca la tabla del worker como un run ordenado en un archivo temporal y la
+// vacía. Formato de cada registro: [len, skill, count, offsets...]
+int spill_run(Worker* worker) {
+    int fd;
+    FILE* file;
+    if (create_run_file(&fd, &file) != 0) return 1;
+
+    size_t total_skills;
+    HashNode** sorted_nodes = sort_skill_nodes(&worker->table, &total_skills);
+    int failed = 0;
+    for (size_t i = 0; i < total_skills && !failed; i++) {
+        HashNode* node = sorted_nodes[i];
+        if (fwrite(&node->skill_len, sizeof(size_t), 1, file) != 1 ||
+            fwrite(node->skill, 1, node->skill_len, file) != node->skill_len ||
+            fwrite(&node->offset_count, sizeof(size_t), 1, file) != 1) {
+            failed = 1;
+        }
+        for (PostingChunk* chunk = node->postings; chunk != NULL && !failed; chunk = chunk->next) {
+            if (fwrite(chunk->offsets, sizeof(long), chunk->used, file) != chunk->used) failed = 1;
+        }
+    }
+    free(sorted_nodes);
+    if (fclose(file) != 0) failed = 1;
+    if (failed) {
+        perror("Error al escribir el run temporal");
+        close(fd);
+        return 1;
+    }
+
+    worker->runs = realloc(worker->runs, (worker->n_runs + 1) * sizeof(int));
+    worker->runs[worker->n_runs++] = fd;
+    reset_skill_table(&worker->table);
+    if (worker->max_runs > 0 && worker->n_runs >= worker->max_runs) {
+        return compact_worker_runs(worker);
+    }
+    return 0;
+}
+
+// Lee la cabecera del siguiente registro. Devuelve 1 si hay registro, 0 al
+// llegar al final y -1 si el run está corrupto.
+int run_reader_next(RunReader* reader) {
+    if (reader->idx) {
+        // Segmento: leer la entrada y decodificar su lista completa
+        if (reader->remaining_skills == 0) return 0;
+        SkillEntry entry;
+        size_t loaded;
+        if (!read_skill_entry(reader->file, &reader->info, &reader->skill, &reader->skill_capacity,
+                              &reader->skill_len, &entry)) {
+            return -1;
+        }
+        if (entry.count > reader->list_capacity) {
+            reader->list_capacity = entry.count;
+            reader->list = realloc(reader->list, reader->list_capacity * sizeof(long));
+        }
+        long save = ftell(reader->file);
+        if (!load_postings(reader->idx, &reader->info, &entry, LONG_MIN, LONG_MAX, reader->list, &loaded) ||
+            loaded != entry.count || fseek(reader->file, save, SEEK_SET) != 0) {
+            return -1;
+        }
+        reader->count = entry.count;
+        reader->list_pos = 0;
+        reader->remaining_skills--;
+        return 1;
+    }
+
+    size_t len;
+    if (fread(&len, sizeof(size_t), 1, reader->file) != 1) return feof(reader->file) ? 0 : -1;
+    if (len + 1 > reader->skill_capacity) {
+        reader->skill_capacity = len + 1;
+        reader->skill = realloc(reader->skill, reader->skill_capacity);
+    }
+    if (fread(reader->skill, 1, len, reader->file) != len ||
+        fread(&reader->count, sizeof(size_t), 1, reader->file) != 1) {
+        return -1;
+    }
+    reader->skill[len] = '\0';
+    reader->skill_len = len;
+    return 1;
+}
+
+// Copia los n siguientes offsets del registro actual.
+static int run_reader_read(RunReader* reader, long* offsets, size_t n) {
+    if (reader->idx) {
+        memcpy(offsets, reader->list + reader->list_pos, n * sizeof(long));
+        reader->list_pos += n;
+        return 0;
+    }
+    return fread(offsets, sizeof(long), n, reader->file) == n ? 0 : -1;
+}
+
+// Orden del heap: por skill y, a igualdad, por posición del run. Los runs se
+// numeran en orden de offsets (worker y luego secuencia), así concatenar las
+// listas de una misma skill en ese orden mantiene los offsets ordenados.
+static int run_reader_less(const RunReader* a, const RunReader* b) {
+    int cmp = strcmp(a->skill, b->skill);
+    if (cmp != 0) return cmp < 0;
+    return a->order < b->order;
+}
+
+static void heap_push(RunReader** heap, int* size, RunReader* reader) {
+    int i = (*size)++;
+    heap[i] = reader;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!run_reader_less(heap[i], heap[parent])) break;
+        RunReader* tmp = heap[i]; heap[i] = heap[parent]; heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static RunReader* heap_pop(RunReader** heap, int* size) {
+    RunReader* top = heap[0];
+    heap[0] = heap[--(*size)];
+    int i = 0;
+    while (1) {
+        int left = 2 * i + 1, right = left + 1, smallest = i;
+        if (left < *size && run_reader_less(heap[left], heap[smallest])) smallest = left;
+        if (right < *size && run_reader_less(heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) break;
+        RunReader* tmp = heap[i]; heap[i] = heap[smallest]; heap[smallest] = tmp;
+        i = smallest;
+    }
+    return top;
+}
+
+// Fusión k-way de 'readers' (ya ordenados por posición). Las skills salen en
+// orden alfabético y los offsets de cada una se copian en streaming, sin
+// cargar listas enteras. El resultado va al índice final (writer) o a otro
+// run (out).
+static int merge_readers(RunReader* readers, int n, IndexWriter* writer, FILE* out) {
+    RunReader** heap = malloc((n > 0 ? n : 1) * sizeof(RunReader*));
+    RunReader** group = malloc((n > 0 ? n : 1) * sizeof(RunReader*));
+    long* offsets = malloc(MERGE_CHUNK * sizeof(long));
+    int heap_size = 0;
+    int failed = 0;
+
+    for (int r = 0; r < n && !failed; r++) {
+        int status = run_reader_next(&readers[r]);
+        if (status < 0) failed = 1;
+        else if (status > 0) heap_push(heap, &heap_size, &readers[r]);
+    }
+
+    while (heap_size > 0 && !failed) {
+        // Sacar todos los runs cuya skill actual es la menor
+        int group_size = 0;
+        group[group_size++] = heap_pop(heap, &heap_size);
+        while (heap_size > 0 && strcmp(heap[0]->skill, group[0]->skill) == 0) {
+            group[group_size++] = heap_pop(heap, &heap_size);
+        }
+
+        size_t total_count = 0;
+        for (int g = 0; g < group_size; g++) total_count += group[g]->count;
+        if (writer) {
+            failed = index_writer_begin_skill(writer, group[0]->skill, group[0]->skill_len, total_count);
+        } else if (fwrite(&group[0]->skill_len, sizeof(size_t), 1, out) != 1 ||
+                   fwrite(group[0]->skill, 1, group[0]->skill_len, out) != group[0]->skill_len ||
+                   fwrite(&total_count, sizeof(size_t), 1, out) != 1) {
+            failed = 1;
+        }
+
+        // Copiar los offsets de cada run en orden y avanzar al siguiente registro
+        for (int g = 0; g < group_size && !failed; g++) {
+            RunReader* reader = group[g];
+            size_t remaining = reader->count;
+            while (remaining > 0) {
+                size_t chunk = remaining < MERGE_CHUNK ? remaining : MERGE_CHUNK;
+                if (run_reader_read(reader, offsets, chunk) != 0) {
+                    fprintf(stderr, "Error: run temporal truncado\n");
+                    failed = 1;
+                    break;
+                }
+                if (writer ? index_writer_append(writer, offsets, chunk) != 0
+                           : fwrite(offsets, sizeof(long), chunk, out) != chunk) {
+                    failed = 1;
+                    break;
+                }
+                remaining -= chunk;
             }
-            HashNode* temp_node = current_node;
-            current_node = current_node->next;
-            free(temp_node->skill);
-            free(temp_node);
+            if (failed) break;
+            int status = run_reader_next(reader);
+            if (status < 0) failed = 1;
+            else if (status > 0) heap_push(heap, &heap_size, reader);
         }
+        if (!failed && writer && index_writer_end_skill(writer) != 0) failed = 1;
     }
+
+    free(heap);
+    free(group);
+    free(offsets);
+    return failed;
+}
+
+// Fusión k-way de los runs 'fds' (ya ordenados por posición). Los
+// descriptores se cierran siempre.
+int merge_run_files(const int* fds, int n, size_t budget, IndexWriter* writer, FILE* out) {
+    // El presupuesto de memoria también limita los buffers de lectura
+    size_t buffer_size = budget / (n > 0 ? n : 1);
+    if (buffer_size < BUFSIZ) buffer_size = BUFSIZ;
+    if (buffer_size > MAX_RUN_BUFFER) buffer_size = MAX_RUN_BUFFER;
+
+    RunReader* readers = calloc(n > 0 ? n : 1, sizeof(RunReader));
+    int failed = 0;
+    for (int r = 0; r < n; r++) {
+        RunReader* reader = &readers[r];
+        reader->order = r;
+        lseek(fds[r], 0, SEEK_SET);
+        reader->file = fdopen(fds[r], "rb");
+        if (!reader->file) {
+            perror("Error al abrir el run temporal");
+            close(fds[r]);
+            failed = 1;
+            continue;
+        }
+        setvbuf(reader->file, NULL, _IOFBF, buffer_size);
+    }
+    if (!failed) failed = merge_readers(readers, n, writer, out);
+
+    for (int r = 0; r < n; r++) {
+        if (readers[r].file) fclose(readers[r].file);
+        free(readers[r].skill);
+    }
+    free(readers);
+    return failed;
+}
+
+// --- Funciones auxiliares y de liberación (incluyendo nuevas funciones de comparación) ---
+int compare_hash_nodes_alpha(const void* a, const void* b) {
+    HashNode* nodeA = *(HashNode**)a;
+    HashNode* nodeB = *(HashNode**)b;
+    return strcmp(nodeA->skill, nodeB->skill);
+}
+
+unsigned long hash_function(const char* str, size_t len) {
+    unsigned long hash = 5381;
+    for (size_t i = 0; i < len; i++) hash = ((hash << 5) + hash) + (unsigned char)str[i];
+    return hash;
 }
 
-char* trim_whitespace(char* str) {
-    char *end;
-    while(isspace((unsigned char)*str)) str++;
-    if(*str == 0) return str;
-    end = str + strlen(str) - 1;
-    while(end > str && isspace((unsigned char)*end)) end--;
-    end[1] = '\0';
-    return str;
+// Nodos, cadenas y offsets están en el arena: basta con liberarlo entero.
+void free_hash_table(SkillTable* table) {
+    if (!table->buckets) return;
+    free(table->buckets);
+    table->buckets = NULL;
+    arena_release(&table->arena);
 }
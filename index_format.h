@@ -0,0 +1,109 @@
+#ifndef INDEX_FORMAT_H
+#define INDEX_FORMAT_H
+
+#include <stdint.h>
+
+// Formato en disco compartido por el indexador y el motor.
+//
+// Versión 1 (original): jobs.skl empieza directamente por el número de skills
+// (size_t) y cada entrada es [len, skill, count, offset_en_idx]. jobs.idx
+// guarda las listas de offsets como 'long' sin comprimir.
+//
+// Versión 2: jobs.skl empieza por SklHeader. Cada entrada añade el tamaño en
+// bytes de la lista comprimida: [len, skill, count, offset_en_idx, bytes].
+// Las listas de jobs.idx se dividen en bloques de POSTING_BLOCK_SIZE offsets
+// codificados como deltas empaquetados a nivel de bit (ver postings.h).
+//
+// Versión 3 (modo zstd, index -z): igual que la 2, pero las listas con al
+// menos zstd_min_postings offsets se guardan como frames zstd independientes
+// precedidos de una tabla de frames (ver postings.h). Así una búsqueda solo
+// descomprime los frames que caen en el rango que le interesa. Las filas de
+// data.csv se guardan aparte en jobs.docs (ver docstore.h).
+//
+// Versión 4 (por defecto): las listas guardan row IDs de 32 bits en lugar de
+// offsets en bytes. La fila i es la línea i de data.csv sin contar la
+// cabecera, y jobs.idx empieza por la tabla rowid -> offset de sus filas:
+//
+//   [uint64 offset * n_rows][listas...]
+//
+// (posición rows_offset; la primera fila de la tabla es first_row). Los
+// deltas continúan la numeración de las filas anteriores, así que los row
+// IDs no cambian al compactar. Las listas se codifican como en la versión 2,
+// con frames zstd si zstd_min_postings > 0 (index -z), salvo las de al menos
+// roaring_min_postings valores, que se guardan como contenedores Roaring
+// (ver roaring.h). Las que no van en frames ni como Roaring y tienen al
+// menos skip_min_postings valores llevan una tabla de saltos (ver postings.h).
+//
+// Desde las versiones 2 y 3 la cabecera indica qué rango de data.csv cubre el
+// índice. Además del índice base (jobs.skl/jobs.idx) puede haber segmentos
+// delta con las filas añadidas después, con el mismo formato (ver segments.h).
+//
+// Directorio por bloques (flag SKL_FLAG_FRONT_CODED, versiones 2 y 3): las
+// entradas se agrupan en bloques de dir_block_skills skills. Cada entrada se
+// escribe con front coding respecto a la anterior del bloque:
+//
+//   [varint compartido][varint len_sufijo][sufijo][varint count][varint bytes][varint hueco]
+//
+// donde 'compartido' es el prefijo común con la skill anterior (0 en la
+// primera del bloque) y offset_en_idx = fin de la lista anterior + hueco (el
+// fin se toma como 0 al empezar cada bloque). Tras los bloques, en
+// dir_index_offset, va el índice disperso que el motor mantiene en memoria:
+//
+//   [uint64 offset_bloque * (n_bloques + 1)][[uint32 len][skill] * n_bloques]
+//
+// con la primera skill de cada bloque. Una búsqueda es una búsqueda binaria
+// sobre esas cabezas más el recorrido de un solo bloque.
+//
+// Hash perfecto (flag SKL_FLAG_MPH): en mph_offset va un hash perfecto mínimo
+// de los nombres (ver mph.h) que da el número de entrada de cada skill. Una
+// búsqueda exacta es un hash más la lectura del bloque de esa entrada para
+// verificar el nombre. Si el hash no se pudo construir, no se activa el flag
+// y se usa la búsqueda binaria.
+
+// "JOBSKL" en little endian. Como número de skills de la versión 1 sería
+// absurdo, así que sirve para distinguir ambos formatos.
+#define SKL_MAGIC 0x4C4B53424F4AULL
+
+#define SKL_VERSION_RAW 1
+#define SKL_VERSION_PACKED 2
+#define SKL_VERSION_ZSTD 3
+#define SKL_VERSION_ROWS 4
+#define SKL_VERSION_CURRENT SKL_VERSION_ROWS
+#define SKL_VERSION_MAX SKL_VERSION_ROWS
+
+// Listas que pasan a contenedores Roaring en la versión 4: al menos 1 de cada
+// SKL_ROARING_DENSITY filas, y nunca menos de SKL_ROARING_MIN_POSTINGS valores
+#define SKL_ROARING_DENSITY 16
+#define SKL_ROARING_MIN_POSTINGS 4096
+
+#define SKL_FLAG_FRONT_CODED 0x1
+#define SKL_FLAG_MPH 0x2
+#define SKL_DIR_BLOCK_SKILLS 32
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;   // sizeof(SklHeader) al escribirlo; permite añadir campos
+    uint64_t total_skills;
+    uint32_t block_size;    // Offsets por bloque en jobs.idx
+    uint32_t flags;         // SKL_FLAG_*
+    uint32_t zstd_min_postings; // Listas con al menos estos offsets van en frames zstd (0 = sin zstd)
+    uint32_t frame_blocks;      // Bloques de POSTING_BLOCK_SIZE offsets por frame zstd
+    uint64_t data_start;        // Bytes [data_start, data_end) de data.csv indexados
+    uint64_t data_end;          // (0, 0 en índices anteriores a los segmentos)
+    uint64_t dir_index_offset;  // Directorio por bloques: posición y tamaño del
+    uint32_t dir_index_bytes;   // índice disperso y skills por bloque
+    uint32_t dir_block_skills;
+    uint64_t mph_offset;        // Hash perfecto de las skills (SKL_FLAG_MPH)
+    uint64_t mph_bytes;
+    uint64_t first_row;         // Versión 4: filas [first_row, first_row + n_rows)
+    uint64_t n_rows;
+    uint64_t rows_offset;       // Tabla rowid -> offset en jobs.idx
+    uint32_t roaring_min_postings;
+    uint32_t skip_min_postings;     // Listas con tabla de saltos (0 = ninguna)
+} SklHeader;
+
+// Tamaño de la cabecera de la versión 2 original, sin los campos de zstd
+#define SKL_HEADER_MIN_SIZE 32
+
+#endif
@@ -0,0 +1,784 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "index_reader.h"
+#include "postings.h"
+#include "roaring.h"
+
+// Contexto zstd para las listas en frames (modo zstd), uno por hilo
+static _Thread_local ZSTD_DCtx* postings_dctx = NULL;
+
+// Límites de un rango de búsqueda recortados a row IDs de 32 bits
+static uint32_t range_low(long lo) {
+    return lo < 0 ? 0 : lo > (long)UINT32_MAX ? UINT32_MAX : (uint32_t)lo;
+}
+
+static uint32_t range_high(long hi) {
+    return hi < 0 ? 0 : hi > (long)UINT32_MAX ? UINT32_MAX : (uint32_t)hi;
+}
+
+// Bytes [offset, offset + size) de jobs.skl o jobs.idx. Si el archivo está
+// proyectado en memoria (set_index_maps) se devuelve un puntero al mapa, sin
+// copias; si no, se leen con pread en un buffer nuevo que queda en *owned.
+// pread no mueve la posición del FILE*, así que varios hilos pueden leer del
+// mismo archivo a la vez.
+static const uint8_t* read_bytes(FILE* file, const uint8_t* map, size_t map_size, uint64_t offset,
+                                 size_t size, uint8_t** owned) {
+    *owned = NULL;
+    if (map) return offset <= map_size && size <= map_size - offset ? map + offset : NULL;
+    *owned = malloc(size > 0 ? size : 1);
+    size_t done = 0;
+    while (*owned && done < size) {
+        ssize_t n = pread(fileno(file), *owned + done, size - done, (off_t)(offset + done));
+        if (n <= 0) {
+            free(*owned);
+            *owned = NULL;
+        } else {
+            done += (size_t)n;
+        }
+    }
+    return *owned;
+}
+
+static int read_varint(FILE* file, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = getc(file);
+        if (byte == EOF) return 0;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return 1;
+    }
+    return 0;
+}
+
+static int get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return 1;
+    }
+    return 0;
+}
+
+// Reserva sitio para un nombre de 'len' bytes más el '\0'
+static void ensure_capacity(char** name, size_t* capacity, size_t len) {
+    if (len + 1 > *capacity) {
+        *capacity = len + 1;
+        *name = realloc(*name, *capacity);
+    }
+}
+
+// Mismo orden que strcmp, que es el que usa el indexador al ordenar
+static int compare_names(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+// Carga el índice disperso de un directorio por bloques y calcula dónde
+// empieza la cabeza de cada bloque.
+static int load_dir_index(FILE* skl_file, const SklHeader* header, SkillDirInfo* info) {
+    if (header->dir_block_skills == 0) return 0;
+    info->front_coded = 1;
+    info->block_skills = header->dir_block_skills;
+    info->n_blocks = (info->total_skills + info->block_skills - 1) / info->block_skills;
+    size_t table = (info->n_blocks + 1) * sizeof(uint64_t);
+    if (header->dir_index_bytes < table) return 0;
+
+    info->dir_index = malloc(header->dir_index_bytes);
+    info->head_starts = malloc((info->n_blocks + 1) * sizeof(uint32_t));
+    if (!info->dir_index || !info->head_starts ||
+        fseek(skl_file, (long)header->dir_index_offset, SEEK_SET) != 0 ||
+        fread(info->dir_index, 1, header->dir_index_bytes, skl_file) != header->dir_index_bytes) {
+        return 0;
+    }
+    info->block_offsets = (uint64_t*)info->dir_index;
+
+    uint32_t pos = (uint32_t)table;
+    for (size_t i = 0; i < info->n_blocks; i++) {
+        uint32_t len;
+        if (pos + sizeof(len) > header->dir_index_bytes) return 0;
+        memcpy(&len, info->dir_index + pos, sizeof(len));
+        if (len > header->dir_index_bytes - pos - sizeof(len)) return 0;
+        info->head_starts[i] = pos;
+        pos += (uint32_t)sizeof(len) + len;
+    }
+    info->head_starts[info->n_blocks] = pos;
+    return 1;
+}
+
+static int load_mph(FILE* skl_file, const SklHeader* header, SkillDirInfo* info) {
+    uint8_t* data = malloc(header->mph_bytes > 0 ? header->mph_bytes : 1);
+    if (!data || fseek(skl_file, (long)header->mph_offset, SEEK_SET) != 0 ||
+        fread(data, 1, header->mph_bytes, skl_file) != header->mph_bytes) {
+        free(data);
+        return 0;
+    }
+    if (mph_load(&info->mph, data, header->mph_bytes) != 0 || info->mph.n_keys != info->total_skills) return 0;
+    info->has_mph = 1;
+    return 1;
+}
+
+// Lee la cabecera de jobs.skl y detecta la versión del formato. Los índices
+// de la versión 1 no tienen cabecera: empiezan directamente por el total.
+int read_skill_dir_header(FILE* skl_file, SkillDirInfo* info) {
+    uint64_t first;
+    memset(info, 0, sizeof(*info));
+    fseek(skl_file, 0, SEEK_SET);
+    if (fread(&first, sizeof(first), 1, skl_file) != 1) {
+        perror("Error al leer el número total de habilidades");
+        return 0;
+    }
+    if (first != SKL_MAGIC) {
+        info->version = SKL_VERSION_RAW;
+        info->total_skills = (size_t)first;
+        info->entries_start = sizeof(size_t);
+        return 1;
+    }
+
+    // Las cabeceras antiguas son más cortas: los campos que falten quedan a 0
+    SklHeader header = {0};
+    fseek(skl_file, 0, SEEK_SET);
+    if (fread(&header, SKL_HEADER_MIN_SIZE, 1, skl_file) != 1 ||
+        header.header_size < SKL_HEADER_MIN_SIZE) {
+        perror("Error al leer la cabecera del índice");
+        return 0;
+    }
+    size_t known = header.header_size < sizeof(header) ? header.header_size : sizeof(header);
+    if (known > SKL_HEADER_MIN_SIZE &&
+        fread((char*)&header + SKL_HEADER_MIN_SIZE, known - SKL_HEADER_MIN_SIZE, 1, skl_file) != 1) {
+        perror("Error al leer la cabecera del índice");
+        return 0;
+    }
+    if (header.version > SKL_VERSION_MAX || header.block_size != POSTING_BLOCK_SIZE ||
+        (header.version >= SKL_VERSION_ZSTD && header.zstd_min_postings > 0 &&
+         header.frame_blocks != POSTING_FRAME_BLOCKS)) {
+        fprintf(stderr, "Formato de índice no soportado (versión %u)\n", header.version);
+        return 0;
+    }
+    info->version = (int)header.version;
+    info->total_skills = header.total_skills;
+    info->entries_start = header.header_size;
+    info->zstd_min_postings = header.version >= SKL_VERSION_ZSTD ? header.zstd_min_postings : 0;
+    info->data_start = header.data_start;
+    info->data_end = header.data_end;
+    if (header.version == SKL_VERSION_ROWS) {
+        info->row_ids = 1;
+        info->first_row = header.first_row;
+        info->n_rows = header.n_rows;
+        info->rows_offset = header.rows_offset;
+        info->roaring_min_postings = header.roaring_min_postings;
+        info->skip_min_postings = header.skip_min_postings;
+    }
+    if ((header.flags & SKL_FLAG_FRONT_CODED) && !load_dir_index(skl_file, &header, info)) {
+        fprintf(stderr, "Error: índice de bloques del directorio corrupto\n");
+        free_skill_dir_info(info);
+        return 0;
+    }
+    if (info->front_coded && (header.flags & SKL_FLAG_MPH) && !load_mph(skl_file, &header, info)) {
+        // Sin el hash las búsquedas siguen funcionando con la búsqueda binaria
+        fprintf(stderr, "Aviso: hash perfecto del directorio corrupto, se ignora\n");
+        mph_free(&info->mph);
+    }
+    fseek(skl_file, info->entries_start, SEEK_SET);
+    return 1;
+}
+
+void set_index_maps(SkillDirInfo* info, const uint8_t* skl_map, size_t skl_size, const uint8_t* idx_map,
+                    size_t idx_size) {
+    info->skl_map = skl_map;
+    info->skl_map_size = skl_size;
+    info->idx_map = idx_map;
+    info->idx_map_size = idx_size;
+}
+
+void free_skill_dir_info(SkillDirInfo* info) {
+    free(info->dir_index);
+    free(info->head_starts);
+    info->dir_index = NULL;
+    info->head_starts = NULL;
+    info->block_offsets = NULL;
+    mph_free(&info->mph);
+    info->has_mph = 0;
+}
+
+// Entrada con front coding en la posición actual de jobs.skl
+static int read_front_coded_entry(FILE* skl_file, SkillDirInfo* info, char** skill, size_t* capacity,
+                                  size_t* len, SkillEntry* entry) {
+    if (info->entries_read % info->block_skills == 0) {
+        info->previous_end = 0;
+        *len = 0;
+    }
+    uint64_t shared, suffix, count, bytes, gap;
+    if (!read_varint(skl_file, &shared) || !read_varint(skl_file, &suffix) || shared > *len) return 0;
+    ensure_capacity(skill, capacity, shared + suffix);
+    if (fread(*skill + shared, 1, suffix, skl_file) != suffix ||
+        !read_varint(skl_file, &count) || !read_varint(skl_file, &bytes) || !read_varint(skl_file, &gap)) {
+        return 0;
+    }
+    *len = shared + suffix;
+    (*skill)[*len] = '\0';
+    entry->count = count;
+    entry->offset = (long)(info->previous_end + gap);
+    entry->bytes = bytes;
+    info->previous_end += gap + bytes;
+    info->entries_read++;
+    return 1;
+}
+
+int read_skill_entry(FILE* skl_file, SkillDirInfo* info, char** skill, size_t* capacity,
+                     size_t* len, SkillEntry* entry) {
+    if (info->front_coded) return read_front_coded_entry(skl_file, info, skill, capacity, len, entry);
+
+    if (fread(len, sizeof(size_t), 1, skl_file) != 1) return 0;
+    ensure_capacity(skill, capacity, *len);
+    if (fread(*skill, 1, *len, skl_file) != *len ||
+        fread(&entry->count, sizeof(size_t), 1, skl_file) != 1 ||
+        fread(&entry->offset, sizeof(long), 1, skl_file) != 1) {
+        return 0;
+    }
+    (*skill)[*len] = '\0';
+    entry->bytes = 0;
+    if (info->version >= SKL_VERSION_PACKED &&
+        fread(&entry->bytes, sizeof(uint64_t), 1, skl_file) != 1) {
+        return 0;
+    }
+    return 1;
+}
+
+// Busca la skill en un bloque del directorio. Si la encuentra, deja en
+// *position su posición dentro del bloque.
+static int scan_block(FILE* skl_file, const SkillDirInfo* info, size_t block, const char* skill,
+                      size_t skill_len, SkillEntry* entry, size_t* position) {
+    size_t size = (size_t)(info->block_offsets[block + 1] - info->block_offsets[block]);
+    uint8_t* owned;
+    const uint8_t* data = read_bytes(skl_file, info->skl_map, info->skl_map_size, info->block_offsets[block],
+                                     size, &owned);
+    if (!data) return 0;
+
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    char* name = NULL;
+    size_t capacity = 0, len = 0;
+    uint64_t previous_end = 0;
+    int found = 0;
+    for (size_t i = 0; i < info->block_skills && p < end; i++) {
+        uint64_t shared, suffix, count, bytes, gap;
+        if (!get_varint(&p, end, &shared) || !get_varint(&p, end, &suffix) ||
+            shared > len || suffix > (uint64_t)(end - p)) {
+            break;
+        }
+        ensure_capacity(&name, &capacity, shared + suffix);
+        memcpy(name + shared, p, suffix);
+        p += suffix;
+        len = shared + suffix;
+        if (!get_varint(&p, end, &count) || !get_varint(&p, end, &bytes) || !get_varint(&p, end, &gap)) break;
+
+        int cmp = compare_names(name, len, skill, skill_len);
+        if (cmp == 0) {
+            entry->count = count;
+            entry->offset = (long)(previous_end + gap);
+            entry->bytes = bytes;
+            *position = i;
+            found = 1;
+            break;
+        }
+        if (cmp > 0) break; // Las skills del bloque están ordenadas
+        previous_end += gap + bytes;
+    }
+    free(name);
+    free(owned);
+    return found;
+}
+
+// Búsqueda en un directorio por bloques. Con hash perfecto, el hash da el
+// número de entrada y por tanto su bloque; si no, búsqueda binaria sobre las
+// cabezas residentes en memoria. En ambos casos se lee un único bloque. En
+// *number queda el número de entrada de la skill.
+static int find_in_blocks(FILE* skl_file, const SkillDirInfo* info, const char* skill, SkillEntry* entry,
+                          size_t* number) {
+    size_t skill_len = strlen(skill);
+    size_t block, position;
+
+    if (info->has_mph) {
+        uint32_t entry_index;
+        if (!mph_lookup(&info->mph, mph_hash(skill, skill_len), &entry_index) ||
+            entry_index >= info->total_skills) {
+            return 0; // La huella descarta la skill sin leer el directorio
+        }
+        block = entry_index / info->block_skills;
+        if (!scan_block(skl_file, info, block, skill, skill_len, entry, &position)) return 0;
+        *number = block * info->block_skills + position;
+        return 1;
+    }
+
+    // Primer bloque cuya cabeza es mayor que la skill; la skill solo puede
+    // estar en el anterior
+    size_t lo = 0, hi = info->n_blocks;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t head_len;
+        memcpy(&head_len, info->dir_index + info->head_starts[mid], sizeof(head_len));
+        const char* head = info->dir_index + info->head_starts[mid] + sizeof(head_len);
+        if (compare_names(head, head_len, skill, skill_len) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+    block = lo - 1;
+    if (!scan_block(skl_file, info, block, skill, skill_len, entry, &position)) return 0;
+    *number = block * info->block_skills + position;
+    return 1;
+}
+
+static int find_in_entries(FILE* skl_file, const SkillDirInfo* info, const char* skill, SkillEntry* entry);
+
+// Busca los metadatos de una skill en el archivo .skl.
+int find_skill_metadata(FILE* skl_file, const SkillDirInfo* info, const char* skill, SkillEntry* entry) {
+    size_t number;
+    if (info->front_coded) return find_in_blocks(skl_file, info, skill, entry, &number);
+
+    // Formatos sin bloques: las entradas tienen longitud variable, así que
+    // solo se pueden recorrer en orden desde la primera. El recorrido usa la
+    // posición del FILE*, que se bloquea mientras tanto.
+    flockfile(skl_file);
+    int found = find_in_entries(skl_file, info, skill, entry);
+    funlockfile(skl_file);
+    return found;
+}
+
+int find_skill_number(FILE* skl_file, const SkillDirInfo* info, const char* skill, size_t* number) {
+    SkillEntry entry;
+    return info->front_coded && find_in_blocks(skl_file, info, skill, &entry, number);
+}
+
+int read_skill_name(FILE* skl_file, const SkillDirInfo* info, size_t number, char** name, size_t* capacity) {
+    if (!info->front_coded || number >= info->total_skills) return 0;
+    size_t block = number / info->block_skills;
+    size_t size = (size_t)(info->block_offsets[block + 1] - info->block_offsets[block]);
+    uint8_t* owned;
+    const uint8_t* data = read_bytes(skl_file, info->skl_map, info->skl_map_size, info->block_offsets[block],
+                                     size, &owned);
+    if (!data) return 0;
+
+    // Con front coding hay que reconstruir los nombres desde la cabeza del bloque
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    size_t len = 0;
+    int found = 0;
+    for (size_t i = 0; i <= number % info->block_skills && p < end; i++) {
+        uint64_t shared, suffix, count, bytes, gap;
+        if (!get_varint(&p, end, &shared) || !get_varint(&p, end, &suffix) ||
+            shared > len || suffix > (uint64_t)(end - p)) {
+            break;
+        }
+        ensure_capacity(name, capacity, shared + suffix);
+        memcpy(*name + shared, p, suffix);
+        p += suffix;
+        len = shared + suffix;
+        if (!get_varint(&p, end, &count) || !get_varint(&p, end, &bytes) || !get_varint(&p, end, &gap)) break;
+        found = i == number % info->block_skills;
+    }
+    if (found) (*name)[len] = '\0';
+    free(owned);
+    return found;
+}
+
+int visit_skill_block(FILE* skl_file, const SkillDirInfo* info, size_t block, SkillVisitor visit, void* arg) {
+    if (!info->front_coded || block >= info->n_blocks) return 0;
+    size_t size = (size_t)(info->block_offsets[block + 1] - info->block_offsets[block]);
+    uint8_t* owned;
+    const uint8_t* data = read_bytes(skl_file, info->skl_map, info->skl_map_size, info->block_offsets[block],
+                                     size, &owned);
+    if (!data) return 0;
+
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    char* name = NULL;
+    size_t capacity = 0, len = 0;
+    uint64_t previous_end = 0;
+    for (size_t i = 0; i < info->block_skills && p < end; i++) {
+        uint64_t shared, suffix, count, bytes, gap;
+        if (!get_varint(&p, end, &shared) || !get_varint(&p, end, &suffix) ||
+            shared > len || suffix > (uint64_t)(end - p)) {
+            break;
+        }
+        ensure_capacity(&name, &capacity, shared + suffix);
+        memcpy(name + shared, p, suffix);
+        p += suffix;
+        len = shared + suffix;
+        if (!get_varint(&p, end, &count) || !get_varint(&p, end, &bytes) || !get_varint(&p, end, &gap)) break;
+        SkillEntry entry = { .count = count, .offset = (long)(previous_end + gap), .bytes = bytes };
+        previous_end += gap + bytes;
+        if (visit(arg, block * info->block_skills + i, name, len, &entry)) break;
+    }
+    free(name);
+    free(owned);
+    return 1;
+}
+
+// 1 si el nombre va detrás del límite buscado: con past = 0, si no va antes
+// que el prefijo; con past = 1, si va después de todos los que empiezan por él
+static int past_bound(const char* name, size_t len, const char* prefix, size_t prefix_len, int past) {
+    if (past) return compare_names(name, len < prefix_len ? len : prefix_len, prefix, prefix_len) > 0;
+    return compare_names(name, len, prefix, prefix_len) >= 0;
+}
+
+typedef struct {
+    const char* prefix;
+    size_t prefix_len;
+    int past;
+    size_t number;
+    int found;
+} BoundScan;
+
+static int visit_bound(void* arg, size_t number, const char* name, size_t len, const SkillEntry* entry) {
+    (void)entry;
+    BoundScan* scan = arg;
+    if (!past_bound(name, len, scan->prefix, scan->prefix_len, scan->past)) return 0;
+    scan->number = number;
+    scan->found = 1;
+    return 1;
+}
+
+// Primera entrada que va detrás del límite (ver past_bound): búsqueda binaria
+// sobre las cabezas y recorrido del bloque anterior a la primera que lo pasa
+static int find_bound(FILE* skl_file, const SkillDirInfo* info, const char* prefix, size_t prefix_len, int past,
+                      size_t* number) {
+    size_t lo = 0, hi = info->n_blocks;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t head_len;
+        memcpy(&head_len, info->dir_index + info->head_starts[mid], sizeof(head_len));
+        const char* head = info->dir_index + info->head_starts[mid] + sizeof(head_len);
+        if (past_bound(head, head_len, prefix, prefix_len, past)) hi = mid;
+        else lo = mid + 1;
+    }
+    if (lo == 0) {
+        *number = 0;
+        return 1;
+    }
+    // Si ninguna entrada del bloque lo pasa, el límite es la cabeza siguiente
+    BoundScan scan = { .prefix = prefix, .prefix_len = prefix_len, .past = past };
+    if (!visit_skill_block(skl_file, info, lo - 1, visit_bound, &scan)) return 0;
+    size_t next = lo * info->block_skills;
+    *number = scan.found ? scan.number : (next < info->total_skills ? next : info->total_skills);
+    return 1;
+}
+
+int find_prefix_range(FILE* skl_file, const SkillDirInfo* info, const char* prefix, size_t prefix_len,
+                      size_t* first, size_t* end) {
+    if (!info->front_coded) return 0;
+    if (!find_bound(skl_file, info, prefix, prefix_len, 0, first) ||
+        !find_bound(skl_file, info, prefix, prefix_len, 1, end)) {
+        return 0;
+    }
+    if (*end < *first) *end = *first;
+    return 1;
+}
+
+// Recorrido lineal de find_skill_metadata, con el FILE* ya bloqueado
+static int find_in_entries(FILE* skl_file, const SkillDirInfo* info, const char* skill, SkillEntry* entry) {
+    fseek(skl_file, info->entries_start, SEEK_SET); // Ir a la primera entrada
+    size_t total_skills = info->total_skills;
+    size_t metadata_size = sizeof(size_t) + sizeof(long) + (info->version >= SKL_VERSION_PACKED ? sizeof(uint64_t) : 0);
+    size_t skill_len = strlen(skill);
+
+    char* name = NULL;
+    size_t capacity = 0;
+    for (size_t i = 0; i < total_skills; i++) {
+        size_t len;
+        if (fread(&len, sizeof(size_t), 1, skl_file) != 1) break; // Fin de archivo
+
+        if (len != skill_len) {
+            // Longitud distinta: saltar el nombre y el resto de los metadatos
+            fseek(skl_file, (long)(len + metadata_size), SEEK_CUR);
+            continue;
+        }
+        ensure_capacity(&name, &capacity, len);
+        if (fread(name, 1, len, skl_file) != len) break;
+
+        if (memcmp(name, skill, len) == 0) {
+            int ok = fread(&entry->count, sizeof(size_t), 1, skl_file) == 1 &&
+                     fread(&entry->offset, sizeof(long), 1, skl_file) == 1;
+            entry->bytes = 0;
+            if (ok && info->version >= SKL_VERSION_PACKED) {
+                ok = fread(&entry->bytes, sizeof(uint64_t), 1, skl_file) == 1;
+            }
+            free(name);
+            return ok; // Encontrado
+        }
+        // Si no es, saltar el resto de los metadatos de esta entrada
+        fseek(skl_file, (long)metadata_size, SEEK_CUR);
+    }
+    free(name);
+    return 0; // No encontrado
+}
+
+static int is_framed(const SkillDirInfo* info, const SkillEntry* entry) {
+    return info->zstd_min_postings > 0 && entry->count >= info->zstd_min_postings;
+}
+
+static int has_skips(const SkillDirInfo* info, const SkillEntry* entry) {
+    return info->skip_min_postings > 0 && entry->count >= info->skip_min_postings &&
+           postings_skip_fits(entry->count) && !postings_are_bitmap(info, entry) && !is_framed(info, entry);
+}
+
+// Lee la tabla de frames o de saltos de una lista. El grupo i cubre los
+// valores (last[i - 1], last[i]] y sus bytes son [end[i - 1], end[i]) a
+// partir de data_start.
+static int load_groups(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry, ListGroups* groups) {
+    groups->framed = is_framed(info, entry);
+    groups->n = groups->framed ? postings_frame_count(entry->count) : postings_skip_count(entry->count);
+    groups->group_values = groups->framed ? POSTING_FRAME_VALUES : POSTING_SKIP_VALUES;
+    size_t entry_size = groups->framed ? sizeof(PostingFrame) : sizeof(PostingSkip);
+    size_t table_bytes = sizeof(uint32_t) + groups->n * entry_size;
+    groups->data_start = (uint64_t)entry->offset + table_bytes;
+
+    uint8_t* owned;
+    const uint8_t* table = read_bytes(idx_file, info->idx_map, info->idx_map_size, (uint64_t)entry->offset,
+                                      table_bytes, &owned);
+    uint32_t stored;
+    if (!table || (memcpy(&stored, table, sizeof(stored)), stored != groups->n)) {
+        free(owned);
+        return 0;
+    }
+    groups->last = malloc((groups->n + 1) * sizeof(uint64_t));
+    groups->end = malloc((groups->n + 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < groups->n; i++) {
+        const uint8_t* p = table + sizeof(uint32_t) + i * entry_size;
+        if (groups->framed) {
+            PostingFrame frame;
+            memcpy(&frame, p, sizeof(frame));
+            groups->last[i] = frame.last;
+            groups->end[i] = frame.end;
+        } else {
+            PostingSkip skip;
+            memcpy(&skip, p, sizeof(skip));
+            groups->last[i] = skip.last;
+            groups->end[i] = skip.end;
+        }
+    }
+    free(owned);
+    return 1;
+}
+
+static void free_groups(ListGroups* groups) {
+    free(groups->last);
+    free(groups->end);
+    groups->last = groups->end = NULL;
+}
+
+// Lee y decodifica los grupos [first, last] de una lista. Los grupos que no
+// se piden ni se leen ni se descomprimen.
+static int decode_groups(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry,
+                         const ListGroups* groups, size_t first, size_t last, long* out, size_t* loaded) {
+    *loaded = 0;
+    uint64_t from = first > 0 ? groups->end[first - 1] : 0;
+    uint64_t to = groups->end[last];
+    if (to < from) return 0;
+    uint8_t* owned;
+    const uint8_t* data = read_bytes(idx_file, info->idx_map, info->idx_map_size, groups->data_start + from,
+                                     (size_t)(to - from), &owned);
+    uint8_t* scratch = NULL;
+    int ok = data != NULL;
+    if (ok && groups->framed) {
+        scratch = malloc(POSTING_FRAME_MAX_BYTES);
+        if (!postings_dctx) postings_dctx = ZSTD_createDCtx();
+        ok = scratch && postings_dctx;
+    }
+    for (size_t i = first; ok && i <= last; i++) {
+        uint64_t start = i > 0 ? groups->end[i - 1] : 0;
+        size_t values = entry->count - i * groups->group_values;
+        if (values > groups->group_values) values = groups->group_values;
+        long previous = i > 0 ? (long)groups->last[i - 1] : 0;
+        if (groups->end[i] < start) {
+            ok = 0;
+        } else if (groups->framed) {
+            ok = postings_decode_frame(postings_dctx, data + (start - from), (size_t)(groups->end[i] - start),
+                                       values, previous, scratch, out + *loaded) == 0;
+        } else {
+            ok = postings_decode_from(data + (start - from), (size_t)(groups->end[i] - start), values, previous,
+                                      out + *loaded) == 0;
+        }
+        *loaded += values;
+    }
+    free(owned);
+    free(scratch);
+    return ok;
+}
+
+// Carga los grupos (frames zstd o grupos de la tabla de saltos) de una lista
+// que pueden contener valores de [lo, hi].
+static int load_grouped_postings(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry, long lo,
+                                 long hi, long* out, size_t* loaded) {
+    ListGroups groups;
+    if (!load_groups(idx_file, info, entry, &groups)) return 0;
+    size_t first = 0;
+    while (first < groups.n && (long)groups.last[first] < lo) first++;
+    size_t last = first;
+    while (last + 1 < groups.n && (long)groups.last[last] <= hi) last++;
+
+    *loaded = 0;
+    int ok = first >= groups.n || decode_groups(idx_file, info, entry, &groups, first, last, out, loaded);
+    free_groups(&groups);
+    return ok;
+}
+
+// Lee los contenedores Roaring de una lista que se solapan con [lo, hi]
+static int read_bitmap_list(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry, long lo, long hi,
+                            Roaring* out) {
+    if (info->idx_map) {
+        uint8_t* owned;
+        const uint8_t* data = read_bytes(idx_file, info->idx_map, info->idx_map_size, (uint64_t)entry->offset,
+                                         (size_t)entry->bytes, &owned);
+        return data && roaring_read_buffer(data, (size_t)entry->bytes, range_low(lo), range_high(hi), out) == 0;
+    }
+    // roaring_read salta con la posición del FILE*: se bloquea mientras lee
+    flockfile(idx_file);
+    int ok = fseek(idx_file, entry->offset, SEEK_SET) == 0 &&
+             roaring_read(idx_file, range_low(lo), range_high(hi), out) == 0;
+    funlockfile(idx_file);
+    return ok;
+}
+
+// En la versión 2 se lee la lista comprimida de una vez y se decodifica en
+// memoria (directamente desde el mapa si jobs.idx está proyectado).
+int load_postings(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry,
+                  long lo, long hi, long* out, size_t* loaded) {
+    if (postings_are_bitmap(info, entry)) {
+        Roaring bitmap;
+        roaring_init(&bitmap);
+        int ok = read_bitmap_list(idx_file, info, entry, lo, hi, &bitmap);
+        *loaded = ok ? roaring_to_array(&bitmap, out) : 0;
+        roaring_free(&bitmap);
+        return ok;
+    }
+    if (is_framed(info, entry) || has_skips(info, entry)) {
+        return load_grouped_postings(idx_file, info, entry, lo, hi, out, loaded);
+    }
+
+    *loaded = entry->count;
+    size_t bytes = info->version == SKL_VERSION_RAW ? entry->count * sizeof(long) : (size_t)entry->bytes;
+    uint8_t* owned;
+    const uint8_t* packed = read_bytes(idx_file, info->idx_map, info->idx_map_size, (uint64_t)entry->offset,
+                                       bytes, &owned);
+    int ok = packed != NULL;
+    if (ok && info->version == SKL_VERSION_RAW) memcpy(out, packed, bytes);
+    else if (ok) ok = postings_decode(packed, entry->bytes, entry->count, out) == 0;
+    free(owned);
+    return ok;
+}
+
+int postings_are_bitmap(const SkillDirInfo* info, const SkillEntry* entry) {
+    return info->roaring_min_postings > 0 && entry->count >= info->roaring_min_postings;
+}
+
+int load_bitmap_postings(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry,
+                         long lo, long hi, Roaring* out) {
+    Roaring part;
+    roaring_init(&part);
+    int ok;
+    if (postings_are_bitmap(info, entry)) {
+        ok = read_bitmap_list(idx_file, info, entry, lo, hi, &part);
+    } else {
+        // Lista corta (por ejemplo en un delta): se convierte
+        long* values = malloc((entry->count > 0 ? entry->count : 1) * sizeof(long));
+        size_t n = 0;
+        ok = values && load_postings(idx_file, info, entry, lo, hi, values, &n);
+        for (size_t i = 0; ok && i < n; i++) ok = roaring_add(&part, (uint32_t)values[i]) == 0;
+        free(values);
+    }
+    ok = ok && roaring_append(out, &part) == 0;
+    roaring_free(&part);
+    return ok;
+}
+
+int lookup_row_offset(FILE* idx_file, const SkillDirInfo* info, uint64_t row, long* offset) {
+    if (row < info->first_row || row >= info->first_row + info->n_rows) return 0;
+    uint64_t value;
+    uint8_t* owned;
+    const uint8_t* data = read_bytes(idx_file, info->idx_map, info->idx_map_size,
+                                     info->rows_offset + (row - info->first_row) * sizeof(uint64_t),
+                                     sizeof(value), &owned);
+    if (!data) return 0;
+    memcpy(&value, data, sizeof(value));
+    free(owned);
+    *offset = (long)value;
+    return 1;
+}
+
+int posting_cursor_open(PostingCursor* cursor, FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->idx_file = idx_file;
+    cursor->info = info;
+    cursor->entry = *entry;
+    cursor->grouped = is_framed(info, entry) || has_skips(info, entry);
+    if (cursor->grouped) {
+        if (!load_groups(idx_file, info, entry, &cursor->groups)) return 0;
+        cursor->group = cursor->groups.n;
+        cursor->values = malloc(cursor->groups.group_values * sizeof(long));
+        return cursor->values != NULL;
+    }
+    // Sin grupos: la lista entera es el único grupo
+    cursor->groups.n = 1;
+    cursor->group = 0;
+    cursor->values = malloc((entry->count > 0 ? entry->count : 1) * sizeof(long));
+    return cursor->values && load_postings(idx_file, info, entry, LONG_MIN, LONG_MAX, cursor->values,
+                                           &cursor->n_values);
+}
+
+void posting_cursor_close(PostingCursor* cursor) {
+    if (cursor->grouped) free_groups(&cursor->groups);
+    free(cursor->values);
+    cursor->values = NULL;
+}
+
+int posting_cursor_seek(PostingCursor* cursor, long target, long* value) {
+    if (cursor->grouped &&
+        (cursor->group == cursor->groups.n || (long)cursor->groups.last[cursor->group] < target)) {
+        // Búsqueda exponencial en la tabla desde el grupo actual y binaria en
+        // el último salto: el primer grupo cuyo último valor es >= target
+        const uint64_t* last = cursor->groups.last;
+        size_t n = cursor->groups.n;
+        size_t lo = cursor->group == n ? 0 : cursor->group + 1;
+        size_t step = 1;
+        while (lo + step < n && (long)last[lo + step - 1] < target) step *= 2;
+        size_t hi = lo + step < n ? lo + step : n;
+        if (step > 1) lo += step / 2;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if ((long)last[mid] < target) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == n) {
+            cursor->group = n;
+            return 0;
+        }
+        if (!decode_groups(cursor->idx_file, cursor->info, &cursor->entry, &cursor->groups, lo, lo,
+                           cursor->values, &cursor->n_values)) {
+            return -1;
+        }
+        cursor->group = lo;
+        cursor->pos = 0;
+    }
+
+    // Galope dentro del grupo: saltos de 1, 2, 4... y búsqueda binaria en el último
+    const long* values = cursor->values;
+    size_t lo = cursor->pos, n = cursor->n_values;
+    size_t step = 1;
+    while (lo + step < n && values[lo + step - 1] < target) step *= 2;
+    size_t hi = lo + step < n ? lo + step : n;
+    if (step > 1) lo += step / 2;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    cursor->pos = lo;
+    if (lo == n) return 0; // Solo sin grupos: con grupos el último valor es >= target
+    *value = values[lo];
+    return 1;
+}
@@ -0,0 +1,167 @@
+#ifndef INDEX_READER_H
+#define INDEX_READER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "index_format.h"
+#include "mph.h"
+#include "roaring.h"
+
+// Lectura de un índice (base o delta) en cualquiera de sus versiones.
+// Lo usan el motor para responder búsquedas y el indexador para compactar.
+//
+// Las búsquedas (find_skill_metadata, load_postings, los cursores...) se
+// pueden hacer desde varios hilos con los mismos FILE* y SkillDirInfo: leen
+// con pread o del mapa, y bloquean el FILE* cuando necesitan su posición.
+// read_skill_entry es secuencial y no admite lecturas concurrentes.
+
+// Datos de la cabecera de jobs.skl
+typedef struct {
+    int version;
+    size_t total_skills;
+    long entries_start;         // Posición de la primera entrada
+    size_t zstd_min_postings;   // Versión 3: listas que van en frames zstd
+    uint64_t data_start;        // Rango de data.csv cubierto (0, 0 si no consta)
+    uint64_t data_end;
+
+    // Versión 4: las listas son row IDs de las filas [first_row, first_row + n_rows)
+    int row_ids;
+    uint64_t first_row;
+    uint64_t n_rows;
+    uint64_t rows_offset;           // Tabla rowid -> offset en jobs.idx
+    size_t roaring_min_postings;    // Listas guardadas como contenedores Roaring
+    size_t skip_min_postings;       // Listas con tabla de saltos
+
+    // Directorio por bloques: índice disperso residente en memoria
+    int front_coded;
+    size_t block_skills;
+    size_t n_blocks;
+    uint64_t* block_offsets;    // n_blocks + 1 posiciones en jobs.skl
+    char* dir_index;            // Índice disperso tal cual está en disco
+    uint32_t* head_starts;      // Posición de la cabeza de cada bloque en dir_index
+    int has_mph;
+    Mph mph;                    // Hash perfecto: skill -> número de entrada
+
+    // jobs.skl y jobs.idx proyectados en memoria (set_index_maps). Si están,
+    // las búsquedas y las listas se leen del mapa en lugar de con fread.
+    const uint8_t* skl_map;
+    size_t skl_map_size;
+    const uint8_t* idx_map;
+    size_t idx_map_size;
+
+    // Estado de la lectura secuencial con read_skill_entry
+    size_t entries_read;
+    uint64_t previous_end;
+} SkillDirInfo;
+
+// Entrada del directorio: dónde está la lista de una skill en jobs.idx
+typedef struct {
+    size_t count;
+    long offset;
+    uint64_t bytes; // Tamaño de la lista comprimida (desde la versión 2)
+} SkillEntry;
+
+// Lee la cabecera de jobs.skl y detecta la versión del formato. Si el
+// directorio va por bloques, carga además su índice disperso y su hash
+// perfecto. Devuelve 1 si
+// el formato es válido y 0 si no. Hay que liberarlo con free_skill_dir_info.
+int read_skill_dir_header(FILE* skl_file, SkillDirInfo* info);
+void free_skill_dir_info(SkillDirInfo* info);
+
+// Asocia al índice sus archivos proyectados en memoria (los proyecta y los
+// libera quien llama). find_skill_metadata, load_postings y el resto de
+// lecturas aleatorias pasan a leer del mapa; read_skill_entry sigue usando
+// el FILE*. Los formatos sin bloques recorren el directorio con el FILE*.
+void set_index_maps(SkillDirInfo* info, const uint8_t* skl_map, size_t skl_size, const uint8_t* idx_map,
+                    size_t idx_size);
+
+// Lee la siguiente entrada de jobs.skl, empezando por la primera tras
+// read_skill_dir_header. El nombre se guarda en *skill (se amplía con realloc
+// si hace falta); con front coding se reconstruye a partir del anterior, así
+// que hay que pasar el mismo buffer en cada llamada. Devuelve 1 si la leyó.
+int read_skill_entry(FILE* skl_file, SkillDirInfo* info, char** skill, size_t* capacity,
+                     size_t* len, SkillEntry* entry);
+
+// Busca una skill en el directorio. Con hash perfecto basta leer el bloque
+// de su entrada para verificarla; sin él, búsqueda binaria sobre las cabezas
+// de bloque y recorrido de un bloque, o recorrido lineal en los formatos sin
+// bloques. Devuelve 1 si la encuentra.
+int find_skill_metadata(FILE* skl_file, const SkillDirInfo* info, const char* skill, SkillEntry* entry);
+
+// Número de entrada de una skill en un directorio por bloques (su posición
+// en el orden alfabético, el ID que usa el índice de skills por fila).
+// Devuelve 1 si la encuentra.
+int find_skill_number(FILE* skl_file, const SkillDirInfo* info, const char* skill, size_t* number);
+
+// Nombre de la entrada 'number' de un directorio por bloques, en *name (se
+// amplía con realloc si hace falta). Devuelve 1 si la pudo leer.
+int read_skill_name(FILE* skl_file, const SkillDirInfo* info, size_t number, char** name, size_t* capacity);
+
+// Recorre las entradas de un bloque de un directorio por bloques. 'visit'
+// recibe el número de entrada, el nombre (sin '\0', vale hasta la siguiente
+// llamada) y los metadatos; si devuelve distinto de 0, el recorrido para.
+// Devuelve 1 si el bloque se pudo leer.
+typedef int (*SkillVisitor)(void* arg, size_t number, const char* name, size_t len, const SkillEntry* entry);
+int visit_skill_block(FILE* skl_file, const SkillDirInfo* info, size_t block, SkillVisitor visit, void* arg);
+
+// Entradas [*first, *end) de un directorio por bloques cuyo nombre empieza
+// por 'prefix': en orden alfabético son contiguas. Búsqueda binaria sobre
+// las cabezas y un bloque leído por cada extremo. Devuelve 1 si va bien.
+int find_prefix_range(FILE* skl_file, const SkillDirInfo* info, const char* prefix, size_t prefix_len,
+                      size_t* first, size_t* end);
+
+// Carga en 'out' la lista de una entrada (offsets, o row IDs en la versión
+// 4). Las listas en frames zstd o en contenedores Roaring solo cargan los
+// trozos que se solapan con [lo, hi], así que 'loaded' puede quedar por
+// debajo de entry->count.
+int load_postings(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry,
+                  long lo, long hi, long* out, size_t* loaded);
+
+// 1 si la lista de la entrada está guardada como contenedores Roaring.
+int postings_are_bitmap(const SkillDirInfo* info, const SkillEntry* entry);
+
+// Añade a 'out' la lista de una entrada como bitmap Roaring; las listas que
+// no están guardadas así se convierten. Con contenedores Roaring solo se
+// leen los tramos que se solapan con [lo, hi].
+int load_bitmap_postings(FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry,
+                         long lo, long hi, Roaring* out);
+
+// Offset en data.csv de una fila (versión 4). Devuelve 0 si la fila no es de
+// este segmento.
+int lookup_row_offset(FILE* idx_file, const SkillDirInfo* info, uint64_t row, long* offset);
+
+// Grupos de una lista que se decodifican por separado: frames zstd o grupos
+// de bloques de la tabla de saltos (ver postings.h).
+typedef struct {
+    int framed;
+    size_t n;
+    size_t group_values;    // Valores por grupo (el último puede tener menos)
+    uint64_t* last;         // Último valor de cada grupo
+    uint64_t* end;          // Fin de cada grupo, relativo a data_start
+    uint64_t data_start;    // Posición del primer grupo en jobs.idx
+} ListGroups;
+
+// Cursor para buscar valores crecientes en una lista (intersección por
+// galope). Con tabla de saltos o frames solo se leen y decodifican los grupos
+// donde caen los valores buscados; las demás listas se cargan enteras al
+// abrir el cursor y se comportan como un único grupo.
+typedef struct {
+    FILE* idx_file;
+    const SkillDirInfo* info;
+    SkillEntry entry;
+    int grouped;
+    ListGroups groups;
+    size_t group;           // Grupo decodificado en 'values' (n si ninguno)
+    long* values;
+    size_t n_values;
+    size_t pos;             // Primer valor que aún puede coincidir
+} PostingCursor;
+
+int posting_cursor_open(PostingCursor* cursor, FILE* idx_file, const SkillDirInfo* info, const SkillEntry* entry);
+// Avanza hasta el primer valor >= target. Devuelve 1 y el valor en *value, 0
+// si la lista se ha acabado y -1 si hay un error de lectura.
+int posting_cursor_seek(PostingCursor* cursor, long target, long* value);
+void posting_cursor_close(PostingCursor* cursor);
+
+#endif
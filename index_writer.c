@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "index_writer.h"
+#include "mph.h"
+
+static char* tmp_name(const char* filename) {
+    size_t len = strlen(filename);
+    char* name = malloc(len + 5);
+    memcpy(name, filename, len);
+    memcpy(name + len, ".tmp", 5);
+    return name;
+}
+
+static void free_buffers(IndexWriter* w) {
+    ZSTD_freeCCtx(w->cctx);
+    free(w->frames);
+    free(w->skips);
+    free(w->frame_raw);
+    free(w->frame_compressed);
+    free(w->skl_filename);
+    free(w->idx_filename);
+    free(w->skill);
+    free(w->block_offsets);
+    free(w->heads);
+    free(w->hashes);
+    roaring_free(&w->bitmap);
+}
+
+static int write_varint(FILE* file, uint64_t value) {
+    while (value >= 0x80) {
+        if (putc((int)(value & 0x7F) | 0x80, file) == EOF) return 1;
+        value >>= 7;
+    }
+    return putc((int)value, file) == EOF ? 1 : 0;
+}
+
+// Guarda la posición y la primera skill del bloque que empieza.
+static void add_dir_block(IndexWriter* w) {
+    size_t n = w->total_skills / SKL_DIR_BLOCK_SKILLS;
+    if (n + 2 > w->blocks_capacity) {
+        w->blocks_capacity = w->blocks_capacity ? w->blocks_capacity * 2 : 1024;
+        w->block_offsets = realloc(w->block_offsets, w->blocks_capacity * sizeof(uint64_t));
+    }
+    w->block_offsets[n] = (uint64_t)ftell(w->skl);
+
+    uint32_t len = (uint32_t)w->skill_len;
+    if (w->heads_size + sizeof(len) + len > w->heads_capacity) {
+        w->heads_capacity = (w->heads_size + sizeof(len) + len) * 2;
+        w->heads = realloc(w->heads, w->heads_capacity);
+    }
+    memcpy(w->heads + w->heads_size, &len, sizeof(len));
+    memcpy(w->heads + w->heads_size + sizeof(len), w->skill, len);
+    w->heads_size += sizeof(len) + len;
+}
+
+// Escribe el índice disperso de bloques al final de jobs.skl.
+static int write_dir_index(IndexWriter* w, uint64_t* offset, uint32_t* bytes) {
+    size_t n_blocks = (w->total_skills + SKL_DIR_BLOCK_SKILLS - 1) / SKL_DIR_BLOCK_SKILLS;
+    if (n_blocks + 1 > w->blocks_capacity) {
+        w->blocks_capacity = n_blocks + 1;
+        w->block_offsets = realloc(w->block_offsets, w->blocks_capacity * sizeof(uint64_t));
+    }
+    *offset = (uint64_t)ftell(w->skl);
+    w->block_offsets[n_blocks] = *offset;
+    *bytes = (uint32_t)((n_blocks + 1) * sizeof(uint64_t) + w->heads_size);
+    if (fwrite(w->block_offsets, sizeof(uint64_t), n_blocks + 1, w->skl) != n_blocks + 1 ||
+        fwrite(w->heads, 1, w->heads_size, w->skl) != w->heads_size) {
+        perror("Error al escribir el índice de bloques del directorio");
+        return 1;
+    }
+    return 0;
+}
+
+// Construye el hash perfecto de las skills y lo escribe tras el índice de
+// bloques. Si no se puede construir (solo con hashes repetidos) el índice se
+// queda sin él y el motor usa la búsqueda binaria.
+static int write_mph(IndexWriter* w) {
+    if (w->total_skills == 0) return 0;
+    uint32_t* entries = malloc(w->total_skills * sizeof(uint32_t));
+    for (size_t i = 0; i < w->total_skills; i++) entries[i] = (uint32_t)i;
+    uint8_t* data;
+    size_t size;
+    int built = mph_build(w->hashes, entries, w->total_skills, &data, &size) == 0;
+    free(entries);
+    if (!built) {
+        fprintf(stderr, "Aviso: no se pudo construir el hash perfecto de '%s'\n", w->skl_filename);
+        return 0;
+    }
+    w->mph_offset = (uint64_t)ftell(w->skl);
+    int failed = fwrite(data, 1, size, w->skl) != size;
+    free(data);
+    if (failed) {
+        perror("Error al escribir el hash perfecto de las skills");
+        return 1;
+    }
+    w->mph_bytes = size;
+    return 0;
+}
+
+static int write_header(IndexWriter* w, uint64_t dir_index_offset, uint32_t dir_index_bytes) {
+    if (w->version == SKL_VERSION_RAW) {
+        return fwrite(&w->total_skills, sizeof(size_t), 1, w->skl) == 1 ? 0 : 1;
+    }
+    SklHeader header = {0};
+    header.magic = SKL_MAGIC;
+    header.version = (uint32_t)w->version;
+    header.header_size = sizeof(SklHeader);
+    header.total_skills = w->total_skills;
+    header.block_size = POSTING_BLOCK_SIZE;
+    header.data_start = w->data_start;
+    header.data_end = w->data_end;
+    header.flags = SKL_FLAG_FRONT_CODED | (w->mph_bytes > 0 ? SKL_FLAG_MPH : 0);
+    header.dir_index_offset = dir_index_offset;
+    header.dir_index_bytes = dir_index_bytes;
+    header.dir_block_skills = SKL_DIR_BLOCK_SKILLS;
+    header.mph_offset = w->mph_offset;
+    header.mph_bytes = w->mph_bytes;
+    if (w->zstd) {
+        header.zstd_min_postings = POSTING_ZSTD_MIN_VALUES;
+        header.frame_blocks = POSTING_FRAME_BLOCKS;
+    }
+    if (w->version == SKL_VERSION_ROWS) {
+        header.first_row = w->first_row;
+        header.n_rows = w->n_rows;
+        header.rows_offset = 0;
+        header.roaring_min_postings = (uint32_t)w->roaring_min;
+        header.skip_min_postings = POSTING_SKIP_MIN_VALUES;
+    }
+    return fwrite(&header, sizeof(header), 1, w->skl) == 1 ? 0 : 1;
+}
+
+int index_writer_open(IndexWriter* w, const char* skl_filename, const char* idx_filename, int version, int zstd) {
+    memset(w, 0, sizeof(*w));
+    w->version = version;
+    w->zstd = zstd && version >= SKL_VERSION_ZSTD;
+    w->skl_filename = strdup(skl_filename);
+    w->idx_filename = strdup(idx_filename);
+
+    char* skl_tmp = tmp_name(skl_filename);
+    char* idx_tmp = tmp_name(idx_filename);
+    w->skl = fopen(skl_tmp, "wb");
+    w->idx = fopen(idx_tmp, "wb");
+    free(skl_tmp);
+    free(idx_tmp);
+    if (w->zstd) {
+        w->cctx = ZSTD_createCCtx();
+        w->frame_raw = malloc(POSTING_FRAME_MAX_BYTES);
+        w->frame_compressed_capacity = ZSTD_compressBound(POSTING_FRAME_MAX_BYTES);
+        w->frame_compressed = malloc(w->frame_compressed_capacity);
+        if (!w->cctx || !w->frame_raw || !w->frame_compressed) {
+            fprintf(stderr, "Error: no se pudo inicializar zstd\n");
+            index_writer_abort(w);
+            return 1;
+        }
+    }
+    if (!w->skl || !w->idx) {
+        perror("Error al crear archivos de índice");
+        index_writer_abort(w);
+        return 1;
+    }
+
+    // El número total de skills se conoce al final: se reserva el hueco de
+    // la cabecera y se reescribe en index_writer_close.
+    if (write_header(w, 0, 0) != 0) {
+        perror("Error al escribir la cabecera del índice");
+        index_writer_abort(w);
+        return 1;
+    }
+    return 0;
+}
+
+void index_writer_set_range(IndexWriter* w, uint64_t start, uint64_t end) {
+    w->data_start = start;
+    w->data_end = end;
+}
+
+void index_writer_set_rows(IndexWriter* w, uint64_t first_row, uint64_t n_rows) {
+    w->first_row = first_row;
+    w->n_rows = n_rows;
+    w->roaring_min = n_rows / SKL_ROARING_DENSITY;
+    if (w->roaring_min < SKL_ROARING_MIN_POSTINGS) w->roaring_min = SKL_ROARING_MIN_POSTINGS;
+}
+
+void index_writer_share_rows(IndexWriter* w, uint64_t first_row, uint64_t n_rows) {
+    index_writer_set_rows(w, first_row, n_rows);
+    w->rows_written = n_rows;
+}
+
+int index_writer_append_rows(IndexWriter* w, const uint64_t* offsets, size_t n) {
+    if (w->version != SKL_VERSION_ROWS || w->total_skills > 0) {
+        fprintf(stderr, "Error: tabla de filas fuera de lugar\n");
+        return 1;
+    }
+    if (fwrite(offsets, sizeof(uint64_t), n, w->idx) != n) {
+        perror("Error al escribir la tabla de filas");
+        return 1;
+    }
+    w->rows_written += n;
+    return 0;
+}
+
+int index_writer_begin_skill(IndexWriter* w, const char* skill, size_t len, size_t count) {
+    // Prefijo común con la skill anterior, antes de sobrescribirla
+    w->shared = 0;
+    while (w->shared < len && w->shared < w->skill_len && w->skill[w->shared] == skill[w->shared]) {
+        w->shared++;
+    }
+    if (len + 1 > w->skill_capacity) {
+        w->skill_capacity = len + 1;
+        w->skill = realloc(w->skill, w->skill_capacity);
+    }
+    memcpy(w->skill, skill, len);
+    w->skill[len] = '\0';
+    w->skill_len = len;
+    w->count = count;
+    w->appended = 0;
+    w->idx_offset = ftell(w->idx);
+    w->block_fill = 0;
+    w->block_previous = 0;
+
+    // Listas muy frecuentes (versión 4): contenedores Roaring, que se
+    // escriben enteros en index_writer_end_skill.
+    w->bitmap_list = w->version == SKL_VERSION_ROWS && w->roaring_min > 0 && count >= w->roaring_min;
+
+    // Listas largas en modo zstd: se reserva el hueco de la tabla de frames,
+    // que se rellena en index_writer_end_skill.
+    w->framed = !w->bitmap_list && w->zstd && count >= POSTING_ZSTD_MIN_VALUES;
+    if (w->framed) {
+        uint32_t n_frames = (uint32_t)postings_frame_count(count);
+        if (n_frames > w->n_frames) {
+            w->frames = realloc(w->frames, n_frames * sizeof(PostingFrame));
+        }
+        w->n_frames = n_frames;
+        memset(w->frames, 0, n_frames * sizeof(PostingFrame));
+        w->frame_index = 0;
+        w->frame_values = 0;
+        w->frame_fill = 0;
+        w->frames_written = 0;
+        if (fwrite(&n_frames, sizeof(n_frames), 1, w->idx) != 1 ||
+            fwrite(w->frames, sizeof(PostingFrame), n_frames, w->idx) != n_frames) {
+            perror("Error al escribir la tabla de frames");
+            return 1;
+        }
+    }
+
+    // Listas largas sin frames (versión 4): se reserva la tabla de saltos. El
+    // fin de cada grupo se guarda en 32 bits, lo que limita el tamaño.
+    w->skipped = w->version == SKL_VERSION_ROWS && !w->bitmap_list && !w->framed &&
+                 count >= POSTING_SKIP_MIN_VALUES && postings_skip_fits(count);
+    if (w->skipped) {
+        uint32_t n_skips = (uint32_t)postings_skip_count(count);
+        if (n_skips > w->skips_capacity) {
+            w->skips_capacity = n_skips;
+            w->skips = realloc(w->skips, n_skips * sizeof(PostingSkip));
+        }
+        w->n_skips = n_skips;
+        memset(w->skips, 0, n_skips * sizeof(PostingSkip));
+        w->blocks_written = 0;
+        w->skip_bytes = 0;
+        if (fwrite(&n_skips, sizeof(n_skips), 1, w->idx) != 1 ||
+            fwrite(w->skips, sizeof(PostingSkip), n_skips, w->idx) != n_skips) {
+            perror("Error al escribir la tabla de saltos");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Comprime el frame en curso y lo añade a jobs.idx.
+static int flush_frame(IndexWriter* w) {
+    if (w->frame_values == 0) return 0;
+    size_t bytes = ZSTD_compressCCtx(w->cctx, w->frame_compressed, w->frame_compressed_capacity,
+                                     w->frame_raw, w->frame_fill, INDEX_ZSTD_LEVEL);
+    if (ZSTD_isError(bytes)) {
+        fprintf(stderr, "Error al comprimir la lista de '%s': %s\n", w->skill, ZSTD_getErrorName(bytes));
+        return 1;
+    }
+    if (fwrite(w->frame_compressed, 1, bytes, w->idx) != bytes) {
+        perror("Error al escribir la lista de offsets");
+        return 1;
+    }
+    w->frames_written += bytes;
+    w->frames[w->frame_index].last = (uint64_t)w->block_previous;
+    w->frames[w->frame_index].end = w->frames_written;
+    w->frame_index++;
+    w->frame_values = 0;
+    w->frame_fill = 0;
+    return 0;
+}
+
+static int flush_block(IndexWriter* w) {
+    if (w->block_fill == 0) return 0;
+    if (w->framed) {
+        // El bloque se acumula en el frame; se comprime cuando está lleno
+        w->frame_fill += postings_encode_block(w->block, w->block_fill, w->block_previous,
+                                               w->frame_raw + w->frame_fill);
+        w->frame_values += w->block_fill;
+        w->block_previous = w->block[w->block_fill - 1];
+        w->block_fill = 0;
+        return w->frame_values == POSTING_FRAME_VALUES ? flush_frame(w) : 0;
+    }
+    size_t bytes = postings_encode_block(w->block, w->block_fill, w->block_previous, w->encoded);
+    if (fwrite(w->encoded, 1, bytes, w->idx) != bytes) {
+        perror("Error al escribir la lista de offsets");
+        return 1;
+    }
+    w->block_previous = w->block[w->block_fill - 1];
+    if (w->skipped) {
+        // El último bloque de cada grupo deja su entrada definitiva
+        PostingSkip* skip = &w->skips[w->blocks_written++ / POSTING_SKIP_BLOCKS];
+        w->skip_bytes += bytes;
+        skip->last = (uint32_t)w->block_previous;
+        skip->end = (uint32_t)w->skip_bytes;
+    }
+    w->block_fill = 0;
+    return 0;
+}
+
+// Reescribe la tabla de saltos reservada al empezar la skill.
+static int write_skip_table(IndexWriter* w) {
+    long end = ftell(w->idx);
+    if (fseek(w->idx, w->idx_offset + (long)sizeof(uint32_t), SEEK_SET) != 0 ||
+        fwrite(w->skips, sizeof(PostingSkip), w->n_skips, w->idx) != w->n_skips ||
+        fseek(w->idx, end, SEEK_SET) != 0) {
+        perror("Error al escribir la tabla de saltos");
+        return 1;
+    }
+    return 0;
+}
+
+// Reescribe la tabla de frames reservada al empezar la skill.
+static int write_frame_table(IndexWriter* w) {
+    if (flush_frame(w) != 0) return 1;
+    long end = ftell(w->idx);
+    if (fseek(w->idx, w->idx_offset + (long)sizeof(uint32_t), SEEK_SET) != 0 ||
+        fwrite(w->frames, sizeof(PostingFrame), w->n_frames, w->idx) != w->n_frames ||
+        fseek(w->idx, end, SEEK_SET) != 0) {
+        perror("Error al escribir la tabla de frames");
+        return 1;
+    }
+    return 0;
+}
+
+int index_writer_append(IndexWriter* w, const long* offsets, size_t n) {
+    // Las intersecciones del motor dependen de que las listas estén ordenadas
+    for (size_t i = 0; i < n; i++) {
+        if (w->appended + i > 0 && offsets[i] < w->last_offset) {
+            fprintf(stderr, "Error: offsets desordenados en la skill '%s'\n", w->skill);
+            return 1;
+        }
+        w->last_offset = offsets[i];
+    }
+    if (w->version == SKL_VERSION_ROWS && n > 0 &&
+        (offsets[0] < (long)w->first_row || offsets[n - 1] >= (long)(w->first_row + w->n_rows))) {
+        fprintf(stderr, "Error: row ID fuera de rango en la skill '%s'\n", w->skill);
+        return 1;
+    }
+    if (w->bitmap_list) {
+        for (size_t i = 0; i < n; i++) {
+            if (roaring_add(&w->bitmap, (uint32_t)offsets[i]) != 0) {
+                fprintf(stderr, "Error: sin memoria para la lista de '%s'\n", w->skill);
+                return 1;
+            }
+        }
+    } else if (w->version == SKL_VERSION_RAW) {
+        if (fwrite(offsets, sizeof(long), n, w->idx) != n) {
+            perror("Error al escribir la lista de offsets");
+            return 1;
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            w->block[w->block_fill++] = offsets[i];
+            if (w->block_fill == POSTING_BLOCK_SIZE && flush_block(w) != 0) return 1;
+        }
+    }
+    w->appended += n;
+    return 0;
+}
+
+int index_writer_end_skill(IndexWriter* w) {
+    if (w->appended != w->count) {
+        fprintf(stderr, "Error: la skill '%s' declaró %zu offsets pero recibió %zu\n",
+                w->skill, w->count, w->appended);
+        return 1;
+    }
+    if (w->bitmap_list) {
+        int failed = roaring_write(&w->bitmap, w->idx);
+        roaring_free(&w->bitmap);
+        if (failed) {
+            perror("Error al escribir la lista de offsets");
+            return 1;
+        }
+    } else if (w->version != SKL_VERSION_RAW && flush_block(w) != 0) {
+        return 1;
+    }
+    if (w->framed && write_frame_table(w) != 0) return 1;
+    if (w->skipped && write_skip_table(w) != 0) return 1;
+
+    uint64_t bytes = (uint64_t)(ftell(w->idx) - w->idx_offset);
+    if (w->version == SKL_VERSION_RAW) {
+        // Formato .skl de la versión 1: [len, skill, count, offset_en_idx]
+        if (fwrite(&w->skill_len, sizeof(size_t), 1, w->skl) != 1 ||
+            fwrite(w->skill, 1, w->skill_len, w->skl) != w->skill_len ||
+            fwrite(&w->count, sizeof(size_t), 1, w->skl) != 1 ||
+            fwrite(&w->idx_offset, sizeof(long), 1, w->skl) != 1) {
+            perror("Error al escribir el directorio de skills");
+            return 1;
+        }
+        w->total_skills++;
+        return 0;
+    }
+
+    // Directorio por bloques con front coding (ver index_format.h)
+    if (w->total_skills % SKL_DIR_BLOCK_SKILLS == 0) {
+        add_dir_block(w);
+        w->shared = 0;
+        w->previous_end = 0;
+    }
+    size_t suffix = w->skill_len - w->shared;
+    if (write_varint(w->skl, w->shared) != 0 || write_varint(w->skl, suffix) != 0 ||
+        fwrite(w->skill + w->shared, 1, suffix, w->skl) != suffix ||
+        write_varint(w->skl, w->count) != 0 || write_varint(w->skl, bytes) != 0 ||
+        write_varint(w->skl, (uint64_t)w->idx_offset - w->previous_end) != 0) {
+        perror("Error al escribir el directorio de skills");
+        return 1;
+    }
+    w->previous_end = (uint64_t)w->idx_offset + bytes;
+
+    if (w->total_skills + 1 > w->hashes_capacity) {
+        w->hashes_capacity = w->hashes_capacity ? w->hashes_capacity * 2 : 1024;
+        w->hashes = realloc(w->hashes, w->hashes_capacity * sizeof(uint64_t));
+    }
+    w->hashes[w->total_skills] = mph_hash(w->skill, w->skill_len);
+    w->total_skills++;
+    return 0;
+}
+
+int index_writer_close(IndexWriter* w) {
+    int failed = 0;
+    if (w->version == SKL_VERSION_ROWS && w->rows_written != w->n_rows) {
+        fprintf(stderr, "Error: la tabla de filas tiene %lu de %lu filas\n",
+                (unsigned long)w->rows_written, (unsigned long)w->n_rows);
+        index_writer_abort(w);
+        return 1;
+    }
+    uint64_t dir_index_offset = 0;
+    uint32_t dir_index_bytes = 0;
+    if (w->version != SKL_VERSION_RAW && (write_dir_index(w, &dir_index_offset, &dir_index_bytes) != 0 ||
+                                           write_mph(w) != 0)) {
+        failed = 1;
+    } else if (fseek(w->skl, 0, SEEK_SET) != 0 || write_header(w, dir_index_offset, dir_index_bytes) != 0) {
+        perror("Error al escribir la cabecera del índice");
+        failed = 1;
+    }
+    if (fclose(w->skl) != 0) failed = 1;
+    if (fclose(w->idx) != 0) failed = 1;
+    w->skl = NULL;
+    w->idx = NULL;
+    if (failed) {
+        index_writer_abort(w);
+        return 1;
+    }
+
+    char* skl_tmp = tmp_name(w->skl_filename);
+    char* idx_tmp = tmp_name(w->idx_filename);
+    if (rename(idx_tmp, w->idx_filename) != 0 || rename(skl_tmp, w->skl_filename) != 0) {
+        perror("Error al renombrar los archivos de índice");
+        failed = 1;
+    }
+    free(skl_tmp);
+    free(idx_tmp);
+    free_buffers(w);
+    return failed;
+}
+
+void index_writer_abort(IndexWriter* w) {
+    if (w->skl) fclose(w->skl);
+    if (w->idx) fclose(w->idx);
+    if (w->skl_filename) {
+        char* skl_tmp = tmp_name(w->skl_filename);
+        remove(skl_tmp);
+        free(skl_tmp);
+    }
+    if (w->idx_filename) {
+        char* idx_tmp = tmp_name(w->idx_filename);
+        remove(idx_tmp);
+        free(idx_tmp);
+    }
+    free_buffers(w);
+    memset(w, 0, sizeof(*w));
+}
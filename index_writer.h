@@ -0,0 +1,118 @@
+#ifndef INDEX_WRITER_H
+#define INDEX_WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "index_format.h"
+#include "postings.h"
+#include "roaring.h"
+
+// Escritor en streaming de jobs.skl/jobs.idx. Las skills deben llegar en
+// orden alfabético y los offsets de cada una en orden creciente:
+//
+//   index_writer_begin_skill(w, skill, len, count);
+//   index_writer_append(w, offsets, n);   // tantas veces como haga falta
+//   index_writer_end_skill(w);
+//
+// En la versión 4 los valores son row IDs y antes de la primera skill hay
+// que escribir la tabla de filas (el offset de cada fila, en orden):
+//
+//   index_writer_append_rows(w, offsets, n);  // tantas veces como haga falta
+//   index_writer_set_rows(w, first_row, n_rows);
+//
+// Los archivos se escriben con sufijo .tmp y se renombran al cerrar, así un
+// fallo a mitad de construcción nunca deja un índice a medias. 'version'
+// elige el formato (ver index_format.h); con 'zstd' (versiones 3 y 4) las
+// listas largas se comprimen en frames zstd.
+typedef struct {
+    int version;
+    int zstd;
+    FILE* skl;
+    FILE* idx;
+    char* skl_filename;
+    char* idx_filename;
+    size_t total_skills;
+    uint64_t data_start;    // Rango de data.csv indexado (cabecera)
+    uint64_t data_end;
+    uint64_t first_row;     // Tabla de filas (versión 4)
+    uint64_t n_rows;
+    uint64_t rows_written;
+    size_t roaring_min;     // Listas que van como contenedores Roaring (0 = ninguna)
+
+    // Skill en curso
+    char* skill;
+    size_t skill_len;
+    size_t skill_capacity;
+    size_t count;
+    size_t appended;
+    long last_offset;
+    long idx_offset;
+    size_t shared;          // Prefijo común con la skill anterior
+
+    // Directorio por bloques (versiones 2 y 3, ver index_format.h)
+    uint64_t previous_end;  // Fin en jobs.idx de la lista anterior del bloque
+    uint64_t* block_offsets;
+    size_t blocks_capacity;
+    char* heads;            // [uint32 len][skill] de la primera skill de cada bloque
+    size_t heads_size;
+    size_t heads_capacity;
+    uint64_t* hashes;       // Hash de cada skill, para el hash perfecto
+    size_t hashes_capacity;
+    uint64_t mph_offset;
+    uint64_t mph_bytes;
+
+    // Bloque en construcción (versión 2)
+    long block[POSTING_BLOCK_SIZE];
+    size_t block_fill;
+    long block_previous;
+    uint8_t encoded[POSTING_MAX_BLOCK_BYTES];
+
+    // Tabla de saltos de la skill en curso (versión 4, ver postings.h)
+    int skipped;
+    PostingSkip* skips;
+    size_t n_skips;
+    size_t skips_capacity;
+    size_t blocks_written;
+    uint64_t skip_bytes;    // Bytes de bloques escritos tras la tabla
+
+    // Lista Roaring de la skill en curso (versión 4, listas muy frecuentes)
+    int bitmap_list;
+    Roaring bitmap;
+
+    // Frames zstd de la skill en curso (listas largas en modo zstd)
+    ZSTD_CCtx* cctx;
+    int framed;
+    PostingFrame* frames;
+    size_t n_frames;
+    size_t frame_index;
+    size_t frame_values;
+    uint64_t frames_written;
+    uint8_t* frame_raw;         // Bloques codificados del frame en curso
+    size_t frame_fill;
+    uint8_t* frame_compressed;
+    size_t frame_compressed_capacity;
+} IndexWriter;
+
+#define INDEX_ZSTD_LEVEL 3
+
+int index_writer_open(IndexWriter* w, const char* skl_filename, const char* idx_filename, int version, int zstd);
+// Rango [start, end) de data.csv que cubre el índice. Se guarda en la
+// cabecera al cerrar (formatos 2 y 3).
+void index_writer_set_range(IndexWriter* w, uint64_t start, uint64_t end);
+// Filas [first_row, first_row + n_rows) del índice (versión 4), después de
+// añadir sus offsets. Con el número de filas se decide qué listas van como
+// contenedores Roaring; al cerrar se comprueba que la tabla está completa.
+void index_writer_set_rows(IndexWriter* w, uint64_t first_row, uint64_t n_rows);
+int index_writer_append_rows(IndexWriter* w, const uint64_t* offsets, size_t n);
+// Como index_writer_set_rows, para un índice sin tabla de filas propia: sus
+// row IDs se resuelven con la de la base (el índice de parejas, ver pairs.h).
+void index_writer_share_rows(IndexWriter* w, uint64_t first_row, uint64_t n_rows);
+int index_writer_begin_skill(IndexWriter* w, const char* skill, size_t len, size_t count);
+int index_writer_append(IndexWriter* w, const long* offsets, size_t n);
+int index_writer_end_skill(IndexWriter* w);
+int index_writer_close(IndexWriter* w);
+// Cierra y borra los temporales sin tocar el índice anterior.
+void index_writer_abort(IndexWriter* w);
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "intersect.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Tercera lista de intersect3. Sin ella (c == NULL) se acepta todo valor.
+typedef struct {
+    const long* c;
+    size_t n;
+    size_t pos;
+} ThirdList;
+
+typedef size_t (*intersect_fn)(const long*, size_t, const long*, size_t, ThirdList*, long*);
+
+// Añade 'value' al resultado si también está en la tercera lista (con out
+// NULL solo lo cuenta). Devuelve 0 si la tercera lista se ha acabado y ya no
+// puede haber más coincidencias.
+static inline int emit(long value, ThirdList* third, long* out, size_t* k) {
+    while (third->pos < third->n && third->c[third->pos] < value) third->pos++;
+    if (third->pos == third->n) return 0;
+    if (third->c[third->pos] == value) {
+        if (out) out[*k] = value;
+        (*k)++;
+    }
+    return 1;
+}
+
+// Dos punteros sin ramas: los avances se calculan con comparaciones. Con out
+// NULL solo se cuentan las coincidencias.
+static size_t intersect_scalar(const long* a, size_t n, const long* b, size_t m, ThirdList* third, long* out) {
+    size_t i = 0, j = 0, k = 0;
+    if (!third->c && !out) {
+        while (i < n && j < m) {
+            long x = a[i], y = b[j];
+            k += x == y;
+            i += x <= y;
+            j += y <= x;
+        }
+        return k;
+    }
+    if (!third->c) {
+        while (i < n && j < m) {
+            long x = a[i], y = b[j];
+            out[k] = x;
+            k += x == y;
+            i += x <= y;
+            j += y <= x;
+        }
+        return k;
+    }
+    while (i < n && j < m) {
+        long x = a[i], y = b[j];
+        if (x == y && !emit(x, third, out, &k)) break;
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Para cada máscara de 4 bits, los índices de 32 bits que llevan al principio
+// del registro los valores de 64 bits marcados (ver intersect_init)
+static int32_t compress_avx2[16][8];
+
+// Bloques de 4 valores: a contra b y sus tres rotaciones, 16 comparaciones
+// en cuatro instrucciones.
+__attribute__((target("avx2")))
+static size_t intersect_avx2(const long* a, size_t n, const long* b, size_t m, ThirdList* third, long* out) {
+    size_t i = 0, j = 0, k = 0, limit = n < m ? n : m;
+    while (i + 4 <= n && j + 4 <= m) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        __m256i eq = _mm256_cmpeq_epi64(va, vb);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x39)));
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x4E)));
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x93)));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        long a_max = a[i + 3], b_max = b[j + 3];
+        if (mask && !third->c) {
+            // Un bloque ya emparejado con otro de b puede haber dejado
+            // valores en 'out': cerca del final se escriben uno a uno
+            if (out && k + 4 > limit) {
+                for (int bits = mask, lane = 0; bits; bits &= bits - 1, lane++) {
+                    out[k + lane] = a[i + __builtin_ctz(bits)];
+                }
+            } else if (out) {
+                __m256i order = _mm256_loadu_si256((const __m256i*)compress_avx2[mask]);
+                _mm256_storeu_si256((__m256i*)(out + k), _mm256_permutevar8x32_epi32(va, order));
+            }
+            k += (size_t)__builtin_popcount(mask);
+        } else if (mask) {
+            for (; mask; mask &= mask - 1) {
+                if (!emit(a[i + __builtin_ctz(mask)], third, out, &k)) return k;
+            }
+        }
+        i += a_max <= b_max ? 4 : 0;
+        j += b_max <= a_max ? 4 : 0;
+    }
+    return k + intersect_scalar(a + i, n - i, b + j, m - j, third, out ? out + k : NULL);
+}
+#endif
+
+static intersect_fn intersect_impl = intersect_scalar;
+static const char* intersect_name = "escalar";
+
+void intersect_init(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    for (int mask = 0; mask < 16; mask++) {
+        int next = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            if (mask & (1 << lane)) {
+                compress_avx2[mask][2 * next] = 2 * lane;
+                compress_avx2[mask][2 * next + 1] = 2 * lane + 1;
+                next++;
+            }
+        }
+        for (; next < 4; next++) {
+            compress_avx2[mask][2 * next] = 0;
+            compress_avx2[mask][2 * next + 1] = 1;
+        }
+    }
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        intersect_impl = intersect_avx2;
+        intersect_name = "AVX2";
+    }
+#endif
+}
+
+const char* intersect_impl_name(void) {
+    return intersect_name;
+}
+
+size_t intersect2(const long* a, size_t n, const long* b, size_t m, long* out) {
+    ThirdList none = { NULL, 0, 0 };
+    return intersect_impl(a, n, b, m, &none, out);
+}
+
+size_t intersect3(const long* a, size_t n, const long* b, size_t m, const long* c, size_t p, long* out) {
+    ThirdList third = { c, p, 0 };
+    if (p == 0) return 0;
+    return intersect_impl(a, n, b, m, &third, out);
+}
+
+size_t intersect2_count(const long* a, size_t n, const long* b, size_t m) {
+    ThirdList none = { NULL, 0, 0 };
+    return intersect_impl(a, n, b, m, &none, NULL);
+}
+
+size_t intersect3_count(const long* a, size_t n, const long* b, size_t m, const long* c, size_t p) {
+    ThirdList third = { c, p, 0 };
+    if (p == 0) return 0;
+    return intersect_impl(a, n, b, m, &third, NULL);
+}
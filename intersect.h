@@ -0,0 +1,34 @@
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+#include <stddef.h>
+
+// Intersección de listas ordenadas y sin repetidos (row IDs u offsets).
+//
+// La versión AVX2 compara bloques de 4 valores de cada lista todos contra
+// todos y avanza el bloque cuyo máximo es menor, sin saltos condicionales por
+// valor. La versión escalar también avanza sin ramas. La implementación se
+// elige al arrancar según la CPU (intersect_init).
+//
+// En todas las funciones 'out' debe tener sitio para min(n, m) valores y no
+// solaparse con las listas: la versión AVX2 escribe bloques completos y luego
+// cuenta solo las coincidencias.
+
+// Selecciona la implementación (AVX2 o escalar) según la CPU.
+// Debe llamarse una vez antes de usar intersect2/intersect3.
+void intersect_init(void);
+const char* intersect_impl_name(void);
+
+// a ∩ b. Devuelve el número de valores escritos en 'out'.
+size_t intersect2(const long* a, size_t n, const long* b, size_t m, long* out);
+
+// a ∩ b ∩ c en una sola pasada, sin lista intermedia: cada coincidencia de
+// a y b se comprueba al momento contra c.
+size_t intersect3(const long* a, size_t n, const long* b, size_t m, const long* c, size_t p, long* out);
+
+// Como intersect2 e intersect3, pero solo cuentan las coincidencias: el
+// mismo recorrido sin escribir ninguna lista.
+size_t intersect2_count(const long* a, size_t n, const long* b, size_t m);
+size_t intersect3_count(const long* a, size_t n, const long* b, size_t m, const long* c, size_t p);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mph.h"
+
+// Finalizador de MurmurHash3: mezcla bien los 64 bits
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t mph_hash(const char* key, size_t len) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)len * 0xbf58476d1ce4e5b9ULL);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, key + i, sizeof(word));
+        h = mix64(h ^ word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, key + i, len - i);
+    return mix64(h ^ tail ^ ((uint64_t)(len - i) << 56));
+}
+
+// Huella: los 16 bits altos del hash, que no intervienen en la posición
+static uint16_t fingerprint(uint64_t hash) {
+    return (uint16_t)(hash >> 48);
+}
+
+static uint64_t level_position(uint64_t hash, uint32_t level, uint64_t bits) {
+    return mix64(hash + (uint64_t)(level + 1) * 0x9E3779B97F4A7C15ULL) % bits;
+}
+
+// Reparte el buffer serializado en sus secciones y calcula la tabla de rangos.
+static int layout(Mph* mph, uint8_t* data, size_t bytes) {
+    memset(mph, 0, sizeof(*mph));
+    MphHeader header;
+    if (bytes < sizeof(header)) return 1;
+    memcpy(&header, data, sizeof(header));
+    if (header.n_levels > MPH_MAX_LEVELS) return 1;
+    size_t pos = sizeof(header);
+    if (bytes - pos < header.n_levels * sizeof(uint64_t)) return 1;
+    const uint64_t* level_words = (const uint64_t*)(data + pos);
+    pos += header.n_levels * sizeof(uint64_t);
+
+    size_t total_words = 0;
+    for (uint32_t l = 0; l < header.n_levels; l++) total_words += level_words[l];
+    size_t needed = total_words * sizeof(uint64_t) + (size_t)header.n_keys * (sizeof(uint32_t) + sizeof(uint16_t));
+    if (bytes - pos != needed) return 1;
+
+    mph->n_keys = header.n_keys;
+    mph->n_levels = header.n_levels;
+    mph->level_words = level_words;
+    mph->bits = (const uint64_t*)(data + pos);
+    pos += total_words * sizeof(uint64_t);
+    mph->values = (const uint32_t*)(data + pos);
+    pos += (size_t)header.n_keys * sizeof(uint32_t);
+    mph->fingerprints = (const uint16_t*)(data + pos);
+
+    mph->ranks = malloc((total_words + 1) * sizeof(uint32_t));
+    if (!mph->ranks) return 1;
+    uint32_t rank = 0;
+    for (size_t w = 0; w < total_words; w++) {
+        mph->ranks[w] = rank;
+        rank += (uint32_t)__builtin_popcountll(mph->bits[w]);
+    }
+    mph->ranks[total_words] = rank;
+    return rank == header.n_keys ? 0 : 1;
+}
+
+// Posición de la clave: el rango de su bit entre todos los niveles
+static int find_slot(const Mph* mph, uint64_t hash, uint32_t* slot) {
+    size_t offset = 0;
+    for (uint32_t l = 0; l < mph->n_levels; l++) {
+        size_t bit = offset * 64 + level_position(hash, l, mph->level_words[l] * 64);
+        uint64_t word = mph->bits[bit / 64];
+        uint64_t mask = 1ULL << (bit % 64);
+        if (word & mask) {
+            *slot = mph->ranks[bit / 64] + (uint32_t)__builtin_popcountll(word & (mask - 1));
+            return 1;
+        }
+        offset += mph->level_words[l];
+    }
+    return 0;
+}
+
+int mph_build(const uint64_t* hashes, const uint32_t* values, size_t n, uint8_t** out, size_t* out_bytes) {
+    uint64_t* pending = malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    uint64_t* level_bits[MPH_MAX_LEVELS];
+    uint64_t level_words[MPH_MAX_LEVELS];
+    uint32_t n_levels = 0;
+    size_t total_words = 0;
+    size_t n_pending = n;
+    int failed = !pending;
+    if (!failed) memcpy(pending, hashes, n * sizeof(uint64_t));
+
+    while (!failed && n_pending > 0) {
+        if (n_levels == MPH_MAX_LEVELS) {
+            failed = 1; // Solo pasa si hay hashes repetidos
+            break;
+        }
+        size_t words = (n_pending * MPH_GAMMA + 63) / 64;
+        uint64_t* taken = calloc(words, sizeof(uint64_t));
+        uint64_t* collided = calloc(words, sizeof(uint64_t));
+        if (!taken || !collided) {
+            free(taken);
+            free(collided);
+            failed = 1;
+            break;
+        }
+        for (size_t i = 0; i < n_pending; i++) {
+            uint64_t p = level_position(pending[i], n_levels, words * 64);
+            if (taken[p / 64] & (1ULL << (p % 64))) collided[p / 64] |= 1ULL << (p % 64);
+            else taken[p / 64] |= 1ULL << (p % 64);
+        }
+        for (size_t w = 0; w < words; w++) taken[w] &= ~collided[w];
+        free(collided);
+
+        // Las claves que colisionaron pasan al siguiente nivel
+        size_t kept = 0;
+        for (size_t i = 0; i < n_pending; i++) {
+            uint64_t p = level_position(pending[i], n_levels, words * 64);
+            if (!(taken[p / 64] & (1ULL << (p % 64)))) pending[kept++] = pending[i];
+        }
+        n_pending = kept;
+        level_bits[n_levels] = taken;
+        level_words[n_levels++] = words;
+        total_words += words;
+    }
+    free(pending);
+
+    uint8_t* data = NULL;
+    size_t bytes = sizeof(MphHeader) + n_levels * sizeof(uint64_t) + total_words * sizeof(uint64_t) +
+                   n * (sizeof(uint32_t) + sizeof(uint16_t));
+    if (!failed) {
+        data = malloc(bytes);
+        failed = !data;
+    }
+    if (!failed) {
+        MphHeader header = { (uint32_t)n, n_levels };
+        uint8_t* p = data;
+        memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        memcpy(p, level_words, n_levels * sizeof(uint64_t));
+        p += n_levels * sizeof(uint64_t);
+        for (uint32_t l = 0; l < n_levels; l++) {
+            memcpy(p, level_bits[l], level_words[l] * sizeof(uint64_t));
+            p += level_words[l] * sizeof(uint64_t);
+        }
+
+        // Guardar el valor y la huella de cada clave en su posición
+        Mph mph;
+        failed = layout(&mph, data, bytes) != 0;
+        uint32_t* slot_values = (uint32_t*)mph.values;
+        uint16_t* slot_fingerprints = (uint16_t*)mph.fingerprints;
+        for (size_t i = 0; !failed && i < n; i++) {
+            uint32_t slot;
+            failed = !find_slot(&mph, hashes[i], &slot);
+            if (!failed) {
+                slot_values[slot] = values[i];
+                slot_fingerprints[slot] = fingerprint(hashes[i]);
+            }
+        }
+        free(mph.ranks);
+    }
+    for (uint32_t l = 0; l < n_levels; l++) free(level_bits[l]);
+
+    if (failed) {
+        free(data);
+        return 1;
+    }
+    *out = data;
+    *out_bytes = bytes;
+    return 0;
+}
+
+int mph_load(Mph* mph, uint8_t* data, size_t bytes) {
+    if (layout(mph, data, bytes) != 0) {
+        free(mph->ranks);
+        free(data);
+        memset(mph, 0, sizeof(*mph));
+        return 1;
+    }
+    mph->data = data;
+    return 0;
+}
+
+void mph_free(Mph* mph) {
+    free(mph->ranks);
+    free(mph->data);
+    memset(mph, 0, sizeof(*mph));
+}
+
+int mph_lookup(const Mph* mph, uint64_t hash, uint32_t* value) {
+    uint32_t slot;
+    if (mph->n_keys == 0 || !find_slot(mph, hash, &slot) || mph->fingerprints[slot] != fingerprint(hash)) {
+        return 0;
+    }
+    *value = mph->values[slot];
+    return 1;
+}
@@ -0,0 +1,61 @@
+#ifndef MPH_H
+#define MPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hash perfecto mínimo (estilo BBHash) sobre los nombres de las skills.
+//
+// Cada clave es un hash de 64 bits del nombre. En el nivel l se reparte cada
+// clave pendiente en un vector de bits de MPH_GAMMA veces su número; las que
+// caen solas en su posición se quedan en ese nivel y las que colisionan pasan
+// al siguiente. La posición de una clave es el rango de su bit entre todos
+// los niveles, así que las n claves se numeran de 0 a n - 1 sin huecos.
+//
+// Formato serializado:
+//
+//   [MphHeader][uint64 palabras por nivel * n_levels][uint64 bits...]
+//   [uint32 valor * n_keys][uint16 huella * n_keys]
+//
+// El valor de cada posición es el que se pasó al construir (en jobs.skl, el
+// número de entrada en el directorio). La huella son 16 bits del hash que no
+// se usan para colocar la clave: descarta casi todas las claves que no están
+// en el conjunto sin tener que leer el directorio.
+
+#define MPH_GAMMA 2
+#define MPH_MAX_LEVELS 32
+
+typedef struct {
+    uint32_t n_keys;
+    uint32_t n_levels;
+} MphHeader;
+
+typedef struct {
+    uint32_t n_keys;
+    uint32_t n_levels;
+    const uint64_t* level_words;    // Palabras de 64 bits de cada nivel
+    const uint64_t* bits;
+    const uint32_t* values;
+    const uint16_t* fingerprints;
+    uint32_t* ranks;                // Bits a 1 antes de cada palabra
+    uint8_t* data;                  // Buffer serializado (propiedad del Mph)
+} Mph;
+
+// Hash de 64 bits de un nombre de skill.
+uint64_t mph_hash(const char* key, size_t len);
+
+// Construye el hash perfecto de n claves (hashes distintos) con sus valores.
+// Devuelve en *out un buffer serializado (liberar con free). Devuelve 1 si
+// no se pudo construir, por ejemplo con dos hashes repetidos.
+int mph_build(const uint64_t* hashes, const uint32_t* values, size_t n, uint8_t** out, size_t* out_bytes);
+
+// Carga un hash serializado. Se queda con 'data' (lo libera mph_free, o la
+// propia mph_load si el formato no es válido). 0 si va bien.
+int mph_load(Mph* mph, uint8_t* data, size_t bytes);
+void mph_free(Mph* mph);
+
+// Busca una clave. Devuelve 1 y su valor si la huella coincide; la clave
+// puede no estar en el conjunto, así que hay que verificarla.
+int mph_lookup(const Mph* mph, uint64_t hash, uint32_t* value);
+
+#endif
@@ -8,10 +8,43 @@
 #include <unistd.h>    // Para fork, exec, exit
 #include <stdlib.h>    // Para exit, EXIT_FAILURE
 #include <signal.h>    // Para kill, SIGTERM
+#include <fcntl.h>     // Para open
 #include "utils.h"
+#include "segments.h"
 
 #define INDEX_FILE "dist/jobs.idx"
 #define DATA_FILE "data.csv"
+#define COMPACT_LOG_FILE "dist/compact.log"
+
+// Lanza './dist/index -c' en segundo plano. Con un doble fork el proceso
+// queda huérfano y lo recoge init, así no hace falta esperarlo. La salida va
+// a COMPACT_LOG_FILE para no mezclarse con la interfaz.
+void start_background_compaction(void)
+{
+    printf("Compactando segmentos del índice en segundo plano (registro en %s)\n", COMPACT_LOG_FILE);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error al crear el proceso de compactación");
+        return;
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    if (fork() == 0) {
+        int log_fd = open(COMPACT_LOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log_fd >= 0) {
+            dup2(log_fd, STDOUT_FILENO);
+            dup2(log_fd, STDERR_FILENO);
+            close(log_fd);
+        }
+        execl("./dist/index", "./dist/index", "-c", (char *)NULL);
+        perror("Error al ejecutar la compactación");
+    }
+    _exit(0);
+}
 
 int main()
 {
@@ -47,6 +80,25 @@ int main()
     else
     {
         printf("Índice encontrado. Para regenerarlo, borre el archivo %s\n", INDEX_FILE);
+
+        // Indexar solo las filas añadidas a data.csv desde la última vez
+        if (!file_exists("dist/index")) {
+            fprintf(stderr, "Error: El ejecutable 'dist/index' no existe. Ejecute 'make' primero.\n");
+            return 1;
+        }
+
+        if (execute_command("./dist/index -u") != 0)
+        {
+            fprintf(stderr, "Error al actualizar el índice\n");
+            return 1;
+        }
+
+        // Si se han acumulado muchos segmentos delta, fusionarlos sin esperar
+        SegmentManifest manifest;
+        if (segments_read(&manifest) == 0 && manifest.n_segments >= SEGMENTS_COMPACT_THRESHOLD)
+        {
+            start_background_compaction();
+        }
     }
 
     // Crear pipes si no existen
@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pairs.h"
+
+void pairs_file_names(const char* skl_name, char* pairs_skl, char* pairs_idx, size_t size) {
+    size_t len = strlen(skl_name);
+    if (len >= 4 && strcmp(skl_name + len - 4, ".skl") == 0) len -= 4;
+    snprintf(pairs_skl, size, "%.*s.pairs.skl", (int)len, skl_name);
+    snprintf(pairs_idx, size, "%.*s.pairs.idx", (int)len, skl_name);
+}
+
+int pairs_key(const char* a, const char* b, char* out, size_t size) {
+    if (strcmp(a, b) > 0) {
+        const char* swap = a;
+        a = b;
+        b = swap;
+    }
+    int len = snprintf(out, size, "%s%c%s", a, PAIRS_SEPARATOR, b);
+    return len >= 0 && (size_t)len < size;
+}
@@ -0,0 +1,44 @@
+#ifndef PAIRS_H
+#define PAIRS_H
+
+#include <stddef.h>
+
+// Intersecciones materializadas de parejas de skills de la base
+// (dist/jobs.pairs.skl y dist/jobs.pairs.idx). Es un índice del formato 4
+// con las mismas filas que la base pero sin tabla de filas propia: cada
+// "skill" es la clave de una pareja (los dos nombres en orden, separados por
+// PAIRS_SEPARATOR) y su lista, la intersección de las listas de las dos en
+// la base. Un AND que contiene la pareja lee esa lista en lugar de las dos.
+//
+// Las parejas salen de una lista dada (index -p, una "skill;skill" por
+// línea) y de las que más filas comparten entre las PAIRS_CANDIDATE_SKILLS
+// skills con más ofertas, contadas con jobs.fwd. Se eligen primero las de la
+// lista y después de más a menos filas compartidas, mientras quepan en el
+// presupuesto de disco contando PAIRS_VALUE_BYTES por valor (lo máximo que
+// ocupa un row ID en los bloques).
+//
+// Solo cubre la base: el motor usa una pareja si ninguna de sus dos skills
+// tiene filas en los segmentos delta.
+
+#define PAIRS_SEPARATOR '\x1f'
+#define PAIRS_CANDIDATE_SKILLS 128
+#define PAIRS_DEFAULT_COUNT 64
+#define PAIRS_DEFAULT_BUDGET_MB 64
+#define PAIRS_VALUE_BYTES 4
+
+// Nombres del índice de parejas a partir del jobs.skl de la base
+void pairs_file_names(const char* skl_name, char* pairs_skl, char* pairs_idx, size_t size);
+
+// Clave de la pareja (a, b) en 'out', la misma que la de (b, a). Devuelve 0
+// si no cabe en 'size'.
+int pairs_key(const char* a, const char* b, char* out, size_t size);
+
+// Genera el índice de parejas de la base 'skl_name'/'idx_name' (como .tmp,
+// renombrado al terminar): las de 'list_file' (NULL si ninguna) y hasta
+// 'max_pairs' derivadas de su .fwd, en 'budget' bytes (0 = sin límite). Sin
+// ninguna pareja que materializar borra las de una base anterior. Está en
+// pairs_writer.c, que solo enlaza el indexador. Devuelve 0 si va bien.
+int pairs_build(const char* skl_name, const char* idx_name, const char* list_file, size_t max_pairs,
+                size_t budget);
+
+#endif
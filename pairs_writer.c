@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "pairs.h"
+#include "forward.h"
+#include "index_reader.h"
+#include "index_writer.h"
+
+// Pareja elegida: su clave y las entradas de sus dos skills en la base
+typedef struct {
+    char* key;
+    SkillEntry first;
+    SkillEntry second;
+} Pair;
+
+typedef struct {
+    FILE* skl;
+    FILE* idx;
+    SkillDirInfo info;
+    Pair* pairs;
+    size_t n_pairs;
+    size_t capacity;
+    size_t budget;      // Bytes (0 = sin límite)
+    size_t used;
+} PairsBuild;
+
+// Candidata a pareja derivada: dos de las skills más frecuentes
+typedef struct {
+    uint32_t number;
+    size_t count;
+    SkillEntry entry;
+    char* name;
+} Candidate;
+
+typedef struct {
+    int first;          // Posiciones en la tabla de candidatas
+    int second;
+    size_t count;
+} Shared;
+
+static long* load_list(PairsBuild* build, const SkillEntry* entry, size_t* n) {
+    long* list = malloc((entry->count + 1) * sizeof(long));
+    if (list && !load_postings(build->idx, &build->info, entry, LONG_MIN, LONG_MAX, list, n)) {
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+// a ∩ b en 'out' (con out NULL solo se cuenta)
+static size_t intersect_lists(const long* a, size_t n, const long* b, size_t m, long* out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < n && j < m) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            if (out) out[k] = a[i];
+            k++;
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+// Añade la pareja si no está ya y cabe en el presupuesto. Devuelve 1 si la
+// añade, 0 si no y -1 si no hay memoria.
+static int choose_pair(PairsBuild* build, const char* a, const SkillEntry* first, const char* b,
+                       const SkillEntry* second, size_t count) {
+    size_t bytes = count * PAIRS_VALUE_BYTES;
+    if (count == 0 || (build->budget > 0 && build->used + bytes > build->budget)) return 0;
+    size_t size = strlen(a) + strlen(b) + 2;
+    char* key = malloc(size);
+    if (!key) return -1;
+    pairs_key(a, b, key, size);
+    for (size_t i = 0; i < build->n_pairs; i++) {
+        if (strcmp(build->pairs[i].key, key) == 0) {
+            free(key);
+            return 0;
+        }
+    }
+    if (build->n_pairs == build->capacity) {
+        size_t capacity = build->capacity ? build->capacity * 2 : 64;
+        Pair* bigger = realloc(build->pairs, capacity * sizeof(Pair));
+        if (!bigger) {
+            free(key);
+            return -1;
+        }
+        build->pairs = bigger;
+        build->capacity = capacity;
+    }
+    // La clave va en orden: las entradas también
+    int swapped = strcmp(a, b) > 0;
+    Pair* pair = &build->pairs[build->n_pairs++];
+    *pair = (Pair){ key, *first, *second };
+    if (swapped) {
+        pair->first = *second;
+        pair->second = *first;
+    }
+    build->used += bytes;
+    return 1;
+}
+
+// Quita espacios y comillas de los extremos de un nombre de la lista
+static char* trim_name(char* name) {
+    while (*name == ' ' || *name == '\t') name++;
+    size_t len = strlen(name);
+    while (len > 0 && (name[len - 1] == ' ' || name[len - 1] == '\t' || name[len - 1] == '\r')) {
+        name[--len] = '\0';
+    }
+    if (len >= 2 && name[0] == '"' && name[len - 1] == '"') {
+        name[len - 1] = '\0';
+        name++;
+    }
+    return name;
+}
+
+// Parejas de la lista, una "skill;skill" por línea. Las que no están en la
+// base se avisan y se saltan.
+static int read_pair_list(PairsBuild* build, const char* list_file, size_t* n_listed) {
+    FILE* file = fopen(list_file, "r");
+    if (!file) {
+        perror("Error al abrir la lista de parejas");
+        return 1;
+    }
+    char* line = NULL;
+    size_t capacity = 0, number = 0;
+    int failed = 0;
+    while (!failed && getline(&line, &capacity, file) > 0) {
+        number++;
+        line[strcspn(line, "\n")] = '\0';
+        char* separator = strchr(line, ';');
+        if (!separator) {
+            if (*trim_name(line) != '\0') {
+                fprintf(stderr, "Aviso: la línea %zu de '%s' no es una pareja 'skill;skill'\n", number, list_file);
+            }
+            continue;
+        }
+        *separator = '\0';
+        char* a = trim_name(line);
+        char* b = trim_name(separator + 1);
+        SkillEntry first, second;
+        if (strcmp(a, b) == 0 || !find_skill_metadata(build->skl, &build->info, a, &first) ||
+            !find_skill_metadata(build->skl, &build->info, b, &second)) {
+            fprintf(stderr, "Aviso: '%s;%s' no es una pareja de skills de la base\n", a, b);
+            continue;
+        }
+        size_t n, m;
+        long* list_a = load_list(build, &first, &n);
+        long* list_b = list_a ? load_list(build, &second, &m) : NULL;
+        failed = !list_b;
+        size_t count = failed ? 0 : intersect_lists(list_a, n, list_b, m, NULL);
+        int added = failed ? 0 : choose_pair(build, a, &first, b, &second, count);
+        if (added < 0) failed = 1;
+        if (added > 0) (*n_listed)++;
+        free(list_a);
+        free(list_b);
+    }
+    free(line);
+    fclose(file);
+    return failed;
+}
+
+static int compare_shared(const void* a, const void* b) {
+    const Shared* x = a;
+    const Shared* y = b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    if (x->first != y->first) return x->first - y->first;
+    return x->second - y->second;
+}
+
+static int compare_pair_keys(const void* a, const void* b) {
+    return strcmp(((const Pair*)a)->key, ((const Pair*)b)->key);
+}
+
+// Parejas de las PAIRS_CANDIDATE_SKILLS skills con más ofertas que más filas
+// comparten. Las filas de cada una se cuentan con el .fwd, que da a la vez lo
+// que comparte con todas las demás. Sin .fwd no se deriva ninguna.
+static int derive_pairs(PairsBuild* build, const char* skl_name, size_t max_pairs, size_t* n_derived) {
+    char fwd_name[256];
+    forward_file_name(skl_name, fwd_name, sizeof(fwd_name));
+    ForwardIndex fwd;
+    if (forward_open(&fwd, fwd_name, 0) != 0 || fwd.header.n_skills != build->info.total_skills ||
+        fwd.header.first_row != build->info.first_row || fwd.header.n_rows != build->info.n_rows) {
+        fprintf(stderr, "Aviso: sin '%s' no se derivan parejas frecuentes\n", fwd_name);
+        if (fwd.fd >= 0) forward_close(&fwd);
+        return 0;
+    }
+
+    // 1. Las skills con más ofertas (a igualdad, la de menor número), con una
+    // pasada por el directorio
+    FILE* scan = fopen(skl_name, "rb");
+    SkillDirInfo info = {0};
+    Candidate candidates[PAIRS_CANDIDATE_SKILLS];
+    int n_candidates = 0;
+    int failed = !scan || !read_skill_dir_header(scan, &info);
+    char* name = NULL;
+    size_t capacity = 0, len;
+    SkillEntry entry;
+    for (uint32_t number = 0; !failed && read_skill_entry(scan, &info, &name, &capacity, &len, &entry); number++) {
+        if (n_candidates == PAIRS_CANDIDATE_SKILLS) {
+            if (entry.count <= candidates[n_candidates - 1].count) continue;
+            free(candidates[--n_candidates].name);
+        }
+        int i = n_candidates++;
+        while (i > 0 && candidates[i - 1].count < entry.count) {
+            candidates[i] = candidates[i - 1];
+            i--;
+        }
+        candidates[i] = (Candidate){ number, entry.count, entry, strdup(name) };
+        failed = !candidates[i].name;
+    }
+    failed = failed || info.entries_read != info.total_skills;
+
+    // 2. Filas compartidas de cada pareja de candidatas
+    uint32_t* counts = failed ? NULL : malloc((fwd.header.n_skills + 1) * sizeof(uint32_t));
+    size_t max_shared = (size_t)n_candidates * (size_t)n_candidates / 2 + 1;
+    Shared* shared = failed ? NULL : malloc(max_shared * sizeof(Shared));
+    size_t n_shared = 0;
+    failed = failed || !counts || !shared;
+    for (int i = 0; !failed && i < n_candidates; i++) {
+        size_t n;
+        long* rows = load_list(build, &candidates[i].entry, &n);
+        memset(counts, 0, (fwd.header.n_skills + 1) * sizeof(uint32_t));
+        failed = !rows || forward_count(&fwd, rows, n, counts) != 0;
+        for (int j = i + 1; !failed && j < n_candidates; j++) {
+            uint32_t count = counts[candidates[j].number];
+            if (count > 0) shared[n_shared++] = (Shared){ i, j, count };
+        }
+        free(rows);
+    }
+
+    // 3. De más a menos filas compartidas, las que quepan
+    if (!failed) qsort(shared, n_shared, sizeof(Shared), compare_shared);
+    for (size_t i = 0; !failed && i < n_shared && *n_derived < max_pairs; i++) {
+        const Candidate* a = &candidates[shared[i].first];
+        const Candidate* b = &candidates[shared[i].second];
+        int added = choose_pair(build, a->name, &a->entry, b->name, &b->entry, shared[i].count);
+        if (added < 0) failed = 1;
+        if (added > 0) (*n_derived)++;
+    }
+
+    if (failed) fprintf(stderr, "Error al contar las parejas de '%s'\n", skl_name);
+    for (int i = 0; i < n_candidates; i++) free(candidates[i].name);
+    free(name);
+    free(counts);
+    free(shared);
+    if (scan) fclose(scan);
+    free_skill_dir_info(&info);
+    forward_close(&fwd);
+    return failed;
+}
+
+// Escribe las listas de las parejas elegidas, en el orden de sus claves
+static int write_pairs(PairsBuild* build, const char* skl_name, uint64_t* bytes) {
+    char pairs_skl[256], pairs_idx[256];
+    pairs_file_names(skl_name, pairs_skl, pairs_idx, sizeof(pairs_skl));
+    qsort(build->pairs, build->n_pairs, sizeof(Pair), compare_pair_keys);
+
+    IndexWriter writer;
+    if (index_writer_open(&writer, pairs_skl, pairs_idx, SKL_VERSION_ROWS, build->info.zstd_min_postings > 0) != 0) {
+        return 1;
+    }
+    index_writer_set_range(&writer, build->info.data_start, build->info.data_end);
+    index_writer_share_rows(&writer, build->info.first_row, build->info.n_rows);
+    int failed = 0;
+    for (size_t i = 0; !failed && i < build->n_pairs; i++) {
+        const Pair* pair = &build->pairs[i];
+        size_t n, m;
+        long* list_a = load_list(build, &pair->first, &n);
+        long* list_b = list_a ? load_list(build, &pair->second, &m) : NULL;
+        long* both = list_b ? malloc(((n < m ? n : m) + 1) * sizeof(long)) : NULL;
+        failed = !both;
+        if (!failed) {
+            size_t k = intersect_lists(list_a, n, list_b, m, both);
+            failed = index_writer_begin_skill(&writer, pair->key, strlen(pair->key), k) != 0 ||
+                     index_writer_append(&writer, both, k) != 0 || index_writer_end_skill(&writer) != 0;
+        }
+        free(list_a);
+        free(list_b);
+        free(both);
+    }
+    if (failed) {
+        index_writer_abort(&writer);
+        return 1;
+    }
+    *bytes = (uint64_t)ftell(writer.idx);
+    return index_writer_close(&writer);
+}
+
+int pairs_build(const char* skl_name, const char* idx_name, const char* list_file, size_t max_pairs,
+                size_t budget) {
+    PairsBuild build = {0};
+    build.budget = budget;
+    build.skl = fopen(skl_name, "rb");
+    build.idx = fopen(idx_name, "rb");
+    if (!build.skl || !build.idx || !read_skill_dir_header(build.skl, &build.info) || !build.info.row_ids) {
+        fprintf(stderr, "Error al abrir el segmento '%s'\n", skl_name);
+        if (build.skl) fclose(build.skl);
+        if (build.idx) fclose(build.idx);
+        free_skill_dir_info(&build.info);
+        return 1;
+    }
+
+    size_t n_listed = 0, n_derived = 0;
+    uint64_t bytes = 0;
+    int failed = list_file && read_pair_list(&build, list_file, &n_listed) != 0;
+    if (!failed && max_pairs > 0) failed = derive_pairs(&build, skl_name, max_pairs, &n_derived) != 0;
+    if (!failed && build.n_pairs == 0) {
+        char pairs_skl[256], pairs_idx[256];
+        pairs_file_names(skl_name, pairs_skl, pairs_idx, sizeof(pairs_skl));
+        remove(pairs_skl);
+        remove(pairs_idx);
+        printf("Ninguna pareja de skills que materializar.\n");
+    } else if (!failed) {
+        failed = write_pairs(&build, skl_name, &bytes) != 0;
+        if (!failed) {
+            printf("Parejas materializadas: %zu de la lista y %zu frecuentes, %.1f MB de listas.\n", n_listed,
+                   n_derived, (double)bytes / (1024 * 1024));
+        }
+    }
+
+    for (size_t i = 0; i < build.n_pairs; i++) free(build.pairs[i].key);
+    free(build.pairs);
+    fclose(build.skl);
+    fclose(build.idx);
+    free_skill_dir_info(&build.info);
+    return failed;
+}
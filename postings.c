@@ -0,0 +1,189 @@
+#include <string.h>
+#include "postings.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define LANES 4
+#define VALUES_PER_LANE (POSTING_BLOCK_SIZE / LANES)
+
+static unsigned bits_needed(uint32_t value) {
+    return value == 0 ? 0 : 32 - __builtin_clz(value);
+}
+
+size_t postings_encode_block(const long* values, size_t n, long previous, uint8_t* out) {
+    if (n < POSTING_BLOCK_SIZE) {
+        // Bloque final incompleto: deltas en varint
+        size_t bytes = 0;
+        for (size_t i = 0; i < n; i++) {
+            unsigned long delta = (unsigned long)(values[i] - previous);
+            while (delta >= 0x80) {
+                out[bytes++] = (uint8_t)(delta | 0x80);
+                delta >>= 7;
+            }
+            out[bytes++] = (uint8_t)delta;
+            previous = values[i];
+        }
+        return bytes;
+    }
+
+    uint32_t deltas[POSTING_BLOCK_SIZE] = {0};
+    uint32_t max_delta = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned long delta = (unsigned long)(values[i] - previous);
+        if (delta > UINT32_MAX) {
+            // Hueco demasiado grande para 32 bits: bloque sin comprimir
+            out[0] = POSTING_RAW_BLOCK;
+            memcpy(out + 1, values, n * sizeof(long));
+            return 1 + n * sizeof(long);
+        }
+        deltas[i] = (uint32_t)delta;
+        if (deltas[i] > max_delta) max_delta = deltas[i];
+        previous = values[i];
+    }
+
+    unsigned b = bits_needed(max_delta);
+    out[0] = (uint8_t)b;
+    uint32_t words[POSTING_BLOCK_SIZE] = {0};
+    for (unsigned lane = 0; lane < LANES; lane++) {
+        unsigned bit = 0;
+        for (unsigned i = 0; i < VALUES_PER_LANE; i++, bit += b) {
+            if (b == 0) break;
+            uint32_t value = deltas[i * LANES + lane];
+            unsigned word = bit / 32, shift = bit % 32;
+            words[word * LANES + lane] |= value << shift;
+            if (shift + b > 32) words[(word + 1) * LANES + lane] |= value >> (32 - shift);
+        }
+    }
+    memcpy(out + 1, words, (size_t)b * LANES * sizeof(uint32_t));
+    return 1 + (size_t)b * LANES * sizeof(uint32_t);
+}
+
+#ifndef __SSE2__
+// Desempaqueta los 128 deltas de un bloque de b bits (1 <= b <= 32).
+static void unpack_scalar(const uint8_t* in, unsigned b, uint32_t* deltas) {
+    uint32_t words[POSTING_BLOCK_SIZE];
+    memcpy(words, in, (size_t)b * LANES * sizeof(uint32_t));
+    uint32_t mask = b == 32 ? UINT32_MAX : (1u << b) - 1;
+    for (unsigned lane = 0; lane < LANES; lane++) {
+        unsigned bit = 0;
+        for (unsigned i = 0; i < VALUES_PER_LANE; i++, bit += b) {
+            unsigned word = bit / 32, shift = bit % 32;
+            uint32_t value = words[word * LANES + lane] >> shift;
+            if (shift + b > 32) value |= words[(word + 1) * LANES + lane] << (32 - shift);
+            deltas[i * LANES + lane] = value & mask;
+        }
+    }
+}
+#else
+// Versión SIMD: cada iteración extrae el mismo campo de los 4 carriles, que
+// son 4 deltas consecutivos, y los guarda con una sola escritura.
+static void unpack_sse2(const uint8_t* in, unsigned b, uint32_t* deltas) {
+    const __m128i* words = (const __m128i*)in;
+    const __m128i mask = _mm_set1_epi32(b == 32 ? -1 : (int)((1u << b) - 1));
+    __m128i current = _mm_loadu_si128(words);
+    unsigned consumed = 0, shift = 0;
+    for (unsigned i = 0; i < VALUES_PER_LANE; i++) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128((int)shift));
+        shift += b;
+        if (shift >= 32) {
+            consumed++;
+            if (consumed < b) {
+                current = _mm_loadu_si128(words + consumed);
+                if (shift > 32) {
+                    value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128((int)(32 - (shift - b)))));
+                }
+            }
+            shift -= 32;
+        }
+        _mm_storeu_si128((__m128i*)(deltas + i * LANES), _mm_and_si128(value, mask));
+    }
+}
+#endif
+
+const char* postings_impl_name(void) {
+#ifdef __SSE2__
+    return "SSE2";
+#else
+    return "escalar";
+#endif
+}
+
+int postings_decode(const uint8_t* data, size_t bytes, size_t count, long* out) {
+    return postings_decode_from(data, bytes, count, 0, out);
+}
+
+int postings_decode_from(const uint8_t* data, size_t bytes, size_t count, long previous, long* out) {
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+    const uint8_t* p = data;
+    const uint8_t* end = data + bytes;
+
+    for (size_t done = 0; done < count; done += POSTING_BLOCK_SIZE) {
+        size_t n = count - done < POSTING_BLOCK_SIZE ? count - done : POSTING_BLOCK_SIZE;
+        if (n < POSTING_BLOCK_SIZE) {
+            for (size_t i = 0; i < n; i++) {
+                unsigned long delta = 0;
+                unsigned shift = 0;
+                do {
+                    if (p >= end || shift > 63) return -1;
+                    delta |= (unsigned long)(*p & 0x7F) << shift;
+                    shift += 7;
+                } while (*p++ & 0x80);
+                previous += (long)delta;
+                out[done + i] = previous;
+            }
+            break;
+        }
+        if (p >= end) return -1;
+        unsigned b = *p++;
+
+        if (b == POSTING_RAW_BLOCK) {
+            if ((size_t)(end - p) < n * sizeof(long)) return -1;
+            memcpy(out + done, p, n * sizeof(long));
+            p += n * sizeof(long);
+            previous = out[done + n - 1];
+            continue;
+        }
+        if (b > 32) return -1;
+        size_t packed = (size_t)b * LANES * sizeof(uint32_t);
+        if ((size_t)(end - p) < packed) return -1;
+
+        if (b == 0) {
+            memset(deltas, 0, sizeof(deltas));
+        } else {
+#ifdef __SSE2__
+            unpack_sse2(p, b, deltas);
+#else
+            unpack_scalar(p, b, deltas);
+#endif
+        }
+        p += packed;
+
+        // Suma prefija: de deltas a offsets absolutos
+        for (size_t i = 0; i < n; i++) {
+            previous += deltas[i];
+            out[done + i] = previous;
+        }
+    }
+    return p == end ? 0 : -1;
+}
+
+size_t postings_frame_count(size_t count) {
+    return (count + POSTING_FRAME_VALUES - 1) / POSTING_FRAME_VALUES;
+}
+
+size_t postings_skip_count(size_t count) {
+    return (count + POSTING_SKIP_VALUES - 1) / POSTING_SKIP_VALUES;
+}
+
+int postings_skip_fits(size_t count) {
+    return count / POSTING_BLOCK_SIZE < UINT32_MAX / POSTING_MAX_BLOCK_BYTES;
+}
+
+int postings_decode_frame(ZSTD_DCtx* dctx, const uint8_t* frame, size_t frame_bytes, size_t count,
+                          long previous, uint8_t* scratch, long* out) {
+    size_t raw = ZSTD_decompressDCtx(dctx, scratch, POSTING_FRAME_MAX_BYTES, frame, frame_bytes);
+    if (ZSTD_isError(raw)) return -1;
+    return postings_decode_from(scratch, raw, count, previous, out);
+}
@@ -0,0 +1,94 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zstd.h>
+
+// Codificación de listas de offsets ordenadas en bloques de 128 valores.
+//
+// Cada bloque guarda las diferencias con el valor anterior (el primero, con
+// el último del bloque previo) empaquetadas con el mínimo número de bits b:
+//
+//   [b: 1 byte][16 * b bytes]
+//
+// Los 128 deltas se reparten en 4 carriles (delta i -> carril i % 4) y cada
+// carril se empaqueta en b palabras de 32 bits intercaladas, de modo que una
+// sola instrucción SIMD desempaqueta 4 deltas consecutivos. Si algún delta no
+// cabe en 32 bits el bloque se guarda sin comprimir: [POSTING_RAW_BLOCK][128 * 8 bytes].
+//
+// El último bloque, si tiene menos de 128 offsets, se guarda como deltas en
+// varint (7 bits por byte). La mayoría de skills tienen listas muy cortas y
+// así no pagan el relleno de un bloque completo.
+//
+// En el modo zstd (versión 3 del índice) las listas largas se agrupan en
+// frames de POSTING_FRAME_BLOCKS bloques, cada uno comprimido con zstd por
+// separado y precedidos de una tabla:
+//
+//   [n_frames: uint32][n_frames * PostingFrame][frame 0][frame 1]...
+//
+// El primer bloque de cada frame toma como base el 'last' del frame anterior,
+// así que cualquier frame se puede descomprimir sin leer los demás.
+//
+// En la versión 4, las listas de al menos POSTING_SKIP_MIN_VALUES valores que
+// no van en frames llevan delante punteros de salto: el último valor de cada
+// grupo de POSTING_SKIP_BLOCKS bloques y dónde acaba el grupo:
+//
+//   [n_skips: uint32][n_skips * PostingSkip][bloques...]
+//
+// Igual que con los frames, un grupo se decodifica por separado partiendo
+// del 'last' del grupo anterior. Al intersecar una lista corta con una larga
+// el motor solo lee los grupos donde caen los valores de la corta.
+
+#define POSTING_BLOCK_SIZE 128
+#define POSTING_RAW_BLOCK 0xFF
+#define POSTING_MAX_BLOCK_BYTES (1 + POSTING_BLOCK_SIZE * 10)
+#define POSTING_FRAME_BLOCKS 64
+#define POSTING_FRAME_VALUES (POSTING_FRAME_BLOCKS * POSTING_BLOCK_SIZE)
+#define POSTING_FRAME_MAX_BYTES (POSTING_FRAME_BLOCKS * POSTING_MAX_BLOCK_BYTES)
+#define POSTING_ZSTD_MIN_VALUES 4096 // Por debajo no compensa la tabla de frames
+
+#define POSTING_SKIP_BLOCKS 4
+#define POSTING_SKIP_VALUES (POSTING_SKIP_BLOCKS * POSTING_BLOCK_SIZE)
+#define POSTING_SKIP_MIN_VALUES 1024
+
+typedef struct {
+    uint64_t last;  // Último offset del frame
+    uint64_t end;   // Fin del frame comprimido, relativo al primer frame
+} PostingFrame;
+
+// Los row IDs de la versión 4 caben en 32 bits, así que la tabla de saltos
+// ocupa la mitad que la de frames.
+typedef struct {
+    uint32_t last;  // Último row ID del grupo
+    uint32_t end;   // Fin del grupo, relativo al primer bloque
+} PostingSkip;
+
+// Codifica n (<= 128) offsets. 'previous' es el último offset del bloque
+// anterior (0 para el primero). Devuelve los bytes escritos en out.
+size_t postings_encode_block(const long* values, size_t n, long previous, uint8_t* out);
+
+// Decodifica una lista completa de 'count' offsets. Devuelve 0 si todo va
+// bien y -1 si los datos no cuadran con 'bytes'.
+int postings_decode(const uint8_t* data, size_t bytes, size_t count, long* out);
+
+// Igual que postings_decode, pero partiendo del offset 'previous' en lugar
+// de 0 (para decodificar un frame suelto).
+int postings_decode_from(const uint8_t* data, size_t bytes, size_t count, long previous, long* out);
+
+// Número de frames de una lista de 'count' offsets en modo zstd.
+size_t postings_frame_count(size_t count);
+// Número de grupos de la tabla de saltos de una lista de 'count' row IDs, y
+// si la lista puede llevarla (el fin de cada grupo debe caber en 32 bits).
+size_t postings_skip_count(size_t count);
+int postings_skip_fits(size_t count);
+
+// Descomprime y decodifica un frame de 'count' offsets. 'scratch' debe tener
+// al menos POSTING_FRAME_MAX_BYTES. Devuelve 0 si todo va bien.
+int postings_decode_frame(ZSTD_DCtx* dctx, const uint8_t* frame, size_t frame_bytes, size_t count,
+                          long previous, uint8_t* scratch, long* out);
+
+// Implementación de desempaquetado en uso ("SSE2" o "escalar").
+const char* postings_impl_name(void);
+
+#endif
@@ -0,0 +1,38 @@
+#include "protocol.h"
+
+void proto_put_u32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+void proto_put_u64(uint8_t* out, uint64_t value) {
+    proto_put_u32(out, (uint32_t)(value >> 32));
+    proto_put_u32(out + 4, (uint32_t)value);
+}
+
+uint32_t proto_get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+uint64_t proto_get_u64(const uint8_t* in) {
+    return (uint64_t)proto_get_u32(in) << 32 | proto_get_u32(in + 4);
+}
+
+void proto_write_header(uint8_t* out, const ProtoHeader* header) {
+    out[0] = header->version;
+    out[1] = header->type;
+    out[2] = (uint8_t)(header->flags >> 8);
+    out[3] = (uint8_t)header->flags;
+    proto_put_u32(out + 4, header->id);
+    proto_put_u32(out + 8, header->length);
+}
+
+void proto_read_header(const uint8_t* in, ProtoHeader* header) {
+    header->version = in[0];
+    header->type = in[1];
+    header->flags = (uint16_t)(in[2] << 8 | in[3]);
+    header->id = proto_get_u32(in + 4);
+    header->length = proto_get_u32(in + 8);
+}
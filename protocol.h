@@ -0,0 +1,87 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Protocolo binario entre el motor y sus clientes (puerto PROTO_PORT).
+//
+// Cada petición y cada respuesta es un marco: una cabecera de
+// PROTO_HEADER_SIZE bytes y 'length' bytes de carga.
+//
+//   [versión u8][tipo u8][flags u16][id u32][length u32][carga...]
+//
+// Los enteros van en orden de red (big endian). El id lo elige el cliente y
+// la respuesta lo repite, así que un cliente puede enviar muchas peticiones
+// seguidas por la misma conexión sin esperar: el motor las resuelve a la vez
+// y responde a cada una cuando termina, no en el orden de llegada. La
+// respuesta lleva el tipo de la petición con PROTO_REPLY, o PROTO_ERROR y el
+// motivo como carga.
+//
+// El puerto de texto (5050) sigue atendiendo el protocolo anterior: saludo
+// fijo y una petición por lectura, con la respuesta sin marco.
+
+#define PROTO_PORT 5051
+#define PROTO_VERSION 1
+#define PROTO_HEADER_SIZE 12
+// Carga máxima de una petición; un marco mayor cierra la conexión
+#define PROTO_MAX_PAYLOAD (1024 * 1024)
+
+// Tipos de marco
+//
+// PROTO_QUERY: la carga es una petición del protocolo de texto (consulta,
+// PAGE, COUNT, FACET, SUGGEST o STATS) y la respuesta, su respuesta de texto.
+//
+// PROTO_IDS: [límite u32][cursor u64][consulta]. Responde
+// [total u64][siguiente cursor u64][n u32][clase u32] y n valores u64: los
+// primeros resultados >= cursor (hasta 'límite', como mucho PROTO_MAX_IDS),
+// sin leer filas. La clase dice si son row IDs (formato 4) u offsets de
+// data.csv; el siguiente cursor es PROTO_NO_CURSOR en la última página.
+//
+// PROTO_BATCH: muchas consultas de una vez, [modo u32][límite u32][n u32] y
+// n consultas [longitud u32][consulta]. El motor lee la lista de cada skill
+// distinta una sola vez para todo el lote. Responde [n u32][clase u32] y, por
+// consulta y en orden, [estado u32]: con PROTO_BATCH_OK, [total u64][k u32]
+// y k valores u64 (ninguno en PROTO_BATCH_COUNT; los primeros hasta
+// 'límite' en PROTO_BATCH_IDS); con PROTO_BATCH_INVALID, [longitud u32] y
+// el motivo. En PROTO_BATCH_IDS, n * límite no puede pasar de
+// PROTO_MAX_BATCH_VALUES.
+#define PROTO_QUERY 1
+#define PROTO_IDS 2
+#define PROTO_BATCH 3
+#define PROTO_ERROR 0x7F
+#define PROTO_REPLY 0x80
+
+#define PROTO_IDS_REQUEST_SIZE 12
+#define PROTO_IDS_REPLY_SIZE 24
+#define PROTO_MAX_IDS 65536
+#define PROTO_NO_CURSOR UINT64_MAX
+#define PROTO_OFFSETS 0
+#define PROTO_ROW_IDS 1
+
+#define PROTO_BATCH_REQUEST_SIZE 12
+#define PROTO_BATCH_COUNT 0
+#define PROTO_BATCH_IDS 1
+#define PROTO_BATCH_OK 0
+#define PROTO_BATCH_INVALID 1
+#define PROTO_MAX_BATCH 65536
+#define PROTO_MAX_BATCH_VALUES (4 * 1024 * 1024)
+
+typedef struct {
+    uint8_t version;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t id;
+    uint32_t length;
+} ProtoHeader;
+
+void proto_put_u32(uint8_t* out, uint32_t value);
+void proto_put_u64(uint8_t* out, uint64_t value);
+uint32_t proto_get_u32(const uint8_t* in);
+uint64_t proto_get_u64(const uint8_t* in);
+
+// Cabecera de marco en PROTO_HEADER_SIZE bytes, y al revés
+void proto_write_header(uint8_t* out, const ProtoHeader* header);
+void proto_read_header(const uint8_t* in, ProtoHeader* header);
+
+#endif
@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "query.h"
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_TERM,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_NOT,
+    TOKEN_SEMICOLON,
+    TOKEN_OPEN,
+    TOKEN_CLOSE
+} TokenType;
+
+typedef struct {
+    const char* text;   // Lo que queda por leer
+    TokenType token;    // Token actual
+    char* term;         // TOKEN_TERM: nombre de la skill, hasta que lo use un nodo
+    int quoted;         // TOKEN_TERM: el nombre iba entre comillas
+    int n_terms;
+    int failed;
+    char* error;
+    size_t error_size;
+} Parser;
+
+// Guarda el primer error; los siguientes son consecuencia de él
+static void fail(Parser* parser, const char* format, ...) {
+    if (parser->failed) return;
+    parser->failed = 1;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(parser->error, parser->error_size, format, args);
+    va_end(args);
+}
+
+// Operador que empieza en 'p' como palabra suelta, o TOKEN_TERM si no hay
+static TokenType keyword_at(const char* p, size_t* len) {
+    static const struct { const char* word; TokenType token; } keywords[] = {
+        { "AND", TOKEN_AND }, { "OR", TOKEN_OR }, { "NOT", TOKEN_NOT }
+    };
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        size_t n = strlen(keywords[i].word);
+        char next = p[n];
+        if (strncmp(p, keywords[i].word, n) == 0 &&
+            (next == '\0' || isspace((unsigned char)next) || strchr("();\"", next))) {
+            *len = n;
+            return keywords[i].token;
+        }
+    }
+    return TOKEN_TERM;
+}
+
+// Lee el siguiente token
+static void advance(Parser* parser) {
+    free(parser->term);
+    parser->term = NULL;
+    parser->quoted = 0;
+    const char* p = parser->text;
+    while (isspace((unsigned char)*p)) p++;
+
+    size_t len;
+    if (*p == '\0') {
+        parser->token = TOKEN_END;
+    } else if (*p == ';' || *p == '(' || *p == ')') {
+        parser->token = *p == ';' ? TOKEN_SEMICOLON : *p == '(' ? TOKEN_OPEN : TOKEN_CLOSE;
+        p++;
+    } else if (*p == '"') {
+        // Nombre entre comillas: se toma tal cual
+        const char* end = strchr(p + 1, '"');
+        if (!end) {
+            fail(parser, "comillas sin cerrar");
+            parser->token = TOKEN_END;
+        } else {
+            parser->token = TOKEN_TERM;
+            parser->term = strndup(p + 1, (size_t)(end - p - 1));
+            parser->quoted = 1;
+            p = end + 1;
+        }
+    } else if ((parser->token = keyword_at(p, &len)) != TOKEN_TERM) {
+        p += len;
+    } else {
+        // Nombre sin comillas: palabras hasta un operador, ';', comillas o un
+        // ')' que no cierre un '(' del propio nombre
+        const char* start = p;
+        const char* end = p;
+        int depth = 0;
+        while (*p && *p != ';' && *p != '"') {
+            if (isspace((unsigned char)*p)) {
+                while (isspace((unsigned char)*p)) p++;
+                if (keyword_at(p, &len) != TOKEN_TERM) break;
+                continue;
+            }
+            if (*p == '(') depth++;
+            if (*p == ')' && depth-- == 0) break;
+            end = ++p;
+        }
+        parser->term = strndup(start, (size_t)(end - start));
+    }
+    if (parser->token == TOKEN_TERM && !parser->term) fail(parser, "sin memoria");
+    parser->text = p;
+}
+
+static QueryNode* new_node(Parser* parser, QueryOp op) {
+    QueryNode* node = calloc(1, sizeof(QueryNode));
+    if (!node) fail(parser, "sin memoria");
+    else node->op = op;
+    return node;
+}
+
+// Añade un hijo; un AND dentro de un AND (o un OR dentro de un OR) aporta
+// directamente sus hijos
+static void add_child(Parser* parser, QueryNode* node, QueryNode* child) {
+    if (!child) return;
+    if (child->op == node->op && child->op != QUERY_NOT) {
+        for (int i = 0; i < child->n_children; i++) add_child(parser, node, child->children[i]);
+        child->n_children = 0;
+        query_free(child);
+        return;
+    }
+    QueryNode** children = realloc(node->children, (size_t)(node->n_children + 1) * sizeof(QueryNode*));
+    if (!children) {
+        fail(parser, "sin memoria");
+        query_free(child);
+        return;
+    }
+    node->children = children;
+    node->children[node->n_children++] = child;
+}
+
+// Un AND u OR de un solo operando es el propio operando
+static QueryNode* finish(Parser* parser, QueryNode* node) {
+    if (!node) return NULL;
+    if (parser->failed) {
+        query_free(node);
+        return NULL;
+    }
+    if (node->n_children == 1) {
+        QueryNode* only = node->children[0];
+        node->n_children = 0;
+        query_free(node);
+        return only;
+    }
+    return node;
+}
+
+static QueryNode* parse_query(Parser* parser, int depth);
+
+static QueryNode* parse_unary(Parser* parser, int depth) {
+    if (parser->failed) return NULL;
+    if (parser->token == TOKEN_NOT) {
+        advance(parser);
+        QueryNode* child = parse_unary(parser, depth);
+        if (!child) return NULL;
+        if (child->op == QUERY_NOT) {
+            // NOT NOT x es x
+            QueryNode* inner = child->children[0];
+            child->n_children = 0;
+            query_free(child);
+            return inner;
+        }
+        QueryNode* node = new_node(parser, QUERY_NOT);
+        if (node) add_child(parser, node, child);
+        else query_free(child);
+        return node;
+    }
+    if (parser->token == TOKEN_OPEN) {
+        if (depth >= QUERY_MAX_DEPTH) {
+            fail(parser, "demasiados paréntesis anidados (máximo %d)", QUERY_MAX_DEPTH);
+            return NULL;
+        }
+        advance(parser);
+        QueryNode* node = parse_query(parser, depth + 1);
+        if (node && parser->token != TOKEN_CLOSE) fail(parser, "falta ')'");
+        if (parser->failed) {
+            query_free(node);
+            return NULL;
+        }
+        advance(parser);
+        return node;
+    }
+    if (parser->token != TOKEN_TERM) {
+        fail(parser, parser->token == TOKEN_END ? "falta una skill al final" : "se esperaba una skill");
+        return NULL;
+    }
+    if (parser->n_terms == QUERY_MAX_TERMS) {
+        fail(parser, "demasiadas skills (máximo %d)", QUERY_MAX_TERMS);
+        return NULL;
+    }
+    QueryNode* node = new_node(parser, QUERY_TERM);
+    if (!node) return NULL;
+    node->skill = parser->term;
+    node->term = parser->n_terms++;
+    node->exact = parser->quoted;
+    parser->term = NULL;
+    advance(parser);
+    return node;
+}
+
+static QueryNode* parse_and(Parser* parser, int depth) {
+    QueryNode* node = new_node(parser, QUERY_AND);
+    if (!node) return NULL;
+    add_child(parser, node, parse_unary(parser, depth));
+    while (!parser->failed && (parser->token == TOKEN_AND || parser->token == TOKEN_NOT)) {
+        // El NOT lo consume parse_unary
+        if (parser->token == TOKEN_AND) advance(parser);
+        add_child(parser, node, parse_unary(parser, depth));
+    }
+    return finish(parser, node);
+}
+
+static QueryNode* parse_expr(Parser* parser, int depth) {
+    QueryNode* node = new_node(parser, QUERY_OR);
+    if (!node) return NULL;
+    add_child(parser, node, parse_and(parser, depth));
+    while (!parser->failed && parser->token == TOKEN_OR) {
+        advance(parser);
+        add_child(parser, node, parse_and(parser, depth));
+    }
+    return finish(parser, node);
+}
+
+// Criterios separados por ';'. Como hacía strtok, se ignoran los vacíos.
+static QueryNode* parse_query(Parser* parser, int depth) {
+    QueryNode* node = new_node(parser, QUERY_AND);
+    if (!node) return NULL;
+    while (parser->token == TOKEN_SEMICOLON) advance(parser);
+    if (parser->token == TOKEN_END || parser->token == TOKEN_CLOSE) {
+        fail(parser, "consulta vacía");
+        return finish(parser, node);
+    }
+    while (!parser->failed) {
+        add_child(parser, node, parse_expr(parser, depth));
+        if (parser->token != TOKEN_SEMICOLON) break;
+        while (parser->token == TOKEN_SEMICOLON) advance(parser);
+        if (parser->token == TOKEN_END || parser->token == TOKEN_CLOSE) break;
+    }
+    return finish(parser, node);
+}
+
+// Reglas de NOT (ver query.h). Devuelve 0 y rellena el error si no se cumplen.
+static int check_negations(Parser* parser, const QueryNode* node) {
+    if (node->op == QUERY_AND) {
+        int positive = 0;
+        for (int i = 0; i < node->n_children; i++) positive |= node->children[i]->op != QUERY_NOT;
+        if (!positive) {
+            fail(parser, "un AND necesita al menos una skill sin NOT");
+            return 0;
+        }
+    } else if (node->op == QUERY_OR) {
+        for (int i = 0; i < node->n_children; i++) {
+            if (node->children[i]->op == QUERY_NOT) {
+                fail(parser, "NOT no puede ser una rama de un OR");
+                return 0;
+            }
+        }
+    }
+    for (int i = 0; i < node->n_children; i++) {
+        if (!check_negations(parser, node->children[i])) return 0;
+    }
+    return 1;
+}
+
+QueryNode* query_parse(const char* text, int* n_terms, char* error, size_t error_size) {
+    Parser parser = { .text = text, .error = error, .error_size = error_size };
+    advance(&parser);
+    QueryNode* root = parse_query(&parser, 0);
+    if (root && parser.token != TOKEN_END) fail(&parser, "')' sin '(' que cierre");
+    if (root && !parser.failed && root->op == QUERY_NOT) fail(&parser, "la consulta solo tiene skills excluidas");
+    if (root && !parser.failed) check_negations(&parser, root);
+    free(parser.term);
+    if (parser.failed) {
+        query_free(root);
+        return NULL;
+    }
+    *n_terms = parser.n_terms;
+    return root;
+}
+
+void query_free(QueryNode* node) {
+    if (!node) return;
+    for (int i = 0; i < node->n_children; i++) query_free(node->children[i]);
+    free(node->children);
+    free(node->skill);
+    free(node);
+}
+
+int query_expand_term(QueryNode* node, char* const* skills, int n, int* n_terms) {
+    if (n == 0) return 1;
+    QueryNode** children = calloc((size_t)n + 1, sizeof(QueryNode*));
+    QueryNode* self = calloc(1, sizeof(QueryNode));
+    int ok = children && self;
+    int n_children = 0;
+    if (ok) {
+        // El término original pasa a ser la primera rama
+        *self = *node;
+        children[n_children++] = self;
+    }
+    for (int i = 0; ok && i < n && *n_terms < QUERY_MAX_TERMS; i++) {
+        QueryNode* child = calloc(1, sizeof(QueryNode));
+        ok = child && (child->skill = strdup(skills[i])) != NULL;
+        if (!ok) {
+            free(child);
+            break;
+        }
+        child->op = QUERY_TERM;
+        child->term = (*n_terms)++;
+        child->exact = 1;
+        children[n_children++] = child;
+    }
+    if (!ok) {
+        for (int i = 1; i < n_children; i++) query_free(children[i]);
+        free(children);
+        free(self);
+        return 0;
+    }
+    if (n_children == 1) {
+        // No cabía ninguna: se queda como estaba
+        free(children);
+        free(self);
+        return 1;
+    }
+    node->op = QUERY_OR;
+    node->variants = 1;
+    node->skill = NULL;
+    node->children = children;
+    node->n_children = n_children;
+    return 1;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Clave de un nodo reservada con malloc, o NULL si no hay memoria
+static char* node_key(const QueryNode* node) {
+    if (node->op == QUERY_TERM) {
+        // Los nombres no pueden llevar comillas: no hay ambigüedad. Una skill
+        // exacta y una que se amplía no dan los mismos resultados.
+        char* key = malloc(strlen(node->skill) + 4);
+        if (key) sprintf(key, "%s\"%s\"", node->exact ? "=" : "", node->skill);
+        return key;
+    }
+    if (node->op == QUERY_NOT) {
+        char* child = node_key(node->children[0]);
+        char* key = child ? malloc(strlen(child) + 5) : NULL;
+        if (key) sprintf(key, "NOT %s", child);
+        free(child);
+        return key;
+    }
+
+    char** keys = calloc((size_t)node->n_children, sizeof(char*));
+    int ok = keys != NULL;
+    size_t total = 8;
+    for (int i = 0; ok && i < node->n_children; i++) {
+        keys[i] = node_key(node->children[i]);
+        ok = keys[i] != NULL;
+        if (ok) total += strlen(keys[i]) + 1;
+    }
+    char* key = NULL;
+    if (ok) {
+        qsort(keys, (size_t)node->n_children, sizeof(char*), compare_keys);
+        int unique = 1;
+        for (int i = 1; i < node->n_children; i++) unique += strcmp(keys[i], keys[i - 1]) != 0;
+        if (unique == 1) {
+            // A AND A es A
+            key = keys[0];
+            keys[0] = NULL;
+        } else if ((key = malloc(total))) {
+            size_t len = (size_t)sprintf(key, "%s(", node->op == QUERY_AND ? "AND" : "OR");
+            for (int i = 0; i < node->n_children; i++) {
+                if (i > 0 && strcmp(keys[i], keys[i - 1]) == 0) continue;
+                len += (size_t)sprintf(key + len, "%s%s", i > 0 ? "," : "", keys[i]);
+            }
+            sprintf(key + len, ")");
+        }
+    }
+    for (int i = 0; keys && i < node->n_children; i++) free(keys[i]);
+    free(keys);
+    return key;
+}
+
+int query_key(const QueryNode* node, char* out, size_t size) {
+    char* key = node_key(node);
+    int fits = key && strlen(key) < size;
+    if (fits) strcpy(out, key);
+    free(key);
+    return fits;
+}
+
+static void append(char* out, size_t size, size_t* len, const char* format, ...) {
+    if (*len >= size) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out + *len, size - *len, format, args);
+    va_end(args);
+    if (n > 0) *len += (size_t)n;
+}
+
+static void format_node(const QueryNode* node, char* out, size_t size, size_t* len) {
+    switch (node->op) {
+    case QUERY_TERM:
+        append(out, size, len, "\"%s\"[%zu]", node->skill, node->cost);
+        return;
+    case QUERY_NOT:
+        append(out, size, len, "NOT ");
+        format_node(node->children[0], out, size, len);
+        return;
+    default:
+        append(out, size, len, "%s[%zu](", node->op == QUERY_AND ? "AND" : "OR", node->cost);
+        for (int i = 0; i < node->n_children; i++) {
+            if (i > 0) append(out, size, len, ", ");
+            format_node(node->children[i], out, size, len);
+        }
+        append(out, size, len, ")");
+    }
+}
+
+void query_format(const QueryNode* node, char* out, size_t size) {
+    size_t len = 0;
+    if (size == 0) return;
+    out[0] = '\0';
+    format_node(node, out, size, &len);
+}
@@ -0,0 +1,71 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stddef.h>
+
+// Lenguaje de consultas del motor. Una consulta combina skills con AND, OR y
+// NOT, con paréntesis para agrupar. Precedencia de menor a mayor:
+//
+//   consulta := expr { ';' expr }                  ';' es un AND entre criterios
+//   expr     := and { OR and }
+//   and      := unario { AND unario | NOT unario } "A NOT B" es A AND NOT B
+//   unario   := NOT unario | '(' consulta ')' | skill
+//
+// Los operadores van en mayúsculas y como palabras sueltas; "and" o "Android"
+// son parte del nombre de una skill. Un nombre puede llevar espacios y
+// paréntesis equilibrados ("Certified Nursing Assistant (CNA)"); entre
+// comillas dobles se toma tal cual. Así, las consultas antiguas con hasta
+// tres criterios separados por ';' siguen significando lo mismo.
+//
+// El motor amplía cada skill sin comillas a las que solo se diferencian de
+// ella en mayúsculas, tildes o espacios (y, si no hay ninguna, a las que
+// están a una o dos ediciones), con query_expand_term. Entre comillas, la
+// skill se busca exactamente como está escrita.
+//
+// NOT solo excluye: cada AND necesita al menos un operando positivo, y ni la
+// consulta entera ni una rama de un OR pueden ser un NOT.
+
+#define QUERY_MAX_TERMS 64
+#define QUERY_MAX_DEPTH 16
+
+typedef enum {
+    QUERY_TERM,
+    QUERY_AND,
+    QUERY_OR,
+    QUERY_NOT
+} QueryOp;
+
+typedef struct QueryNode {
+    QueryOp op;
+    char* skill;                    // QUERY_TERM
+    int term;                       // QUERY_TERM: número de término, 0..n_terms-1
+    int exact;                      // QUERY_TERM: iba entre comillas, no se amplía
+    int variants;                   // QUERY_OR: variantes de un término (query_expand_term)
+    struct QueryNode** children;    // AND y OR: dos o más; NOT: uno
+    int n_children;
+    size_t cost;                    // Filas estimadas, lo rellena el planificador
+} QueryNode;
+
+// Analiza una consulta. Devuelve el árbol (con los AND y OR anidados del
+// mismo tipo aplanados) y el número de términos en *n_terms, o NULL con el
+// motivo en 'error' si la consulta no es válida.
+QueryNode* query_parse(const char* text, int* n_terms, char* error, size_t error_size);
+void query_free(QueryNode* node);
+
+// Convierte el término 'node' en un OR de sí mismo y de las n skills de
+// 'skills', que se buscan exactas, marcado con 'variants'. Toman números de
+// término desde *n_terms, sin pasar de QUERY_MAX_TERMS; con n = 0 el término
+// se queda como está. Devuelve 0 si no hay memoria.
+int query_expand_term(QueryNode* node, char* const* skills, int n, int* n_terms);
+
+// Clave canónica de la consulta, para la caché de resultados: los operandos
+// de cada AND y OR van ordenados y sin repetir, así que consultas que solo
+// difieren en el orden o en repeticiones tienen la misma clave. Devuelve 0
+// si no cabe en 'size'.
+int query_key(const QueryNode* node, char* out, size_t size);
+
+// Escribe el árbol en una línea, con el coste de cada nodo, para el registro
+// del motor. Trunca si no cabe en 'size'.
+void query_format(const QueryNode* node, char* out, size_t size);
+
+#endif
@@ -0,0 +1,465 @@
+#include <stdlib.h>
+#include <string.h>
+#include "roaring.h"
+
+void roaring_init(Roaring* r) {
+    memset(r, 0, sizeof(*r));
+}
+
+static void free_container(RoaringContainer* c) {
+    free(c->array);
+    free(c->bitmap);
+}
+
+void roaring_free(Roaring* r) {
+    for (size_t i = 0; i < r->n; i++) free_container(&r->containers[i]);
+    free(r->containers);
+    roaring_init(r);
+}
+
+// Añade un contenedor vacío al final
+static RoaringContainer* push_container(Roaring* r, uint16_t key, uint16_t type) {
+    if (r->n == r->capacity) {
+        size_t capacity = r->capacity ? r->capacity * 2 : 16;
+        RoaringContainer* containers = realloc(r->containers, capacity * sizeof(RoaringContainer));
+        if (!containers) return NULL;
+        r->containers = containers;
+        r->capacity = capacity;
+    }
+    RoaringContainer* c = &r->containers[r->n++];
+    memset(c, 0, sizeof(*c));
+    c->key = key;
+    c->type = type;
+    if (type == ROARING_BITMAP) {
+        c->bitmap = calloc(ROARING_BITMAP_WORDS, sizeof(uint64_t));
+        if (!c->bitmap) {
+            r->n--;
+            return NULL;
+        }
+    }
+    return c;
+}
+
+// Un array que supera ROARING_ARRAY_MAX valores pasa a bitmap
+static int array_to_bitmap(RoaringContainer* c) {
+    uint64_t* bitmap = calloc(ROARING_BITMAP_WORDS, sizeof(uint64_t));
+    if (!bitmap) return 1;
+    for (uint32_t i = 0; i < c->cardinality; i++) {
+        bitmap[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
+    }
+    free(c->array);
+    c->array = NULL;
+    c->capacity = 0;
+    c->bitmap = bitmap;
+    c->type = ROARING_BITMAP;
+    return 0;
+}
+
+int roaring_add(Roaring* r, uint32_t value) {
+    uint16_t key = (uint16_t)(value >> 16);
+    uint16_t low = (uint16_t)value;
+    RoaringContainer* c = r->n > 0 ? &r->containers[r->n - 1] : NULL;
+    if (!c || c->key != key) {
+        c = push_container(r, key, ROARING_ARRAY);
+        if (!c) return 1;
+    }
+    if (c->type == ROARING_ARRAY && c->cardinality == ROARING_ARRAY_MAX && array_to_bitmap(c) != 0) return 1;
+
+    if (c->type == ROARING_BITMAP) {
+        c->bitmap[low >> 6] |= 1ULL << (low & 63);
+    } else {
+        if (c->cardinality == c->capacity) {
+            uint32_t capacity = c->capacity ? c->capacity * 2 : 8;
+            if (capacity > ROARING_ARRAY_MAX) capacity = ROARING_ARRAY_MAX;
+            uint16_t* array = realloc(c->array, capacity * sizeof(uint16_t));
+            if (!array) return 1;
+            c->array = array;
+            c->capacity = capacity;
+        }
+        c->array[c->cardinality] = low;
+    }
+    c->cardinality++;
+    return 0;
+}
+
+// Recorre los valores de un contenedor en orden
+#define FOR_EACH_VALUE(c, value, body)                                          \
+    do {                                                                        \
+        if ((c)->type == ROARING_ARRAY) {                                       \
+            for (uint32_t i_ = 0; i_ < (c)->cardinality; i_++) {                \
+                uint32_t value = ((uint32_t)(c)->key << 16) | (c)->array[i_];   \
+                body                                                            \
+            }                                                                   \
+        } else {                                                                \
+            for (uint32_t w_ = 0; w_ < ROARING_BITMAP_WORDS; w_++) {            \
+                uint64_t word_ = (c)->bitmap[w_];                               \
+                while (word_) {                                                 \
+                    uint32_t value = ((uint32_t)(c)->key << 16) | (w_ << 6) |   \
+                                     (uint32_t)__builtin_ctzll(word_);          \
+                    word_ &= word_ - 1;                                         \
+                    body                                                        \
+                }                                                               \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+int roaring_append(Roaring* dst, Roaring* src) {
+    size_t first = 0;
+    if (dst->n > 0 && src->n > 0 && dst->containers[dst->n - 1].key == src->containers[0].key) {
+        // Tramo compartido: sus valores se añaden uno a uno
+        RoaringContainer* c = &src->containers[0];
+        int failed = 0;
+        FOR_EACH_VALUE(c, value, { if (!failed) failed = roaring_add(dst, value); });
+        if (failed) return 1;
+        free_container(c);
+        first = 1;
+    }
+    for (size_t i = first; i < src->n; i++) {
+        if (dst->n == dst->capacity) {
+            size_t capacity = dst->capacity ? dst->capacity * 2 : 16;
+            if (capacity < dst->n + src->n - i) capacity = dst->n + src->n - i;
+            RoaringContainer* containers = realloc(dst->containers, capacity * sizeof(RoaringContainer));
+            if (!containers) {
+                for (size_t j = i; j < src->n; j++) free_container(&src->containers[j]);
+                free(src->containers);
+                roaring_init(src);
+                return 1;
+            }
+            dst->containers = containers;
+            dst->capacity = capacity;
+        }
+        dst->containers[dst->n++] = src->containers[i];
+    }
+    free(src->containers);
+    roaring_init(src);
+    return 0;
+}
+
+static const RoaringContainer* find_container(const Roaring* r, uint16_t key) {
+    size_t lo = 0, hi = r->n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < r->n && r->containers[lo].key == key ? &r->containers[lo] : NULL;
+}
+
+int roaring_contains(const Roaring* r, uint32_t value) {
+    const RoaringContainer* c = find_container(r, (uint16_t)(value >> 16));
+    if (!c) return 0;
+    uint16_t low = (uint16_t)value;
+    if (c->type == ROARING_BITMAP) return (c->bitmap[low >> 6] >> (low & 63)) & 1;
+
+    uint32_t lo = 0, hi = c->cardinality;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (c->array[mid] < low) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < c->cardinality && c->array[lo] == low;
+}
+
+int roaring_seek(const Roaring* r, uint32_t target, uint32_t* value) {
+    // Primer contenedor cuyo tramo puede tener valores >= target
+    uint16_t key = (uint16_t)(target >> 16);
+    size_t lo = 0, hi = r->n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t i = lo; i < r->n; i++) {
+        const RoaringContainer* c = &r->containers[i];
+        // En los tramos siguientes vale cualquier valor
+        uint32_t low = c->key == key ? (uint16_t)target : 0;
+        if (c->type == ROARING_BITMAP) {
+            uint32_t w = low >> 6;
+            uint64_t word = c->bitmap[w] & (~0ULL << (low & 63));
+            while (!word && ++w < ROARING_BITMAP_WORDS) word = c->bitmap[w];
+            if (word) {
+                *value = ((uint32_t)c->key << 16) | (w * 64 + (uint32_t)__builtin_ctzll(word));
+                return 1;
+            }
+            continue;
+        }
+        uint32_t a = 0, b = c->cardinality;
+        while (a < b) {
+            uint32_t mid = a + (b - a) / 2;
+            if (c->array[mid] < low) a = mid + 1;
+            else b = mid;
+        }
+        if (a < c->cardinality) {
+            *value = ((uint32_t)c->key << 16) | c->array[a];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t roaring_cardinality(const Roaring* r) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < r->n; i++) total += r->containers[i].cardinality;
+    return total;
+}
+
+void roaring_bounds(const Roaring* r, uint32_t* lo, uint32_t* hi) {
+    *lo = (uint32_t)r->containers[0].key << 16;
+    *hi = ((uint32_t)r->containers[r->n - 1].key << 16) | 0xFFFF;
+}
+
+void roaring_clip(Roaring* r, uint32_t lo, uint32_t hi) {
+    size_t kept = 0;
+    for (size_t i = 0; i < r->n; i++) {
+        RoaringContainer* c = &r->containers[i];
+        uint32_t base = (uint32_t)c->key << 16;
+        if (base + 0xFFFF < lo || base > hi) {
+            free_container(c);
+            continue;
+        }
+        // Valores bajos que se conservan del tramo: [first, last]
+        uint32_t first = lo > base ? lo - base : 0;
+        uint32_t last = hi < base + 0xFFFF ? hi - base : 0xFFFF;
+        if (c->type == ROARING_ARRAY && (first > 0 || last < 0xFFFF)) {
+            uint32_t n = 0;
+            for (uint32_t j = 0; j < c->cardinality; j++) {
+                if (c->array[j] >= first && c->array[j] <= last) c->array[n++] = c->array[j];
+            }
+            c->cardinality = n;
+        } else if (first > 0 || last < 0xFFFF) {
+            uint32_t cardinality = 0;
+            for (uint32_t w = 0; w < ROARING_BITMAP_WORDS; w++) {
+                uint32_t low = w * 64, high = w * 64 + 63;
+                uint64_t mask = 0;
+                if (high >= first && low <= last) {
+                    mask = ~0ULL;
+                    if (low < first) mask &= ~0ULL << (first - low);
+                    if (high > last) mask &= ~0ULL >> (high - last);
+                }
+                c->bitmap[w] &= mask;
+                cardinality += (uint32_t)__builtin_popcountll(c->bitmap[w]);
+            }
+            c->cardinality = cardinality;
+        }
+        if (c->cardinality == 0) {
+            free_container(c);
+            continue;
+        }
+        r->containers[kept++] = *c;
+    }
+    r->n = kept;
+}
+
+// Intersección de dos contenedores del mismo tramo; no añade nada si queda vacía
+static int and_containers(const RoaringContainer* a, const RoaringContainer* b, Roaring* out) {
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        uint32_t cardinality = 0;
+        for (uint32_t w = 0; w < ROARING_BITMAP_WORDS; w++) {
+            cardinality += (uint32_t)__builtin_popcountll(a->bitmap[w] & b->bitmap[w]);
+        }
+        if (cardinality == 0) return 0;
+        if (cardinality > ROARING_ARRAY_MAX) {
+            RoaringContainer* c = push_container(out, a->key, ROARING_BITMAP);
+            if (!c) return 1;
+            for (uint32_t w = 0; w < ROARING_BITMAP_WORDS; w++) c->bitmap[w] = a->bitmap[w] & b->bitmap[w];
+            c->cardinality = cardinality;
+            return 0;
+        }
+        // Pocos valores: el resultado se guarda como array
+        for (uint32_t w = 0; w < ROARING_BITMAP_WORDS; w++) {
+            uint64_t word = a->bitmap[w] & b->bitmap[w];
+            while (word) {
+                uint32_t value = ((uint32_t)a->key << 16) | (w << 6) | (uint32_t)__builtin_ctzll(word);
+                word &= word - 1;
+                if (roaring_add(out, value) != 0) return 1;
+            }
+        }
+        return 0;
+    }
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY) {
+        uint32_t i = 0, j = 0;
+        while (i < a->cardinality && j < b->cardinality) {
+            if (a->array[i] < b->array[j]) i++;
+            else if (b->array[j] < a->array[i]) j++;
+            else {
+                if (roaring_add(out, ((uint32_t)a->key << 16) | a->array[i]) != 0) return 1;
+                i++;
+                j++;
+            }
+        }
+        return 0;
+    }
+    // Array contra bitmap: se comprueba cada valor del array
+    const RoaringContainer* array = a->type == ROARING_ARRAY ? a : b;
+    const RoaringContainer* bitmap = a->type == ROARING_ARRAY ? b : a;
+    for (uint32_t i = 0; i < array->cardinality; i++) {
+        uint16_t low = array->array[i];
+        if ((bitmap->bitmap[low >> 6] >> (low & 63)) & 1) {
+            if (roaring_add(out, ((uint32_t)array->key << 16) | low) != 0) return 1;
+        }
+    }
+    return 0;
+}
+
+int roaring_and(const Roaring* a, const Roaring* b, Roaring* out) {
+    size_t i = 0, j = 0;
+    while (i < a->n && j < b->n) {
+        if (a->containers[i].key < b->containers[j].key) i++;
+        else if (b->containers[j].key < a->containers[i].key) j++;
+        else {
+            if (and_containers(&a->containers[i], &b->containers[j], out) != 0) return 1;
+            i++;
+            j++;
+        }
+    }
+    return 0;
+}
+
+// Valores comunes de dos contenedores del mismo tramo, sin construir el resultado
+static uint32_t and_containers_cardinality(const RoaringContainer* a, const RoaringContainer* b) {
+    uint32_t cardinality = 0;
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        for (uint32_t w = 0; w < ROARING_BITMAP_WORDS; w++) {
+            cardinality += (uint32_t)__builtin_popcountll(a->bitmap[w] & b->bitmap[w]);
+        }
+        return cardinality;
+    }
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY) {
+        uint32_t i = 0, j = 0;
+        while (i < a->cardinality && j < b->cardinality) {
+            uint16_t x = a->array[i], y = b->array[j];
+            cardinality += x == y;
+            i += x <= y;
+            j += y <= x;
+        }
+        return cardinality;
+    }
+    const RoaringContainer* array = a->type == ROARING_ARRAY ? a : b;
+    const RoaringContainer* bitmap = a->type == ROARING_ARRAY ? b : a;
+    for (uint32_t i = 0; i < array->cardinality; i++) {
+        uint16_t low = array->array[i];
+        cardinality += (uint32_t)((bitmap->bitmap[low >> 6] >> (low & 63)) & 1);
+    }
+    return cardinality;
+}
+
+uint64_t roaring_and_cardinality(const Roaring* a, const Roaring* b) {
+    uint64_t total = 0;
+    size_t i = 0, j = 0;
+    while (i < a->n && j < b->n) {
+        if (a->containers[i].key < b->containers[j].key) i++;
+        else if (b->containers[j].key < a->containers[i].key) j++;
+        else total += and_containers_cardinality(&a->containers[i++], &b->containers[j++]);
+    }
+    return total;
+}
+
+size_t roaring_to_array(const Roaring* r, long* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < r->n; i++) {
+        const RoaringContainer* c = &r->containers[i];
+        FOR_EACH_VALUE(c, value, { out[n++] = (long)value; });
+    }
+    return n;
+}
+
+int roaring_write(const Roaring* r, FILE* file) {
+    uint32_t n = (uint32_t)r->n;
+    if (fwrite(&n, sizeof(n), 1, file) != 1) return 1;
+    for (size_t i = 0; i < r->n; i++) {
+        RoaringContainerHeader header = { r->containers[i].key, r->containers[i].type, r->containers[i].cardinality };
+        if (fwrite(&header, sizeof(header), 1, file) != 1) return 1;
+    }
+    for (size_t i = 0; i < r->n; i++) {
+        const RoaringContainer* c = &r->containers[i];
+        int ok = c->type == ROARING_BITMAP
+                     ? fwrite(c->bitmap, sizeof(uint64_t), ROARING_BITMAP_WORDS, file) == ROARING_BITMAP_WORDS
+                     : fwrite(c->array, sizeof(uint16_t), c->cardinality, file) == c->cardinality;
+        if (!ok) return 1;
+    }
+    return 0;
+}
+
+static size_t container_bytes(const RoaringContainerHeader* header) {
+    return header->type == ROARING_BITMAP ? ROARING_BITMAP_BYTES : header->cardinality * sizeof(uint16_t);
+}
+
+// Contenedores de los tramos de [lo, hi]: [*first, *last) en la tabla. Son
+// consecutivos; *skip son los bytes de datos anteriores y *span los suyos.
+static void overlapping_containers(const RoaringContainerHeader* headers, size_t n, uint32_t lo, uint32_t hi,
+                                   size_t* first, size_t* last, size_t* skip, size_t* span) {
+    uint16_t key_lo = (uint16_t)(lo >> 16), key_hi = (uint16_t)(hi >> 16);
+    *skip = 0;
+    *span = 0;
+    *first = 0;
+    while (*first < n && headers[*first].key < key_lo) *skip += container_bytes(&headers[(*first)++]);
+    *last = *first;
+    while (*last < n && headers[*last].key <= key_hi) *span += container_bytes(&headers[(*last)++]);
+}
+
+// Añade a 'out' los contenedores [first, last) con sus datos en 'data'
+static int push_containers(const RoaringContainerHeader* headers, size_t first, size_t last, const uint8_t* data,
+                           Roaring* out) {
+    size_t pos = 0;
+    for (size_t i = first; i < last; i++) {
+        const RoaringContainerHeader* header = &headers[i];
+        if (header->cardinality == 0 || (header->type == ROARING_ARRAY && header->cardinality > ROARING_ARRAY_MAX)) {
+            return 1;
+        }
+        RoaringContainer* c = push_container(out, header->key, header->type == ROARING_BITMAP ? ROARING_BITMAP : ROARING_ARRAY);
+        if (!c) return 1;
+        c->cardinality = header->cardinality;
+        size_t bytes = container_bytes(header);
+        if (c->type == ROARING_BITMAP) {
+            memcpy(c->bitmap, data + pos, bytes);
+        } else {
+            c->array = malloc(bytes);
+            c->capacity = header->cardinality;
+            if (!c->array) return 1;
+            memcpy(c->array, data + pos, bytes);
+        }
+        pos += bytes;
+    }
+    return 0;
+}
+
+int roaring_read(FILE* file, uint32_t lo, uint32_t hi, Roaring* out) {
+    uint32_t n;
+    if (fread(&n, sizeof(n), 1, file) != 1 || n > 65536) return 1;
+    RoaringContainerHeader* headers = malloc((n > 0 ? n : 1) * sizeof(RoaringContainerHeader));
+    if (!headers || fread(headers, sizeof(RoaringContainerHeader), n, file) != n) {
+        free(headers);
+        return 1;
+    }
+
+    // Los contenedores que interesan se leen de una vez
+    size_t first, last, skip, span;
+    overlapping_containers(headers, n, lo, hi, &first, &last, &skip, &span);
+    int failed = 0;
+    uint8_t* data = NULL;
+    if (last > first) {
+        data = malloc(span);
+        failed = !data || fseek(file, (long)skip, SEEK_CUR) != 0 || fread(data, 1, span, file) != span;
+    }
+    if (!failed) failed = push_containers(headers, first, last, data, out);
+    free(data);
+    free(headers);
+    return failed;
+}
+
+int roaring_read_buffer(const uint8_t* data, size_t size, uint32_t lo, uint32_t hi, Roaring* out) {
+    uint32_t n;
+    if (size < sizeof(n)) return 1;
+    memcpy(&n, data, sizeof(n));
+    size_t table = sizeof(n) + (size_t)n * sizeof(RoaringContainerHeader);
+    if (n > 65536 || size < table) return 1;
+    RoaringContainerHeader* headers = malloc((n > 0 ? n : 1) * sizeof(RoaringContainerHeader));
+    if (!headers) return 1;
+    memcpy(headers, data + sizeof(n), (size_t)n * sizeof(RoaringContainerHeader));
+
+    size_t first, last, skip, span;
+    overlapping_containers(headers, n, lo, hi, &first, &last, &skip, &span);
+    int failed = skip + span > size - table || push_containers(headers, first, last, data + table + skip, out);
+    free(headers);
+    return failed;
+}
@@ -0,0 +1,88 @@
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Conjuntos de row IDs de 32 bits al estilo Roaring. El espacio de IDs se
+// divide en tramos de 65536; cada tramo con algún valor es un contenedor con
+// los 16 bits bajos de sus valores:
+//
+//   - array:  hasta ROARING_ARRAY_MAX valores uint16 ordenados
+//   - bitmap: 65536 bits (8 KB) cuando el tramo tiene más valores
+//
+// Las skills muy frecuentes guardan así sus listas en jobs.idx (formato 4).
+// La intersección de dos bitmaps es un AND palabra a palabra, y comprobar si
+// un row ID está en el conjunto es una búsqueda en un solo contenedor.
+//
+// Formato en disco:
+//
+//   [n_contenedores: uint32][n * RoaringContainerHeader][datos de cada contenedor]
+//
+// Los datos de un array ocupan 2 * cardinality bytes y los de un bitmap
+// ROARING_BITMAP_BYTES, así que la posición de cada contenedor se deduce de
+// la tabla y se pueden leer solo los que interesan.
+
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024
+#define ROARING_BITMAP_BYTES (ROARING_BITMAP_WORDS * 8)
+#define ROARING_ARRAY 0
+#define ROARING_BITMAP 1
+
+typedef struct {
+    uint16_t key;           // 16 bits altos de los valores del contenedor
+    uint16_t type;          // ROARING_ARRAY o ROARING_BITMAP
+    uint32_t cardinality;
+} RoaringContainerHeader;
+
+typedef struct {
+    uint16_t key;
+    uint16_t type;
+    uint32_t cardinality;
+    uint32_t capacity;      // Capacidad del array
+    uint16_t* array;
+    uint64_t* bitmap;
+} RoaringContainer;
+
+typedef struct {
+    RoaringContainer* containers;   // Ordenados por key
+    size_t n;
+    size_t capacity;
+} Roaring;
+
+void roaring_init(Roaring* r);
+void roaring_free(Roaring* r);
+
+// Añade un valor mayor que todos los anteriores. 0 si va bien.
+int roaring_add(Roaring* r, uint32_t value);
+// Mueve los contenedores de 'src', con valores mayores que los de 'dst', al
+// final de 'dst'. Si ambos comparten el tramo de la frontera se unen.
+int roaring_append(Roaring* dst, Roaring* src);
+
+int roaring_contains(const Roaring* r, uint32_t value);
+// Primer valor >= target. Devuelve 1 y el valor en *value, o 0 si no hay.
+int roaring_seek(const Roaring* r, uint32_t target, uint32_t* value);
+uint64_t roaring_cardinality(const Roaring* r);
+// Menor y mayor valor posible según los tramos presentes (r no vacío).
+void roaring_bounds(const Roaring* r, uint32_t* lo, uint32_t* hi);
+// Quita los valores fuera de [lo, hi] (y los contenedores que quedan vacíos).
+void roaring_clip(Roaring* r, uint32_t lo, uint32_t hi);
+
+// out = a AND b. 'out' debe estar inicializado y vacío. 0 si va bien.
+int roaring_and(const Roaring* a, const Roaring* b, Roaring* out);
+// Número de valores de a AND b, sin construir el conjunto.
+uint64_t roaring_and_cardinality(const Roaring* a, const Roaring* b);
+// Escribe los valores en orden en 'out' y devuelve cuántos son.
+size_t roaring_to_array(const Roaring* r, long* out);
+
+// Serializa el conjunto en la posición actual de 'file'. 0 si va bien.
+int roaring_write(const Roaring* r, FILE* file);
+// Lee del conjunto que empieza en la posición actual de 'file' solo los
+// contenedores que pueden tener valores de [lo, hi], y los añade a 'out'
+// (que debe estar vacío). 0 si va bien.
+int roaring_read(FILE* file, uint32_t lo, uint32_t hi, Roaring* out);
+// Igual, con el conjunto serializado en memoria ('size' bytes en 'data').
+int roaring_read_buffer(const uint8_t* data, size_t size, uint32_t lo, uint32_t hi, Roaring* out);
+
+#endif
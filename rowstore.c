@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rowstore.h"
+
+#ifdef ROWS_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// Dos filas pedidas a menos de ROWS_TABLE_GAP filas de distancia comparten
+// la lectura de la tabla (1024 posiciones son 4 KB)
+#define ROWS_TABLE_GAP 1024
+// Dos registros separados por menos de ROWS_READ_GAP bytes se leen juntos,
+// en lecturas de hasta ROWS_MAX_READ bytes
+#define ROWS_READ_GAP (16 * 1024)
+#define ROWS_MAX_READ (1024 * 1024)
+#define ROWS_WRITE_BUFFER 4096
+
+// Lectura de 'size' bytes en la posición 'offset' del almacén
+typedef struct ReadOp {
+    uint64_t offset;
+    size_t size;
+    char* buffer;
+} ReadOp;
+
+static char* tmp_name(const char* filename) {
+    size_t len = strlen(filename);
+    char* name = malloc(len + 5);
+    memcpy(name, filename, len);
+    memcpy(name + len, ".tmp", 5);
+    return name;
+}
+
+// Primera línea de datos: la de después de la cabecera del CSV
+static size_t first_data_line(const char* csv, size_t size) {
+    const char* newline = memchr(csv, '\n', size);
+    return newline ? (size_t)(newline - csv) + 1 : size;
+}
+
+static int pread_full(int fd, char* buffer, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, buffer + done, size - done, (off_t)(offset + done));
+        if (n <= 0) return 1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static size_t put_varint(uint8_t* p, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        p[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t)value;
+    return n;
+}
+
+static int get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int rowstore_build(const char* filename, const char* csv, size_t size) {
+    // 1. Contar las filas, para saber dónde empiezan los registros, y el
+    //    prefijo común de las URL
+    size_t start = first_data_line(csv, size);
+    uint64_t n_rows = 0;
+    size_t prefix = 0;
+    for (size_t pos = start; pos < size; n_rows++) {
+        const char* newline = memchr(csv + pos, '\n', size - pos);
+        size_t end = newline ? (size_t)(newline - csv) : size;
+        const char* comma = memchr(csv + pos, ',', end - pos);
+        size_t url_len = comma ? (size_t)(comma - csv) - pos : end - pos;
+        if (n_rows == 0) prefix = url_len < ROWS_MAX_URL_PREFIX ? url_len : ROWS_MAX_URL_PREFIX;
+        size_t same = 0;
+        while (same < prefix && same < url_len && csv[pos + same] == csv[start + same]) same++;
+        prefix = same;
+        pos = newline ? end + 1 : size;
+    }
+
+    RowStoreHeader header = {0};
+    header.magic = ROWS_MAGIC;
+    header.version = ROWS_VERSION;
+    header.header_size = sizeof(RowStoreHeader);
+    header.n_rows = n_rows;
+    header.groups_offset = sizeof(RowStoreHeader);
+    uint64_t n_groups = n_rows / ROWS_GROUP_ROWS + 1;
+    header.table_offset = header.groups_offset + n_groups * sizeof(uint64_t);
+    header.csv_size = size;
+    header.url_prefix_len = prefix;
+    memcpy(header.url_prefix, csv + start, prefix);
+
+    // 2. La tabla y los registros se escriben a la vez, cada uno con su
+    //    propio FILE* sobre el mismo archivo; los grupos, al final
+    char* tmp = tmp_name(filename);
+    uint64_t* groups = malloc(n_groups * sizeof(uint64_t));
+    FILE* table = groups ? fopen(tmp, "wb") : NULL;
+    FILE* records = table ? fopen(tmp, "r+b") : NULL;
+    if (!table || !records) {
+        perror("Error al crear el almacén de filas");
+        if (table) fclose(table);
+        remove(tmp);
+        free(tmp);
+        free(groups);
+        return 1;
+    }
+    uint64_t position = header.table_offset + (n_rows + 1) * sizeof(uint32_t);
+    int failed = fseek(table, (long)header.table_offset, SEEK_SET) != 0 ||
+                 fseek(records, (long)position, SEEK_SET) != 0;
+
+    uint32_t buffer[ROWS_WRITE_BUFFER];
+    size_t fill = 0;
+    uint64_t row = 0;
+    for (size_t pos = start; !failed; row++) {
+        // La fila n_rows solo aporta la posición del final
+        if (row % ROWS_GROUP_ROWS == 0) groups[row / ROWS_GROUP_ROWS] = position;
+        uint64_t relative = position - groups[row / ROWS_GROUP_ROWS];
+        if (relative > UINT32_MAX) {
+            fprintf(stderr, "Error: %d filas seguidas de data.csv ocupan más de 4 GB\n", ROWS_GROUP_ROWS);
+            failed = 1;
+            break;
+        }
+        buffer[fill++] = (uint32_t)relative;
+        if (fill == ROWS_WRITE_BUFFER || row == n_rows) {
+            failed = fwrite(buffer, sizeof(uint32_t), fill, table) != fill;
+            fill = 0;
+        }
+        if (row == n_rows) break;
+
+        const char* line = csv + pos;
+        const char* newline = memchr(line, '\n', size - pos);
+        size_t end = newline ? (size_t)(newline - csv) : size;
+        const char* comma = memchr(line, ',', end - pos);
+        if (end - pos > ROWS_LENGTH_MASK) {
+            fprintf(stderr, "Error: línea de más de 512 MB en data.csv\n");
+            failed = 1;
+            break;
+        }
+        size_t url_len = comma ? (size_t)(comma - line) : end - pos;
+        const char* skills = comma ? comma + 1 : line + url_len;
+        size_t skills_len = comma ? end - (size_t)(skills - csv) : 0;
+        uint64_t flags = comma ? 0 : ROWS_RECORD_NO_SKILLS;
+        if (!newline) flags |= ROWS_RECORD_NO_NEWLINE;
+        if (skills_len >= 2 && skills[0] == '"' && skills[skills_len - 1] == '"') {
+            flags |= ROWS_RECORD_QUOTED;
+            skills++;
+            skills_len -= 2;
+        }
+
+        uint8_t length[10];
+        size_t length_bytes = put_varint(length, ((uint64_t)skills_len << ROWS_RECORD_FLAG_BITS) | flags);
+        url_len -= prefix;
+        failed = fwrite(length, 1, length_bytes, records) != length_bytes ||
+                 fwrite(line + prefix, 1, url_len, records) != url_len ||
+                 fwrite(skills, 1, skills_len, records) != skills_len;
+        position += length_bytes + url_len + skills_len;
+        pos = newline ? end + 1 : size;
+    }
+    if (!failed) {
+        failed = fseek(table, (long)header.groups_offset, SEEK_SET) != 0 ||
+                 fwrite(groups, sizeof(uint64_t), n_groups, table) != n_groups ||
+                 fseek(table, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, table) != 1;
+    }
+    if (failed) perror("Error al escribir el almacén de filas");
+    if (fclose(records) != 0) failed = 1;
+    if (fclose(table) != 0) failed = 1;
+    if (!failed && rename(tmp, filename) != 0) {
+        perror("Error al renombrar el almacén de filas");
+        failed = 1;
+    }
+    if (failed) remove(tmp);
+    free(tmp);
+    free(groups);
+    return failed;
+}
+
+int rowstore_open(RowStore* store, const char* filename, int use_map) {
+    memset(store, 0, sizeof(*store));
+    store->fd = open(filename, O_RDONLY);
+    if (store->fd < 0) return 1;
+
+    struct stat st;
+    RowStoreHeader* header = &store->header;
+    uint64_t n_groups = 0;
+    int ok = fstat(store->fd, &st) == 0 &&
+             pread(store->fd, header, sizeof(*header), 0) == (ssize_t)sizeof(*header) &&
+             header->magic == ROWS_MAGIC && header->version == ROWS_VERSION;
+    if (ok) {
+        n_groups = header->n_rows / ROWS_GROUP_ROWS + 1;
+        ok = header->url_prefix_len <= ROWS_MAX_URL_PREFIX &&
+             header->groups_offset + n_groups * sizeof(uint64_t) <= header->table_offset &&
+             header->table_offset + (header->n_rows + 1) * sizeof(uint32_t) <= (uint64_t)st.st_size;
+    }
+    store->groups = ok ? malloc(n_groups * sizeof(uint64_t)) : NULL;
+    if (!store->groups || pread_full(store->fd, (char*)store->groups, n_groups * sizeof(uint64_t),
+                                     header->groups_offset) != 0) {
+        fprintf(stderr, "Formato de %s no soportado\n", filename);
+        rowstore_close(store);
+        return 1;
+    }
+    store->file_size = (uint64_t)st.st_size;
+    if (use_map) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, store->fd, 0);
+        // Sin mapa se sigue leyendo con pread
+        if (map != MAP_FAILED) store->map = map;
+    }
+    return 0;
+}
+
+void rowstore_close(RowStore* store) {
+    if (store->map) munmap((void*)store->map, store->file_size);
+    if (store->fd >= 0) close(store->fd);
+    free(store->groups);
+    memset(store, 0, sizeof(*store));
+    store->fd = -1;
+}
+
+void rowstore_reader_init(RowReader* reader, const RowStore* store) {
+    memset(reader, 0, sizeof(*reader));
+    reader->store = store;
+}
+
+void rowstore_reader_free(RowReader* reader) {
+    free(reader->table);
+    free(reader->op_of_row);
+    free(reader->spans);
+    free(reader->data);
+    free(reader->ops);
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Asegura que el buffer tenga sitio para 'n' elementos de 'size' bytes
+static int reserve(void** buffer, size_t* capacity, size_t n, size_t size) {
+    if (n <= *capacity) return 0;
+    size_t bigger = *capacity ? *capacity : 64;
+    while (bigger < n) bigger *= 2;
+    void* grown = realloc(*buffer, bigger * size);
+    if (!grown) return 1;
+    *buffer = grown;
+    *capacity = bigger;
+    return 0;
+}
+
+#ifdef ROWS_IO_URING
+
+#define ROWS_RING_ENTRIES 64
+
+// Anillo de io_uring de un hilo, con las llamadas al sistema directas
+typedef struct {
+    int fd;                     // -1 si todavía no se ha creado, -2 si no se pudo
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    unsigned entries;
+} Ring;
+
+// Cada hilo que lee filas tiene su anillo; los workers del motor viven
+// hasta el final, así que no se libera
+static _Thread_local Ring ring = { .fd = -1 };
+
+static int ring_setup(Ring* r) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, ROWS_RING_ENTRIES, &params);
+    if (fd < 0) return 1;
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+    char* sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char* cq = sq;
+    if (sq != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    void* sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        close(fd);
+        return 1;
+    }
+    r->sq_head = (unsigned*)(sq + params.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + params.sq_off.array);
+    r->cq_head = (unsigned*)(cq + params.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    r->sqes = sqes;
+    r->entries = params.sq_entries;
+    r->fd = fd;
+    return 0;
+}
+
+// Envía hasta 'entries' lecturas de una vez y espera a todas. Una lectura
+// corta se completa con pread.
+static int ring_read(Ring* r, int fd, ReadOp* ops, size_t n) {
+    unsigned tail = *r->sq_tail;
+    for (size_t i = 0; i < n; i++) {
+        unsigned index = tail & *r->sq_mask;
+        struct io_uring_sqe* sqe = &r->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->off = ops[i].offset;
+        sqe->addr = (uint64_t)(uintptr_t)ops[i].buffer;
+        sqe->len = (uint32_t)ops[i].size;
+        sqe->user_data = i;
+        r->sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+    int failed = 0;
+    size_t submitted = 0, completed = 0;
+    while (completed < n) {
+        unsigned to_submit = (unsigned)(n - submitted);
+        int ret = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            // Interrumpida por una señal: se reintenta. Con otro error no se
+            // sabe qué lecturas quedan en el anillo, así que se abandona y
+            // el hilo sigue con pread
+            if (errno == EINTR) continue;
+            r->fd = -2;
+            return 1;
+        }
+        submitted += (size_t)ret;
+        unsigned head = *r->cq_head;
+        unsigned cq_tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; head++) {
+            const struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+            ReadOp* op = &ops[cqe->user_data];
+            if (cqe->res < 0) failed = 1;
+            else if ((size_t)cqe->res < op->size &&
+                     pread_full(fd, op->buffer + cqe->res, op->size - (size_t)cqe->res, op->offset + (uint64_t)cqe->res) != 0) {
+                failed = 1;
+            }
+            completed++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return failed;
+}
+
+#endif
+
+// Ejecuta las lecturas de ops[0..n). Con ROWS_IO_URING van al kernel en
+// grupos del tamaño del anillo; si no, son pread seguidos.
+static int read_ops(int fd, ReadOp* ops, size_t n) {
+#ifdef ROWS_IO_URING
+    if (ring.fd == -1 && ring_setup(&ring) != 0) ring.fd = -2;
+    for (size_t i = 0; i < n && ring.fd >= 0; ) {
+        size_t batch = n - i < ring.entries ? n - i : ring.entries;
+        if (ring_read(&ring, fd, ops + i, batch) != 0) return 1;
+        i += batch;
+        if (i == n) return 0;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        if (pread_full(fd, ops[i].buffer, ops[i].size, ops[i].offset) != 0) return 1;
+    }
+    return 0;
+}
+
+// Posición del registro de la fila 'row' a partir de su entrada de la tabla
+static uint64_t row_position(const RowStore* store, uint64_t row, uint32_t relative) {
+    return store->groups[row / ROWS_GROUP_ROWS] + relative;
+}
+
+// Posiciones de inicio y fin del registro de cada fila del almacén, en
+// reader->spans. Las filas cercanas se leen de la tabla en un solo tramo.
+static int read_spans(RowReader* reader, const RowFetch* rows, size_t n) {
+    const RowStore* store = reader->store;
+    if (store->map) {
+        const uint32_t* table = (const uint32_t*)(store->map + store->header.table_offset);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t row = rows[i].row;
+            reader->spans[2 * i] = row_position(store, row, table[row]);
+            reader->spans[2 * i + 1] = row_position(store, row + 1, table[row + 1]);
+        }
+        return 0;
+    }
+
+    // Tramos [first, last + 1] de la tabla: primero se cuentan para reservar
+    size_t n_ops = 0, n_entries = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && rows[j].row - rows[i].row < ROWS_TABLE_GAP) j++;
+        n_entries += rows[j - 1].row - rows[i].row + 2;
+        n_ops++;
+        i = j;
+    }
+    if (reserve((void**)&reader->table, &reader->table_capacity, n_entries, sizeof(uint32_t)) != 0 ||
+        reserve((void**)&reader->ops, &reader->ops_capacity, n_ops, sizeof(ReadOp)) != 0) {
+        return 1;
+    }
+    n_ops = n_entries = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && rows[j].row - rows[i].row < ROWS_TABLE_GAP) j++;
+        ReadOp* op = &reader->ops[n_ops++];
+        op->offset = store->header.table_offset + rows[i].row * sizeof(uint32_t);
+        op->size = (rows[j - 1].row - rows[i].row + 2) * sizeof(uint32_t);
+        op->buffer = (char*)(reader->table + n_entries);
+        n_entries += rows[j - 1].row - rows[i].row + 2;
+        i = j;
+    }
+    if (read_ops(store->fd, reader->ops, n_ops) != 0) return 1;
+
+    // Cada fila toma sus dos posiciones del tramo de su grupo
+    const uint32_t* table = reader->table;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && rows[j].row - rows[i].row < ROWS_TABLE_GAP) j++;
+        for (size_t k = i; k < j; k++) {
+            uint64_t row = rows[k].row;
+            reader->spans[2 * k] = row_position(store, row, table[row - rows[i].row]);
+            reader->spans[2 * k + 1] = row_position(store, row + 1, table[row - rows[i].row + 1]);
+        }
+        table += rows[j - 1].row - rows[i].row + 2;
+        i = j;
+    }
+    return 0;
+}
+
+// Registro de una fila a partir de sus bytes [record, record + size)
+static void parse_record(const RowStore* store, RowFetch* row, const char* record, uint64_t size) {
+    const uint8_t* p = (const uint8_t*)record;
+    const uint8_t* end = p + size;
+    uint64_t prefix;
+    if (!get_varint(&p, end, &prefix)) return;
+    uint64_t skills_len = prefix >> ROWS_RECORD_FLAG_BITS;
+    uint64_t rest = (uint64_t)(end - p);
+    if (skills_len > rest || skills_len > ROWS_LENGTH_MASK) return;
+    row->url_prefix = store->header.url_prefix;
+    row->url_prefix_len = (uint32_t)store->header.url_prefix_len;
+    row->url = (const char*)p;
+    row->url_len = (uint32_t)(rest - skills_len);
+    row->skills = row->url + row->url_len;
+    row->skills_len = (uint32_t)skills_len;
+    if (prefix & ROWS_RECORD_NO_SKILLS) row->skills_len |= ROWS_NO_SKILLS;
+    if (prefix & ROWS_RECORD_NO_NEWLINE) row->skills_len |= ROWS_NO_NEWLINE;
+    if (prefix & ROWS_RECORD_QUOTED) row->skills_len |= ROWS_QUOTED;
+    row->found = 1;
+}
+
+// Un registro solo se lee si su tramo es coherente con el archivo
+static int valid_span(const RowStore* store, uint64_t start, uint64_t end) {
+    return start < end && end <= store->file_size;
+}
+
+int rowstore_fetch(RowReader* reader, RowFetch* rows, size_t n) {
+    const RowStore* store = reader->store;
+    for (size_t i = 0; i < n; i++) rows[i].found = 0;
+
+    // Las filas del almacén son un prefijo: los row IDs van en orden
+    size_t in_store = 0;
+    while (in_store < n && rows[in_store].row < store->header.n_rows) in_store++;
+    if (in_store == 0) return 0;
+    if (reserve((void**)&reader->spans, &reader->spans_capacity, 2 * in_store, sizeof(uint64_t)) != 0 ||
+        read_spans(reader, rows, in_store) != 0) {
+        return 1;
+    }
+    const uint64_t* spans = reader->spans;
+
+    if (store->map) {
+        for (size_t i = 0; i < in_store; i++) {
+            if (valid_span(store, spans[2 * i], spans[2 * i + 1])) {
+                parse_record(store, &rows[i], store->map + spans[2 * i], spans[2 * i + 1] - spans[2 * i]);
+            }
+        }
+        return 0;
+    }
+
+    // Registros: un tramo por grupo de filas cercanas. Como en la tabla, se
+    // cuenta primero lo que hay que leer y después se reparte el buffer.
+    size_t n_ops = 0, total = 0;
+    uint64_t group_start = 0, group_end = 0;
+    for (size_t i = 0; i < in_store; i++) {
+        uint64_t start = spans[2 * i], end = spans[2 * i + 1];
+        if (!valid_span(store, start, end)) continue;
+        if (n_ops > 0 && start >= group_end && start - group_end < ROWS_READ_GAP &&
+            end - group_start <= ROWS_MAX_READ) {
+            group_end = end;
+            continue;
+        }
+        if (n_ops > 0) total += group_end - group_start;
+        group_start = start;
+        group_end = end;
+        n_ops++;
+    }
+    if (n_ops == 0) return 0;
+    total += group_end - group_start;
+    if (reserve((void**)&reader->data, &reader->data_capacity, total, 1) != 0 ||
+        reserve((void**)&reader->ops, &reader->ops_capacity, n_ops, sizeof(ReadOp)) != 0) {
+        return 1;
+    }
+
+    // Cada fila recuerda en qué tramo está
+    if (reserve((void**)&reader->op_of_row, &reader->op_of_row_capacity, in_store, sizeof(size_t)) != 0) {
+        return 1;
+    }
+    ReadOp* op = NULL;
+    char* next = reader->data;
+    for (size_t i = 0; i < in_store; i++) {
+        uint64_t start = spans[2 * i], end = spans[2 * i + 1];
+        if (!valid_span(store, start, end)) continue;
+        if (!op || start < op->offset + op->size || start - (op->offset + op->size) >= ROWS_READ_GAP ||
+            end - op->offset > ROWS_MAX_READ) {
+            if (op) next += op->size;
+            op = op ? op + 1 : reader->ops;
+            op->offset = start;
+            op->size = end - start;
+            op->buffer = next;
+        } else {
+            op->size = end - op->offset;
+        }
+        reader->op_of_row[i] = (size_t)(op - reader->ops);
+    }
+    if (read_ops(store->fd, reader->ops, n_ops) != 0) return 1;
+
+    for (size_t i = 0; i < in_store; i++) {
+        uint64_t start = spans[2 * i], end = spans[2 * i + 1];
+        if (!valid_span(store, start, end)) continue;
+        op = &reader->ops[reader->op_of_row[i]];
+        parse_record(store, &rows[i], op->buffer + (start - op->offset), end - start);
+    }
+    return 0;
+}
+
+size_t rowstore_line_length(const RowFetch* row) {
+    size_t len = row->url_prefix_len + row->url_len;
+    if (!(row->skills_len & ROWS_NO_SKILLS)) {
+        len += 1 + (row->skills_len & ROWS_LENGTH_MASK);
+        if (row->skills_len & ROWS_QUOTED) len += 2;
+    }
+    if (!(row->skills_len & ROWS_NO_NEWLINE)) len++;
+    return len;
+}
+
+size_t rowstore_line(const RowFetch* row, char* buffer, size_t size) {
+    if (size == 0) return 0;
+    size_t len = 0;
+    size_t room = size - 1;
+    size_t n = row->url_prefix_len < room ? row->url_prefix_len : room;
+    memcpy(buffer, row->url_prefix, n);
+    len += n;
+    n = row->url_len < room - len ? row->url_len : room - len;
+    memcpy(buffer + len, row->url, n);
+    len += n;
+    if (!(row->skills_len & ROWS_NO_SKILLS) && len < room) {
+        int quoted = (row->skills_len & ROWS_QUOTED) != 0;
+        buffer[len++] = ',';
+        if (quoted && len < room) buffer[len++] = '"';
+        size_t skills_len = row->skills_len & ROWS_LENGTH_MASK;
+        n = skills_len < room - len ? skills_len : room - len;
+        memcpy(buffer + len, row->skills, n);
+        len += n;
+        if (quoted && len < room) buffer[len++] = '"';
+    }
+    if (!(row->skills_len & ROWS_NO_NEWLINE) && len < room) buffer[len++] = '\n';
+    buffer[len] = '\0';
+    return len;
+}
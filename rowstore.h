@@ -0,0 +1,129 @@
+#ifndef ROWSTORE_H
+#define ROWSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Almacén de filas por row ID (dist/jobs.rows, formato 4 sin -z).
+//
+// Cada fila de data.csv se guarda como su URL y su campo de skills, con la
+// longitud de las skills delante, y se localiza por row ID sin pasar por
+// jobs.idx:
+//
+//   [RowStoreHeader][grupos: n_rows / ROWS_GROUP_ROWS + 1 posiciones uint64]
+//   [tabla: n_rows + 1 posiciones uint32][registros...]
+//
+// La fila i empieza en grupos[i / ROWS_GROUP_ROWS] + tabla[i]: la tabla es
+// relativa al inicio del grupo de la fila, así que cuesta 4 bytes por fila.
+// La última posición marca el final del archivo y cada fila es
+// [pos(i), pos(i + 1)). Un registro es [varint][URL][skills], con el varint
+// igual a la longitud de las skills por 8 más los flags ROWS_RECORD_*; la
+// URL es el resto del registro, sin el prefijo que comparten todas las URL
+// (guardado una vez en la cabecera). La coma que separa los dos campos, el
+// salto de línea y las comillas que rodean al campo de skills no se
+// guardan. Con los flags se rehace la línea tal cual.
+//
+// El motor carga los grupos al abrir el almacén y lee las filas de una
+// página de resultados de una vez: ordenadas por row ID, las posiciones y
+// los registros cercanos se juntan en pocas lecturas grandes (ver
+// rowstore_fetch).
+
+// "JOBROWS" en little endian
+#define ROWS_MAGIC 0x53574F52424F4AULL
+#define ROWS_VERSION 2
+#define ROWS_GROUP_ROWS 4096
+#define ROWS_MAX_URL_PREFIX 128
+
+// Flags del varint de un registro
+#define ROWS_RECORD_NO_SKILLS 1     // La línea no tiene coma: solo URL
+#define ROWS_RECORD_NO_NEWLINE 2    // Última línea de data.csv, sin '\n'
+#define ROWS_RECORD_QUOTED 4        // El campo de skills iba entre comillas
+#define ROWS_RECORD_FLAG_BITS 3
+
+// Bits altos de RowFetch.skills_len
+#define ROWS_NO_SKILLS 0x80000000u
+#define ROWS_NO_NEWLINE 0x40000000u
+#define ROWS_QUOTED 0x20000000u
+#define ROWS_LENGTH_MASK 0x1FFFFFFFu
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t n_rows;
+    uint64_t groups_offset;
+    uint64_t table_offset;
+    uint64_t csv_size;      // Bytes de data.csv cubiertos
+    uint64_t url_prefix_len;
+    char url_prefix[ROWS_MAX_URL_PREFIX];   // Prefijo común de todas las URL
+} RowStoreHeader;
+
+// Escribe en 'filename' (como .tmp, renombrado al terminar) un registro por
+// cada línea de datos de los 'size' bytes del CSV; la cabecera no cuenta.
+int rowstore_build(const char* filename, const char* csv, size_t size);
+
+// Almacén abierto. Con use_map se proyecta en memoria y las filas se leen
+// del mapa; si no, con pread. Se puede compartir entre hilos.
+typedef struct {
+    int fd;
+    RowStoreHeader header;
+    uint64_t file_size;
+    const char* map;        // NULL si no está proyectado
+    uint64_t* groups;       // Inicio de cada grupo de filas
+} RowStore;
+
+int rowstore_open(RowStore* store, const char* filename, int use_map);
+void rowstore_close(RowStore* store);
+
+// Fila pedida a rowstore_fetch. 'url' y 'skills' apuntan al buffer del
+// lector (o al mapa) y valen hasta la siguiente lectura; 'url' va sin el
+// prefijo común y, con ROWS_QUOTED, 'skills' sin las comillas.
+typedef struct {
+    uint64_t row;
+    int found;
+    const char* url_prefix;
+    uint32_t url_prefix_len;
+    const char* url;
+    uint32_t url_len;
+    const char* skills;
+    uint32_t skills_len;    // Longitud y flags ROWS_*
+} RowFetch;
+
+struct ReadOp;
+
+// Lector de un almacén, uno por respuesta: guarda los buffers de las
+// lecturas por lotes para reutilizarlos.
+typedef struct {
+    const RowStore* store;
+    uint32_t* table;        // Tramos de la tabla leídos
+    size_t table_capacity;
+    size_t* op_of_row;      // Lectura de los registros de cada fila pedida
+    size_t op_of_row_capacity;
+    uint64_t* spans;        // Inicio y fin del registro de cada fila pedida
+    size_t spans_capacity;
+    char* data;             // Tramos de registros leídos
+    size_t data_capacity;
+    struct ReadOp* ops;
+    size_t ops_capacity;
+} RowReader;
+
+void rowstore_reader_init(RowReader* reader, const RowStore* store);
+void rowstore_reader_free(RowReader* reader);
+
+// Lee las filas de rows[0..n), que deben ir en orden creciente de row ID.
+// Las que no están en el almacén quedan con found = 0. Primero se leen los
+// tramos de la tabla que cubren las filas y después los de los registros;
+// dos filas cercanas comparten lectura. Compilado con ROWS_IO_URING, cada
+// grupo de lecturas se envía al kernel de una vez con io_uring (con pread
+// si el kernel no lo admite). Devuelve 1 si falla la E/S.
+int rowstore_fetch(RowReader* reader, RowFetch* rows, size_t n);
+
+// Rehace la línea de una fila encontrada con la semántica de fgets: con el
+// '\n' y cortada a size - 1 bytes. Devuelve su longitud.
+size_t rowstore_line(const RowFetch* row, char* buffer, size_t size);
+
+// Longitud de la línea entera de una fila encontrada, con el '\n': con un
+// buffer de un byte más, rowstore_line no la corta.
+size_t rowstore_line_length(const RowFetch* row);
+
+#endif
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "segments.h"
+
+int segments_read(SegmentManifest* manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    FILE* file = fopen(SEGMENTS_FILE, "rb");
+    if (!file) return 0; // Sin manifiesto: solo está la base
+
+    SegManifestHeader header;
+    int failed = fread(&header, sizeof(header), 1, file) != 1 ||
+                 header.magic != SEG_MAGIC || header.version != SEG_VERSION ||
+                 header.n_segments > MAX_SEGMENTS - 1 ||
+                 fread(manifest->segments, sizeof(SegmentEntry), header.n_segments, file) != header.n_segments;
+    fclose(file);
+    if (failed) {
+        fprintf(stderr, "Error: manifiesto de segmentos %s corrupto\n", SEGMENTS_FILE);
+        memset(manifest, 0, sizeof(*manifest));
+        return 1;
+    }
+    manifest->next_id = header.next_id;
+    manifest->n_segments = header.n_segments;
+    return 0;
+}
+
+int segments_write(const SegmentManifest* manifest) {
+    if (manifest->n_segments == 0) {
+        if (remove(SEGMENTS_FILE) != 0 && access(SEGMENTS_FILE, F_OK) == 0) {
+            perror("Error al borrar el manifiesto de segmentos");
+            return 1;
+        }
+        return 0;
+    }
+
+    SegManifestHeader header = {0};
+    header.magic = SEG_MAGIC;
+    header.version = SEG_VERSION;
+    header.n_segments = manifest->n_segments;
+    header.next_id = manifest->next_id;
+
+    const char* tmp = SEGMENTS_FILE ".tmp";
+    FILE* file = fopen(tmp, "wb");
+    if (!file) {
+        perror("Error al crear el manifiesto de segmentos");
+        return 1;
+    }
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1 ||
+                 fwrite(manifest->segments, sizeof(SegmentEntry), manifest->n_segments, file) != manifest->n_segments;
+    if (fclose(file) != 0) failed = 1;
+    if (!failed && rename(tmp, SEGMENTS_FILE) != 0) failed = 1;
+    if (failed) {
+        perror("Error al escribir el manifiesto de segmentos");
+        remove(tmp);
+    }
+    return failed;
+}
+
+void segments_file_names(uint32_t id, char* skl, char* idx, size_t size) {
+    snprintf(skl, size, "dist/jobs.%u.skl", id);
+    snprintf(idx, size, "dist/jobs.%u.idx", id);
+}
+
+int segments_lock(const char* path, int wait) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Error al abrir el archivo de bloqueo");
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void segments_unlock(int fd) {
+    if (fd < 0) return;
+    flock(fd, LOCK_UN);
+    close(fd);
+}
@@ -0,0 +1,63 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Segmentos del índice. El índice base (jobs.skl/jobs.idx) cubre data.csv
+// desde el principio; cada 'index -u' indexa solo las filas añadidas desde
+// entonces en un segmento delta (jobs.<id>.skl/jobs.<id>.idx) y lo registra
+// en el manifiesto jobs.seg. El motor busca en la base y en los deltas, e
+// 'index -c' los fusiona de nuevo en una sola base.
+//
+// Formato de jobs.seg: [SegManifestHeader][n_segments * SegmentEntry], con
+// los deltas en orden de rango. Se reescribe entero (.tmp + rename) bajo
+// SEGMENTS_LOCK_FILE, así los lectores nunca ven uno a medias.
+
+#define BASE_SKL_FILE "dist/jobs.skl"
+#define BASE_IDX_FILE "dist/jobs.idx"
+#define SEGMENTS_FILE "dist/jobs.seg"
+#define SEGMENTS_LOCK_FILE "dist/jobs.lock"
+#define COMPACT_LOCK_FILE "dist/jobs.compact.lock"
+
+#define MAX_SEGMENTS 32                 // Base incluida
+#define SEGMENTS_COMPACT_THRESHOLD 4    // Deltas a partir de los cuales conviene compactar
+
+// "JOBSEG" en little endian
+#define SEG_MAGIC 0x474553424F4AULL
+#define SEG_VERSION 1
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t n_segments;
+    uint32_t next_id;   // Identificador del próximo delta
+    uint32_t reserved;
+} SegManifestHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t data_start;    // Bytes [data_start, data_end) de data.csv
+    uint64_t data_end;
+} SegmentEntry;
+
+typedef struct {
+    uint32_t next_id;
+    uint32_t n_segments;
+    SegmentEntry segments[MAX_SEGMENTS - 1];
+} SegmentManifest;
+
+// Lee jobs.seg. Si no existe, devuelve un manifiesto vacío. 0 si todo va bien.
+int segments_read(SegmentManifest* manifest);
+// Escribe jobs.seg de forma atómica; sin deltas, lo borra.
+int segments_write(const SegmentManifest* manifest);
+// Nombres de los archivos de un delta.
+void segments_file_names(uint32_t id, char* skl, char* idx, size_t size);
+
+// Bloqueo exclusivo (flock) sobre 'path'. Con wait = 0 no espera y devuelve
+// -1 si otro proceso lo tiene. Devuelve el descriptor para segments_unlock.
+int segments_lock(const char* path, int wait);
+void segments_unlock(int fd);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "suggest.h"
+
+void suggest_file_name(const char* skl_name, char* sug_name, size_t size) {
+    size_t len = strlen(skl_name);
+    if (len >= 4 && strcmp(skl_name + len - 4, ".skl") == 0) len -= 4;
+    snprintf(sug_name, size, "%.*s.sug", (int)len, skl_name);
+}
+
+// 1 si a va antes que b: más filas o, a igualdad, menor número de entrada
+static int ranks_before(const SugItem* a, const SugItem* b) {
+    return a->count > b->count || (a->count == b->count && a->number < b->number);
+}
+
+// Mete el elemento en una lista ordenada de k huecos si le corresponde sitio
+static void insert_item(SugItem* list, size_t k, const SugItem* item) {
+    if (item->number == SUG_EMPTY || k == 0) return;
+    if (list[k - 1].number != SUG_EMPTY && !ranks_before(item, &list[k - 1])) return;
+    size_t i = k - 1;
+    while (i > 0 && (list[i - 1].number == SUG_EMPTY || ranks_before(item, &list[i - 1]))) {
+        list[i] = list[i - 1];
+        i--;
+    }
+    list[i] = *item;
+}
+
+static void clear_items(SugItem* list, size_t k) {
+    for (size_t i = 0; i < k; i++) {
+        list[i].number = SUG_EMPTY;
+        list[i].count = 0;
+    }
+}
+
+int suggest_build(const char* skl_name, const char* sug_name) {
+    FILE* skl = fopen(skl_name, "rb");
+    SkillDirInfo info = {0};
+    if (!skl || !read_skill_dir_header(skl, &info) || !info.front_coded || info.total_skills > UINT32_MAX) {
+        fprintf(stderr, "Error al abrir el segmento '%s'\n", skl_name);
+        if (skl) fclose(skl);
+        free_skill_dir_info(&info);
+        return 1;
+    }
+    SugHeader header = {0};
+    header.magic = SUG_MAGIC;
+    header.version = SUG_VERSION;
+    header.header_size = sizeof(SugHeader);
+    header.n_skills = info.total_skills;
+    header.data_end = info.data_end;
+    header.leaf_skills = (uint32_t)(info.block_skills * SUG_LEAF_BLOCKS);
+    header.top_k = SUG_TOP_K;
+    header.n_leaves = (header.n_skills + header.leaf_skills - 1) / header.leaf_skills;
+    size_t n_leaves = (size_t)header.n_leaves;
+    size_t k = SUG_TOP_K;
+
+    SugItem* nodes = malloc((2 * n_leaves + 1) * k * sizeof(SugItem));
+    int failed = !nodes;
+    if (nodes) clear_items(nodes, (2 * n_leaves + 1) * k);
+
+    // 1. Las hojas, con una pasada por el directorio en orden
+    char* skill = NULL;
+    size_t capacity = 0, len;
+    SkillEntry entry;
+    for (size_t number = 0; number < header.n_skills && !failed; number++) {
+        if (!read_skill_entry(skl, &info, &skill, &capacity, &len, &entry)) {
+            failed = 1;
+            break;
+        }
+        SugItem item = { (uint32_t)number, entry.count > UINT32_MAX ? UINT32_MAX : (uint32_t)entry.count };
+        insert_item(nodes + (n_leaves + number / header.leaf_skills) * k, k, &item);
+    }
+
+    // 2. Cada nodo interno junta sus dos hijos, de abajo arriba
+    for (size_t i = n_leaves - 1; i >= 1 && i < n_leaves && !failed; i--) {
+        for (size_t j = 0; j < k; j++) {
+            insert_item(nodes + i * k, k, nodes + 2 * i * k + j);
+            insert_item(nodes + i * k, k, nodes + (2 * i + 1) * k + j);
+        }
+    }
+
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", sug_name);
+    FILE* out = failed ? NULL : fopen(tmp, "wb");
+    failed = failed || !out || fwrite(&header, sizeof(header), 1, out) != 1 ||
+             fwrite(nodes, sizeof(SugItem), 2 * n_leaves * k, out) != 2 * n_leaves * k;
+    if (out && fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp, sug_name) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "Error al escribir el índice de autocompletado '%s'\n", sug_name);
+        remove(tmp);
+    }
+
+    fclose(skl);
+    free_skill_dir_info(&info);
+    free(skill);
+    free(nodes);
+    return failed;
+}
+
+int suggest_open(SuggestIndex* index, const char* filename) {
+    memset(index, 0, sizeof(*index));
+    FILE* file = fopen(filename, "rb");
+    if (!file) return 1;
+
+    SugHeader* header = &index->header;
+    int ok = fread(header, sizeof(*header), 1, file) == 1 && header->magic == SUG_MAGIC &&
+             header->version == SUG_VERSION && header->header_size == sizeof(SugHeader) &&
+             header->leaf_skills > 0 && header->top_k > 0 && header->top_k <= SUG_TOP_K &&
+             header->n_leaves == (header->n_skills + header->leaf_skills - 1) / header->leaf_skills;
+    size_t n_items = ok ? (size_t)(2 * header->n_leaves * header->top_k) : 0;
+    if (ok) {
+        index->nodes = malloc((n_items > 0 ? n_items : 1) * sizeof(SugItem));
+        ok = index->nodes && fread(index->nodes, sizeof(SugItem), n_items, file) == n_items;
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Formato de %s no soportado\n", filename);
+        suggest_close(index);
+        return 1;
+    }
+    return 0;
+}
+
+void suggest_close(SuggestIndex* index) {
+    free(index->nodes);
+    memset(index, 0, sizeof(*index));
+}
+
+// Entradas sueltas de un extremo del tramo, leídas del directorio
+typedef struct {
+    size_t lo;
+    size_t hi;
+    SugItem* list;
+    size_t k;
+} EdgeScan;
+
+static int visit_edge(void* arg, size_t number, const char* name, size_t len, const SkillEntry* entry) {
+    (void)name;
+    (void)len;
+    EdgeScan* scan = arg;
+    if (number >= scan->hi) return 1;
+    if (number >= scan->lo) {
+        SugItem item = { (uint32_t)number, entry->count > UINT32_MAX ? UINT32_MAX : (uint32_t)entry->count };
+        insert_item(scan->list, scan->k, &item);
+    }
+    return 0;
+}
+
+static int scan_entries(FILE* skl_file, const SkillDirInfo* info, size_t lo, size_t hi, SugItem* list,
+                        size_t k) {
+    EdgeScan scan = { lo, hi, list, k };
+    for (size_t block = lo / info->block_skills; lo < hi && block * info->block_skills < hi; block++) {
+        if (!visit_skill_block(skl_file, info, block, visit_edge, &scan)) return 1;
+    }
+    return 0;
+}
+
+int suggest_top(const SuggestIndex* index, FILE* skl_file, const SkillDirInfo* info, const char* prefix,
+                size_t prefix_len, size_t k, SugItem* out, size_t* n) {
+    const SugHeader* header = &index->header;
+    *n = 0;
+    if (k > header->top_k) k = header->top_k;
+    if (header->n_skills != info->total_skills) return 1;
+
+    size_t first, end;
+    if (!find_prefix_range(skl_file, info, prefix, prefix_len, &first, &end)) return 1;
+    clear_items(out, k);
+
+    // Grupos enteros [a, b) del tramo; lo que queda fuera, del directorio
+    size_t leaf = header->leaf_skills;
+    size_t a = (first + leaf - 1) / leaf;
+    size_t b = end / leaf;
+    if (a >= b) {
+        if (scan_entries(skl_file, info, first, end, out, k) != 0) return 1;
+    } else {
+        if (scan_entries(skl_file, info, first, a * leaf, out, k) != 0 ||
+            scan_entries(skl_file, info, b * leaf, end, out, k) != 0) {
+            return 1;
+        }
+        size_t top_k = header->top_k;
+        for (size_t l = a + header->n_leaves, r = b + header->n_leaves; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) {
+                for (size_t j = 0; j < k; j++) insert_item(out, k, index->nodes + l * top_k + j);
+                l++;
+            }
+            if (r & 1) {
+                r--;
+                for (size_t j = 0; j < k; j++) insert_item(out, k, index->nodes + r * top_k + j);
+            }
+        }
+    }
+    while (*n < k && out[*n].number != SUG_EMPTY) (*n)++;
+    return 0;
+}
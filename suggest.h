@@ -0,0 +1,74 @@
+#ifndef SUGGEST_H
+#define SUGGEST_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "index_reader.h"
+
+// Autocompletado de skills (dist/jobs.sug, directorio de la base por bloques).
+//
+// En el directorio ordenado, las skills que empiezan por un prefijo son un
+// tramo contiguo de números de entrada: el directorio ya es el trie, y el
+// tramo sale de las cabezas de bloque (find_prefix_range). Lo que guarda
+// este archivo es, para no recorrer el tramo entero, las SUG_TOP_K skills con
+// más filas de cada grupo de leaf_skills entradas y de cada nodo de un árbol
+// de segmentos sobre los grupos:
+//
+//   [SugHeader][nodos 0 .. 2 * n_leaves - 1, top_k SugItem cada uno]
+//
+// El nodo n_leaves + j es el grupo j y el nodo i < n_leaves junta los nodos
+// 2i y 2i + 1 (el 0 no se usa). Cada lista va por filas de mayor a menor y,
+// a igualdad, por número de entrada; los huecos llevan SUG_EMPTY.
+//
+// Un prefijo se responde con los O(log n) nodos que cubren los grupos
+// enteros del tramo y las entradas sueltas de sus dos extremos, que se leen
+// del directorio.
+
+// "JOBSUG" en little endian
+#define SUG_MAGIC 0x4755534F424AULL
+#define SUG_VERSION 1
+#define SUG_TOP_K 10
+// Entradas por grupo, en bloques del directorio
+#define SUG_LEAF_BLOCKS 4
+#define SUG_EMPTY UINT32_MAX
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t n_skills;      // Entradas del directorio de la base
+    uint64_t data_end;      // Fin del rango de data.csv de la base, como en jobs.skl
+    uint32_t leaf_skills;
+    uint32_t top_k;
+    uint64_t n_leaves;
+} SugHeader;
+
+typedef struct {
+    uint32_t number;        // Número de entrada en el directorio
+    uint32_t count;         // Filas con la skill
+} SugItem;
+
+// Nombre del .sug a partir del jobs.skl
+void suggest_file_name(const char* skl_name, char* sug_name, size_t size);
+
+// Genera 'sug_name' (como .tmp, renombrado al terminar) con una pasada por
+// el directorio de 'skl_name'. Devuelve 0 si va bien.
+int suggest_build(const char* skl_name, const char* sug_name);
+
+// Árbol cargado entero en memoria. Se puede compartir entre hilos.
+typedef struct {
+    SugHeader header;
+    SugItem* nodes;
+} SuggestIndex;
+
+int suggest_open(SuggestIndex* index, const char* filename);
+void suggest_close(SuggestIndex* index);
+
+// Las (como mucho) k <= top_k skills con más filas que empiezan por
+// 'prefix', en 'out' y en el orden del árbol. 'info' es el directorio del
+// que se generó el índice. Deja en *n cuántas hay; devuelve 0 si va bien.
+int suggest_top(const SuggestIndex* index, FILE* skl_file, const SkillDirInfo* info, const char* prefix,
+                size_t prefix_len, size_t k, SugItem* out, size_t* n);
+
+#endif
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../fuzzy.h"
+#include "../index_format.h"
+#include "../index_writer.h"
+
+// Pruebas de la búsqueda aproximada sobre un directorio pequeño generado en
+// un directorio temporal. Devuelve 0 si todas pasan.
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: falla '%s'\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Directorio con Skill00001..Skill00009, cada una en una fila
+static int write_directory(const char* skl_name, const char* idx_name) {
+    IndexWriter writer;
+    if (index_writer_open(&writer, skl_name, idx_name, SKL_VERSION_PACKED, 0) != 0) return 1;
+    index_writer_set_range(&writer, 0, 1000);
+    for (long i = 1; i <= 9; i++) {
+        char skill[16];
+        int len = snprintf(skill, sizeof(skill), "Skill%05ld", i);
+        long offset = i * 100;
+        if (index_writer_begin_skill(&writer, skill, (size_t)len, 1) != 0 ||
+            index_writer_append(&writer, &offset, 1) != 0 || index_writer_end_skill(&writer) != 0) {
+            index_writer_abort(&writer);
+            return 1;
+        }
+    }
+    return index_writer_close(&writer);
+}
+
+// Nombre de la entrada 'number' del directorio de write_directory
+static void entry_name(uint32_t number, char* out, size_t size) {
+    snprintf(out, size, "Skill%05u", number + 1);
+}
+
+// Una errata de una edición no se amplía con las skills a dos
+static void test_nearest_typo(const FuzzyIndex* index) {
+    FuzzyMatch matches[16];
+    size_t n = 0;
+    CHECK(fuzzy_lookup(index, "Skil00007", -1, matches, 16, &n) == 0);
+    CHECK(n > 1); // Las de distancia 2 (Skill00001...) también se encuentran
+    size_t nearest = fuzzy_nearest(matches, n);
+    CHECK(nearest == 1);
+    char name[16];
+    entry_name(matches[0].number, name, sizeof(name));
+    CHECK(strcmp(name, "Skill00007") == 0);
+    CHECK(matches[0].distance == 1);
+    for (size_t i = 0; i < nearest; i++) CHECK(matches[i].distance == 1);
+}
+
+// Con dos ediciones, todas las que están a dos
+static void test_nearest_two_edits(const FuzzyIndex* index) {
+    FuzzyMatch matches[16];
+    size_t n = 0;
+    CHECK(fuzzy_lookup(index, "Skil0007", -1, matches, 16, &n) == 0);
+    size_t nearest = fuzzy_nearest(matches, n);
+    CHECK(nearest >= 1);
+    for (size_t i = 0; i < nearest; i++) CHECK(matches[i].distance == matches[0].distance);
+    CHECK(fuzzy_nearest(matches, 0) == 0);
+}
+
+// La misma clave normalizada, a distancia 0
+static void test_same_key(const FuzzyIndex* index) {
+    FuzzyMatch matches[16];
+    size_t n = 0;
+    CHECK(fuzzy_lookup(index, "skill00003", 0, matches, 16, &n) == 0);
+    CHECK(n == 1);
+    CHECK(n == 1 && matches[0].distance == 0);
+}
+
+int main(void) {
+    char dir[] = "/tmp/fuzzy_testXXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char skl[64], idx[64], fzy[64];
+    snprintf(skl, sizeof(skl), "%s/jobs.skl", dir);
+    snprintf(idx, sizeof(idx), "%s/jobs.idx", dir);
+    fuzzy_file_name(skl, fzy, sizeof(fzy));
+
+    FuzzyIndex index;
+    if (write_directory(skl, idx) != 0 || fuzzy_build(skl, fzy, 0) != 0 || fuzzy_open(&index, fzy, 0) != 0) {
+        fprintf(stderr, "No se pudo generar el índice de prueba en %s\n", dir);
+        return 1;
+    }
+    test_nearest_typo(&index);
+    test_nearest_two_edits(&index);
+    test_same_key(&index);
+    fuzzy_close(&index);
+
+    unlink(skl);
+    unlink(idx);
+    unlink(fzy);
+    rmdir(dir);
+    if (failures > 0) {
+        fprintf(stderr, "fuzzy_test: %d comprobaciones fallidas\n", failures);
+        return 1;
+    }
+    printf("fuzzy_test: OK\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Pruebas de extremo a extremo de las respuestas con filas de más de 4 KB:
+// en un directorio temporal se genera un data.csv, se indexa con dist/index
+// y se piden las filas a dist/engine con PAGE y sin ella, con cada origen de
+// las filas (jobs.rows, data.csv con stdio y proyectado con -M, y jobs.docs
+// con -z). Usa los puertos del motor, así que no puede haber otro en marcha.
+// Se llama con las rutas absolutas del indexador y del motor. Devuelve 0 si
+// todas pasan.
+
+#define PORT 5050
+#define GREETING_SIZE 1023
+#define N_ROWS 6
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: falla '%s'\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Filas de data.csv, sin el salto de línea. La 1, la 3 y la 5 tienen la
+// skill LongSkill y más de 4 KB: la URL, el campo de skills y la URL de la
+// última línea, que no lleva '\n'.
+static char* rows[N_ROWS];
+
+static char* make_row(int i, size_t url_extra, size_t skills_extra, int long_skill) {
+    size_t size = 256 + url_extra + skills_extra;
+    char* row = malloc(size);
+    int len = snprintf(row, size, "https://www.linkedin.com/jobs/view/job-%d", i);
+    if (url_extra > 0) {
+        row[len++] = '?';
+        memset(row + len, 'a' + i, url_extra);
+        len += (int)url_extra;
+    }
+    len += snprintf(row + len, size - (size_t)len, ",\"%sShort", long_skill ? "LongSkill, " : "");
+    for (size_t k = 0; k < skills_extra / 11; k++) len += snprintf(row + len, size - (size_t)len, ", Skill%04zu", k);
+    snprintf(row + len, size - (size_t)len, "\"");
+    return row;
+}
+
+static int write_csv(void) {
+    rows[0] = make_row(0, 0, 0, 0);
+    rows[1] = make_row(1, 6000, 0, 1);
+    rows[2] = make_row(2, 0, 0, 0);
+    rows[3] = make_row(3, 0, 5000, 1);
+    rows[4] = make_row(4, 0, 0, 0);
+    rows[5] = make_row(5, 4500, 0, 1);
+    FILE* csv = fopen("data.csv", "w");
+    if (!csv) return 1;
+    fputs("job_link,job_skills\n", csv);
+    for (int i = 0; i < N_ROWS; i++) fprintf(csv, "%s%s", rows[i], i + 1 < N_ROWS ? "\n" : "");
+    return fclose(csv) != 0;
+}
+
+// Ejecuta un programa con la salida a dist/test.log y devuelve su pid
+static pid_t spawn(char* const argv[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int log = open("dist/test.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int run(char* const argv[]) {
+    int status = 0;
+    pid_t pid = spawn(argv);
+    return pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+static int connect_engine(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in server = { .sin_family = AF_INET, .sin_port = htons(PORT) };
+    inet_pton(AF_INET, "127.0.0.1", &server.sin_addr);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&server, sizeof(server)) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Envía una petición por el protocolo de texto y devuelve la respuesta
+// entera (el motor cierra al responder porque ya no se envía nada más)
+static char* request(const char* text, size_t* len) {
+    int fd = connect_engine();
+    if (fd < 0) return NULL;
+    char greeting[GREETING_SIZE];
+    size_t got = 0;
+    ssize_t n = 1;
+    while (got < sizeof(greeting) && (n = recv(fd, greeting + got, sizeof(greeting) - got, 0)) > 0) got += (size_t)n;
+    size_t capacity = 1 << 16;
+    char* reply = malloc(capacity);
+    *len = 0;
+    if (got < sizeof(greeting) || send(fd, text, strlen(text), 0) < 0 || shutdown(fd, SHUT_WR) != 0) n = -1;
+    while (n > 0) {
+        if (*len == capacity) reply = realloc(reply, capacity *= 2);
+        n = recv(fd, reply + *len, capacity - *len, 0);
+        if (n > 0) *len += (size_t)n;
+    }
+    close(fd);
+    if (n < 0) {
+        free(reply);
+        return NULL;
+    }
+    return reply;
+}
+
+// Las tres filas con LongSkill llegan enteras en una página
+static void check_page(void) {
+    size_t len = 0;
+    char* reply = request("PAGE 10 0\nLongSkill", &len);
+    CHECK(reply != NULL);
+    if (!reply) return;
+    const char* p = reply;
+    const char* end = reply + len;
+    size_t total = 0, n = 0;
+    int consumed = 0;
+    CHECK(sscanf(p, "OK %zu %zu -\n%n", &total, &n, &consumed) == 2 && consumed > 0);
+    CHECK(total == 3 && n == 3);
+    p += consumed;
+    for (int i = 1; i < N_ROWS && consumed > 0; i += 2) {
+        size_t row_len = 0;
+        consumed = 0;
+        CHECK(sscanf(p, "%zu\n%n", &row_len, &consumed) == 1 && consumed > 0);
+        p += consumed;
+        CHECK(row_len == strlen(rows[i]) && row_len > 4096);
+        CHECK(p + row_len <= end && memcmp(p, rows[i], strlen(rows[i])) == 0);
+        p += row_len;
+    }
+    CHECK(p == end);
+    free(reply);
+}
+
+// Sin PAGE, la primera fila va entera y la segunda, que ya no cabe en la
+// respuesta, se sustituye por el aviso en lugar de cortarse
+static void check_legacy(void) {
+    size_t len = 0;
+    char* reply = request("LongSkill", &len);
+    CHECK(reply != NULL);
+    if (!reply) return;
+    const char* truncated = "\n... (resultados truncados) ...";
+    size_t row_len = strlen(rows[1]);
+    CHECK(len == row_len + 1 + strlen(truncated));
+    CHECK(len > row_len && memcmp(reply, rows[1], row_len) == 0 && reply[row_len] == '\n');
+    CHECK(len == row_len + 1 + strlen(truncated) && memcmp(reply + row_len + 1, truncated, strlen(truncated)) == 0);
+    free(reply);
+}
+
+// Arranca el motor con la opción dada (o ninguna), espera a que acepte
+// conexiones, hace las pruebas dos veces (la segunda, desde la caché) y lo
+// para
+static void check_engine(const char* engine, const char* option) {
+    char* argv[] = { (char*)engine, (char*)option, NULL };
+    pid_t pid = spawn(argv);
+    CHECK(pid > 0);
+    if (pid <= 0) return;
+    int ready = 0;
+    for (int attempt = 0; attempt < 100 && !ready; attempt++) {
+        int fd = connect_engine();
+        if (fd >= 0) {
+            close(fd);
+            ready = 1;
+        } else {
+            usleep(50000);
+        }
+    }
+    CHECK(ready);
+    for (int pass = 0; ready && pass < 2; pass++) {
+        check_page();
+        check_legacy();
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 || argv[1][0] != '/' || argv[2][0] != '/') {
+        fprintf(stderr, "Uso: %s <ruta absoluta de index> <ruta absoluta de engine>\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    char dir[] = "/tmp/page_testXXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0 || mkdir("dist", 0755) != 0 || write_csv() != 0) {
+        perror("Error al preparar el directorio de prueba");
+        return 1;
+    }
+
+    // jobs.rows, y sin él data.csv con stdio y proyectado
+    char* index[] = { argv[1], NULL };
+    CHECK(run(index) == 0);
+    check_engine(argv[2], NULL);
+    CHECK(remove("dist/jobs.rows") == 0);
+    check_engine(argv[2], NULL);
+    check_engine(argv[2], "-M");
+
+    // jobs.docs
+    char* index_zstd[] = { argv[1], "-z", NULL };
+    CHECK(run(index_zstd) == 0);
+    check_engine(argv[2], NULL);
+
+    for (int i = 0; i < N_ROWS; i++) free(rows[i]);
+    if (failures > 0) {
+        fprintf(stderr, "page_test: %d comprobaciones fallidas (registro en %s/dist/test.log)\n", failures, dir);
+        return 1;
+    }
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) fprintf(stderr, "Aviso: no se pudo borrar %s\n", dir);
+    printf("page_test: OK\n");
+    return 0;
+}
@@ -4,11 +4,12 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stdint.h>
 #include "utils.h"
+#include "protocol.h"
 #include <arpa/inet.h>
 #include <signal.h>
 
-#define PORT 5050
 #define BUFFER_SIZE 1024
 /**
  * Server IP address
@@ -17,8 +18,188 @@
  */
 #define HOST "127.0.0.1"
 
+// Filas por página de resultados
+#define PAGE_SIZE 10
+// Skills que se sugieren al escribir un criterio
+#define SUGGESTIONS 5
+
 int serverFd = -1;
 
+// Lectura de las respuestas del motor por el protocolo binario (ver
+// protocol.h). Cada petición lleva su id y la respuesta se recibe entera en
+// memoria; de ahí se leen la cabecera y las filas.
+typedef struct {
+    char* data;
+    size_t len;
+    size_t pos;
+} Reply;
+
+// Id de la siguiente petición
+uint32_t next_request_id = 1;
+
+// Recibe exactamente n bytes. Devuelve 0 si el motor cierra la conexión o hay un error.
+static int recv_all(void* out, size_t n) {
+    size_t received = 0;
+    while (received < n) {
+        ssize_t check = recv(serverFd, (char*)out + received, n - received, 0);
+        if (check <= 0) return 0;
+        received += (size_t)check;
+    }
+    return 1;
+}
+
+// Envía 'text' como petición PROTO_QUERY y espera su respuesta. Devuelve 0 si
+// se pierde la conexión con el motor.
+static int request_text(const char* text, Reply* reply) {
+    uint8_t header[PROTO_HEADER_SIZE];
+    ProtoHeader request = { PROTO_VERSION, PROTO_QUERY, 0, next_request_id++, (uint32_t)strlen(text) };
+    proto_write_header(header, &request);
+    if (send(serverFd, header, sizeof(header), 0) < 0 || send(serverFd, text, strlen(text), 0) < 0) {
+        perror("Error al enviar la consulta al motor");
+        return 0;
+    }
+    // La ui solo tiene una petición en curso: la respuesta es la suya
+    ProtoHeader response;
+    if (!recv_all(header, sizeof(header))) return 0;
+    proto_read_header(header, &response);
+    if (response.version != PROTO_VERSION || response.id != request.id) return 0;
+    reply->data = malloc((size_t)response.length + 1);
+    reply->len = response.length;
+    reply->pos = 0;
+    if (!reply->data || !recv_all(reply->data, reply->len)) {
+        free(reply->data);
+        reply->data = NULL;
+        return 0;
+    }
+    reply->data[reply->len] = '\0';
+    if (response.type != (PROTO_QUERY | PROTO_REPLY)) {
+        fprintf(stderr, "Error del motor: %s\n", reply->data);
+        free(reply->data);
+        reply->data = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Lee una línea sin el '\n'. Devuelve 0 si no está completa.
+static int read_response_line(Reply* reply, char* line, size_t size) {
+    char* newline = memchr(reply->data + reply->pos, '\n', reply->len - reply->pos);
+    if (!newline) return 0;
+    size_t len = (size_t)(newline - (reply->data + reply->pos));
+    if (len >= size) return 0;
+    memcpy(line, reply->data + reply->pos, len);
+    line[len] = '\0';
+    reply->pos += len + 1;
+    return 1;
+}
+
+// Lee exactamente n bytes en 'out' (n < size) y los termina en '\0'
+static int read_response_bytes(Reply* reply, char* out, size_t n, size_t size) {
+    if (n >= size || reply->len - reply->pos < n) return 0;
+    memcpy(out, reply->data + reply->pos, n);
+    out[n] = '\0';
+    reply->pos += n;
+    return 1;
+}
+
+// Pide y muestra la página de 'query' que empieza en 'cursor'. Guarda en
+// *next el cursor de la página siguiente (-1 si no hay). Devuelve 0 si se
+// pierde la conexión con el motor.
+static int show_page(const char* query, long cursor, int page_number, long* next) {
+    char request[BUFFER_SIZE + 64];
+    snprintf(request, sizeof(request), "PAGE %d %ld\n%s", PAGE_SIZE, cursor, query);
+    *next = -1;
+
+    // Medir tiempo de respuesta
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    // Enviar la consulta al motor y recibir la página entera
+    Reply reply = { 0 };
+    char header[256];
+    if (!request_text(request, &reply) || !read_response_line(&reply, header, sizeof(header))) {
+        free(reply.data);
+        fprintf(stderr, "Error al recibir la respuesta del motor\n");
+        return 0;
+    }
+    // Calcular tiempo transcurrido
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    printf("\n--- Resultados de la Búsqueda ---\n");
+    if (strncmp(header, "ERR ", 4) == 0) {
+        printf("Consulta no válida: %s\n", header + 4);
+        printf("---------------------------------\n");
+        free(reply.data);
+        return 1;
+    }
+    size_t total, n;
+    char next_cursor[32];
+    if (sscanf(header, "OK %zu %zu %31s", &total, &n, next_cursor) != 3) {
+        fprintf(stderr, "Respuesta del motor no válida: %s\n", header);
+        free(reply.data);
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        char length[32], row[4096];
+        size_t len;
+        if (!read_response_line(&reply, length, sizeof(length)) || sscanf(length, "%zu", &len) != 1 ||
+            !read_response_bytes(&reply, row, len, sizeof(row))) {
+            fprintf(stderr, "Respuesta del motor no válida\n");
+            free(reply.data);
+            return 0;
+        }
+        if (i == 0) {
+            char time_buffer[100];
+            format_time(time_buffer, sizeof(time_buffer), &start_time, &end_time);
+            printf("Tiempo de respuesta: %s\n", time_buffer);
+            printf("%zu ofertas. Página %d (%zu-%zu)\n\n", total, page_number + 1,
+                   (size_t)page_number * PAGE_SIZE + 1, (size_t)page_number * PAGE_SIZE + n);
+        }
+        printf("%zu. %s\n", (size_t)page_number * PAGE_SIZE + i + 1, row);
+    }
+    free(reply.data);
+    if (n == 0) {
+        // No se encontraron ofertas con TODOS los criterios especificados.
+        printf("NA\n");
+    }
+    if (strcmp(next_cursor, "-") != 0) *next = atol(next_cursor);
+    printf("---------------------------------\n");
+    return 1;
+}
+
+// Pide al motor las skills con más ofertas que empiezan por 'prefix'.
+// Guarda en *n cuántas llegan (0 si el motor no tiene autocompletado).
+// Devuelve 0 si se pierde la conexión con el motor.
+static int fetch_suggestions(const char* prefix, char names[][256], size_t* n) {
+    char request[BUFFER_SIZE + 64];
+    snprintf(request, sizeof(request), "SUGGEST %d\n%s", SUGGESTIONS, prefix);
+    *n = 0;
+    Reply reply = { 0 };
+    char line[512];
+    size_t total;
+    if (!request_text(request, &reply) || !read_response_line(&reply, line, sizeof(line))) {
+        free(reply.data);
+        fprintf(stderr, "Error al recibir la respuesta del motor\n");
+        return 0;
+    }
+    if (sscanf(line, "OK %zu", &total) != 1) total = 0; // ERR: sin sugerencias
+    for (size_t i = 0; i < total; i++) {
+        unsigned count;
+        int offset;
+        if (!read_response_line(&reply, line, sizeof(line)) || sscanf(line, "%u %n", &count, &offset) != 1) break;
+        if (*n < SUGGESTIONS) snprintf(names[(*n)++], 256, "%s", line + offset);
+    }
+    free(reply.data);
+    return 1;
+}
+
+// Un criterio que es una sola skill, sin operadores ni paréntesis, se puede
+// completar con las sugerencias del motor
+static int is_plain_skill(const char* criterion) {
+    return criterion[0] != '\0' && !strpbrk(criterion, ";()\"") && !strstr(criterion, " OR ") &&
+           !strstr(criterion, " AND ") && strncmp(criterion, "NOT ", 4) != 0;
+}
+
 void clean_stdin() {
     int c;
     while ((c = getchar()) != '\n' && c != EOF);
@@ -52,7 +233,7 @@ int main(void) {
         exit(1);
     }
 
-    printf("Iniciando cliente en %s:%d\n", HOST, PORT);
+    printf("Iniciando cliente en %s:%d\n", HOST, PROTO_PORT);
 
     struct sockaddr_in server;
     
@@ -78,7 +259,7 @@ int main(void) {
     }
 
     // Configurar el servidor
-    server.sin_port = htons(PORT);
+    server.sin_port = htons(PROTO_PORT);
     server.sin_family = AF_INET;
     server.sin_addr.s_addr = inet_addr(HOST);
 
@@ -92,37 +273,30 @@ int main(void) {
         exit(1);
     }
 
-    printf("Conectado al servidor en %s:%d\n", HOST, PORT);
-
-    char buffer[BUFFER_SIZE] = {0};
-
-    // Recibir respuesta del servidor
-    check = recv(serverFd, buffer, BUFFER_SIZE, 0);
+    printf("Conectado al servidor en %s:%d\n", HOST, PROTO_PORT);
 
-    if (check <= 0)
-    {
-        if (check == 0) {
-            printf("El servidor ha cerrado la conexión\n");
-        } else {
-            perror("Error al recibir la respuesta");
-        }
-        close(serverFd);
-        exit(1);
-    }
-    
-    buffer[check] = '\0'; // 0 al final
-    printf("Respuesta del servidor: %s\n", buffer);
+    // El protocolo binario no tiene saludo: la conexión ya está lista
 
     char* criteria[3] = {NULL, NULL, NULL};
     int choice;
 
+    // Búsqueda actual: el cursor de cada página vista, para poder volver
+    char current_query[BUFFER_SIZE] = "";
+    long* page_cursors = NULL;
+    int page = -1;              // -1 si aún no hay búsqueda
+    long next_cursor = -1;
+
     while (1) {
         printf("\n--- Buscador de Empleos Multi-Criterio ---\n");
+        printf("(Cada criterio admite AND, OR, NOT y paréntesis, p. ej. \"Python OR Go\")\n");
+        printf("(Sin comillas se incluyen variantes y erratas: \"python\" encuentra Python y Pythón)\n");
         printf("1. Ingresar primer criterio (Actual: %s)\n", criteria[0] ? criteria[0] : "Ninguno");
         printf("2. Ingresar segundo criterio (Actual: %s)\n", criteria[1] ? criteria[1] : "Ninguno");
         printf("3. Ingresar tercer criterio (Actual: %s)\n", criteria[2] ? criteria[2] : "Ninguno");
         printf("4. Realizar búsqueda\n");
-        printf("5. Salir\n");
+        printf("5. Página siguiente\n");
+        printf("6. Página anterior\n");
+        printf("7. Salir\n");
         printf("Seleccione una opción: ");
 
         if (scanf("%d", &choice) != 1) {
@@ -143,6 +317,22 @@ int main(void) {
             }
             buffer[strcspn(buffer, "\n")] = 0;
 
+            // Ofrecer las skills más frecuentes que empiezan por lo escrito
+            char suggestions[SUGGESTIONS][256];
+            size_t n_suggestions = 0;
+            if (is_plain_skill(buffer) && !fetch_suggestions(buffer, suggestions, &n_suggestions)) break;
+            if (n_suggestions > 0 && !(n_suggestions == 1 && strcmp(suggestions[0], buffer) == 0)) {
+                printf("Sugerencias:\n");
+                for (size_t i = 0; i < n_suggestions; i++) printf("  %zu. %s\n", i + 1, suggestions[i]);
+                printf("Elija una sugerencia (Enter para dejar \"%s\"): ", buffer);
+                char answer[32];
+                int pick;
+                if (fgets(answer, sizeof(answer), stdin) && sscanf(answer, "%d", &pick) == 1 && pick >= 1 &&
+                    (size_t)pick <= n_suggestions) {
+                    snprintf(buffer, sizeof(buffer), "%s", suggestions[pick - 1]);
+                }
+            }
+
             if (criteria[index] != NULL) {
                 free(criteria[index]); // Liberar criterio anterior si existe
             }
@@ -165,40 +355,38 @@ int main(void) {
                 continue;
             }
 
-            // Medir tiempo de respuesta
-            struct timespec start_time, end_time;
-            clock_gettime(CLOCK_MONOTONIC, &start_time);
-            
-            // Enviar la consulta al motor
-            check = send(serverFd, query_string, strlen(query_string), 0);
-
-            if (check < 0) {
-                perror("Error al enviar la consulta al motor");
-                close(serverFd);
+            // Nueva búsqueda: primera página
+            long* cursors = realloc(page_cursors, sizeof(long));
+            if (!cursors) {
+                perror("Error al reservar memoria");
                 continue;
             }
-
-            // Recibir respuesta
-            char result_buffer[8192];
-            ssize_t bytes_read = recv(serverFd, result_buffer, sizeof(result_buffer) - 1, 0);
-            
-            // Calcular tiempo transcurrido
-            clock_gettime(CLOCK_MONOTONIC, &end_time);
-            char time_buffer[100];
-            format_time(time_buffer, sizeof(time_buffer), &start_time, &end_time);
-
-            result_buffer[bytes_read] = '\0';
-            printf("\n--- Resultados de la Búsqueda ---\n");
-            printf("Tiempo de respuesta: %s\n\n", time_buffer);
-            if (strcmp(result_buffer, "NA") == 0) {
-                // No se encontraron ofertas con TODOS los criterios especificados.
-                printf("NA\n");
-            } else {
-                printf("%s", result_buffer);
-            }
-            printf("---------------------------------\n");
-
+            page_cursors = cursors;
+            page_cursors[0] = 0;
+            page = 0;
+            snprintf(current_query, sizeof(current_query), "%s", query_string);
+            if (!show_page(current_query, page_cursors[page], page, &next_cursor)) break;
         } else if (choice == 5) {
+            if (page < 0 || next_cursor < 0) {
+                printf("No hay más páginas.\n");
+                continue;
+            }
+            long* cursors = realloc(page_cursors, (size_t)(page + 2) * sizeof(long));
+            if (!cursors) {
+                perror("Error al reservar memoria");
+                continue;
+            }
+            page_cursors = cursors;
+            page_cursors[++page] = next_cursor;
+            if (!show_page(current_query, page_cursors[page], page, &next_cursor)) break;
+        } else if (choice == 6) {
+            if (page <= 0) {
+                printf("Ya está en la primera página.\n");
+                continue;
+            }
+            page--;
+            if (!show_page(current_query, page_cursors[page], page, &next_cursor)) break;
+        } else if (choice == 7) {
             break;
         } else {
             printf("Opción no válida.\n");
@@ -206,6 +394,7 @@ int main(void) {
     }
 
     // Liberar memoria final
+    free(page_cursors);
     for (int i = 0; i < 3; i++) {
         if (criteria[i]) free(criteria[i]);
     }
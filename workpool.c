@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include "workpool.h"
+
+// Trozos pendientes de un participante: [front, back)
+typedef struct {
+    pthread_mutex_t lock;
+    size_t front;
+    size_t back;
+} TaskRange;
+
+typedef struct WorkJob {
+    void (*fn)(void* arg, size_t task);
+    void* arg;
+    size_t n_tasks;
+    int n_slots;                // Participantes: el hilo que llama y los del grupo
+    TaskRange* slots;
+    int joined;                 // Participantes que ya tienen bloque (con pool->lock)
+    int helpers;                // Hilos del grupo trabajando en ella (con pool->lock)
+    size_t done;                // Trozos terminados (con pool->lock)
+    pthread_cond_t finished;
+    struct WorkJob* next;
+} WorkJob;
+
+// Siguiente trozo: del bloque propio por delante o, si se ha acabado, robado
+// por detrás del bloque de otro participante. Devuelve 0 si no queda ninguno.
+static int next_task(WorkJob* job, int slot, size_t* task) {
+    for (int k = 0; k < job->n_slots; k++) {
+        TaskRange* range = &job->slots[(slot + k) % job->n_slots];
+        pthread_mutex_lock(&range->lock);
+        int found = range->front < range->back;
+        if (found && k == 0) *task = range->front++;
+        else if (found) *task = --range->back;
+        pthread_mutex_unlock(&range->lock);
+        if (found) return 1;
+    }
+    return 0;
+}
+
+// Quita la tarea de la lista de pendientes, si sigue en ella
+static void unlink_job(WorkPool* pool, WorkJob* job) {
+    for (WorkJob** link = &pool->jobs; *link; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            return;
+        }
+    }
+}
+
+// Ejecuta trozos de la tarea hasta que no quede ninguno sin empezar
+static void run_tasks(WorkPool* pool, WorkJob* job, int slot) {
+    size_t task;
+    while (next_task(job, slot, &task)) {
+        job->fn(job->arg, task);
+        pthread_mutex_lock(&pool->lock);
+        job->done++;
+        if (job->done == job->n_tasks) pthread_cond_signal(&job->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    // Ya no queda nada que repartir: que no se sumen más hilos
+    pthread_mutex_lock(&pool->lock);
+    unlink_job(pool, job);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void* pool_thread(void* arg) {
+    WorkPool* pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->jobs) pthread_cond_wait(&pool->work, &pool->lock);
+        WorkJob* job = pool->jobs;
+        int slot = job->joined < job->n_slots ? job->joined++ : 0;
+        job->helpers++;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_tasks(pool, job, slot);
+
+        pthread_mutex_lock(&pool->lock);
+        // Quien llamó espera a que los hilos suelten la tarea para liberarla
+        if (--job->helpers == 0) pthread_cond_signal(&job->finished);
+    }
+    return NULL;
+}
+
+int workpool_init(WorkPool* pool, int n_threads) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pool->jobs = NULL;
+    pool->n_threads = 0;
+    pool->threads = n_threads > 0 ? malloc((size_t)n_threads * sizeof(pthread_t)) : NULL;
+    if (n_threads > 0 && !pool->threads) return 1;
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_thread, pool) != 0) return 1;
+        pthread_detach(pool->threads[i]);
+        pool->n_threads++;
+    }
+    return 0;
+}
+
+void workpool_run(WorkPool* pool, size_t n_tasks, void (*fn)(void* arg, size_t task), void* arg) {
+    WorkJob job = { .fn = fn, .arg = arg, .n_tasks = n_tasks, .n_slots = pool->n_threads + 1, .joined = 1 };
+    job.slots = malloc((size_t)job.n_slots * sizeof(TaskRange));
+    if (pool->n_threads == 0 || n_tasks < 2 || !job.slots) {
+        // Sin hilos que ayuden (o sin memoria para repartir), todo aquí
+        free(job.slots);
+        for (size_t i = 0; i < n_tasks; i++) fn(arg, i);
+        return;
+    }
+    for (int s = 0; s < job.n_slots; s++) {
+        pthread_mutex_init(&job.slots[s].lock, NULL);
+        job.slots[s].front = n_tasks * (size_t)s / (size_t)job.n_slots;
+        job.slots[s].back = n_tasks * (size_t)(s + 1) / (size_t)job.n_slots;
+    }
+    pthread_cond_init(&job.finished, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    job.next = pool->jobs;
+    pool->jobs = &job;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    // El hilo que llama trabaja en su bloque (el 0) y luego roba
+    run_tasks(pool, &job, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (job.done < job.n_tasks || job.helpers > 0) pthread_cond_wait(&job.finished, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_cond_destroy(&job.finished);
+    for (int s = 0; s < job.n_slots; s++) pthread_mutex_destroy(&job.slots[s].lock);
+    free(job.slots);
+}
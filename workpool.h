@@ -0,0 +1,36 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Grupo de hilos para repartir una tarea en trozos (por ejemplo, los rangos
+// de una intersección grande). El hilo que llama a workpool_run también
+// trabaja, así que la tarea avanza aunque los hilos del grupo estén ocupados
+// con otra.
+//
+// Los trozos se reparten en bloques contiguos, uno por participante. Cada
+// uno toma los suyos por delante y, cuando se le acaban, roba por detrás
+// los que quedan en los bloques de los demás: los trozos que cuestan más de
+// lo previsto no dejan a los otros hilos parados.
+
+struct WorkJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    struct WorkJob* jobs;   // Tareas con trozos sin empezar
+    int n_threads;
+    pthread_t* threads;
+} WorkPool;
+
+// Arranca n_threads hilos (puede ser 0: workpool_run lo hace todo el hilo
+// que llama). Devuelve 0 si va bien.
+int workpool_init(WorkPool* pool, int n_threads);
+
+// Ejecuta fn(arg, i) para cada i de [0, n_tasks) y vuelve cuando han
+// terminado todos. Los trozos pueden ejecutarse en cualquier orden y a la
+// vez, cada uno en un hilo.
+void workpool_run(WorkPool* pool, size_t n_tasks, void (*fn)(void* arg, size_t task), void* arg);
+
+#endif